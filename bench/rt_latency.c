@@ -0,0 +1,385 @@
+/*
+ *  This file is owned by the Embedded Systems Laboratory of Seoul National University of Science and Technology
+ *  as a part of RT-AIDE or the RTOS-Agnostic and Interoperable Development Environment for Real-time Systems
+ *
+ *  File: rt_latency.c
+ *  Author: 2022 Raimarius Delgado
+ *  Description: cyclictest-like wakeup latency benchmark using create_rt_task/set_task_period/wait_next_period
+ *
+ *
+ *
+ *
+*/
+#include "posix_rt.h"
+#include "rt_telemetry.h"
+#include <getopt.h>
+
+#define MAX_BENCH_TASKS		(64)
+#define DEFAULT_PERIOD_US	(1000)
+#define DEFAULT_DURATION_S	(10)
+
+typedef enum _BENCH_FORMAT
+{
+	eFormatHuman = 0,
+	eFormatCsv,
+	eFormatJson,
+} BENCH_FORMAT;
+
+typedef struct _BENCH_CONFIG
+{
+	INT				nTasks;
+	RTTIME			ullPeriodNs;
+	RTTIME			ullIntervalNs;		// period increment between consecutive tasks
+	INT				nPriority;
+	BOOL			bPrioDescending;	// first task gets nPriority, the next ones one less each
+	BOOL			bHybridWakeup;
+	RTTIME			ullSpinMarginNs;	// initial margin of the hybrid wakeup, 0 for the library default
+	INT				nCpus[CPU_SETSIZE];
+	INT				nCpuCnt;
+	UINT64			ullLoops;
+	INT				nDurationSec;
+	BENCH_FORMAT	eFormat;
+	BOOL			bHistogram;
+	BOOL			bTelemetry;			// publish the tasks for rtposix-top
+	const char*		strOutput;			// report file, stdout when NULL
+} BENCH_CONFIG;
+
+typedef struct _BENCH_TASK
+{
+	POSIX_TASK		stTask;
+	INT				nCpu;
+	UINT64			ullLoops;
+} BENCH_TASK;
+
+static BENCH_TASK g_stTasks[MAX_BENCH_TASKS];
+static volatile BOOL g_bStop = FALSE;
+static FILE* g_pOutput = NULL;
+
+/*****************************************************************************/
+static void
+bench_signal_handler(int nSignal)
+{
+	g_bStop = TRUE;
+}
+/*****************************************************************************/
+static void
+bench_periodic_proc(void* arg)
+{
+	BENCH_TASK* pBench = (BENCH_TASK*)arg;
+	UINT64 ullCycles = 0;
+
+	while (g_bStop == FALSE && (pBench->ullLoops == 0 || ullCycles < pBench->ullLoops))
+	{
+		wait_next_period(NULL);
+		ullCycles++;
+	}
+}
+/*****************************************************************************/
+static INT
+parse_cpu_list(const char* astrList, INT* apnCpus)
+{
+	// accepts lists like "0,2-3,5"
+	INT nCnt = 0;
+	const char* pCur = astrList;
+	while (*pCur != '\0' && nCnt < CPU_SETSIZE)
+	{
+		char* pEnd;
+		long lFirst = strtol(pCur, &pEnd, 10);
+		long lLast = lFirst;
+		if (pEnd == pCur || lFirst < 0)
+			return -EINVAL;
+		if (*pEnd == '-')
+		{
+			pCur = pEnd + 1;
+			lLast = strtol(pCur, &pEnd, 10);
+			if (pEnd == pCur || lLast < lFirst)
+				return -EINVAL;
+		}
+		for (long lCpu = lFirst; lCpu <= lLast && nCnt < CPU_SETSIZE; lCpu++)
+			apnCpus[nCnt++] = (INT)lCpu;
+		if (*pEnd == ',')
+			pEnd++;
+		else if (*pEnd != '\0')
+			return -EINVAL;
+		pCur = pEnd;
+	}
+	return nCnt;
+}
+/*****************************************************************************/
+static void
+print_usage(const char* astrProgram)
+{
+	printf("usage: %s [options]\n", astrProgram);
+	printf("  -t <num>     number of periodic tasks (default 1, max %d)\n", MAX_BENCH_TASKS);
+	printf("  -i <us>      period of the first task in microseconds (default %d)\n", DEFAULT_PERIOD_US);
+	printf("  -d <us>      period increment for every following task (default 0)\n");
+	printf("  -p <prio>    SCHED_FIFO priority (default 99)\n");
+	printf("  -s           give every following task one priority less\n");
+	printf("  -w <us>      sleep until <us> before the release and spin the rest (0: default margin)\n");
+	printf("  -a <list>    CPUs to distribute the tasks on, e.g. 0,2-3 (default 0)\n");
+	printf("  -l <loops>   number of cycles per task (default: run for -D seconds)\n");
+	printf("  -D <sec>     duration of the run in seconds (default %d)\n", DEFAULT_DURATION_S);
+	printf("  -o <format>  output format: human, csv or json (default human)\n");
+	printf("  -f <file>    write the report to a file instead of stdout\n");
+	printf("  -H           include the latency histogram in the report\n");
+	printf("  -T           publish live telemetry for rtposix-top\n");
+}
+/*****************************************************************************/
+static INT
+parse_options(int argc, char** argv, BENCH_CONFIG* apConfig)
+{
+	int nOpt;
+
+	apConfig->nTasks = 1;
+	apConfig->ullPeriodNs = (RTTIME)DEFAULT_PERIOD_US * 1000;
+	apConfig->ullIntervalNs = 0;
+	apConfig->nPriority = LIM_PRIORITY_HI;
+	apConfig->bPrioDescending = FALSE;
+	apConfig->bHybridWakeup = FALSE;
+	apConfig->ullSpinMarginNs = 0;
+	apConfig->nCpus[0] = 0;
+	apConfig->nCpuCnt = 1;
+	apConfig->ullLoops = 0;
+	apConfig->nDurationSec = DEFAULT_DURATION_S;
+	apConfig->eFormat = eFormatHuman;
+	apConfig->bHistogram = FALSE;
+	apConfig->bTelemetry = FALSE;
+	apConfig->strOutput = NULL;
+
+	while ((nOpt = getopt(argc, argv, "t:i:d:p:sw:a:l:D:o:f:HTh")) != -1)
+	{
+		switch (nOpt)
+		{
+		case 't':
+			apConfig->nTasks = atoi(optarg);
+			break;
+		case 'i':
+			apConfig->ullPeriodNs = strtoull(optarg, NULL, 10) * 1000;
+			break;
+		case 'd':
+			apConfig->ullIntervalNs = strtoull(optarg, NULL, 10) * 1000;
+			break;
+		case 'p':
+			apConfig->nPriority = atoi(optarg);
+			break;
+		case 's':
+			apConfig->bPrioDescending = TRUE;
+			break;
+		case 'w':
+			apConfig->bHybridWakeup = TRUE;
+			apConfig->ullSpinMarginNs = strtoull(optarg, NULL, 10) * 1000;
+			break;
+		case 'a':
+			apConfig->nCpuCnt = parse_cpu_list(optarg, apConfig->nCpus);
+			if (apConfig->nCpuCnt <= 0)
+			{
+				fprintf(stderr, "invalid CPU list: %s\n", optarg);
+				return -EINVAL;
+			}
+			break;
+		case 'l':
+			apConfig->ullLoops = strtoull(optarg, NULL, 10);
+			break;
+		case 'D':
+			apConfig->nDurationSec = atoi(optarg);
+			break;
+		case 'o':
+			if (strcmp(optarg, "human") == 0)
+				apConfig->eFormat = eFormatHuman;
+			else if (strcmp(optarg, "csv") == 0)
+				apConfig->eFormat = eFormatCsv;
+			else if (strcmp(optarg, "json") == 0)
+				apConfig->eFormat = eFormatJson;
+			else
+			{
+				fprintf(stderr, "invalid output format: %s\n", optarg);
+				return -EINVAL;
+			}
+			break;
+		case 'f':
+			apConfig->strOutput = optarg;
+			break;
+		case 'H':
+			apConfig->bHistogram = TRUE;
+			break;
+		case 'T':
+			apConfig->bTelemetry = TRUE;
+			break;
+		default:
+			return -EINVAL;
+		}
+	}
+
+	if (apConfig->nTasks < 1 || apConfig->nTasks > MAX_BENCH_TASKS || apConfig->ullPeriodNs == 0)
+	{
+		fprintf(stderr, "invalid number of tasks or period\n");
+		return -EINVAL;
+	}
+	return RET_SUCC;
+}
+/*****************************************************************************/
+static void
+print_histogram(const POSIX_TASK_HIST* apHist, const char* astrIndent, BOOL abJson)
+{
+	BOOL bFirst = TRUE;
+	for (INT nIdx = 0; nIdx < STAT_HIST_BUCKETS; nIdx++)
+	{
+		RTTIME ullLower, ullUpper;
+		if (apHist->ullBuckets[nIdx] == 0)
+			continue;
+		get_hist_bucket_range(nIdx, &ullLower, &ullUpper);
+		if (abJson)
+			fprintf(g_pOutput, "%s{\"lo_ns\": %llu, \"hi_ns\": %llu, \"count\": %llu}", bFirst ? "" : ", ",
+				(unsigned long long)ullLower, (unsigned long long)ullUpper, (unsigned long long)apHist->ullBuckets[nIdx]);
+		else
+			fprintf(g_pOutput, "%s%10llu - %10llu ns : %llu\n", astrIndent,
+				(unsigned long long)ullLower, (unsigned long long)ullUpper, (unsigned long long)apHist->ullBuckets[nIdx]);
+		bFirst = FALSE;
+	}
+}
+/*****************************************************************************/
+static void
+print_report(const BENCH_CONFIG* apConfig)
+{
+	if (apConfig->eFormat == eFormatCsv)
+		fprintf(g_pOutput, "task,cpu,priority,period_ns,cycles,overruns,lat_min_ns,lat_avg_ns,lat_max_ns,lat_p99_ns,lat_p999_ns,exec_max_ns\n");
+	else if (apConfig->eFormat == eFormatJson)
+		fprintf(g_pOutput, "{\"tasks\": [\n");
+
+	for (INT nIdx = 0; nIdx < apConfig->nTasks; nIdx++)
+	{
+		BENCH_TASK* pBench = &g_stTasks[nIdx];
+		POSIX_TASK_STATS stStats;
+		POSIX_TASK_HIST stHist;
+		get_task_stats(&pBench->stTask, &stStats);
+		get_task_histogram(&pBench->stTask, &stHist, NULL);
+
+		switch (apConfig->eFormat)
+		{
+		case eFormatCsv:
+			fprintf(g_pOutput, "%s,%d,%d,%llu,%llu,%llu,%llu,%llu,%llu,%llu,%llu,%llu\n",
+				pBench->stTask.strName, pBench->nCpu, pBench->stTask.nPriority, (unsigned long long)pBench->stTask.ullPeriod,
+				(unsigned long long)stStats.ullCycles, (unsigned long long)stStats.ullOverruns,
+				(unsigned long long)stStats.ullLatMin, (unsigned long long)stStats.ullLatMean, (unsigned long long)stStats.ullLatMax,
+				(unsigned long long)stStats.ullLatP99, (unsigned long long)stStats.ullLatP999, (unsigned long long)stStats.ullExecMax);
+			break;
+		case eFormatJson:
+			fprintf(g_pOutput, "  {\"task\": \"%s\", \"cpu\": %d, \"priority\": %d, \"period_ns\": %llu, \"cycles\": %llu, \"overruns\": %llu,\n",
+				pBench->stTask.strName, pBench->nCpu, pBench->stTask.nPriority, (unsigned long long)pBench->stTask.ullPeriod,
+				(unsigned long long)stStats.ullCycles, (unsigned long long)stStats.ullOverruns);
+			fprintf(g_pOutput, "   \"latency_ns\": {\"min\": %llu, \"avg\": %llu, \"max\": %llu, \"p99\": %llu, \"p999\": %llu}, \"exec_max_ns\": %llu",
+				(unsigned long long)stStats.ullLatMin, (unsigned long long)stStats.ullLatMean, (unsigned long long)stStats.ullLatMax,
+				(unsigned long long)stStats.ullLatP99, (unsigned long long)stStats.ullLatP999, (unsigned long long)stStats.ullExecMax);
+			if (apConfig->bHistogram)
+			{
+				fprintf(g_pOutput, ",\n   \"histogram\": [");
+				print_histogram(&stHist, "", TRUE);
+				fprintf(g_pOutput, "]");
+			}
+			fprintf(g_pOutput, "}%s\n", (nIdx + 1 < apConfig->nTasks) ? "," : "");
+			break;
+		default:
+			fprintf(g_pOutput, "T:%2d (%s) CPU:%2d P:%2d I:%8llu C:%10llu O:%6llu Min:%8llu Avg:%8llu Max:%8llu P99:%8llu P99.9:%8llu (ns)\n",
+				nIdx, pBench->stTask.strName, pBench->nCpu, pBench->stTask.nPriority, (unsigned long long)pBench->stTask.ullPeriod,
+				(unsigned long long)stStats.ullCycles, (unsigned long long)stStats.ullOverruns,
+				(unsigned long long)stStats.ullLatMin, (unsigned long long)stStats.ullLatMean, (unsigned long long)stStats.ullLatMax,
+				(unsigned long long)stStats.ullLatP99, (unsigned long long)stStats.ullLatP999);
+			if (apConfig->bHistogram)
+				print_histogram(&stHist, "      ", FALSE);
+			break;
+		}
+	}
+
+	if (apConfig->eFormat == eFormatJson)
+		fprintf(g_pOutput, "]}\n");
+}
+/*****************************************************************************/
+int
+main(int argc, char** argv)
+{
+	BENCH_CONFIG stConfig;
+	INT nRet;
+
+	if (parse_options(argc, argv, &stConfig) != RET_SUCC)
+	{
+		print_usage(argv[0]);
+		return RET_FAIL;
+	}
+
+	signal(SIGTERM, bench_signal_handler);
+	signal(SIGINT, bench_signal_handler);
+
+	/* Lock all current and future pages from preventing of being paged to swap */
+	mlockall(MCL_CURRENT | MCL_FUTURE);
+
+	if (stConfig.bTelemetry && start_telemetry() != RET_SUCC)
+		fprintf(stderr, "failed to start the telemetry, continuing without\n");
+
+	for (INT nIdx = 0; nIdx < stConfig.nTasks; nIdx++)
+	{
+		BENCH_TASK* pBench = &g_stTasks[nIdx];
+		CHAR strName[MAX_NAME_LENGTH];
+		INT nPriority = stConfig.nPriority;
+		if (stConfig.bPrioDescending)
+			nPriority = (stConfig.nPriority - nIdx > LIM_PRIORITY_LO) ? stConfig.nPriority - nIdx : LIM_PRIORITY_LO + 1;
+
+		snprintf(strName, sizeof(strName), "BENCH%d", nIdx);
+		pBench->nCpu = stConfig.nCpus[nIdx % stConfig.nCpuCnt];
+		pBench->ullLoops = stConfig.ullLoops;
+
+		nRet = create_rt_task(&pBench->stTask, strName, 0, nPriority);
+		if (nRet == RET_SUCC)
+			nRet = set_cpu_affinity(&pBench->stTask, pBench->nCpu);
+		if (nRet == RET_SUCC && stConfig.bHybridWakeup)
+			nRet = set_task_wakeup_mode(&pBench->stTask, eWakeupHybrid, stConfig.ullSpinMarginNs);
+		if (nRet != RET_SUCC)
+		{
+			fprintf(stderr, "failed to create %s (%d:%s)\n", strName, nRet, strerror(-nRet));
+			return RET_FAIL;
+		}
+	}
+
+	// common start time slightly in the future so that no task begins by catching up
+	RTTIME rttStart = read_timer() + (RTTIME)10 * NANOSEC_PER_SEC / MILLISEC_PER_SEC;
+	for (INT nIdx = 0; nIdx < stConfig.nTasks; nIdx++)
+	{
+		nRet = set_task_period(&g_stTasks[nIdx].stTask, rttStart, stConfig.ullPeriodNs + (RTTIME)nIdx * stConfig.ullIntervalNs);
+		if (nRet == RET_SUCC)
+			nRet = start_task(&g_stTasks[nIdx].stTask, &bench_periodic_proc, &g_stTasks[nIdx]);
+		if (nRet != RET_SUCC)
+		{
+			fprintf(stderr, "failed to start %s (%d:%s)\n", g_stTasks[nIdx].stTask.strName, nRet, strerror(-nRet));
+			return RET_FAIL;
+		}
+	}
+
+	// run until every task is done, the duration has elapsed or we get signalled
+	RTTIME rttEnd = read_timer() + (RTTIME)stConfig.nDurationSec * NANOSEC_PER_SEC;
+	while (g_bStop == FALSE)
+	{
+		BOOL bAllDone = TRUE;
+		for (INT nIdx = 0; nIdx < stConfig.nTasks; nIdx++)
+			bAllDone = bAllDone && (g_stTasks[nIdx].stTask.dwStatus == (DWORD)eDead);
+		if (bAllDone || (stConfig.ullLoops == 0 && read_timer() >= rttEnd))
+			break;
+		usleep(10000);
+	}
+	g_bStop = TRUE;
+	if (stConfig.bTelemetry)
+		stop_telemetry();
+
+	g_pOutput = stdout;
+	if (stConfig.strOutput != NULL)
+	{
+		g_pOutput = fopen(stConfig.strOutput, "w");
+		if (g_pOutput == NULL)
+		{
+			fprintf(stderr, "failed to open %s (%s)\n", stConfig.strOutput, strerror(errno));
+			return RET_FAIL;
+		}
+	}
+	print_report(&stConfig);
+	if (g_pOutput != stdout)
+		fclose(g_pOutput);
+	return RET_SUCC;
+}
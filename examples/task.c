@@ -1,5 +1,6 @@
 #include <stdio.h>
 #include "posix_rt.h"
+#include "rt_system.h"
 #include <string.h>
 
 
@@ -40,11 +41,13 @@ int main()
     signal(SIGTERM, signal_handler);
     signal(SIGINT, signal_handler);
     
-    /* Lock all current and future pages from preventing of being paged to swap */
-    mlockall(MCL_CURRENT | MCL_FUTURE);
-
     int nRet = 0;
     init_lowlevel_logger(TRUE);
+
+    /* Lock the memory, hold the DMA latency at 0 and report what else may hurt the latency */
+    RT_SYSTEM_REPORT stReport;
+    rt_system_prepare(RT_SYS_ALL, DEFAULT_SYSTEM_PREFAULT, &stReport);
+    print_rt_system_report(&stReport);
     create_rt_task(&g_stRtTask1, (const PCHAR)"PERIODIC", 0, 99);
     set_task_period(&g_stRtTask1, SET_TM_NOW, 1000000);
     
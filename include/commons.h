@@ -78,13 +78,28 @@ typedef enum _LOWLEVEL_LOG_TYPE
 	eINFO,
 } LOWLEVEL_LOG_TYPE;
 
-#define __FILENAME__					(strrchr(__FILE__, '/') ? strrchr(__FILE__, '/') + 1 : __FILE__)
-#define DBG_TRACE(fmt, ...)			write_lowlevel_logger((const PCHAR)__FILENAME__, __LINE__, eTRACE, (PCHAR) fmt, ##__VA_ARGS__)
-#define DBG_ERROR(fmt, ...)			write_lowlevel_logger((const PCHAR)__FILENAME__, __LINE__, eERROR, (PCHAR) fmt,  ##__VA_ARGS__)
-#define DBG_WARN(fmt, ...)				write_lowlevel_logger((const PCHAR)__FILENAME__, __LINE__, eWARN, (PCHAR)fmt,  ##__VA_ARGS__)
-#define DBG_INFO(fmt, ...)				write_lowlevel_logger((const PCHAR)__FILENAME__, __LINE__, eINFO, (PCHAR)fmt,  ##__VA_ARGS__)
+/* compile-time log filter: clear the bit of a LOWLEVEL_LOG_TYPE to drop the corresponding DBG_* calls */
+#ifndef LOWLEVEL_LOG_MASK
+#define LOWLEVEL_LOG_MASK				((1 << eTRACE) | (1 << eWARN) | (1 << eERROR) | (1 << eINFO))
+#endif
+
+/* resolve the file name at compile time instead of calling strrchr on every log */
+#ifdef __FILE_NAME__
+#define __FILENAME__					__FILE_NAME__
+#else
+#define __FILENAME__					(__builtin_strrchr(__FILE__, '/') ? __builtin_strrchr(__FILE__, '/') + 1 : __FILE__)
+#endif
+
+#define DBG_LOG(type, fmt, ...)		((LOWLEVEL_LOG_MASK & (1 << (type))) ? write_lowlevel_logger((const PCHAR)__FILENAME__, __LINE__, type, (PCHAR)fmt, ##__VA_ARGS__) : PASS)
+#define DBG_TRACE(fmt, ...)			DBG_LOG(eTRACE, fmt, ##__VA_ARGS__)
+#define DBG_ERROR(fmt, ...)			DBG_LOG(eERROR, fmt, ##__VA_ARGS__)
+#define DBG_WARN(fmt, ...)				DBG_LOG(eWARN, fmt, ##__VA_ARGS__)
+#define DBG_INFO(fmt, ...)				DBG_LOG(eINFO, fmt, ##__VA_ARGS__)
 
 #define ZERO_MEMORY(input, sz)			zero_memory(input, sz)		
+#ifndef ROUND_UP
+#define ROUND_UP(x, a)					(((x) + (a) - 1) & ~((size_t)(a) - 1))	// a is a power of two
+#endif
 
 #ifdef __cplusplus
 extern "C" {
@@ -92,8 +107,13 @@ extern "C" {
 
 void	init_lowlevel_logger			(BOOL abOnOff);
 void	write_lowlevel_logger			(const PCHAR astrFileName, INT anLineNo, LOWLEVEL_LOG_TYPE aeType, PCHAR astrFmt, ...);
+void	init_deferred_logger			(BOOL abOnOff);
+INT		flush_lowlevel_logger			(VOID);
+UINT64	get_lowlevel_logger_drops		(VOID);
 void	zero_memory						(PVOID pInput, size_t aulSize);
 INT		get_available_cpus				(VOID);
+INT		map_locked_region				(PVOID* appRegion, size_t aulSize, const CHAR* astrWho);
+INT		unmap_locked_region				(PVOID apRegion, size_t aulSize);
 
 #ifdef __cplusplus
 }
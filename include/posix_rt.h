@@ -18,6 +18,7 @@
 #endif 
 
 #include "commons.h"
+#include <sys/epoll.h>
 
 #define DEFAULT_STKSIZE	(65536) //64kb
 #define MAX_NAME_LENGTH (32)	//32 bytes
@@ -26,6 +27,23 @@
 #define SET_DEFAULT_STKSZ	0
 #define SET_PRIORITY_MED	50
 #define SET_TM_NOW			(RTTIME)-99				
+#define TM_INFINITE			(RTTIME)0
+#define DEFAULT_LOG_PERIOD	(10000000)	//10ms
+#define LIM_DL_RUNTIME_MIN	(1024)		//smallest runtime accepted by the kernel (ns)
+#define DEFAULT_SPIN_MARGIN	(50000)		//50us, initial margin of the hybrid wakeup
+#define LIM_SPIN_MARGIN_MIN	(1000)		//1us
+#define LIM_TASK_REGISTRY	(256)		//tasks listed by the registry
+#define LIM_WAIT_FDS		(16)		//fds in one wait set
+#define WAIT_SOURCE_DEADLINE	(-1)	//POSIX_WAIT_EVENT source when the deadline fired
+
+#ifndef SCHED_DEADLINE
+#define SCHED_DEADLINE		6
+#endif
+
+/* log-linear histogram: 2^SUB_BITS sub-buckets per power of two, values clamped at 2^MAX_BITS ns */
+#define STAT_HIST_SUB_BITS	(2)
+#define STAT_HIST_MAX_BITS	(40)
+#define STAT_HIST_BUCKETS	((STAT_HIST_MAX_BITS - STAT_HIST_SUB_BITS + 1) << STAT_HIST_SUB_BITS)
 
 typedef UINT64			RTTIME,			*PRTTIME;
 typedef pid_t			PID;
@@ -34,6 +52,33 @@ typedef pthread_t		PTHREAD,		*PPTHREAD;
 typedef	pthread_attr_t	PTHREADATTR,	*PPTHREADATTR;
 typedef struct timespec TIMESPEC;
 
+typedef struct _POSIX_TASK_HIST
+{
+	UINT64			ullCount;
+	UINT64			ullMin;
+	UINT64			ullMax;
+	UINT64			ullSum;
+	UINT64			ullBuckets[STAT_HIST_BUCKETS];
+} POSIX_TASK_HIST;
+
+typedef struct _POSIX_TASK_USAGE
+{
+	CHAR			strName[MAX_NAME_LENGTH];
+	PID				nPid;
+	DWORD			dwStatus;
+	INT				nPriority;
+	INT				nSchedPolicy;
+	RTTIME			ullCpuTime;		// consumed CPU time
+	UINT64			ullVolCtxSw;	// voluntary context switches (blocking, sleeping)
+	UINT64			ullInvolCtxSw;	// involuntary context switches (preemption)
+	UINT32			uUtilization;	// CPU time over wall time since the previous sample, in 1/100 %
+} POSIX_TASK_USAGE;
+
+struct _POSIX_TASK;
+
+/* overrun handler, gets the number of missed releases and returns the POSIX_OVERRUN_POLICY to apply */
+typedef INT (*POVERRUNFCN)(struct _POSIX_TASK* apTask, UINT64 aullMissed, PVOID apArg);
+
 typedef struct _POSIX_TASK
 {
 	PTHREAD			stThread;
@@ -43,36 +88,124 @@ typedef struct _POSIX_TASK
 	/* task specifications */
 	DWORD			dwStatus;
 	INT				nPriority;
+	BOOL			bPriorityPending;	// set_task_priority() came before the thread knew its TID, it applies it itself
 	UINT64			ullStackSize;
+	INT				nStackSlot;		// slot in the stack arena, -1 when glibc owns the stack
 	BOOL			bRtMode;
 	BOOL			bPeriodic;
+	INT				nSchedPolicy;	// SCHED_OTHER, SCHED_FIFO or SCHED_DEADLINE
 	CPUSET			stCpuAffinity;
+	BOOL			bAffinityPending;	// set_cpu_affinity_mask() came before the thread knew its TID, it applies it itself
 	CHAR			strName[MAX_NAME_LENGTH];
 	RTTIME			ullPeriod;
 	
 	/* timer related (for periodic tasks) */
 	TIMESPEC		stDeadline;
+
+	/* SCHED_DEADLINE reservation, the period is ullPeriod */
+	RTTIME			ullDlRuntime;
+	RTTIME			ullDlDeadline;
+	UINT32			uDlApplied;		// futex word, set once the task has called sched_setattr()
+	INT				nDlResult;		// what sched_setattr() returned, start_task() passes it on
+
+	/* wakeup mode, the hybrid mode sleeps until the release minus ullSpinMargin and spins the rest */
+	INT				nWakeupMode;
+	RTTIME			ullSpinMargin;
+
+	/* what wait_next_period() does with releases that were missed by an overrun */
+	INT				nOverrunPolicy;
+	POVERRUNFCN		pOverrunFcn;
+	PVOID			pOverrunArg;
+	INT				nOverrunAction;		// last answer of pOverrunFcn, kept while catching up
+	RTTIME			rttMissedUntil;		// latest release already counted as missed
+
+	/* timing model for priority assignment and admission control (rt_sched.c), 0 when not declared */
+	RTTIME			ullWcet;
+	RTTIME			ullRelDeadline;
 	
 	/* task function pointer and arguments */
 	PTASKFCN		pTaskFcn;
 	PVOID			pTaskArg;
 
-	/* use conditional variable to suspend task */
-	BOOL			bStartSuspended;
-	pthread_cond_t  cvSuspend;
-	pthread_mutex_t mtxSuspend;
+	/* suspension futex word, another task is suspended at its next wait_next_period() or wait_next_event() */
+	UINT32			uSuspend;
+	RTTIME			rttResumeRequest;	// when resume_task() was called
+	RTTIME			ullResumeLatency;	// from resume_task() until the task ran again, last suspension
+
+	/* runtime statistics, written only by the task itself inside wait_next_period() */
+	RTTIME			rttLastWakeup;
+	UINT64			ullOverruns;
+	RTTIME			ullLastLatency;
+	RTTIME			ullLastExecTime;
+	POSIX_TASK_HIST	stLatency;
+	POSIX_TASK_HIST	stExecTime;
+
+	/* CPU usage, stUsage holds the final counters once the task has ended */
+	RTTIME			rttStartTime;
+	POSIX_TASK_USAGE	stUsage;
+
+	/* record of the task in the shared-memory telemetry, -1 when it has none */
+	INT				nTelemetrySlot;
+
+	/* trace session in the high half and index in the tracer table in the low half (rt_trace.c), 0 until its first traced event */
+	UINT64			ullTraceTask;
 } POSIX_TASK;
 
+/* a set of fds a task can block on together with a deadline (epoll + timerfd) */
+typedef struct _POSIX_WAIT_SET
+{
+	INT				nEpollFd;
+	INT				nTimerFd;
+	UINT32			uFdCnt;
+	INT				nFds[LIM_WAIT_FDS];	// indexed by source, -1 for a free entry
+	RTTIME			rttArmed;			// deadline currently programmed in nTimerFd, TM_INFINITE when disarmed
+} POSIX_WAIT_SET;
+
+typedef struct _POSIX_WAIT_EVENT
+{
+	INT				nSource;	// index returned by add_wait_fd(), WAIT_SOURCE_DEADLINE for the deadline
+	INT				nFd;		// fd that became ready, -1 for the deadline
+	UINT32			uEvents;	// epoll events of the fd (EPOLLIN, EPOLLOUT, ...)
+	RTTIME			rttWakeup;	// when the task woke up
+	/* wakeup time minus the deadline; fd readiness carries no timestamp, compare rttWakeup with your own */
+	RTTIME			ullLatency;
+} POSIX_WAIT_EVENT;
+
+typedef INT (*PTASKVISITFCN)(POSIX_TASK* apTask, PVOID apArg);
+
 typedef struct _POSIX_TASK_INFO
 {
 	INT				nPriority;
 	BOOL			bRTMode;
 	BOOL			bPeriodic;
+	INT				nSchedPolicy;
 	CHAR			strName[MAX_NAME_LENGTH];
 	pid_t			nPid;
 	DWORD			dwStatus;
 } POSIX_TASK_INFO;
 
+typedef struct _POSIX_TASK_STATS
+{
+	UINT64			ullCycles;
+	UINT64			ullOverruns;
+	/* wakeup latency: actual wakeup time minus the programmed release time */
+	RTTIME			ullLatMin;
+	RTTIME			ullLatMax;
+	RTTIME			ullLatMean;
+	RTTIME			ullLatP99;
+	RTTIME			ullLatP999;
+	/* execution time: wakeup until the next call to wait_next_period() */
+	RTTIME			ullExecMin;
+	RTTIME			ullExecMax;
+	RTTIME			ullExecMean;
+	RTTIME			ullExecP99;
+	RTTIME			ullExecP999;
+	/* current margin of the hybrid wakeup, 0 when the task only sleeps */
+	RTTIME			ullSpinMargin;
+	/* resume_task() until the suspended task ran again, last suspension */
+	RTTIME			ullResumeLatency;
+} POSIX_TASK_STATS;
+
 typedef enum _ePOSIX_STATE_MACHINE
 {
 	eUnknown = 0x00,
@@ -85,6 +218,26 @@ typedef enum _ePOSIX_STATE_MACHINE
 	eDead,
 } POSIX_STATE_MACHINE;
 
+typedef enum _ePOSIX_WAKEUP_MODE
+{
+	eWakeupSleep = 0x00,	// clock_nanosleep() until the release time
+	eWakeupHybrid,			// clock_nanosleep() until shortly before, then spin to the release time
+} POSIX_WAKEUP_MODE;
+
+typedef enum _ePOSIX_OVERRUN_POLICY
+{
+	eOverrunCatchUp = 0x00,	// release the missed cycles back-to-back
+	eOverrunSkip,			// drop the missed releases and continue at the next future period boundary
+	eOverrunHandler,		// ask the task's overrun handler which of the two to apply
+} POSIX_OVERRUN_POLICY;
+
+typedef enum _ePOSIX_PLACEMENT
+{
+	ePlaceCpu0 = 0x00,		// every new task is pinned to CPU0
+	ePlaceAny,				// new tasks may run on every available CPU
+	ePlaceIsolated,			// RT tasks are spread over the isolated CPUs, NRT tasks stay on the housekeeping CPUs
+} POSIX_PLACEMENT;
+
 #ifdef __cplusplus
 extern "C" {
 #endif //__cplusplus
@@ -94,19 +247,63 @@ INT				create_rt_task		(POSIX_TASK* apTask, const PCHAR astrName, INT anStkSize,
 INT				spawn_rt_task		(POSIX_TASK* apTask, const PCHAR astrName, INT anStkSize, INT anPriority, PTASKFCN apEntry, PVOID apArg);
 INT				create_nrt_task		(POSIX_TASK* apTask, const PCHAR astrName, INT anStkSize);
 INT				spawn_nrt_task		(POSIX_TASK* apTask, const PCHAR astrName, INT anStkSize, PTASKFCN apEntry, PVOID apArg);
+INT				create_dl_task		(POSIX_TASK* apTask, const PCHAR astrName, INT anStkSize, RTTIME aullRuntime, RTTIME aullDeadline, RTTIME aullPeriod);
+INT				spawn_dl_task		(POSIX_TASK* apTask, const PCHAR astrName, INT anStkSize, RTTIME aullRuntime, RTTIME aullDeadline, RTTIME aullPeriod, PTASKFCN apEntry, PVOID apArg);
 INT				get_task_info		(POSIX_TASK* apTask, POSIX_TASK_INFO* apTaskInfo);
+INT				get_task_stats		(POSIX_TASK* apTask, POSIX_TASK_STATS* apTaskStats);
+INT				get_task_histogram	(POSIX_TASK* apTask, POSIX_TASK_HIST* apLatHist, POSIX_TASK_HIST* apExecHist);
+INT				get_hist_bucket_range	(INT anBucket, RTTIME* apullLower, RTTIME* apullUpper);
+INT				set_task_priority	(POSIX_TASK* apTask, INT anPriority);
 INT				set_cpu_affinity	(POSIX_TASK* apTask, INT anCpuNum);
+INT				set_cpu_affinity_mask	(POSIX_TASK* apTask, const CPUSET* apCpuSet);
+INT				get_cpu_affinity_mask	(POSIX_TASK* apTask, CPUSET* apCpuSet);
 INT				start_task			(POSIX_TASK* apTask, PTASKFCN apEntry, PVOID apArg);
 INT				delete_task			(POSIX_TASK* apTask);
+INT				wait_task_end		(POSIX_TASK* apTask, RTTIME arttAbsTimeout);	// until the thread is gone, -ETIMEDOUT after the deadline
 INT				suspend_task		(POSIX_TASK* apTask);
 INT				resume_task			(POSIX_TASK* apTask);
 POSIX_TASK*		get_self			(VOID);
 
+/* TASK REGISTRY (a POSIX_TASK is listed while its thread exists, from start_task() until its entry returns) */
+POSIX_TASK*	find_task_by_name	(const PCHAR astrName);
+INT		for_each_task			(PTASKVISITFCN apVisit, PVOID apArg);
+INT		get_task_snapshot		(POSIX_TASK_USAGE* apUsage, INT anMaxCnt);
+INT		get_task_usage			(POSIX_TASK* apTask, POSIX_TASK_USAGE* apUsage);
+
+/* CPU PLACEMENT */
+INT		set_task_placement		(INT anPlacement);
+INT		get_isolated_cpus		(CPUSET* apCpuSet);
+INT		get_housekeeping_cpus	(CPUSET* apCpuSet);
+
+/* STACK ARENA (locked and pre-faulted task stacks) */
+INT		init_stack_arena	(UINT32 auSlotCnt, INT anSlotSize);
+INT		release_stack_arena	(VOID);
+INT		get_stack_arena_usage	(UINT32* apuSlotCnt, UINT32* apuInUse);
+
 /* TIMER MANAGEMENT */
 INT		set_task_period		(POSIX_TASK* apTask, RTTIME aulStartTime, RTTIME aullPeriod);
 RTTIME	read_timer			(VOID);
+RTTIME	read_timer_fast		(VOID);		// CLOCK_MONOTONIC from the TSC, re-anchored once per second and never stepping back
+BOOL	has_fast_timer		(VOID);
 VOID	spin_timer			(RTTIME aullSpinTimeNS);
+/* *apullOverrunsCnt: releases missed since the previous call, each one is reported once (-ETIMEDOUT when > 0,
+ * the back-to-back cycles of eOverrunCatchUp report 0 and RET_SUCC); ullOverruns of the task holds the running total */
 INT		wait_next_period	(UINT64* apullOverrunsCnt);
+INT		set_task_wakeup_mode	(POSIX_TASK* apTask, INT anMode, RTTIME aullSpinMargin);
+INT		set_overrun_policy		(POSIX_TASK* apTask, INT anPolicy, POVERRUNFCN apHandler, PVOID apArg);
+RTTIME	get_next_release	(POSIX_TASK* apTask);
+
+/* EVENT WAIT (fds and a deadline, the deadline of wait_next_event() is the next release of the task) */
+INT		create_wait_set		(POSIX_WAIT_SET* apSet);
+INT		delete_wait_set		(POSIX_WAIT_SET* apSet);
+INT		add_wait_fd			(POSIX_WAIT_SET* apSet, INT anFd, UINT32 auEvents);
+INT		remove_wait_fd		(POSIX_WAIT_SET* apSet, INT anFd);
+INT		wait_fd_event		(POSIX_WAIT_SET* apSet, RTTIME aullAbsDeadline, POSIX_WAIT_EVENT* apEvent);
+INT		wait_next_event		(POSIX_WAIT_SET* apSet, POSIX_WAIT_EVENT* apEvent, UINT64* apullOverrunsCnt);
+
+/* DEFERRED LOGGING */
+INT		start_logger_task	(RTTIME aullFlushPeriod);
+INT		stop_logger_task	(VOID);
 
 /* TIME CONVERSION */
 INT		convert_nsecs_to_timespec	(UINT64 aullNanoSecs, TIMESPEC* apTimeSpec);
@@ -121,10 +318,21 @@ void	set_test_variable(POSIX_TASK* apTask, int nValue);
 #endif // !gettid
 
 #ifndef cpu_relax
+#if defined(__x86_64__) || defined(__i386__)
+#define cpu_relax() __asm__ __volatile__("pause" ::: "memory")
+#elif defined(__aarch64__)
+#define cpu_relax() __asm__ __volatile__("yield" ::: "memory")
+#else
 #define cpu_relax() __sync_synchronize()
 #endif
+#endif
 
 LONG system_call(LONG alMagicNo);
+PID  get_cached_tid(VOID);	// TID of the calling thread, read once per thread and again after fork()
+
+/* FUTEX (process-private, absolute CLOCK_MONOTONIC timeouts, TM_INFINITE waits forever) */
+INT		futex_wait			(UINT32* apuAddr, UINT32 auExpected, RTTIME aullAbsTimeout);
+INT		futex_wake			(UINT32* apuAddr, INT anCount);
 
 #ifdef __cplusplus
 }
@@ -0,0 +1,103 @@
+/*
+ *  This file is owned by the Embedded Systems Laboratory of Seoul National University of Science and Technology
+ *  as a part of RT-AIDE or the RTOS-Agnostic and Interoperable Development Environment for Real-time Systems
+ *
+ *  File: rt_cyclic.h
+ *  Author: 2022 Raimarius Delgado
+ *  Description: Header file for rt_cyclic.c, cyclic executive that runs callbacks of harmonic rates
+ *				 from a table of minor frames on one periodic task, with execution budgets per callback
+ *
+ *
+ *
+*/
+#ifndef __RT_CYCLIC_H__
+#define __RT_CYCLIC_H__
+
+#include "posix_rt.h"
+
+#define LIM_CYCLIC_ENTRIES			(32)
+#define LIM_CYCLIC_FRAMES			(64)			// minor frames in one major frame
+#define DEFAULT_CYCLIC_STOP_TIMEOUT	(1000000000)	//1s for the executive to finish its frame on stop
+
+struct _POSIX_CYCLIC;
+
+// called from the executive when a callback runs past its budget, a negative return stops the executive
+typedef INT (*PCYCLICBUDGETFCN)(struct _POSIX_CYCLIC* apCyclic, INT anEntry, RTTIME aullExecTime, PVOID apArg);
+
+typedef struct _POSIX_CYCLIC_ENTRY
+{
+	CHAR			strName[MAX_NAME_LENGTH];
+	PTASKFCN		pFcn;
+	PVOID			pArg;
+	UINT32			uDivider;		// period in minor frames
+	UINT32			uPhase;			// first minor frame, spreads the slow callbacks over the major frame
+	RTTIME			ullBudget;		// 0 for none
+
+	/* written by the executive only */
+	UINT64			ullCalls;
+	UINT64			ullBudgetOverruns;
+	RTTIME			ullExecLast;
+	RTTIME			ullExecMax;
+	RTTIME			ullExecSum;
+} POSIX_CYCLIC_ENTRY;
+
+typedef struct _POSIX_CYCLIC_STATS
+{
+	UINT32			uMajorFrames;		// minor frames in one major frame
+	UINT64			ullFrames;			// minor frames executed
+	UINT64			ullFramesSkipped;	// minor frames dropped after a missed release
+	UINT64			ullFrameOverruns;	// minor frames that took longer than the minor period
+	RTTIME			ullFrameExecLast;
+	RTTIME			ullFrameExecMax;
+	UINT64			ullBudgetOverruns;	// of all callbacks
+} POSIX_CYCLIC_STATS;
+
+typedef struct _POSIX_CYCLIC
+{
+	CHAR				strName[MAX_NAME_LENGTH];
+	POSIX_TASK			stTask;
+	RTTIME				ullMinorPeriod;
+	UINT32				uEntryCnt;
+	POSIX_CYCLIC_ENTRY	stEntries[LIM_CYCLIC_ENTRIES];
+
+	PCYCLICBUDGETFCN	pBudgetFcn;
+	PVOID				pBudgetArg;
+
+	/* frame table built by start_cyclic_executive(), entries of a frame in execution order */
+	UINT32				uFrameCnt;
+	UINT8				uFrameEntryCnt[LIM_CYCLIC_FRAMES];
+	UINT8				uFrameEntries[LIM_CYCLIC_FRAMES][LIM_CYCLIC_ENTRIES];
+
+	BOOL				bStarted;
+	BOOL				bStop;
+	UINT64				ullFrames;
+	UINT64				ullFramesSkipped;
+	UINT64				ullFrameOverruns;
+	RTTIME				ullFrameExecLast;
+	RTTIME				ullFrameExecMax;
+} POSIX_CYCLIC;
+
+#ifdef __cplusplus
+extern "C" {
+#endif //__cplusplus
+
+/* EXECUTIVE MANAGEMENT (the executive owns its periodic RT task, the minor frame is its period) */
+INT		create_cyclic_executive	(POSIX_CYCLIC* apCyclic, const PCHAR astrName, INT anStkSize, INT anPriority, RTTIME aullMinorPeriod);
+INT		delete_cyclic_executive	(POSIX_CYCLIC* apCyclic);
+INT		set_cyclic_budget_handler	(POSIX_CYCLIC* apCyclic, PCYCLICBUDGETFCN apFcn, PVOID apArg);
+
+/* CALLBACKS (aullPeriod a multiple of the minor period, returns the index of the entry) */
+INT		add_cyclic_entry		(POSIX_CYCLIC* apCyclic, const PCHAR astrName, RTTIME aullPeriod, UINT32 auPhase,
+								 RTTIME aullBudget, PTASKFCN apFcn, PVOID apArg);
+
+/* EXECUTION (the first minor frame is released one minor period after arttStart, SET_TM_NOW for now) */
+INT		start_cyclic_executive	(POSIX_CYCLIC* apCyclic, RTTIME arttStart);
+INT		stop_cyclic_executive	(POSIX_CYCLIC* apCyclic);
+INT		get_cyclic_stats		(POSIX_CYCLIC* apCyclic, POSIX_CYCLIC_STATS* apStats);
+INT		get_cyclic_entry		(POSIX_CYCLIC* apCyclic, INT anEntry, POSIX_CYCLIC_ENTRY* apEntry);
+
+#ifdef __cplusplus
+}
+#endif //__cplusplus
+
+#endif //__RT_CYCLIC_H__
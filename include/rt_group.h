@@ -0,0 +1,71 @@
+/*
+ *  This file is owned by the Embedded Systems Laboratory of Seoul National University of Science and Technology
+ *  as a part of RT-AIDE or the RTOS-Agnostic and Interoperable Development Environment for Real-time Systems
+ *
+ *  File: rt_group.h
+ *  Author: 2022 Raimarius Delgado
+ *  Description: Header file for rt_group.c, groups of periodic tasks that are held at a barrier and
+ *				 released together on a common period grid, each with its own phase offset
+ *
+ *
+ *
+*/
+#ifndef __RT_GROUP_H__
+#define __RT_GROUP_H__
+
+#include "posix_rt.h"
+
+#define LIM_GROUP_TASKS				(32)
+#define DEFAULT_GROUP_RELEASE_DELAY	(1000000)		//1ms after the last task reached the barrier (SET_TM_NOW)
+#define DEFAULT_GROUP_READY_TIMEOUT	(1000000000)	//1s for every task to reach the barrier
+
+struct _POSIX_TASK_GROUP;
+
+typedef enum _eGROUP_BARRIER
+{
+	eGroupClosed = 0x00,	// the tasks wait at the barrier
+	eGroupReleased,			// every task runs on the group grid
+	eGroupAborted,			// a task could not be started, the others leave without running their entry
+} eGROUP_BARRIER;
+
+typedef struct _POSIX_GROUP_MEMBER
+{
+	struct _POSIX_TASK_GROUP*	pGroup;
+	POSIX_TASK*		pTask;
+	RTTIME			ullOffset;		// first release is the group release plus this offset
+	PTASKFCN		pEntry;
+	PVOID			pArg;
+} POSIX_GROUP_MEMBER;
+
+typedef struct _POSIX_TASK_GROUP
+{
+	CHAR				strName[MAX_NAME_LENGTH];
+	UINT32				uTaskCnt;
+	POSIX_GROUP_MEMBER	stMembers[LIM_GROUP_TASKS];
+
+	/* release barrier, both are futex words */
+	UINT32				uReady;		// tasks waiting at the barrier
+	UINT32				uReleased;	// eGROUP_BARRIER, eGroupClosed until start_task_group() opens or aborts it
+	RTTIME				rttRelease;	// common release time, valid once uReleased is eGroupReleased
+} POSIX_TASK_GROUP;
+
+#ifdef __cplusplus
+extern "C" {
+#endif //__cplusplus
+
+/* GROUP MANAGEMENT (a group and its tasks must outlive the tasks' execution) */
+INT		create_task_group	(POSIX_TASK_GROUP* apGroup, const PCHAR astrName);
+INT		delete_task_group	(POSIX_TASK_GROUP* apGroup);
+INT		add_group_task		(POSIX_TASK_GROUP* apGroup, POSIX_TASK* apTask, RTTIME aullOffset, PTASKFCN apEntry, PVOID apArg);
+INT		create_group_task	(POSIX_TASK_GROUP* apGroup, POSIX_TASK* apTask, const PCHAR astrName, INT anStkSize, INT anPriority,
+							 RTTIME aullPeriod, RTTIME aullOffset, PTASKFCN apEntry, PVOID apArg);
+
+/* RELEASE (an aborted group cannot be started again, delete_task_group() cleans it up) */
+INT		start_task_group	(POSIX_TASK_GROUP* apGroup, RTTIME aullReleaseTime);
+RTTIME	get_group_release	(POSIX_TASK_GROUP* apGroup);
+
+#ifdef __cplusplus
+}
+#endif //__cplusplus
+
+#endif //__RT_GROUP_H__
@@ -0,0 +1,80 @@
+/*
+ *  This file is owned by the Embedded Systems Laboratory of Seoul National University of Science and Technology
+ *  as a part of RT-AIDE or the RTOS-Agnostic and Interoperable Development Environment for Real-time Systems
+ *
+ *  File: rt_latest.h
+ *  Author: 2022 Raimarius Delgado
+ *  Description: Header file for rt_latest.c, latest-value channels (seqlock and triple buffer) that
+ *				 publish a state of any size between RT and NRT tasks without locks or waiting writers
+ *
+ *
+ *
+*/
+#ifndef __RT_LATEST_H__
+#define __RT_LATEST_H__
+
+#include "posix_rt.h"
+
+#define LIM_LATEST_SIZE			(1 << 20)	//1MB per value
+#define DEFAULT_SEQLOCK_SPINS	(64)		// failed reads before rt_seqlock_read() yields the CPU
+
+/* SEQLOCK: one writer that never waits, any number of readers that retry while a write is in progress.
+ * The writer must not be preempted by a reader on its own CPU, so it suits an RT writer and NRT readers. */
+typedef struct _RT_SEQLOCK
+{
+	UINT32			uSeq __attribute__((aligned(64)));	// odd while a write is in progress, wraps around
+	BOOL			bHasData;		// set by the first write, the sequence alone cannot tell after it wrapped
+	UINT32			uSize;
+	UINT32			uWordCnt;
+	UINT64*			pullData;
+	PBYTE			pRegion;
+	size_t			ulRegionSize;
+} RT_SEQLOCK;
+
+/* TRIPLE BUFFER: one writer and one reader, neither of them waits nor retries, so it suits both directions.
+ * The writer fills its own slot and swaps it with the middle one, the reader swaps the middle one for its own. */
+typedef struct _RT_TRIPLE_BUF
+{
+	UINT32			uMiddle __attribute__((aligned(64)));	// slot index, plus RT_TRIPLE_FRESH once published
+	UINT64			ullPublished;
+
+	UINT32			uWrite __attribute__((aligned(64)));	// writer side
+	UINT32			uRead __attribute__((aligned(64)));	// reader side
+	BOOL			bHasData;
+
+	UINT32			uSize;
+	size_t			ulSlotSize;
+	PBYTE			pSlots[3];
+	PBYTE			pRegion;
+	size_t			ulRegionSize;
+} RT_TRIPLE_BUF;
+
+#define RT_TRIPLE_FRESH			(0x4)
+
+#ifdef __cplusplus
+extern "C" {
+#endif //__cplusplus
+
+/* SEQLOCK */
+INT		create_rt_seqlock		(RT_SEQLOCK* apLock, UINT32 auSize);
+INT		delete_rt_seqlock		(RT_SEQLOCK* apLock);
+INT		rt_seqlock_write		(RT_SEQLOCK* apLock, const PVOID apData);
+INT		rt_seqlock_try_read		(RT_SEQLOCK* apLock, PVOID apData, UINT32* apuVersion);	// -EAGAIN while a write is in progress
+INT		rt_seqlock_read			(RT_SEQLOCK* apLock, PVOID apData, UINT32* apuVersion);
+UINT32	get_rt_seqlock_version	(RT_SEQLOCK* apLock);										// writes so far (modulo 2^31), 0 for none
+
+/* TRIPLE BUFFER (rt_triple_write() copies, the slot functions let either side work in place) */
+INT		create_rt_triple_buf	(RT_TRIPLE_BUF* apBuf, UINT32 auSize);
+INT		delete_rt_triple_buf	(RT_TRIPLE_BUF* apBuf);
+INT		rt_triple_write			(RT_TRIPLE_BUF* apBuf, const PVOID apData);
+PVOID	rt_triple_write_slot	(RT_TRIPLE_BUF* apBuf);
+INT		rt_triple_publish		(RT_TRIPLE_BUF* apBuf);
+INT		rt_triple_read			(RT_TRIPLE_BUF* apBuf, PVOID apData, BOOL* apbFresh);
+PVOID	rt_triple_read_slot		(RT_TRIPLE_BUF* apBuf, BOOL* apbFresh);					// valid until the next read
+UINT64	get_rt_triple_published	(RT_TRIPLE_BUF* apBuf);
+
+#ifdef __cplusplus
+}
+#endif //__cplusplus
+
+#endif //__RT_LATEST_H__
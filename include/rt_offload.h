@@ -0,0 +1,99 @@
+/*
+ *  This file is owned by the Embedded Systems Laboratory of Seoul National University of Science and Technology
+ *  as a part of RT-AIDE or the RTOS-Agnostic and Interoperable Development Environment for Real-time Systems
+ *
+ *  File: rt_offload.h
+ *  Author: 2022 Raimarius Delgado
+ *  Description: Header file for rt_offload.c, a pool of NRT workers that runs slow jobs (file and network
+ *				 I/O, logging) handed over by RT tasks without ever blocking them
+ *
+ *
+ *
+*/
+#ifndef __RT_OFFLOAD_H__
+#define __RT_OFFLOAD_H__
+
+#include "posix_rt.h"
+
+#define LIM_OFFLOAD_WORKERS			(16)
+#define DEFAULT_OFFLOAD_STOP_TIMEOUT	(1000000000)	//1s for the workers to drain and leave on delete
+
+typedef struct _RT_OFFLOAD_JOB
+{
+	UINT32			uSeq;			// ticket of the slot, tells producers and consumers whose turn it is
+	PTASKFCN		pFcn;
+	PVOID			pArg;
+	RTTIME			rttSubmit;
+} RT_OFFLOAD_JOB;
+
+struct _RT_OFFLOAD_POOL;
+
+typedef struct _RT_OFFLOAD_WORKER
+{
+	POSIX_TASK					stTask;
+	struct _RT_OFFLOAD_POOL*	pPool;
+	UINT32						uIndex;
+
+	/* bounded job ring of this worker, idle workers steal from the others */
+	RT_OFFLOAD_JOB*	pJobs;
+	UINT32			uTail __attribute__((aligned(64)));
+	UINT32			uHead __attribute__((aligned(64)));
+	UINT64			ullExecuted;
+	UINT64			ullStolen;
+} RT_OFFLOAD_WORKER;
+
+typedef struct _RT_OFFLOAD_STATS
+{
+	UINT64			ullSubmitted;
+	UINT64			ullRejected;		// every ring was full
+	UINT64			ullExecuted;
+	UINT64			ullStolen;			// jobs run by a worker other than the one they were queued to
+	UINT32			uDepth;				// queued and not started yet
+	UINT32			uDepthMax;
+	RTTIME			ullLatencyLast;		// submit until the job starts
+	RTTIME			ullLatencyMax;
+	RTTIME			ullLatencyAvg;
+} RT_OFFLOAD_STATS;
+
+typedef struct _RT_OFFLOAD_POOL
+{
+	/* read-only after create_rt_offload_pool() */
+	CHAR				strName[MAX_NAME_LENGTH];
+	PBYTE				pRegion;
+	size_t				ulRegionSize;
+	UINT32				uWorkerCnt;
+	UINT32				uJobMask;		// jobs per ring minus one, the ring size is a power of two
+	RT_OFFLOAD_WORKER	stWorkers[LIM_OFFLOAD_WORKERS];
+
+	UINT32			uNextWorker __attribute__((aligned(64)));
+	UINT32			uDepth;
+	UINT64			ullSubmitted;
+	UINT64			ullRejected;
+
+	UINT32			uSignal __attribute__((aligned(64)));	// futex word of the idle workers
+	UINT32			uSleepers;
+	BOOL			bStop;
+
+	UINT32			uDepthMax __attribute__((aligned(64)));
+	RTTIME			ullLatencyLast;
+	RTTIME			ullLatencyMax;
+	RTTIME			ullLatencySum;
+} RT_OFFLOAD_POOL;
+
+#ifdef __cplusplus
+extern "C" {
+#endif //__cplusplus
+
+/* POOL MANAGEMENT (auJobCnt is rounded up to a power of two for each worker) */
+INT		create_rt_offload_pool	(RT_OFFLOAD_POOL* apPool, const PCHAR astrName, UINT32 auWorkerCnt, UINT32 auJobCnt);
+INT		delete_rt_offload_pool	(RT_OFFLOAD_POOL* apPool);
+INT		get_rt_offload_stats	(RT_OFFLOAD_POOL* apPool, RT_OFFLOAD_STATS* apStats);
+
+/* SUBMIT (bounded number of steps, never blocks, safe from any POSIX_TASK) */
+INT		rt_offload_submit		(RT_OFFLOAD_POOL* apPool, PTASKFCN apFcn, PVOID apArg);
+
+#ifdef __cplusplus
+}
+#endif //__cplusplus
+
+#endif //__RT_OFFLOAD_H__
@@ -0,0 +1,92 @@
+/*
+ *  This file is owned by the Embedded Systems Laboratory of Seoul National University of Science and Technology
+ *  as a part of RT-AIDE or the RTOS-Agnostic and Interoperable Development Environment for Real-time Systems
+ *
+ *  File: rt_parallel.h
+ *  Author: 2022 Raimarius Delgado
+ *  Description: Header file for rt_parallel.c, a fork-join pool of pre-spawned and pinned SCHED_FIFO
+ *				 workers that splits a loop into chunks inside the period of the calling task
+ *
+ *
+ *
+*/
+#ifndef __RT_PARALLEL_H__
+#define __RT_PARALLEL_H__
+
+#include "posix_rt.h"
+
+#define LIM_PAR_WORKERS			(16)
+#define DEFAULT_PAR_STOP_TIMEOUT	(1000000000)	//1s for the workers to leave on delete
+
+/* body of a parallel loop, called for every chunk [auBegin, auEnd) */
+typedef VOID (*PPARFCN)(UINT32 auBegin, UINT32 auEnd, PVOID apArg);
+
+struct _RT_PAR_POOL;
+
+typedef struct _RT_PAR_WORKER
+{
+	POSIX_TASK				stTask;
+	struct _RT_PAR_POOL*	pPool;
+} RT_PAR_WORKER;
+
+typedef struct _RT_PAR_STATS
+{
+	UINT64			ullCalls;
+	RTTIME			ullWakeupLast;		// dispatch until the last worker runs
+	RTTIME			ullWakeupMax;
+	RTTIME			ullWakeupSum;
+	RTTIME			ullJoinLast;		// last chunk done until the caller returns
+	RTTIME			ullJoinMax;
+	RTTIME			ullJoinSum;
+	RTTIME			ullSpanLast;		// whole rt_parallel_for() call
+	RTTIME			ullSpanMax;
+	RTTIME			ullSpanSum;
+} RT_PAR_STATS;
+
+typedef struct _RT_PAR_POOL
+{
+	/* read-only after create_rt_par_pool() */
+	CHAR			strName[MAX_NAME_LENGTH];
+	UINT32			uWorkerCnt;
+	RTTIME			ullSpinTime;		// busy-wait before sleeping on the futex, 0 for a pure futex handoff
+	RT_PAR_WORKER	stWorkers[LIM_PAR_WORKERS];
+
+	/* current loop, published by the generation bump */
+	PPARFCN			pFcn;
+	PVOID			pArg;
+	UINT32			uBegin;
+	UINT32			uEnd;
+	UINT32			uChunk;
+	UINT32			uChunkCnt;
+	RTTIME			rttDispatch;
+
+	UINT32			uNextChunk __attribute__((aligned(64)));
+	UINT32			uGeneration __attribute__((aligned(64)));	// futex word of the workers
+	UINT32			uSleepers;
+	UINT32			uPending __attribute__((aligned(64)));		// futex word of the caller, workers still busy
+	UINT32			uJoinWaiting;
+	RTTIME			rttLastWakeup;
+	RTTIME			rttLastDone;
+	BOOL			bBusy;
+	BOOL			bStop;
+
+	RT_PAR_STATS	stStats;
+} RT_PAR_POOL;
+
+#ifdef __cplusplus
+extern "C" {
+#endif //__cplusplus
+
+/* POOL MANAGEMENT (worker i runs on apnCpus[i]) */
+INT		create_rt_par_pool	(RT_PAR_POOL* apPool, const PCHAR astrName, const INT* apnCpus, UINT32 auWorkerCnt, INT anPriority, RTTIME aullSpinTime);
+INT		delete_rt_par_pool	(RT_PAR_POOL* apPool);
+INT		get_rt_par_stats	(RT_PAR_POOL* apPool, RT_PAR_STATS* apStats);
+
+/* FORK-JOIN (the caller takes chunks too and returns once all of them are done) */
+INT		rt_parallel_for		(RT_PAR_POOL* apPool, UINT32 auBegin, UINT32 auEnd, UINT32 auChunk, PPARFCN apFcn, PVOID apArg);
+
+#ifdef __cplusplus
+}
+#endif //__cplusplus
+
+#endif //__RT_PARALLEL_H__
@@ -0,0 +1,72 @@
+/*
+ *  This file is owned by the Embedded Systems Laboratory of Seoul National University of Science and Technology
+ *  as a part of RT-AIDE or the RTOS-Agnostic and Interoperable Development Environment for Real-time Systems
+ *
+ *  File: rt_pool.h
+ *  Author: 2022 Raimarius Delgado
+ *  Description: Header file for rt_pool.c, a deterministic fixed-block memory pool for real-time tasks
+ *
+ *
+ *
+ *
+*/
+#ifndef __RT_POOL_H__
+#define __RT_POOL_H__
+
+#include "posix_rt.h"
+
+#define RT_POOL_MAX_CLASSES		(8)
+#define RT_POOL_ALIGNMENT		(16)
+#define RT_POOL_EMPTY			(0xFFFFFFFFU)
+
+typedef struct _RT_POOL_CLASS
+{
+	/* read-only after create_rt_pool() */
+	PBYTE			pBase;
+	UINT32*			puNext;			// free-list links, one per block
+	UINT32			uBlockSize;
+	UINT32			uBlockCnt;
+
+	/* free list head: (ABA tag << 32) | block index */
+	UINT64			ullFreeHead __attribute__((aligned(64)));
+	UINT32			uInUse;
+	UINT32			uHighWater;
+	UINT64			ullFailures;
+} RT_POOL_CLASS;
+
+typedef struct _RT_POOL
+{
+	PBYTE			pRegion;
+	size_t			ulRegionSize;
+	UINT32			uClassCnt;
+	CHAR			strName[MAX_NAME_LENGTH];
+	RT_POOL_CLASS	stClasses[RT_POOL_MAX_CLASSES];
+} RT_POOL;
+
+typedef struct _RT_POOL_STATS
+{
+	UINT32			uBlockSize;
+	UINT32			uBlockCnt;
+	UINT32			uInUse;
+	UINT32			uHighWater;
+	UINT64			ullFailures;
+} RT_POOL_STATS;
+
+#ifdef __cplusplus
+extern "C" {
+#endif //__cplusplus
+
+/* POOL MANAGEMENT */
+INT		create_rt_pool		(RT_POOL* apPool, const PCHAR astrName, const UINT32* apuBlockSizes, const UINT32* apuBlockCnts, UINT32 auClassCnt);
+INT		delete_rt_pool		(RT_POOL* apPool);
+INT		get_rt_pool_stats	(RT_POOL* apPool, UINT32 auClass, RT_POOL_STATS* apStats);
+
+/* ALLOCATION (lock-free, safe from any POSIX_TASK) */
+PVOID	rt_pool_alloc		(RT_POOL* apPool, size_t aulSize);
+INT		rt_pool_free		(RT_POOL* apPool, PVOID apBlock);
+
+#ifdef __cplusplus
+}
+#endif //__cplusplus
+
+#endif //__RT_POOL_H__
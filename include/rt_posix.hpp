@@ -0,0 +1,257 @@
+/*
+ *  This file is owned by the Embedded Systems Laboratory of Seoul National University of Science and Technology
+ *  as a part of RT-AIDE or the RTOS-Agnostic and Interoperable Development Environment for Real-time Systems
+ *
+ *  File: rt_posix.hpp
+ *  Author: 2022 Raimarius Delgado
+ *  Description: header-only C++17 wrapper of posix_rt.h. Tasks own their POSIX_TASK and their callable
+ *				 (no heap), priorities and periods are compile-time tags, and the periodic loop is
+ *				 generated per callable type so that the body inlines into it.
+ *
+ *
+*/
+#ifndef __RT_POSIX_HPP__
+#define __RT_POSIX_HPP__
+
+#include "posix_rt.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <ratio>
+#include <type_traits>
+#include <utility>
+
+namespace rt
+{
+
+/* COMPILE-TIME TAGS */
+template <INT Prio>
+struct Priority
+{
+	static_assert(Prio > LIM_PRIORITY_LO && Prio <= LIM_PRIORITY_HI, "rt::Priority: an RT priority must lie within 1 ~ 99");
+	static constexpr INT value = Prio;
+};
+template <INT Prio>
+inline constexpr Priority<Prio> priority{};
+
+// SCHED_OTHER task, it has no RT priority
+struct NonRealTime
+{
+	static constexpr INT value = 0;
+};
+inline constexpr NonRealTime nrt{};
+
+template <std::intmax_t Count, typename Ratio = std::nano>
+struct Period
+{
+	using duration = std::chrono::duration<std::intmax_t, Ratio>;
+	static constexpr std::chrono::nanoseconds value = std::chrono::duration_cast<std::chrono::nanoseconds>(duration(Count));
+	static_assert(value.count() > 0, "rt::Period: the period must be at least one nanosecond");
+};
+template <std::intmax_t Count> using Nanos = Period<Count, std::nano>;
+template <std::intmax_t Count> using Micros = Period<Count, std::micro>;
+template <std::intmax_t Count> using Millis = Period<Count, std::milli>;
+template <std::intmax_t Count> using Seconds = Period<Count, std::ratio<1>>;
+
+constexpr RTTIME
+to_rttime(std::chrono::nanoseconds adTime)
+{
+	return (RTTIME)adTime.count();
+}
+
+/* TASK BASE (owns the POSIX_TASK, not copyable nor movable since the thread keeps a pointer to it) */
+class TaskBase
+{
+public:
+	TaskBase(const TaskBase&) = delete;
+	TaskBase& operator=(const TaskBase&) = delete;
+
+	POSIX_TASK*	native()				{ return &m_stTask; }
+	INT			error() const			{ return m_nError; }
+	BOOL		started() const			{ return m_bStarted; }
+	BOOL		running() const
+	{
+		DWORD dwStatus = __atomic_load_n(&m_stTask.dwStatus, __ATOMIC_ACQUIRE);
+		return m_bStarted && dwStatus != (DWORD)eDead;
+	}
+
+	// the callable is asked to return, the periodic loop checks it once per cycle
+	VOID		request_stop()			{ m_bStop.store(true, std::memory_order_release); }
+	BOOL		stop_requested() const	{ return m_bStop.load(std::memory_order_acquire); }
+
+	INT			set_cpu(INT anCpu)		{ return set_cpu_affinity(&m_stTask, anCpu); }
+	INT			suspend()				{ return suspend_task(&m_stTask); }
+	INT			resume()				{ return resume_task(&m_stTask); }
+	INT			stats(POSIX_TASK_STATS& arStats)	{ return get_task_stats(&m_stTask, &arStats); }
+
+	// waits for the callable to return, -ETIMEDOUT if it does not within adTimeout
+	INT
+	join(std::chrono::nanoseconds adTimeout = std::chrono::seconds(1))
+	{
+		if (m_bStarted == FALSE)
+			return RET_SUCC;
+		return wait_task_end(&m_stTask, read_timer() + to_rttime(adTimeout));
+	}
+
+protected:
+	TaskBase(const CHAR* astrName, INT anPriority, INT anStkSize)
+	{
+		if (anPriority == NonRealTime::value)
+			m_nError = create_nrt_task(&m_stTask, const_cast<PCHAR>(astrName), anStkSize);
+		else
+			m_nError = create_rt_task(&m_stTask, const_cast<PCHAR>(astrName), anStkSize, anPriority);
+	}
+
+	~TaskBase() { shutdown(); }
+
+	// called by the destructor of the derived class as well, its callable must outlive the thread
+	VOID
+	shutdown()
+	{
+		request_stop();
+		if (m_nError != RET_SUCC || m_bDeleted)
+			return;
+		// delete_task() cannot end a running thread, the object must not go away while the callable runs;
+		// eDead is the last access of the thread to m_stTask, a callable that ignores the stop request blocks here
+		if (m_bStarted && join() != RET_SUCC)
+		{
+			DBG_WARN("WARNING : TaskBase: %s ignores the stop request, waiting for it to return", m_stTask.strName);
+			wait_task_end(&m_stTask, TM_INFINITE);
+		}
+		delete_task(&m_stTask);
+		m_bDeleted = TRUE;
+	}
+
+	INT
+	start_entry(PTASKFCN apEntry, PVOID apArg)
+	{
+		if (m_nError != RET_SUCC)
+			return m_nError;
+		INT nRet = start_task(&m_stTask, apEntry, apArg);
+		m_bStarted = (nRet == RET_SUCC);
+		return nRet;
+	}
+
+	POSIX_TASK			m_stTask;
+	INT					m_nError = -EINVAL;
+	BOOL				m_bStarted = FALSE;
+	BOOL				m_bDeleted = FALSE;
+	std::atomic<bool>	m_bStop{ false };
+};
+
+/* ONE-SHOT TASK: the callable runs once, it may take a TaskBase& to watch stop_requested() */
+template <typename Prio, typename Fn>
+class Task : public TaskBase
+{
+public:
+	Task(const CHAR* astrName, Prio, Fn aFn, INT anStkSize = 0)
+		: TaskBase(astrName, Prio::value, anStkSize), m_fn(std::move(aFn))
+	{
+	}
+	~Task() { shutdown(); }
+
+	INT start() { return start_entry(&Task::_entry, this); }
+
+private:
+	static VOID
+	_entry(PVOID apArg)
+	{
+		Task* pSelf = static_cast<Task*>(apArg);
+		if constexpr (std::is_invocable_v<Fn&, TaskBase&>)
+			pSelf->m_fn(static_cast<TaskBase&>(*pSelf));
+		else
+			pSelf->m_fn();
+	}
+
+	Fn		m_fn;
+};
+
+template <INT P, typename Fn> Task(const CHAR*, Priority<P>, Fn) -> Task<Priority<P>, Fn>;
+template <INT P, typename Fn> Task(const CHAR*, Priority<P>, Fn, INT) -> Task<Priority<P>, Fn>;
+template <typename Fn> Task(const CHAR*, NonRealTime, Fn) -> Task<NonRealTime, Fn>;
+template <typename Fn> Task(const CHAR*, NonRealTime, Fn, INT) -> Task<NonRealTime, Fn>;
+
+/* PERIODIC TASK: the callable is the body of one cycle, wait_next_period() is called after it.
+ * It may take the missed releases of the last wait (UINT64) and may return bool, false ends the loop. */
+template <typename PeriodT, typename Prio, typename Fn>
+class PeriodicTask : public TaskBase
+{
+public:
+	static constexpr std::chrono::nanoseconds period = PeriodT::value;
+
+	PeriodicTask(const CHAR* astrName, PeriodT, Prio, Fn aFn, INT anStkSize = 0)
+		: TaskBase(astrName, Prio::value, anStkSize), m_fn(std::move(aFn))
+	{
+	}
+	~PeriodicTask() { shutdown(); }
+
+	// the body first runs at the first release, one period after arttStart (SET_TM_NOW for now)
+	INT
+	start(RTTIME arttStart = SET_TM_NOW)
+	{
+		if (m_nError != RET_SUCC)
+			return m_nError;
+		INT nRet = set_task_period(&m_stTask, arttStart, to_rttime(period));
+		if (nRet != RET_SUCC)
+			return nRet;
+		return start_entry(&PeriodicTask::_entry, this);
+	}
+
+	UINT64	overruns() const	{ return __atomic_load_n(&m_stTask.ullOverruns, __ATOMIC_RELAXED); }
+	// missed releases of the wait that a stop request ended, the body never sees those (0 otherwise)
+	UINT64	last_missed() const	{ return __atomic_load_n(&m_ullLastMissed, __ATOMIC_RELAXED); }
+
+private:
+	static VOID
+	_entry(PVOID apArg)
+	{
+		PeriodicTask* pSelf = static_cast<PeriodicTask*>(apArg);
+		pSelf->_loop();
+	}
+
+	// instantiated for every callable type, so the compiler sees the body and can inline it
+	VOID
+	_loop()
+	{
+		__atomic_store_n(&m_ullLastMissed, 0, __ATOMIC_RELAXED);
+		while (stop_requested() == FALSE)
+		{
+			// every job starts at its release, so its latency and execution time are in the stats
+			UINT64 ullMissed = 0;
+			wait_next_period(&ullMissed);
+			if (stop_requested())
+			{
+				__atomic_store_n(&m_ullLastMissed, ullMissed, __ATOMIC_RELAXED);
+				break;
+			}
+
+			if constexpr (std::is_invocable_v<Fn&, UINT64>)
+			{
+				if constexpr (std::is_void_v<std::invoke_result_t<Fn&, UINT64>>)
+					m_fn(ullMissed);
+				else if (!m_fn(ullMissed))
+					break;
+			}
+			else
+			{
+				if constexpr (std::is_void_v<std::invoke_result_t<Fn&>>)
+					m_fn();
+				else if (!m_fn())
+					break;
+			}
+		}
+	}
+
+	Fn		m_fn;
+	UINT64	m_ullLastMissed = 0;
+};
+
+template <std::intmax_t N, typename R, typename Prio, typename Fn>
+PeriodicTask(const CHAR*, Period<N, R>, Prio, Fn) -> PeriodicTask<Period<N, R>, Prio, Fn>;
+template <std::intmax_t N, typename R, typename Prio, typename Fn>
+PeriodicTask(const CHAR*, Period<N, R>, Prio, Fn, INT) -> PeriodicTask<Period<N, R>, Prio, Fn>;
+
+} // namespace rt
+
+#endif //__RT_POSIX_HPP__
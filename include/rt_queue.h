@@ -0,0 +1,61 @@
+/*
+ *  This file is owned by the Embedded Systems Laboratory of Seoul National University of Science and Technology
+ *  as a part of RT-AIDE or the RTOS-Agnostic and Interoperable Development Environment for Real-time Systems
+ *
+ *  File: rt_queue.h
+ *  Author: 2022 Raimarius Delgado
+ *  Description: Header file for rt_queue.c, a lock-free single-producer/single-consumer message queue
+ *				 whose messages are written and read in place (zero-copy)
+ *
+ *
+ *
+*/
+#ifndef __RT_QUEUE_H__
+#define __RT_QUEUE_H__
+
+#include "posix_rt.h"
+
+#define RT_CACHELINE_SIZE	(64)
+#define RT_QUEUE_SLOT_HDR	(16)	// per-slot header, keeps the payload 16-byte aligned
+
+typedef struct _RT_QUEUE
+{
+	/* read-only after create_rt_queue() */
+	PBYTE			pBuffer;
+	UINT32			uSlotSize;		// stride between slots, multiple of RT_CACHELINE_SIZE
+	UINT32			uSlotCnt;		// power of two
+	UINT32			uMsgSize;		// largest payload of a slot
+	CHAR			strName[MAX_NAME_LENGTH];
+
+	/* producer side */
+	UINT32			uHead __attribute__((aligned(RT_CACHELINE_SIZE)));
+	BOOL			bReserved;
+
+	/* consumer side */
+	UINT32			uTail __attribute__((aligned(RT_CACHELINE_SIZE)));
+	UINT32			uWaiting;		// consumer is asleep in rt_queue_timed_receive()
+} RT_QUEUE;
+
+#ifdef __cplusplus
+extern "C" {
+#endif //__cplusplus
+
+/* QUEUE MANAGEMENT */
+INT		create_rt_queue			(RT_QUEUE* apQueue, const PCHAR astrName, UINT32 auMsgSize, UINT32 auMsgCnt);
+INT		delete_rt_queue			(RT_QUEUE* apQueue);
+UINT32	get_rt_queue_count		(RT_QUEUE* apQueue);
+
+/* PRODUCER */
+INT		rt_queue_reserve		(RT_QUEUE* apQueue, PVOID* appMsg);
+INT		rt_queue_commit			(RT_QUEUE* apQueue, UINT32 auSize);
+
+/* CONSUMER */
+INT		rt_queue_receive		(RT_QUEUE* apQueue, PVOID* appMsg, UINT32* apuSize);
+INT		rt_queue_timed_receive	(RT_QUEUE* apQueue, PVOID* appMsg, UINT32* apuSize, RTTIME aullAbsTimeout);
+INT		rt_queue_release		(RT_QUEUE* apQueue);
+
+#ifdef __cplusplus
+}
+#endif //__cplusplus
+
+#endif //__RT_QUEUE_H__
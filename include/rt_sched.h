@@ -0,0 +1,61 @@
+/*
+ *  This file is owned by the Embedded Systems Laboratory of Seoul National University of Science and Technology
+ *  as a part of RT-AIDE or the RTOS-Agnostic and Interoperable Development Environment for Real-time Systems
+ *
+ *  File: rt_sched.h
+ *  Author: 2022 Raimarius Delgado
+ *  Description: Header file for rt_sched.c, rate/deadline-monotonic priority assignment and
+ *				 response-time analysis of the periodic SCHED_FIFO tasks of every CPU
+ *
+ *
+ *
+*/
+#ifndef __RT_SCHED_H__
+#define __RT_SCHED_H__
+
+#include "posix_rt.h"
+
+typedef enum _eRT_PRIO_ORDER
+{
+	eOrderRateMonotonic = 0x00,	// shorter period, higher priority
+	eOrderDeadlineMonotonic,	// shorter relative deadline, higher priority
+} RT_PRIO_ORDER;
+
+typedef enum _eRT_ADMISSION
+{
+	eAdmitOff = 0x00,			// start_task() does not analyse anything
+	eAdmitWarn,					// start_task() logs the tasks that would miss their deadline
+	eAdmitReject,				// start_task() fails with -EBUSY if a task would miss its deadline
+} RT_ADMISSION;
+
+typedef struct _RT_RTA_RESULT
+{
+	POSIX_TASK*		pTask;
+	INT				nCpu;			// CPU of the worst response time, -1 when the task was not analysed
+	RTTIME			ullWcet;		// declared WCET, or the largest measured execution time
+	RTTIME			ullDeadline;	// relative deadline (the period unless declared)
+	RTTIME			ullResponse;	// worst-case response time, the analysis stops once it passes the deadline
+	BOOL			bSchedulable;
+} RT_RTA_RESULT;
+
+#ifdef __cplusplus
+extern "C" {
+#endif //__cplusplus
+
+/* TIMING MODEL */
+INT		set_task_wcet			(POSIX_TASK* apTask, RTTIME aullWcet, RTTIME aullDeadline);
+RTTIME	get_task_wcet			(POSIX_TASK* apTask);
+
+/* PRIORITY ASSIGNMENT AND ANALYSIS */
+INT		assign_task_priorities	(POSIX_TASK** appTasks, INT anTaskCnt, INT anOrder, INT anPrioHi);
+INT		analyze_task_set		(POSIX_TASK** appTasks, INT anTaskCnt, RT_RTA_RESULT* apResults);
+
+/* ADMISSION CONTROL (called by start_task()) */
+INT		set_admission_control	(INT anMode);
+INT		admit_task				(POSIX_TASK* apTask);
+
+#ifdef __cplusplus
+}
+#endif //__cplusplus
+
+#endif //__RT_SCHED_H__
@@ -0,0 +1,77 @@
+/*
+ *  This file is owned by the Embedded Systems Laboratory of Seoul National University of Science and Technology
+ *  as a part of RT-AIDE or the RTOS-Agnostic and Interoperable Development Environment for Real-time Systems
+ *
+ *  File: rt_sync.h
+ *  Author: 2022 Raimarius Delgado
+ *  Description: Header file for rt_sync.c, priority-inheritance mutex, counting semaphore and event flags
+ *				 that stay in user space when uncontended and sleep on a futex otherwise
+ *
+ *
+ *
+*/
+#ifndef __RT_SYNC_H__
+#define __RT_SYNC_H__
+
+#include "posix_rt.h"
+
+/* a PI futex word: TID of the owner plus the FUTEX_WAITERS bit set by the kernel, 0 when free */
+typedef struct _RT_MUTEX
+{
+	UINT32			uOwner;
+} RT_MUTEX;
+
+typedef struct _RT_SEM
+{
+	UINT32			uCount;
+	UINT32			uWaiters;		// tasks asleep in rt_sem_timed_wait()
+} RT_SEM;
+
+typedef struct _RT_EVENT
+{
+	UINT32			uFlags;
+	UINT32			uWaiters;		// tasks asleep in rt_event_timed_wait()
+} RT_EVENT;
+
+typedef enum _eRT_EVENT_MODE
+{
+	eEventAny = 0x00,		// wake up when any of the bits in the mask is set
+	eEventAll = 0x01,		// wake up when all of the bits in the mask are set
+	eEventConsume = 0x02,	// or-ed with the above, clear the awaited bits when waking up
+} RT_EVENT_MODE;
+
+#ifdef __cplusplus
+extern "C" {
+#endif //__cplusplus
+
+/* MUTEX (priority inheritance, not recursive) */
+INT		create_rt_mutex			(RT_MUTEX* apMutex);
+INT		delete_rt_mutex			(RT_MUTEX* apMutex);
+INT		rt_mutex_lock			(RT_MUTEX* apMutex);
+INT		rt_mutex_trylock		(RT_MUTEX* apMutex);
+INT		rt_mutex_timed_lock		(RT_MUTEX* apMutex, RTTIME aullAbsTimeout);
+INT		rt_mutex_unlock			(RT_MUTEX* apMutex);
+
+/* COUNTING SEMAPHORE */
+INT		create_rt_sem			(RT_SEM* apSem, UINT32 auInitial);
+INT		delete_rt_sem			(RT_SEM* apSem);
+UINT32	get_rt_sem_count		(RT_SEM* apSem);
+INT		rt_sem_post				(RT_SEM* apSem);
+INT		rt_sem_trywait			(RT_SEM* apSem);
+INT		rt_sem_wait				(RT_SEM* apSem);
+INT		rt_sem_timed_wait		(RT_SEM* apSem, RTTIME aullAbsTimeout);
+
+/* EVENT FLAGS */
+INT		create_rt_event			(RT_EVENT* apEvent, UINT32 auInitial);
+INT		delete_rt_event			(RT_EVENT* apEvent);
+UINT32	get_rt_event_flags		(RT_EVENT* apEvent);
+INT		rt_event_set			(RT_EVENT* apEvent, UINT32 auMask);
+INT		rt_event_clear			(RT_EVENT* apEvent, UINT32 auMask);
+INT		rt_event_wait			(RT_EVENT* apEvent, UINT32 auMask, INT anMode, UINT32* apuFlags);
+INT		rt_event_timed_wait		(RT_EVENT* apEvent, UINT32 auMask, INT anMode, UINT32* apuFlags, RTTIME aullAbsTimeout);
+
+#ifdef __cplusplus
+}
+#endif //__cplusplus
+
+#endif //__RT_SYNC_H__
@@ -0,0 +1,88 @@
+/*
+ *  This file is owned by the Embedded Systems Laboratory of Seoul National University of Science and Technology
+ *  as a part of RT-AIDE or the RTOS-Agnostic and Interoperable Development Environment for Real-time Systems
+ *
+ *  File: rt_system.h
+ *  Author: 2022 Raimarius Delgado
+ *  Description: Header file for rt_system.c, one-call process setup for RT (DMA latency, timer slack,
+ *				 memory locking, malloc tuning) and a report of the system settings that hurt latency
+ *
+ *
+ *
+*/
+#ifndef __RT_SYSTEM_H__
+#define __RT_SYSTEM_H__
+
+#include "posix_rt.h"
+
+#define MAX_SYSTEM_DETAIL			(96)
+#define DEFAULT_SYSTEM_PREFAULT		(8 * 1024 * 1024)	//8MB of heap touched and kept by rt_system_prepare()
+
+/* SETUP STEPS (auFlags of rt_system_prepare) */
+#define RT_SYS_DMA_LATENCY			(1 << 0)	// hold /dev/cpu_dma_latency at 0 until rt_system_release()
+#define RT_SYS_TIMER_SLACK			(1 << 1)	// 1ns slack, inherited by the tasks created afterwards
+#define RT_SYS_MEMLOCK				(1 << 2)	// mlockall() of the current and future pages
+#define RT_SYS_MALLOC				(1 << 3)	// no heap trimming and no mmap for malloc()
+#define RT_SYS_PREFAULT				(1 << 4)	// touch the heap once so that malloc() never faults
+#define RT_SYS_ALL					(0x1F)
+
+typedef enum _eRT_SYSTEM_ITEM
+{
+	/* setup */
+	eSysDmaLatency = 0x00,
+	eSysTimerSlack,
+	eSysMemLock,
+	eSysMalloc,
+	eSysPrefault,
+	/* checks */
+	eSysIsolCpus,
+	eSysNohzFull,
+	eSysGovernor,
+	eSysRtThrottling,
+	eSysPreemptRt,
+	eSysHugePages,
+	eSysTimerMigration,
+	eSysRtPriority,
+	eSysItemCnt,
+} RT_SYSTEM_ITEM;
+
+typedef enum _eRT_SYSTEM_RESULT
+{
+	eSysSkipped = 0x00,		// not requested or not applicable on this system
+	eSysPassed,
+	eSysWarning,			// a latency hazard, nothing failed
+	eSysFailed,				// the setup step did not succeed, nErrno tells why
+} RT_SYSTEM_RESULT;
+
+typedef struct _RT_SYSTEM_CHECK
+{
+	INT				nResult;
+	INT				nErrno;
+	CHAR			strDetail[MAX_SYSTEM_DETAIL];
+} RT_SYSTEM_CHECK;
+
+typedef struct _RT_SYSTEM_REPORT
+{
+	RT_SYSTEM_CHECK	stItems[eSysItemCnt];
+	UINT32			uFailed;
+	UINT32			uWarnings;
+} RT_SYSTEM_REPORT;
+
+#ifdef __cplusplus
+extern "C" {
+#endif //__cplusplus
+
+/* SETUP (runs the steps in auFlags and then the checks, apReport may be NULL) */
+INT			rt_system_prepare		(UINT32 auFlags, size_t aulPrefault, RT_SYSTEM_REPORT* apReport);
+INT			rt_system_release		(VOID);
+
+/* CHECKS ONLY (changes nothing) */
+INT			rt_system_check			(RT_SYSTEM_REPORT* apReport);
+const PCHAR	get_rt_system_item_name	(INT anItem);
+VOID		print_rt_system_report	(RT_SYSTEM_REPORT* apReport);
+
+#ifdef __cplusplus
+}
+#endif //__cplusplus
+
+#endif //__RT_SYSTEM_H__
@@ -0,0 +1,81 @@
+/*
+ *  This file is owned by the Embedded Systems Laboratory of Seoul National University of Science and Technology
+ *  as a part of RT-AIDE or the RTOS-Agnostic and Interoperable Development Environment for Real-time Systems
+ *
+ *  File: rt_telemetry.h
+ *  Author: 2022 Raimarius Delgado
+ *  Description: Header file for rt_telemetry.c, per-task telemetry published into a shared-memory region
+ *				 that external tools (rtposix-top) can read without disturbing the RT tasks
+ *
+ *
+ *
+*/
+#ifndef __RT_TELEMETRY_H__
+#define __RT_TELEMETRY_H__
+
+#include "posix_rt.h"
+
+#define RT_TELEMETRY_MAGIC		(0x52545054)	// "RTPT"
+#define RT_TELEMETRY_VERSION	(1)
+#define RT_TELEMETRY_MAX_TASKS	(64)
+#define RT_TELEMETRY_PREFIX		"/rtposix."		// shm name is the prefix followed by the PID
+
+/* one record per task, written only by the task itself and guarded by a seqlock (odd uSeq: write in progress) */
+typedef struct _RT_TELEMETRY_RECORD
+{
+	UINT32			uSeq;
+	UINT32			uInUse;		// TID of the owning task, 0 for a free record
+	CHAR			strName[MAX_NAME_LENGTH];
+	PID				nPid;
+	DWORD			dwStatus;
+	INT				nPriority;
+	INT				nSchedPolicy;
+	RTTIME			ullPeriod;
+	UINT64			ullCycles;
+	UINT64			ullOverruns;
+	RTTIME			ullLatLast;
+	RTTIME			ullLatMin;
+	RTTIME			ullLatMax;
+	RTTIME			ullLatSum;
+	RTTIME			ullExecLast;
+	RTTIME			ullExecMax;
+	RTTIME			rttUpdated;
+} __attribute__((aligned(64))) RT_TELEMETRY_RECORD;
+
+typedef struct _RT_TELEMETRY_HEADER
+{
+	UINT32			uMagic;
+	UINT32			uVersion;
+	UINT32			uRecordSize;
+	UINT32			uRecordCnt;
+	PID				nPid;
+	RTTIME			rttStarted;
+	CHAR			strProcess[MAX_NAME_LENGTH];
+} __attribute__((aligned(64))) RT_TELEMETRY_HEADER;
+
+typedef struct _RT_TELEMETRY_REGION
+{
+	RT_TELEMETRY_HEADER		stHeader;
+	RT_TELEMETRY_RECORD		stRecords[RT_TELEMETRY_MAX_TASKS];
+} RT_TELEMETRY_REGION;
+
+#ifdef __cplusplus
+extern "C" {
+#endif //__cplusplus
+
+/* PUBLISHER (inside the RT process) */
+INT		start_telemetry			(VOID);
+INT		stop_telemetry			(VOID);
+INT		publish_task_telemetry	(POSIX_TASK* apTask);
+VOID	release_task_telemetry	(POSIX_TASK* apTask);
+
+/* READER (external tools) */
+INT		open_telemetry			(PID anPid, RT_TELEMETRY_REGION** appRegion);
+INT		read_telemetry_record	(RT_TELEMETRY_REGION* apRegion, UINT32 auIndex, RT_TELEMETRY_RECORD* apRecord);
+INT		close_telemetry			(RT_TELEMETRY_REGION* apRegion);
+
+#ifdef __cplusplus
+}
+#endif //__cplusplus
+
+#endif //__RT_TELEMETRY_H__
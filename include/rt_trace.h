@@ -0,0 +1,92 @@
+/*
+ *  This file is owned by the Embedded Systems Laboratory of Seoul National University of Science and Technology
+ *  as a part of RT-AIDE or the RTOS-Agnostic and Interoperable Development Environment for Real-time Systems
+ *
+ *  File: rt_trace.h
+ *  Author: 2022 Raimarius Delgado
+ *  Description: Header file for rt_trace.c, binary per-CPU event tracer of the task lifecycle with a
+ *				 flight-recorder mode and an exporter to the Chrome/Perfetto JSON trace format
+ *
+ *
+ *
+*/
+#ifndef __RT_TRACE_H__
+#define __RT_TRACE_H__
+
+#include "posix_rt.h"
+
+#define LIM_TRACE_CPUS			(64)
+#define LIM_TRACE_TASKS			(256)
+#define RT_TRACE_NO_TASK		(0xFFFF)
+#define DEFAULT_TRACE_EVENTS	(4096)		// events per CPU
+
+typedef enum _eRT_TRACE_TYPE
+{
+	eTraceCreate = 0x00,	// arg: priority
+	eTraceStart,			// the thread runs, arg: PID
+	eTraceRelease,			// stamped with the programmed release time
+	eTraceWakeup,			// arg: wakeup latency
+	eTraceWait,				// the job ends, arg: next release
+	eTraceOverrun,			// arg: missed releases
+	eTraceSuspend,
+	eTraceResume,			// arg: 1 if the task was parked
+	eTraceEnd,
+	eTraceUser,				// arg: user defined
+	eTraceTypeCnt,
+} RT_TRACE_TYPE;
+
+typedef enum _eRT_TRACE_MODE
+{
+	eTraceContinuous = 0x00,	// the rings wrap around until stop_trace()
+	eTraceFlightRecorder,		// the rings wrap around until the first overrun, then they are frozen
+} RT_TRACE_MODE;
+
+typedef struct _RT_TRACE_EVENT
+{
+	UINT32			uSeq;		// position in the ring plus one once the event is complete
+	UINT16			uType;
+	UINT16			uTask;		// index in the task table of the tracer, RT_TRACE_NO_TASK for none
+	PID				nTid;		// thread that recorded the event
+	UINT32			uCpu;
+	RTTIME			rttStamp;
+	UINT64			ullArg;
+} RT_TRACE_EVENT;
+
+typedef struct _RT_TRACE_INFO
+{
+	BOOL			bActive;
+	BOOL			bFrozen;
+	INT				nMode;
+	UINT32			uCpuCnt;
+	UINT32			uEventsPerCpu;
+	UINT64			ullRecorded;	// events written since start_trace()
+	UINT64			ullLost;		// events overwritten by the ring wrapping around
+	RTTIME			rttFrozen;
+	CHAR			strFrozenBy[MAX_NAME_LENGTH];
+} RT_TRACE_INFO;
+
+#ifdef __cplusplus
+extern "C" {
+#endif //__cplusplus
+
+/* CONTROL */
+INT		start_trace			(UINT32 auEventsPerCpu, INT anMode);
+INT		stop_trace			(VOID);
+INT		rearm_trace			(VOID);
+BOOL	is_trace_frozen		(VOID);
+INT		get_trace_info		(RT_TRACE_INFO* apInfo);
+
+/* RECORDING (arttStamp 0 means read_timer()), called by posix_rt.c on every lifecycle event */
+VOID	trace_task_event	(INT anType, POSIX_TASK* apTask, RTTIME arttStamp, UINT64 aullArg);
+VOID	trace_user_event	(UINT64 aullArg);
+
+/* EXPORT (events of all CPUs ordered by time) */
+INT		read_trace_events	(RT_TRACE_EVENT* apEvents, UINT32 auMaxCnt);
+INT		get_trace_task_name	(UINT16 auTask, PCHAR astrName);
+INT		export_trace_json	(const PCHAR astrPath);
+
+#ifdef __cplusplus
+}
+#endif //__cplusplus
+
+#endif //__RT_TRACE_H__
@@ -30,7 +30,56 @@
 #define BOLDCYAN    "\033[1m\033[36m"      /* Bold Cyan */
 #define BOLDWHITE   "\033[1m\033[37m"      /* Bold White */
 
+/* deferred logger: every thread owns a single-producer ring of binary records that a drain task formats later */
+#define LOG_RING_RECORDS	(128)		// must be a power of two
+#define LOG_MAX_RINGS		(32)
+#define LOG_MAX_ARGS		(8)
+#define LOG_STR_ARENA		(48)		// bytes reserved per record for copies of %s arguments
+#define LOG_MAX_SPEC		(32)
+
+typedef enum _LOG_RING_STATE
+{
+	eRingFree = 0,
+	eRingActive,
+	eRingOrphan,						// owner thread exited, recycled once drained
+} LOG_RING_STATE;
+
+typedef union _LOG_ARG
+{
+	long long		llInt;
+	double			dFloat;
+	PVOID			pPtr;
+} LOG_ARG;
+
+typedef struct _LOG_RECORD
+{
+	const CHAR*			strFmt;
+	const CHAR*			strFileName;
+	INT					nLineNo;
+	LOWLEVEL_LOG_TYPE	eType;
+	UINT64				ullTimestamp;	// CLOCK_MONOTONIC, same timebase as read_timer()
+	BYTE				byArgCnt;
+	BYTE				byArenaUsed;
+	LOG_ARG				unArgs[LOG_MAX_ARGS];
+	CHAR				strArena[LOG_STR_ARENA];
+} LOG_RECORD;
+
+typedef struct _LOG_RING
+{
+	UINT32		uHead __attribute__((aligned(64)));	// written by the owner thread only
+	UINT32		uTail __attribute__((aligned(64)));	// written by the drain only
+	INT			nState;
+	LOG_RECORD	stRecords[LOG_RING_RECORDS];
+} LOG_RING;
+
 static BOOL bVerbose = FALSE;
+static BOOL bDeferred = FALSE;
+static LOG_RING g_stLogRings[LOG_MAX_RINGS];
+static UINT64 g_ullLogDrops = 0;
+static __thread LOG_RING* tls_pLogRing = NULL;
+static pthread_key_t g_unLogRingKey;
+static pthread_once_t g_unLogRingOnce = PTHREAD_ONCE_INIT;
+static pthread_mutex_t g_mtxLogDrain = PTHREAD_MUTEX_INITIALIZER;
 
 void 
 zero_memory(PVOID pInput, size_t aulSize)
@@ -50,15 +99,403 @@ get_available_cpus(VOID)
 	return get_nprocs();
 }
 
+INT
+map_locked_region(PVOID* appRegion, size_t aulSize, const CHAR* astrWho)
+{
+	// pre-faulted, locked and zeroed, the RT paths that use it never take a page fault
+	PVOID pRegion = mmap(NULL, aulSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_POPULATE, -1, 0);
+	if (pRegion == MAP_FAILED)
+	{
+		INT nErr = errno;
+		DBG_ERROR("FAILED : %s (mmap): with errno (%d:%s)", astrWho, nErr, strerror(nErr));
+		return -nErr;
+	}
+	if (mlock(pRegion, aulSize) != 0)
+		DBG_WARN("WARNING : %s (mlock): with errno (%d:%s)", astrWho, errno, strerror(errno));
+
+	memset(pRegion, 0, aulSize);
+	*appRegion = pRegion;
+	return RET_SUCC;
+}
+
+INT
+unmap_locked_region(PVOID apRegion, size_t aulSize)
+{
+	if (munmap(apRegion, aulSize) != 0)
+		return -errno;
+	return RET_SUCC;
+}
+
+static void
+_print_log_record(const CHAR* astrTimeStamp, LOWLEVEL_LOG_TYPE aeType, const CHAR* astrMsg, const CHAR* astrFileName, INT anLineNo)
+{
+	switch (aeType)
+	{
+	case eTRACE:
+		printf(RST "%-10s [TRACE] %s [%s:%d]\n", astrTimeStamp, astrMsg, astrFileName, anLineNo);
+		break;
+	
+	case eWARN:
+		printf(BOLDYELLOW "%-10s [WARNING] %s [%s:%d]\n" RST, astrTimeStamp, astrMsg, astrFileName, anLineNo);
+		break;
+	case eERROR:
+		printf(BOLDRED "%-10s [ERROR] %s [%s:%d]\n" RST, astrTimeStamp, astrMsg, astrFileName, anLineNo);
+		break;
+	case eINFO:
+		printf(BOLDGREEN "%-10s [INFO] %s\n" RST, astrTimeStamp, astrMsg);
+		break;
+	default:
+		break;
+	}
+}
+
+static void
+_release_log_ring(PVOID apRing)
+{
+	// called on thread exit, the drain recycles the ring after printing what is left
+	__atomic_store_n(&((LOG_RING*)apRing)->nState, (INT)eRingOrphan, __ATOMIC_RELEASE);
+}
+
+static void
+_create_log_ring_key(void)
+{
+	pthread_key_create(&g_unLogRingKey, _release_log_ring);
+}
+
+static LOG_RING*
+_acquire_log_ring(void)
+{
+	pthread_once(&g_unLogRingOnce, _create_log_ring_key);
+	for (INT nIdx = 0; nIdx < LOG_MAX_RINGS; nIdx++)
+	{
+		INT nExpected = (INT)eRingFree;
+		if (__atomic_compare_exchange_n(&g_stLogRings[nIdx].nState, &nExpected, (INT)eRingActive, FALSE, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED))
+		{
+			pthread_setspecific(g_unLogRingKey, &g_stLogRings[nIdx]);
+			return &g_stLogRings[nIdx];
+		}
+	}
+	return NULL;
+}
+
+/* parse one conversion specification starting right after '%', returns a pointer past it */
+static const CHAR*
+_parse_log_spec(const CHAR* astrSpec, PCHAR apcConv, INT* apnLength, INT* apnStars)
+{
+	const CHAR* pCur = astrSpec;
+	*apnStars = 0;
+	while (*pCur && strchr("-+ #0'", *pCur))
+		pCur++;
+	if (*pCur == '*')
+	{
+		(*apnStars)++;
+		pCur++;
+	}
+	while (isdigit((unsigned char)*pCur))
+		pCur++;
+	if (*pCur == '.')
+	{
+		pCur++;
+		if (*pCur == '*')
+		{
+			(*apnStars)++;
+			pCur++;
+		}
+		while (isdigit((unsigned char)*pCur))
+			pCur++;
+	}
+	// length modifiers: 0 none, 1 hh, 2 h, 3 l, 4 ll/q/j, 5 z/t, 6 L
+	*apnLength = 0;
+	if (pCur[0] == 'h' && pCur[1] == 'h')		{ *apnLength = 1; pCur += 2; }
+	else if (pCur[0] == 'h')					{ *apnLength = 2; pCur++; }
+	else if (pCur[0] == 'l' && pCur[1] == 'l')	{ *apnLength = 4; pCur += 2; }
+	else if (pCur[0] == 'l')					{ *apnLength = 3; pCur++; }
+	else if (pCur[0] == 'q' || pCur[0] == 'j')	{ *apnLength = 4; pCur++; }
+	else if (pCur[0] == 'z' || pCur[0] == 't')	{ *apnLength = 5; pCur++; }
+	else if (pCur[0] == 'L')					{ *apnLength = 6; pCur++; }
+
+	*apcConv = *pCur;
+	return (*pCur) ? pCur + 1 : pCur;
+}
+
+/* copy the arguments referenced by astrFmt into the record without formatting them */
+static void
+_capture_log_args(LOG_RECORD* apRecord, const CHAR* astrFmt, va_list astList)
+{
+	const CHAR* pCur = astrFmt;
+	apRecord->byArgCnt = 0;
+	apRecord->byArenaUsed = 0;
+
+	while ((pCur = strchr(pCur, '%')) != NULL)
+	{
+		CHAR cConv;
+		INT nLength, nStars;
+		if (pCur[1] == '%')
+		{
+			pCur += 2;
+			continue;
+		}
+		pCur = _parse_log_spec(pCur + 1, &cConv, &nLength, &nStars);
+		if (apRecord->byArgCnt + nStars + 1 > LOG_MAX_ARGS)
+			break; // the remaining conversions are printed as-is
+
+		for (INT nIdx = 0; nIdx < nStars; nIdx++)
+			apRecord->unArgs[apRecord->byArgCnt++].llInt = va_arg(astList, int);
+
+		LOG_ARG* pArg = &apRecord->unArgs[apRecord->byArgCnt++];
+		switch (cConv)
+		{
+		case 'd': case 'i':
+			if (nLength == 4)		pArg->llInt = va_arg(astList, long long);
+			else if (nLength == 3)	pArg->llInt = va_arg(astList, long);
+			else if (nLength == 5)	pArg->llInt = va_arg(astList, ssize_t);
+			else if (nLength == 1)	pArg->llInt = (signed char)va_arg(astList, int);
+			else if (nLength == 2)	pArg->llInt = (short)va_arg(astList, int);
+			else					pArg->llInt = va_arg(astList, int);
+			break;
+		case 'u': case 'o': case 'x': case 'X':
+			if (nLength == 4)		pArg->llInt = (long long)va_arg(astList, unsigned long long);
+			else if (nLength == 3)	pArg->llInt = (long long)va_arg(astList, unsigned long);
+			else if (nLength == 5)	pArg->llInt = (long long)va_arg(astList, size_t);
+			else if (nLength == 1)	pArg->llInt = (unsigned char)va_arg(astList, unsigned int);
+			else if (nLength == 2)	pArg->llInt = (unsigned short)va_arg(astList, unsigned int);
+			else					pArg->llInt = va_arg(astList, unsigned int);
+			break;
+		case 'c':
+			pArg->llInt = va_arg(astList, int);
+			break;
+		case 'f': case 'F': case 'e': case 'E': case 'g': case 'G': case 'a': case 'A':
+			if (nLength == 6)		pArg->dFloat = (double)va_arg(astList, long double);
+			else					pArg->dFloat = va_arg(astList, double);
+			break;
+		case 's':
+		{
+			// strings may live on the caller's stack, so copy them into the record
+			const CHAR* strArg = va_arg(astList, const CHAR*);
+			size_t ulFree = LOG_STR_ARENA - apRecord->byArenaUsed;
+			PCHAR strDst = &apRecord->strArena[apRecord->byArenaUsed];
+			if (strArg == NULL)
+				strArg = "(null)";
+			if (ulFree > 0)
+			{
+				size_t ulLen = strnlen(strArg, ulFree - 1);
+				memcpy(strDst, strArg, ulLen);
+				strDst[ulLen] = '\0';
+				apRecord->byArenaUsed += (BYTE)(ulLen + 1);
+				pArg->pPtr = strDst;
+			}
+			else
+				pArg->pPtr = NULL;
+			break;
+		}
+		case 'p': case 'n':
+			pArg->pPtr = va_arg(astList, PVOID);
+			break;
+		default:
+			apRecord->byArgCnt--;
+			break;
+		}
+	}
+}
+
+/* rebuild the message of a captured record, the drain side of _capture_log_args() */
+static void
+_format_log_record(const LOG_RECORD* apRecord, PCHAR astrBuf, size_t aulSize)
+{
+	const CHAR* pCur = apRecord->strFmt;
+	size_t ulUsed = 0;
+	INT nArg = 0;
+
+	astrBuf[0] = '\0';
+	while (*pCur && ulUsed + 1 < aulSize)
+	{
+		if (*pCur != '%')
+		{
+			astrBuf[ulUsed++] = *pCur++;
+			astrBuf[ulUsed] = '\0';
+			continue;
+		}
+		if (pCur[1] == '%')
+		{
+			astrBuf[ulUsed++] = '%';
+			astrBuf[ulUsed] = '\0';
+			pCur += 2;
+			continue;
+		}
+
+		CHAR cConv;
+		INT nLength, nStars;
+		const CHAR* pEnd = _parse_log_spec(pCur + 1, &cConv, &nLength, &nStars);
+		if (nArg + nStars + 1 > apRecord->byArgCnt)
+		{
+			// argument was not captured, print the rest of the format verbatim
+			snprintf(&astrBuf[ulUsed], aulSize - ulUsed, "%s", pCur);
+			return;
+		}
+
+		// rebuild the specification with '*' resolved and the length modifier normalized
+		CHAR strSpec[LOG_MAX_SPEC];
+		size_t ulSpec = 0;
+		for (const CHAR* pSpec = pCur; pSpec < pEnd && ulSpec + 24 < sizeof(strSpec); pSpec++)
+		{
+			if (*pSpec == '*')
+				ulSpec += (size_t)snprintf(&strSpec[ulSpec], sizeof(strSpec) - ulSpec, "%d", (INT)apRecord->unArgs[nArg++].llInt);
+			else if (strchr("hlqjztL", *pSpec) == NULL && pSpec != pEnd - 1)
+				strSpec[ulSpec++] = *pSpec;
+		}
+		const LOG_ARG* pArg = &apRecord->unArgs[nArg++];
+		INT nWritten = 0;
+		switch (cConv)
+		{
+		case 'd': case 'i': case 'u': case 'o': case 'x': case 'X':
+			ulSpec += (size_t)snprintf(&strSpec[ulSpec], sizeof(strSpec) - ulSpec, "ll%c", cConv);
+			nWritten = snprintf(&astrBuf[ulUsed], aulSize - ulUsed, strSpec, pArg->llInt);
+			break;
+		case 'c':
+			strSpec[ulSpec++] = cConv;
+			strSpec[ulSpec] = '\0';
+			nWritten = snprintf(&astrBuf[ulUsed], aulSize - ulUsed, strSpec, (INT)pArg->llInt);
+			break;
+		case 'f': case 'F': case 'e': case 'E': case 'g': case 'G': case 'a': case 'A':
+			strSpec[ulSpec++] = cConv;
+			strSpec[ulSpec] = '\0';
+			nWritten = snprintf(&astrBuf[ulUsed], aulSize - ulUsed, strSpec, pArg->dFloat);
+			break;
+		case 's':
+			strSpec[ulSpec++] = cConv;
+			strSpec[ulSpec] = '\0';
+			nWritten = snprintf(&astrBuf[ulUsed], aulSize - ulUsed, strSpec, pArg->pPtr ? (const CHAR*)pArg->pPtr : "(...)");
+			break;
+		case 'p':
+			strSpec[ulSpec++] = cConv;
+			strSpec[ulSpec] = '\0';
+			nWritten = snprintf(&astrBuf[ulUsed], aulSize - ulUsed, strSpec, pArg->pPtr);
+			break;
+		default:
+			break; // %n and unknown conversions are dropped
+		}
+		if (nWritten > 0)
+			ulUsed += ((size_t)nWritten < aulSize - ulUsed) ? (size_t)nWritten : aulSize - ulUsed - 1;
+		pCur = pEnd;
+	}
+}
+
+static BOOL
+_push_log_record(const PCHAR astrFileName, INT anLineNo, LOWLEVEL_LOG_TYPE aeType, PCHAR astrFmt, va_list astList)
+{
+	LOG_RING* pRing = tls_pLogRing;
+	if (pRing == NULL)
+	{
+		pRing = _acquire_log_ring();
+		if (pRing == NULL)
+			return FALSE;
+		tls_pLogRing = pRing;
+	}
+
+	UINT32 uHead = pRing->uHead;
+	UINT32 uTail = __atomic_load_n(&pRing->uTail, __ATOMIC_ACQUIRE);
+	if (uHead - uTail >= LOG_RING_RECORDS)
+		return FALSE;
+
+	LOG_RECORD* pRecord = &pRing->stRecords[uHead & (LOG_RING_RECORDS - 1)];
+	struct timespec stNow;
+	clock_gettime(CLOCK_MONOTONIC, &stNow);
+	pRecord->ullTimestamp = (UINT64)stNow.tv_sec * NANOSEC_PER_SEC + (UINT64)stNow.tv_nsec;
+	pRecord->strFmt = astrFmt;
+	pRecord->strFileName = astrFileName;
+	pRecord->nLineNo = anLineNo;
+	pRecord->eType = aeType;
+	_capture_log_args(pRecord, astrFmt, astList);
+
+	__atomic_store_n(&pRing->uHead, uHead + 1, __ATOMIC_RELEASE);
+	return TRUE;
+}
+
+void
+init_deferred_logger(BOOL abOnOff)
+{
+	__atomic_store_n(&bDeferred, abOnOff, __ATOMIC_RELEASE);
+}
+
+UINT64
+get_lowlevel_logger_drops(VOID)
+{
+	return __atomic_load_n(&g_ullLogDrops, __ATOMIC_RELAXED);
+}
+
+INT
+flush_lowlevel_logger(VOID)
+{
+	INT nPrinted = 0;
+	CHAR strBuf[MAX_BUFFER_SIZE];
+	CHAR strTimeStamp[15];
+	struct timespec stMono, stReal;
+
+	pthread_mutex_lock(&g_mtxLogDrain);
+	// records carry monotonic timestamps, shift them to wall-clock time for printing
+	clock_gettime(CLOCK_MONOTONIC, &stMono);
+	clock_gettime(CLOCK_REALTIME, &stReal);
+	INT64 llOffset = ((INT64)stReal.tv_sec - (INT64)stMono.tv_sec) * NANOSEC_PER_SEC + ((INT64)stReal.tv_nsec - (INT64)stMono.tv_nsec);
+
+	for (INT nIdx = 0; nIdx < LOG_MAX_RINGS; nIdx++)
+	{
+		LOG_RING* pRing = &g_stLogRings[nIdx];
+		INT nState = __atomic_load_n(&pRing->nState, __ATOMIC_ACQUIRE);
+		if (nState == (INT)eRingFree)
+			continue;
+
+		UINT32 uTail = pRing->uTail;
+		UINT32 uHead = __atomic_load_n(&pRing->uHead, __ATOMIC_ACQUIRE);
+		for (; uTail != uHead; uTail++)
+		{
+			const LOG_RECORD* pRecord = &pRing->stRecords[uTail & (LOG_RING_RECORDS - 1)];
+			_format_log_record(pRecord, strBuf, sizeof(strBuf));
+
+			time_t stTimeNow = (time_t)(((INT64)pRecord->ullTimestamp + llOffset) / NANOSEC_PER_SEC);
+			TM stTimeStruct;
+			localtime_r(&stTimeNow, &stTimeStruct);
+			strftime(strTimeStamp, sizeof(strTimeStamp), "<%H:%M:%S>", &stTimeStruct);
+
+			_print_log_record(strTimeStamp, pRecord->eType, strBuf, pRecord->strFileName, pRecord->nLineNo);
+			nPrinted++;
+		}
+		__atomic_store_n(&pRing->uTail, uTail, __ATOMIC_RELEASE);
+
+		// recycle rings of exited threads once they are empty
+		if (nState == (INT)eRingOrphan && uTail == __atomic_load_n(&pRing->uHead, __ATOMIC_ACQUIRE))
+		{
+			pRing->uHead = 0;
+			pRing->uTail = 0;
+			__atomic_store_n(&pRing->nState, (INT)eRingFree, __ATOMIC_RELEASE);
+		}
+	}
+	if (nPrinted > 0)
+		fflush(stdout);
+	pthread_mutex_unlock(&g_mtxLogDrain);
+
+	return nPrinted;
+}
+
 void
 write_lowlevel_logger(const PCHAR astrFileName, INT anLineNo, LOWLEVEL_LOG_TYPE aeType, PCHAR astrFmt, ...)
 {
 	if (TRUE == bVerbose)
 	{
-		CHAR	strBuf[MAX_BUFFER_SIZE] = "";
 		va_list strList;
+		if (TRUE == __atomic_load_n(&bDeferred, __ATOMIC_ACQUIRE))
+		{
+			// never format or print on the calling thread, the drain task does it
+			va_start(strList, astrFmt);
+			BOOL bPushed = _push_log_record(astrFileName, anLineNo, aeType, astrFmt, strList);
+			va_end(strList);
+			if (bPushed == FALSE)
+				__atomic_fetch_add(&g_ullLogDrops, 1, __ATOMIC_RELAXED);
+			return;
+		}
+
+		CHAR	strBuf[MAX_BUFFER_SIZE] = "";
 		va_start(strList, astrFmt);
-		vsprintf(strBuf, astrFmt, strList);
+		vsnprintf(strBuf, sizeof(strBuf), astrFmt, strList);
 		va_end(strList);
 		
 		time_t stTimeNow;
@@ -67,24 +504,6 @@ write_lowlevel_logger(const PCHAR astrFileName, INT anLineNo, LOWLEVEL_LOG_TYPE
 		PTM stTimeStruct = localtime(&stTimeNow);
 		strftime(strTimeStamp, sizeof(strTimeStamp), "<%H:%M:%S>", stTimeStruct);
 
-
-		switch (aeType)
-		{
-		case eTRACE:
-			printf(RST "%-10s [TRACE] %s [%s:%d]\n", strTimeStamp, strBuf, astrFileName, anLineNo);
-			break;
-		
-		case eWARN:
-			printf(BOLDYELLOW "%-10s [WARNING] %s [%s:%d]\n" RST, strTimeStamp, strBuf, astrFileName, anLineNo);
-			break;
-		case eERROR:
-			printf(BOLDRED "%-10s [ERROR] %s [%s:%d]\n" RST, strTimeStamp, strBuf, astrFileName, anLineNo);
-			break;
-		case eINFO:
-			printf(BOLDGREEN "%-10s [INFO] %s\n" RST, strTimeStamp, strBuf);
-			break;
-		default:
-			break;
-		}
+		_print_log_record(strTimeStamp, aeType, strBuf, astrFileName, anLineNo);
 	}
-}
\ No newline at end of file
+}
@@ -12,11 +12,118 @@
 */
 #include "posix_rt.h"
 #include "version.h"
+#include "rt_telemetry.h"
+#include "rt_sched.h"
+#include "rt_trace.h"
+#include <linux/futex.h>
+#include <sys/timerfd.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <cpuid.h>
+#endif
 #define CLOCK_TO_USE CLOCK_MONOTONIC
+#define TSC_SHIFT			(32)
+#define WAIT_SOURCE_TIMER_TAG	(LIM_WAIT_FDS)	// epoll tag of the deadline timerfd, fds use their index
+#define TSC_CALIB_PERIOD	(10000000)	//10ms against CLOCK_MONOTONIC
+#define TSC_CALIB_SAMPLES	(16)
+#define TSC_ANCHOR_PERIOD	(1000000000)	//1s between two re-anchors of the TSC timebase
+
+/* glibc does not wrap sched_setattr(2), so we carry the kernel's struct sched_attr ourselves */
+typedef struct _DL_SCHED_ATTR
+{
+	UINT32		size;
+	UINT32		sched_policy;
+	UINT64		sched_flags;
+	INT32		sched_nice;
+	UINT32		sched_priority;
+	UINT64		sched_runtime;
+	UINT64		sched_deadline;
+	UINT64		sched_period;
+} DL_SCHED_ATTR;
 
 pthread_key_t g_unTaskKey; // create a specific key to identify the created task
 
+static POSIX_TASK g_stLoggerTask; // drains the deferred logger outside of the RT tasks
+static BOOL g_bLoggerRunning = FALSE;
+
+typedef enum _eSUSPEND_STATE
+{
+	eSuspendNone = 0x00,
+	eSuspendPending,	// suspend_task() was called, the task parks at its next suspension point
+	eSuspendParked,		// the task sleeps on uSuspend until resume_task()
+} SUSPEND_STATE;
+
+typedef enum _eSTACK_SLOT_STATE
+{
+	eStackFree = 0x00,
+	eStackInUse,
+	eStackRetired,	// the owner thread has ended but may still be running on the stack
+} STACK_SLOT_STATE;
+
+typedef struct _STACK_ARENA
+{
+	pthread_mutex_t	mtxLock;
+	PBYTE			pBase;
+	size_t			ulRegionSize;
+	size_t			ulSlotSize;		// usable stack of a slot, excludes the guard page
+	size_t			ulGuardSize;
+	UINT32			uSlotCnt;
+	BYTE*			pbyState;
+	PID*			pnOwnerTid;
+} STACK_ARENA;
+
+static STACK_ARENA g_stStackArena = { .mtxLock = PTHREAD_MUTEX_INITIALIZER };
+
+/* TSC timebase, calibrated against CLOCK_MONOTONIC when the library is loaded and re-anchored once per second.
+ * The readers use one of two parameter sets, the re-anchor fills the other one and then switches them. */
+typedef struct _TSC_PARAMS
+{
+	UINT32			uSeq;			// odd while the re-anchor rewrites this set
+	UINT64			ullTscBase;
+	RTTIME			rttNsBase;
+	UINT64			ullMult;		// nanoseconds per tick << TSC_SHIFT
+} TSC_PARAMS;
+
+typedef struct _TSC_TIMEBASE
+{
+	BOOL			bValid;
+	UINT64			ullFreqHz;
+	UINT64			ullAnchorTicks;	// ticks between two re-anchors
+	UINT32			uActive;		// index of the set in stParams the readers use
+	UINT32			uAnchoring;		// one thread re-anchors at a time
+	UINT64			ullCalTsc;		// last sample against CLOCK_MONOTONIC, the rate is measured from it
+	RTTIME			rttCalNs;
+	TSC_PARAMS		stParams[2];
+} TSC_TIMEBASE;
+
+static TSC_TIMEBASE g_stTimebase;
+
+static void _calibrate_timebase(VOID);
+
+static INT g_nPlacement = ePlaceCpu0;	// where _create_task() puts new tasks
+static UINT32 g_uPlaceNext = 0;
+static INT _place_task(POSIX_TASK* apTask);
+
+static void _advance_deadline(POSIX_TASK* apTask, UINT64 aullPeriods);
+
+/* every POSIX_TASK whose thread exists, from start_task() until the thread ends, guarded by g_mtxRegistry */
+typedef struct _REGISTRY_ENTRY
+{
+	POSIX_TASK*		pTask;			// the thread lives on it, so it stays valid while listed
+	CHAR			strName[MAX_NAME_LENGTH];
+	PID				nPid;
+	INT				nSchedPolicy;
+	RTTIME			rttWall;		// previous usage sample, for the utilization window
+	RTTIME			ullCpuTime;
+} REGISTRY_ENTRY;
+
+static REGISTRY_ENTRY g_stRegistry[LIM_TASK_REGISTRY];
+static void _init_registry_lock(VOID);
+static pthread_mutex_t g_mtxRegistry;	// priority inheritance, RT tasks take it on start and exit
+
+static __thread PID t_nCachedTid = 0;	// see get_cached_tid()
+
 VOID _constructor_fcn(void) __attribute__((constructor));
+static void _reset_cached_tid(void);
 VOID _destructor_fcn(void) __attribute__((destructor));
 
 /*****************************************************************************/
@@ -43,6 +150,10 @@ _constructor_fcn(void) // initiates the task management pthread_key
 		DBG_INFO("LOADING RT-POSIX v%d.%d.%d.%d [%s]", (INT)VER_MAJOR, (INT)VER_MINOR, (INT)VER_SUB, (INT)VER_PATCH, VER_NAME);
 	}
 
+	_calibrate_timebase();
+	_init_registry_lock();
+	pthread_atfork(NULL, NULL, _reset_cached_tid);
+
 	signal(SIGTERM, handle_signals);
 	signal(SIGINT, handle_signals);
 
@@ -53,6 +164,13 @@ _constructor_fcn(void) // initiates the task management pthread_key
 VOID 
 _destructor_fcn(void) // deletes the task management pthread_key
 {
+	// print whatever the deferred logger still holds before going synchronous again
+	if (TRUE == g_bLoggerRunning)
+	{
+		init_deferred_logger(FALSE);
+		flush_lowlevel_logger();
+	}
+
 	// turn on the logger in case it is turned off by the user
 	init_lowlevel_logger(TRUE); 
 	if (pthread_key_delete(g_unTaskKey))
@@ -92,6 +210,13 @@ _get_posix_task_or_self(POSIX_TASK* apTask)
 	return pTask;
 }
 /*****************************************************************************/
+static BOOL
+_is_task_started(POSIX_TASK* apTask)
+{
+	// wait_next_period() puts a running task back to eReady, only a task that never got a thread has no TID
+	return (apTask->dwStatus > eReady || apTask->nPid != 0) ? TRUE : FALSE;
+}
+/*****************************************************************************/
 INT
 convert_nsecs_to_timespec(UINT64 aullNanoSecs, TIMESPEC* apTimeSpec)
 {
@@ -115,44 +240,603 @@ convert_timespec_to_nsecs(TIMESPEC astTimeSpec, UINT64* apullNanoSecs)
 	return RET_SUCC;
 }
 /*****************************************************************************/
+static void
+_align_deadline_period(POSIX_TASK* apTask)
+{
+	// the reservation starts now, align the period bookkeeping of wait_next_period() with it
+	clock_gettime(CLOCK_TO_USE, &apTask->stDeadline);
+	apTask->stDeadline.tv_nsec += (INT64)apTask->ullPeriod;
+	apTask->stDeadline.tv_sec += apTask->stDeadline.tv_nsec / NANOSEC_PER_SEC;
+	apTask->stDeadline.tv_nsec %= NANOSEC_PER_SEC;
+}
+/*****************************************************************************/
+static INT
+_set_deadline_sched(POSIX_TASK* apTask)
+{
+	// SCHED_DEADLINE can only be applied to a running thread, so the task does it to itself
+	DL_SCHED_ATTR stAttr;
+	ZERO_MEMORY(&stAttr, sizeof(stAttr));
+	stAttr.size = sizeof(stAttr);
+	stAttr.sched_policy = SCHED_DEADLINE;
+	stAttr.sched_runtime = apTask->ullDlRuntime;
+	stAttr.sched_deadline = apTask->ullDlDeadline;
+	stAttr.sched_period = apTask->ullPeriod;
+
+	if (syscall(SYS_sched_setattr, 0, &stAttr, 0) != 0)
+		return -errno;
+
+	_align_deadline_period(apTask);
+	return RET_SUCC;
+}
+/*****************************************************************************/
+/* Stack arena */
+/*****************************************************************************/
+static BOOL
+_is_stack_slot_free(UINT32 auSlot)
+{
+	// a retired slot still belongs to its thread until the kernel has reaped it, caller holds mtxLock
+	if (g_stStackArena.pbyState[auSlot] == eStackRetired &&
+		tgkill(getpid(), g_stStackArena.pnOwnerTid[auSlot], 0) != 0 && errno == ESRCH)
+		g_stStackArena.pbyState[auSlot] = eStackFree;
+
+	return (g_stStackArena.pbyState[auSlot] == eStackFree) ? TRUE : FALSE;
+}
+/*****************************************************************************/
+static INT
+_acquire_stack_slot(POSIX_TASK* apTask)
+{
+	INT nSlot = -1;
+	pthread_mutex_lock(&g_stStackArena.mtxLock);
+	for (UINT32 uSlot = 0; uSlot < g_stStackArena.uSlotCnt && nSlot < 0; uSlot++)
+	{
+		if (_is_stack_slot_free(uSlot))
+		{
+			g_stStackArena.pbyState[uSlot] = eStackInUse;
+			g_stStackArena.pnOwnerTid[uSlot] = 0;
+			nSlot = (INT)uSlot;
+		}
+	}
+	pthread_mutex_unlock(&g_stStackArena.mtxLock);
+
+	apTask->nStackSlot = nSlot;
+	return nSlot;
+}
+/*****************************************************************************/
+static void
+_release_stack_slot(POSIX_TASK* apTask, PID anOwnerTid)
+{
+	if (apTask->nStackSlot < 0)
+		return;
+
+	pthread_mutex_lock(&g_stStackArena.mtxLock);
+	if ((UINT32)apTask->nStackSlot < g_stStackArena.uSlotCnt)
+	{
+		// a thread cannot free the stack it is running on, it is recycled once the thread is gone
+		g_stStackArena.pbyState[apTask->nStackSlot] = (anOwnerTid != 0) ? eStackRetired : eStackFree;
+		g_stStackArena.pnOwnerTid[apTask->nStackSlot] = anOwnerTid;
+	}
+	pthread_mutex_unlock(&g_stStackArena.mtxLock);
+	apTask->nStackSlot = -1;
+}
+/*****************************************************************************/
+static INT
+_set_task_stack(POSIX_TASK* apTask, INT anStkSize)
+{
+	// check sanity of stack size
+	if (anStkSize < (INT)PTHREAD_STACK_MIN || anStkSize == (INT)SET_DEFAULT_STKSZ)
+		apTask->ullStackSize = (UINT64)DEFAULT_STKSIZE;
+	else
+		apTask->ullStackSize = (UINT64)anStkSize;
+
+	// take a locked and pre-faulted stack from the arena whenever one is large enough
+	if (g_stStackArena.pBase != NULL && apTask->ullStackSize <= g_stStackArena.ulSlotSize)
+	{
+		INT nSlot = _acquire_stack_slot(apTask);
+		if (nSlot >= 0)
+		{
+			PBYTE pStack = g_stStackArena.pBase + (size_t)nSlot * (g_stStackArena.ulGuardSize + g_stStackArena.ulSlotSize) + g_stStackArena.ulGuardSize;
+			INT nRet = pthread_attr_setstack(&apTask->stThreadAttr, pStack, g_stStackArena.ulSlotSize);
+			if (nRet != RET_SUCC)
+			{
+				DBG_ERROR("FAILED : Create TASK (pthread_attr_setstack): %s with errno (%d:%s)", apTask->strName, nRet, strerror(nRet));
+				_release_stack_slot(apTask, 0);
+				return -nRet;
+			}
+			apTask->ullStackSize = (UINT64)g_stStackArena.ulSlotSize;
+			return RET_SUCC;
+		}
+		DBG_WARN("WARNING : Create TASK: %s stack arena is exhausted, falling back to a lazily mapped stack", apTask->strName);
+	}
+
+	INT nRet = pthread_attr_setstacksize(&apTask->stThreadAttr, apTask->ullStackSize);
+	if (nRet != RET_SUCC)
+	{
+		DBG_ERROR("FAILED : Create TASK (pthread_attr_setstacksize): %s with errno (%d:%s)", apTask->strName, nRet, strerror(nRet));
+		return -nRet;
+	}
+	return RET_SUCC;
+}
+/*****************************************************************************/
+INT
+init_stack_arena(UINT32 auSlotCnt, INT anSlotSize)
+{
+	if (auSlotCnt == 0 || anSlotSize < (INT)PTHREAD_STACK_MIN)
+	{
+		DBG_ERROR("FAILED : Init Stack Arena: invalid parameters (slots=%u, size=%d)", auSlotCnt, anSlotSize);
+		return -EINVAL;
+	}
+	if (g_stStackArena.pBase != NULL)
+	{
+		DBG_ERROR("FAILED : Init Stack Arena: arena already exists, release it first");
+		return -EBUSY;
+	}
+
+	size_t ulPageSize = (size_t)sysconf(_SC_PAGESIZE);
+	size_t ulSlotSize = ((size_t)anSlotSize + ulPageSize - 1) & ~(ulPageSize - 1);
+	size_t ulStride = ulPageSize + ulSlotSize;
+	size_t ulRegionSize = ulStride * auSlotCnt;
+
+	PBYTE pBase = (PBYTE)mmap(NULL, ulRegionSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (pBase == MAP_FAILED)
+	{
+		DBG_ERROR("FAILED : Init Stack Arena (mmap) with errno (%d:%s)", errno, strerror(errno));
+		return -errno;
+	}
+
+	for (UINT32 uSlot = 0; uSlot < auSlotCnt; uSlot++)
+	{
+		// stacks grow down, so the guard page sits below each slot
+		PBYTE pSlot = pBase + uSlot * ulStride;
+		if (mprotect(pSlot, ulPageSize, PROT_NONE) != 0)
+		{
+			INT nErr = errno;
+			DBG_ERROR("FAILED : Init Stack Arena (mprotect) with errno (%d:%s)", nErr, strerror(nErr));
+			munmap(pBase, ulRegionSize);
+			return -nErr;
+		}
+		if (mlock(pSlot + ulPageSize, ulSlotSize) != 0)
+			DBG_WARN("WARNING : Init Stack Arena (mlock) with errno (%d:%s)", errno, strerror(errno));
+
+		// pre-fault every page so that the first deep call of a task never page-faults
+		memset(pSlot + ulPageSize, 0, ulSlotSize);
+	}
+
+	BYTE* pbyState = (BYTE*)calloc(auSlotCnt, sizeof(BYTE));
+	PID* pnOwnerTid = (PID*)calloc(auSlotCnt, sizeof(PID));
+	if (pbyState == NULL || pnOwnerTid == NULL)
+	{
+		free(pbyState);
+		free(pnOwnerTid);
+		munmap(pBase, ulRegionSize);
+		DBG_ERROR("FAILED : Init Stack Arena: out of memory");
+		return -ENOMEM;
+	}
+
+	pthread_mutex_lock(&g_stStackArena.mtxLock);
+	g_stStackArena.pbyState = pbyState;
+	g_stStackArena.pnOwnerTid = pnOwnerTid;
+	g_stStackArena.ulSlotSize = ulSlotSize;
+	g_stStackArena.ulGuardSize = ulPageSize;
+	g_stStackArena.ulRegionSize = ulRegionSize;
+	g_stStackArena.uSlotCnt = auSlotCnt;
+	g_stStackArena.pBase = pBase;
+	pthread_mutex_unlock(&g_stStackArena.mtxLock);
+
+	DBG_TRACE("SUCCESS: Init Stack Arena : slots=%u, slotsize=%zu", auSlotCnt, ulSlotSize);
+	return RET_SUCC;
+}
+/*****************************************************************************/
+INT
+release_stack_arena(VOID)
+{
+	UINT32 uInUse = 0;
+	if (g_stStackArena.pBase == NULL)
+		return -EINVAL;
+
+	if (get_stack_arena_usage(NULL, &uInUse) != RET_SUCC || uInUse > 0)
+	{
+		DBG_ERROR("FAILED : Release Stack Arena: %u stacks are still owned by tasks", uInUse);
+		return -EBUSY;
+	}
+
+	pthread_mutex_lock(&g_stStackArena.mtxLock);
+	munmap(g_stStackArena.pBase, g_stStackArena.ulRegionSize);
+	free(g_stStackArena.pbyState);
+	free(g_stStackArena.pnOwnerTid);
+	g_stStackArena.pBase = NULL;
+	g_stStackArena.pbyState = NULL;
+	g_stStackArena.pnOwnerTid = NULL;
+	g_stStackArena.uSlotCnt = 0;
+	pthread_mutex_unlock(&g_stStackArena.mtxLock);
+	return RET_SUCC;
+}
+/*****************************************************************************/
+INT
+get_stack_arena_usage(UINT32* apuSlotCnt, UINT32* apuInUse)
+{
+	UINT32 uInUse = 0;
+
+	pthread_mutex_lock(&g_stStackArena.mtxLock);
+	for (UINT32 uSlot = 0; uSlot < g_stStackArena.uSlotCnt; uSlot++)
+	{
+		if (!_is_stack_slot_free(uSlot))
+			uInUse++;
+	}
+	if (apuSlotCnt != NULL)
+		*apuSlotCnt = g_stStackArena.uSlotCnt;
+	if (apuInUse != NULL)
+		*apuInUse = uInUse;
+	pthread_mutex_unlock(&g_stStackArena.mtxLock);
+
+	return RET_SUCC;
+}
+/*****************************************************************************/
+/* Task registry */
+/*****************************************************************************/
+static void
+_init_registry_lock(VOID)
+{
+	// a monitor that holds the lock must not keep an RT task from starting or ending for longer than the critical section
+	pthread_mutexattr_t stAttr;
+	pthread_mutexattr_init(&stAttr);
+	if (pthread_mutexattr_setprotocol(&stAttr, PTHREAD_PRIO_INHERIT) != 0)
+		DBG_WARN("WARNING : CONSTRUCTOR: registry lock without priority inheritance");
+	pthread_mutex_init(&g_mtxRegistry, &stAttr);
+	pthread_mutexattr_destroy(&stAttr);
+}
+/*****************************************************************************/
+static void
+_register_task(POSIX_TASK* apTask)
+{
+	INT nFree = -1;
+	BOOL bListed = FALSE;
+	pthread_mutex_lock(&g_mtxRegistry);
+	for (INT nIdx = 0; nIdx < LIM_TASK_REGISTRY && bListed == FALSE; nIdx++)
+	{
+		// a POSIX_TASK that is created again keeps its entry
+		if (g_stRegistry[nIdx].pTask == apTask)
+		{
+			nFree = nIdx;
+			bListed = TRUE;
+		}
+		else if (g_stRegistry[nIdx].pTask == NULL && nFree < 0)
+			nFree = nIdx;
+	}
+	if (nFree >= 0)
+	{
+		REGISTRY_ENTRY* pEntry = &g_stRegistry[nFree];
+		pEntry->pTask = apTask;
+		memcpy(pEntry->strName, apTask->strName, sizeof(pEntry->strName));
+		pEntry->nPid = apTask->nPid;
+		pEntry->nSchedPolicy = apTask->nSchedPolicy;
+		pEntry->rttWall = 0;
+		pEntry->ullCpuTime = 0;
+	}
+	else
+		DBG_WARN("WARNING : Register TASK: %s registry is full, the task will not be listed", apTask->strName);
+	pthread_mutex_unlock(&g_mtxRegistry);
+}
+/*****************************************************************************/
+static REGISTRY_ENTRY*
+_find_registry_entry(POSIX_TASK* apTask)
+{
+	// call with g_mtxRegistry held, a thread leaves the registry before it ends so a listed TID is never reused
+	for (INT nIdx = 0; nIdx < LIM_TASK_REGISTRY; nIdx++)
+	{
+		if (g_stRegistry[nIdx].pTask == apTask)
+			return &g_stRegistry[nIdx];
+	}
+	return NULL;
+}
+/*****************************************************************************/
+static void
+_update_registered_tid(POSIX_TASK* apTask)
+{
+	// the TID is only known once the thread runs
+	pthread_mutex_lock(&g_mtxRegistry);
+	REGISTRY_ENTRY* pEntry = _find_registry_entry(apTask);
+	if (pEntry != NULL)
+		pEntry->nPid = apTask->nPid;
+
+	// changes that came while nobody knew our TID yet
+	if (apTask->bAffinityPending == TRUE && sched_setaffinity(0, sizeof(CPUSET), &apTask->stCpuAffinity) != 0)
+		DBG_WARN("WARNING : START PROC (sched_setaffinity): %s with errno (%d:%s)", apTask->strName, errno, strerror(errno));
+	apTask->bAffinityPending = FALSE;
+	if (apTask->bPriorityPending == TRUE)
+	{
+		struct sched_param stParam = { .sched_priority = apTask->nPriority };
+		if (sched_setscheduler(0, SCHED_FIFO, &stParam) != 0)
+			DBG_WARN("WARNING : START PROC (sched_setscheduler): %s with errno (%d:%s)", apTask->strName, errno, strerror(errno));
+	}
+	apTask->bPriorityPending = FALSE;
+	pthread_mutex_unlock(&g_mtxRegistry);
+}
+/*****************************************************************************/
+static void
+_unregister_task(POSIX_TASK* apTask)
+{
+	pthread_mutex_lock(&g_mtxRegistry);
+	for (INT nIdx = 0; nIdx < LIM_TASK_REGISTRY; nIdx++)
+	{
+		if (g_stRegistry[nIdx].pTask == apTask)
+			g_stRegistry[nIdx].pTask = NULL;
+	}
+	pthread_mutex_unlock(&g_mtxRegistry);
+}
+/*****************************************************************************/
+static void
+_read_ctx_switches(PID anTid, POSIX_TASK_USAGE* apUsage)
+{
+	CHAR strPath[64];
+	CHAR strLine[128];
+	snprintf(strPath, sizeof(strPath), "/proc/self/task/%d/status", (INT)anTid);
+
+	FILE* pFile = fopen(strPath, "r");
+	if (pFile == NULL)
+		return;
+
+	unsigned long long ullValue;
+	while (fgets(strLine, sizeof(strLine), pFile) != NULL)
+	{
+		if (sscanf(strLine, "voluntary_ctxt_switches: %llu", &ullValue) == 1)
+			apUsage->ullVolCtxSw = (UINT64)ullValue;
+		else if (sscanf(strLine, "nonvoluntary_ctxt_switches: %llu", &ullValue) == 1)
+			apUsage->ullInvolCtxSw = (UINT64)ullValue;
+	}
+	fclose(pFile);
+}
+/*****************************************************************************/
+static void
+_copy_task_usage(POSIX_TASK* apTask, REGISTRY_ENTRY* apEntry, POSIX_TASK_USAGE* apUsage)
+{
+	// under g_mtxRegistry for a listed task, a task that has ended reports the counters it left behind in stUsage
+	*apUsage = apTask->stUsage;
+	memcpy(apUsage->strName, (apEntry != NULL) ? apEntry->strName : apTask->strName, sizeof(apUsage->strName));
+	apUsage->nPid = (apEntry != NULL) ? apEntry->nPid : apTask->nPid;
+	apUsage->dwStatus = apTask->dwStatus;
+	apUsage->nPriority = apTask->nPriority;
+	apUsage->nSchedPolicy = (apEntry != NULL) ? apEntry->nSchedPolicy : apTask->nSchedPolicy;
+}
+/*****************************************************************************/
+static BOOL
+_read_task_counters(POSIX_TASK_USAGE* apUsage)
+{
+	// without the registry lock, the thread may be gone by now and then the reads just fail
+	// a periodic task is back in eReady during its body, the TID tells whether the thread runs
+	if (apUsage->nPid == 0 || apUsage->dwStatus >= eDead)
+		return FALSE;
+
+	// same clock as pthread_getcpuclockid(), built from the TID so that it stays safe for detached threads
+	TIMESPEC stCpuTime;
+	if (clock_gettime((clockid_t)((~(UINT32)apUsage->nPid << 3) | 6), &stCpuTime) != 0)
+		return FALSE;
+	convert_timespec_to_nsecs(stCpuTime, &apUsage->ullCpuTime);
+	_read_ctx_switches(apUsage->nPid, apUsage);
+	return TRUE;
+}
+/*****************************************************************************/
+static void
+_update_task_utilization(POSIX_TASK* apTask, RTTIME arttSampled, POSIX_TASK_USAGE* apUsage)
+{
+	// under g_mtxRegistry, utilization over the window since the previous sample (or since the task started)
+	REGISTRY_ENTRY* pEntry = _find_registry_entry(apTask);
+	if (pEntry == NULL || pEntry->nPid != apUsage->nPid)
+		return;
+
+	RTTIME rttSince = (pEntry->rttWall != 0) ? pEntry->rttWall : apTask->rttStartTime;
+	if (arttSampled > rttSince && apUsage->ullCpuTime >= pEntry->ullCpuTime)
+		apUsage->uUtilization = (UINT32)(((apUsage->ullCpuTime - pEntry->ullCpuTime) * 10000) / (arttSampled - rttSince));
+	pEntry->rttWall = arttSampled;
+	pEntry->ullCpuTime = apUsage->ullCpuTime;
+}
+/*****************************************************************************/
+static void
+_finish_task_usage(POSIX_TASK* apTask)
+{
+	// the thread is the only one who can still read its own counters on the way out
+	TIMESPEC stCpuTime;
+	if (clock_gettime(CLOCK_THREAD_CPUTIME_ID, &stCpuTime) == 0)
+		convert_timespec_to_nsecs(stCpuTime, &apTask->stUsage.ullCpuTime);
+	_read_ctx_switches(apTask->nPid, &apTask->stUsage);
+	apTask->stUsage.uUtilization = 0;
+}
+/*****************************************************************************/
+INT
+get_task_usage(POSIX_TASK* apTask, POSIX_TASK_USAGE* apUsage)
+{
+	POSIX_TASK* pTask;
+	pTask = _get_posix_task_or_self(apTask);
+	if (pTask == NULL || apUsage == NULL)
+		return -EPERM;
+
+	pthread_mutex_lock(&g_mtxRegistry);
+	REGISTRY_ENTRY* pEntry = _find_registry_entry(pTask);
+	_copy_task_usage(pTask, pEntry, apUsage);
+	pthread_mutex_unlock(&g_mtxRegistry);
+
+	// /proc and the CPU clock are read without the lock, RT tasks take it to start and end
+	if (_read_task_counters(apUsage) == TRUE && pEntry != NULL)
+	{
+		RTTIME rttSampled = read_timer();
+		pthread_mutex_lock(&g_mtxRegistry);
+		_update_task_utilization(pTask, rttSampled, apUsage);
+		pthread_mutex_unlock(&g_mtxRegistry);
+	}
+	return RET_SUCC;
+}
+/*****************************************************************************/
+INT
+get_task_snapshot(POSIX_TASK_USAGE* apUsage, INT anMaxCnt)
+{
+	INT nCnt = 0;
+	if (apUsage == NULL || anMaxCnt <= 0)
+		return -EINVAL;
+
+	// the listed tasks are copied under the lock, their counters are read after it is released
+	POSIX_TASK* pTasks[LIM_TASK_REGISTRY];
+	RTTIME rttSampled[LIM_TASK_REGISTRY];
+	pthread_mutex_lock(&g_mtxRegistry);
+	for (INT nIdx = 0; nIdx < LIM_TASK_REGISTRY && nCnt < anMaxCnt; nIdx++)
+	{
+		if (g_stRegistry[nIdx].pTask == NULL)
+			continue;
+		pTasks[nCnt] = g_stRegistry[nIdx].pTask;
+		_copy_task_usage(g_stRegistry[nIdx].pTask, &g_stRegistry[nIdx], &apUsage[nCnt++]);
+	}
+	pthread_mutex_unlock(&g_mtxRegistry);
+
+	for (INT nIdx = 0; nIdx < nCnt; nIdx++)
+		rttSampled[nIdx] = (_read_task_counters(&apUsage[nIdx]) == TRUE) ? read_timer() : 0;
+
+	// a task that left in the meantime is no longer listed and keeps no window
+	pthread_mutex_lock(&g_mtxRegistry);
+	for (INT nIdx = 0; nIdx < nCnt; nIdx++)
+	{
+		if (rttSampled[nIdx] != 0)
+			_update_task_utilization(pTasks[nIdx], rttSampled[nIdx], &apUsage[nIdx]);
+	}
+	pthread_mutex_unlock(&g_mtxRegistry);
+	return nCnt;
+}
+/*****************************************************************************/
+INT
+for_each_task(PTASKVISITFCN apVisit, PVOID apArg)
+{
+	INT nCnt = 0;
+	if (apVisit == NULL)
+		return -EINVAL;
+
+	// the visitor runs under the registry lock, it must not create or delete tasks
+	pthread_mutex_lock(&g_mtxRegistry);
+	for (INT nIdx = 0; nIdx < LIM_TASK_REGISTRY; nIdx++)
+	{
+		if (g_stRegistry[nIdx].pTask == NULL)
+			continue;
+		nCnt++;
+		if (apVisit(g_stRegistry[nIdx].pTask, apArg) != RET_SUCC)
+			break;
+	}
+	pthread_mutex_unlock(&g_mtxRegistry);
+	return nCnt;
+}
+/*****************************************************************************/
+POSIX_TASK*
+find_task_by_name(const PCHAR astrName)
+{
+	POSIX_TASK* pFound = NULL;
+	if (astrName == NULL)
+		return NULL;
+
+	pthread_mutex_lock(&g_mtxRegistry);
+	for (INT nIdx = 0; nIdx < LIM_TASK_REGISTRY && pFound == NULL; nIdx++)
+	{
+		if (g_stRegistry[nIdx].pTask != NULL && strncmp(g_stRegistry[nIdx].strName, astrName, MAX_NAME_LENGTH) == 0)
+			pFound = g_stRegistry[nIdx].pTask;
+	}
+	pthread_mutex_unlock(&g_mtxRegistry);
+	return pFound;
+}
+/*****************************************************************************/
+static BOOL
+_park_task(POSIX_TASK* apTask)
+{
+	// a resume_task() in between cancels the suspension
+	UINT32 uState = eSuspendPending;
+	if (!__atomic_compare_exchange_n(&apTask->uSuspend, &uState, eSuspendParked, FALSE, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE))
+		return FALSE;
+
+	DWORD dwStatus = apTask->dwStatus;
+	apTask->dwStatus = (DWORD)eSuspended;
+	publish_task_telemetry(apTask);
+
+	// futex_wait() returns at once if resume_task() has already cleared the word
+	while (__atomic_load_n(&apTask->uSuspend, __ATOMIC_ACQUIRE) == eSuspendParked)
+		futex_wait(&apTask->uSuspend, eSuspendParked, TM_INFINITE);
+
+	RTTIME rttNow = read_timer();
+	RTTIME rttResume = __atomic_load_n(&apTask->rttResumeRequest, __ATOMIC_RELAXED);
+	__atomic_store_n(&apTask->ullResumeLatency, (rttNow > rttResume) ? rttNow - rttResume : 0, __ATOMIC_RELAXED);
+	apTask->dwStatus = dwStatus;
+	return TRUE;
+}
+/*****************************************************************************/
+static void
+_park_periodic_task(POSIX_TASK* apTask)
+{
+	if (_park_task(apTask) == FALSE)
+		return;
+
+	// the releases that passed while suspended are skipped, they are not overruns
+	RTTIME rttRelease;
+	RTTIME rttNow = read_timer();
+	convert_timespec_to_nsecs(apTask->stDeadline, &rttRelease);
+	if (apTask->ullPeriod > 0 && rttNow > rttRelease)
+		_advance_deadline(apTask, (rttNow - rttRelease) / apTask->ullPeriod + 1);
+}
+/*****************************************************************************/
 PVOID 
 default_trampoline_proc(PVOID arg)
 {
 	POSIX_TASK* pTask = (POSIX_TASK*)arg;
 	
-	if (pTask == NULL || (pTask->dwStatus != ePendingStart && pTask->dwStatus != eSuspended))
+	if (pTask == NULL || pTask->dwStatus != ePendingStart)
 	{
 		DBG_ERROR("FAILED : START PROC : pTask is NULL or pTask is not Started!");
 		exit(-1);
 	}
-	else if ((pTask->dwStatus == eSuspended) || (pTask->bStartSuspended == TRUE))
-	{
-		DBG_TRACE("START PROC : %s Task Start Suspended! Waiting for resume_task()", pTask->strName);
-		pthread_mutex_lock(&pTask->mtxSuspend);
-		pTask->dwStatus = (DWORD)eSuspended;
-		int nRet = pthread_cond_wait(&pTask->cvSuspend, &pTask->mtxSuspend);
-		if (nRet != RET_SUCC)
-		{
-			DBG_ERROR("FAILED : START PROC (pthread_cond_wait): %s with errno (%d:%s)", pTask->strName, nRet, strerror(nRet));
-			exit(-1);
-		}
-		pthread_mutex_unlock(&pTask->mtxSuspend);
-		pTask->bStartSuspended = FALSE;
-	}
 	
 	if((pthread_setname_np(pTask->stThread, pTask->strName)))
 		DBG_WARN("WARNING : START PROC (pthread_setname_np): %s", pTask->strName);
 
 	pTask->nPid = gettid();
+	pTask->rttStartTime = read_timer();
 	_set_current_task(pTask);
+	_update_registered_tid(pTask);
+
+	if (pTask->nSchedPolicy == SCHED_DEADLINE)
+	{
+		// start_task() waits for the answer of the kernel's DL admission before it returns
+		INT nRet = _set_deadline_sched(pTask);
+		if (nRet != RET_SUCC)
+		{
+			DBG_ERROR("FAILED : START PROC (sched_setattr): %s with errno (%d:%s)", pTask->strName, -nRet, strerror(-nRet));
+			_finish_task_usage(pTask);
+			_unregister_task(pTask);
+			_release_stack_slot(pTask, pTask->nPid);
+			pTask->dwStatus = (DWORD)eDead;
+		}
+		// the caller may reuse the POSIX_TASK on a failure, the wakeup is the last access to it
+		pTask->nDlResult = nRet;
+		__atomic_store_n(&pTask->uDlApplied, 1, __ATOMIC_RELEASE);
+		futex_wake(&pTask->uDlApplied, 1);
+		if (nRet != RET_SUCC)
+			return NULL;
+	}
+
+	// suspend_task() before the start, wait here for resume_task()
+	if (__atomic_load_n(&pTask->uSuspend, __ATOMIC_ACQUIRE) != eSuspendNone)
+	{
+		DBG_TRACE("START PROC : %s Task Start Suspended! Waiting for resume_task()", pTask->strName);
+		if (_park_task(pTask) == TRUE && pTask->nSchedPolicy == SCHED_DEADLINE)
+			_align_deadline_period(pTask);
+	}
 	DBG_TRACE("START PROC : %s Task Started! (PID: %d)", pTask->strName, pTask->nPid);
 	pTask->dwStatus = (DWORD)eRunning;
+	publish_task_telemetry(pTask);
+	trace_task_event(eTraceStart, pTask, 0, (UINT64)pTask->nPid);
 	
 	// run the function pointer (entry of the task)
 	pTask->pTaskFcn(pTask->pTaskArg);
 	
-	pTask->dwStatus = (DWORD)eDead;
+	_finish_task_usage(pTask);
+	_unregister_task(pTask);
+	trace_task_event(eTraceEnd, pTask, 0, 0);
+	release_task_telemetry(pTask);
+	_release_stack_slot(pTask, pTask->nPid);
 	DBG_TRACE("START PROC : %s Task Ended!", pTask->strName);
+
+	// the last access, whoever waits for eDead may free or reuse the POSIX_TASK right away
+	__atomic_store_n(&pTask->dwStatus, (DWORD)eDead, __ATOMIC_RELEASE);
 	return NULL;
 }
 /*****************************************************************************/
@@ -164,12 +848,16 @@ _init_posix_task(POSIX_TASK* apTask)
 	apTask->dwStatus = (DWORD)eInit;
 	apTask->nPriority = 0;
 	apTask->ullStackSize = DEFAULT_STKSIZE;
+	apTask->nStackSlot = -1;
 	apTask->bRtMode = FALSE;
 	apTask->bPeriodic = FALSE;
+	apTask->nSchedPolicy = SCHED_OTHER;
 
 	/* first CPU core as the default */
 	CPU_ZERO(&apTask->stCpuAffinity);
 	CPU_SET(0, &apTask->stCpuAffinity);
+	apTask->bAffinityPending = FALSE;
+	apTask->bPriorityPending = FALSE;
 	
 	/* Clear strName */
 	ZERO_MEMORY(apTask->strName, sizeof(apTask->strName));
@@ -177,11 +865,38 @@ _init_posix_task(POSIX_TASK* apTask)
 	apTask->ullPeriod = 0;
 	apTask->stDeadline.tv_sec = 0;
 	apTask->stDeadline.tv_nsec= 0;
+	apTask->ullDlRuntime = 0;
+	apTask->ullDlDeadline = 0;
+	apTask->uDlApplied = 0;
+	apTask->nDlResult = RET_SUCC;
+	apTask->nWakeupMode = eWakeupSleep;
+	apTask->ullSpinMargin = 0;
+	apTask->nOverrunPolicy = eOverrunCatchUp;
+	apTask->nOverrunAction = eOverrunCatchUp;
+	apTask->rttMissedUntil = 0;
+	apTask->pOverrunFcn = NULL;
+	apTask->pOverrunArg = NULL;
+	apTask->ullWcet = 0;
+	apTask->ullRelDeadline = 0;
 
 	apTask->pTaskFcn = NULL;
 	apTask->pTaskArg = NULL;
 
-	apTask->bStartSuspended = FALSE;
+	apTask->uSuspend = eSuspendNone;
+	apTask->rttResumeRequest = 0;
+	apTask->ullResumeLatency = 0;
+
+	apTask->rttLastWakeup = 0;
+	apTask->ullOverruns = 0;
+	apTask->ullLastLatency = 0;
+	apTask->ullLastExecTime = 0;
+	apTask->nTelemetrySlot = -1;
+	apTask->ullTraceTask = 0;
+	ZERO_MEMORY(&apTask->stLatency, sizeof(apTask->stLatency));
+	ZERO_MEMORY(&apTask->stExecTime, sizeof(apTask->stExecTime));
+
+	apTask->rttStartTime = 0;
+	ZERO_MEMORY(&apTask->stUsage, sizeof(apTask->stUsage));
 }
 /*****************************************************************************/
 static INT 
@@ -199,6 +914,7 @@ _create_task(POSIX_TASK* apTask, const PCHAR astrName, INT anStkSize, INT anPrio
 	// setup task name and RT mode
 	strcpy(apTask->strName, astrName);
 	apTask->bRtMode = abIsTaskRT;
+	apTask->nSchedPolicy = (abIsTaskRT == TRUE) ? SCHED_FIFO : SCHED_OTHER;
 	BOOL bIsRealTime = apTask->bRtMode;
 
 	// initiate pthread attributes
@@ -253,60 +969,19 @@ _create_task(POSIX_TASK* apTask, const PCHAR astrName, INT anStkSize, INT anPrio
 		}
 	}
 	
-	// deploy the thread to CPU0 by default, this can be changed before the tasks starts
-	nRet = set_cpu_affinity(apTask, 0);
+	// deploy the thread according to the placement policy (CPU0 by default), this can be changed later on
+	nRet = _place_task(apTask);
 	if (nRet != RET_SUCC)
-		return -nRet;
-
-	// check sanity of stack size
-	if (anStkSize < (INT)PTHREAD_STACK_MIN || anStkSize == (INT)SET_DEFAULT_STKSZ)
-		apTask->ullStackSize = (UINT64)DEFAULT_STKSIZE;
-	else
-		apTask->ullStackSize = (UINT64)anStkSize;
+		return nRet;
 
-	nRet = pthread_attr_setstacksize(&apTask->stThreadAttr, apTask->ullStackSize);
-	if (nRet != RET_SUCC)
-	{
-		DBG_ERROR("FAILED : Create TASK (pthread_attr_setstacksize): %s with errno (%d:%s)", astrName, nRet, strerror(nRet));
-		return -nRet;
-	}
-	
 	apTask->dwStatus = (DWORD)eReady;
 
-	/* initiate conditional variable and corresponding mutex */
-	nRet = pthread_cond_init(&apTask->cvSuspend, NULL);
+	// the stack is taken last so that none of the failures above can leak an arena slot
+	nRet = _set_task_stack(apTask, anStkSize);
 	if (nRet != RET_SUCC)
-	{
-		DBG_ERROR("FAILED : Create TASK (pthread_cond_init): %s with errno (%d:%s)", astrName, nRet, strerror(nRet));
-		return -nRet;
-	}
-	
-	pthread_mutexattr_t *pstMtxAttr = NULL;
-	pthread_mutexattr_t stMtxAttr;
-	// we need to ensure that the mutex implements priority inheritance in case of real-time task
-	if (bIsRealTime == TRUE)
-	{
-		nRet = pthread_mutexattr_init(&stMtxAttr);
-		if (nRet != RET_SUCC)
-		{
-			DBG_ERROR("FAILED : Create TASK (pthread_mutexattr_init): %s with errno (%d:%s)", astrName, nRet, strerror(nRet));
-			return -nRet;
-		}
-		nRet = pthread_mutexattr_setprotocol(&stMtxAttr, PTHREAD_PRIO_INHERIT);
-		if (nRet != RET_SUCC)
-		{
-			DBG_ERROR("FAILED : Create TASK (pthread_mutexattr_init): %s with errno (%d:%s)", astrName, nRet, strerror(nRet));
-			return -nRet;
-		}
-		pstMtxAttr = &stMtxAttr;
-	}
-	nRet = pthread_mutex_init(&apTask->mtxSuspend, pstMtxAttr);
-	if (nRet != RET_SUCC)
-	{
-		DBG_ERROR("FAILED : Create TASK (pthread_mutexattr_init): %s with errno (%d:%s)", astrName, nRet, strerror(nRet));
-		return -nRet;
-	}
+		return nRet;
 
+	trace_task_event(eTraceCreate, apTask, 0, (UINT64)apTask->nPriority);
 	return RET_SUCC;
 }
 /*****************************************************************************/
@@ -375,24 +1050,97 @@ spawn_nrt_task(POSIX_TASK* apTask, const PCHAR astrName, INT anStkSize, PTASKFCN
 }
 /*****************************************************************************/
 INT
+create_dl_task(POSIX_TASK* apTask, const PCHAR astrName, INT anStkSize, RTTIME aullRuntime, RTTIME aullDeadline, RTTIME aullPeriod)
+{
+	// a deadline of 0 means implicit deadline (equal to the period)
+	if (aullDeadline == 0)
+		aullDeadline = aullPeriod;
+
+	if (aullRuntime < (RTTIME)LIM_DL_RUNTIME_MIN || aullRuntime > aullDeadline || aullDeadline > aullPeriod)
+	{
+		DBG_ERROR("FAILED : Create DL TASK: %s requires %d <= runtime <= deadline <= period", astrName, (INT)LIM_DL_RUNTIME_MIN);
+		return -EINVAL;
+	}
+
+	// the thread starts as SCHED_OTHER and switches itself to SCHED_DEADLINE in default_trampoline_proc()
+	INT nRet = _create_task(apTask, astrName, anStkSize, 0, FALSE);
+	if (nRet != RET_SUCC)
+	{
+		DBG_ERROR("FAILED : Create DL TASK: %s with errno (%d:%s)", astrName, nRet, strerror(-nRet));
+		return nRet;
+	}
+
+	// the kernel rejects SCHED_DEADLINE for threads that do not span their whole root domain
+	CPU_ZERO(&apTask->stCpuAffinity);
+	for (INT nCpu = 0; nCpu < get_available_cpus(); nCpu++)
+		CPU_SET((size_t)nCpu, &apTask->stCpuAffinity);
+	nRet = pthread_attr_setaffinity_np(&apTask->stThreadAttr, sizeof(CPUSET), &apTask->stCpuAffinity);
+	if (nRet != RET_SUCC)
+	{
+		DBG_ERROR("FAILED : Create DL TASK (pthread_attr_setaffinity_np): %s with errno (%d:%s)", astrName, nRet, strerror(nRet));
+		return -nRet;
+	}
+
+	apTask->bRtMode = TRUE;
+	apTask->nSchedPolicy = SCHED_DEADLINE;
+	apTask->ullDlRuntime = aullRuntime;
+	apTask->ullDlDeadline = aullDeadline;
+	apTask->ullPeriod = aullPeriod;
+	apTask->bPeriodic = TRUE;
+
+	DBG_TRACE("SUCCESS: Create DL TASK : name=%s, runtime=%llu, deadline=%llu, period=%llu", apTask->strName, 
+		(unsigned long long)aullRuntime, (unsigned long long)aullDeadline, (unsigned long long)aullPeriod);
+	return RET_SUCC;
+}
+/*****************************************************************************/
+INT
+spawn_dl_task(POSIX_TASK* apTask, const PCHAR astrName, INT anStkSize, RTTIME aullRuntime, RTTIME aullDeadline, RTTIME aullPeriod, PTASKFCN apEntry, PVOID apArg)
+{
+	INT nRet = create_dl_task(apTask, astrName, anStkSize, aullRuntime, aullDeadline, aullPeriod);
+	if (nRet != RET_SUCC)
+	{
+		DBG_ERROR("FAILED : Spawn DL TASK: could not CREATE %s with errno (%d:%s)", astrName, nRet, strerror(-nRet));
+		return nRet;
+	}
+	nRet = start_task(apTask, apEntry, apArg);
+	if (nRet != RET_SUCC)
+	{
+		DBG_ERROR("FAILED : Spawn DL TASK: could not START %s with errno (%d:%s)", astrName, nRet, strerror(-nRet));
+		return nRet;
+	}
+
+	DBG_TRACE("SUCCESS: Spawn DL TASK : name=%s", apTask->strName);
+	return RET_SUCC;
+}
+/*****************************************************************************/
+INT
 start_task(POSIX_TASK* apTask, PTASKFCN apEntry, PVOID apArg)
 {
 	INT nRet = RET_FAIL;
 
-	if (apTask == NULL || apTask->dwStatus > eReady)
+	if (apTask == NULL || _is_task_started(apTask) == TRUE)
 	{
 		DBG_ERROR("FAILED : START TASK: apTask is either NULL or has already started!");
 		return -EWOULDBLOCK;
 	}
+	// refuse (or warn about) a task that makes its CPUs unschedulable, see set_admission_control()
+	nRet = admit_task(apTask);
+	if (nRet != RET_SUCC)
+		return nRet;
+
 	DWORD dwPreviousStatus = apTask->dwStatus;
 	apTask->pTaskFcn = apEntry;
 	apTask->pTaskArg = apArg;
+	apTask->uDlApplied = 0;
 	apTask->dwStatus = (DWORD)ePendingStart;
 
+	// listed before the thread exists, so that it never runs unlisted
+	_register_task(apTask);
 	nRet = pthread_create(&apTask->stThread, &apTask->stThreadAttr, default_trampoline_proc, apTask);
 	if (nRet != RET_SUCC)
 	{
 		DBG_ERROR("FAILED : START TASK (pthread_create): %s with errno (%d:%s)", apTask->strName, nRet, strerror(nRet));
+		_unregister_task(apTask);
 		apTask->dwStatus = dwPreviousStatus;
 		return -nRet;
 	}
@@ -404,6 +1152,18 @@ start_task(POSIX_TASK* apTask, PTASKFCN apEntry, PVOID apArg)
 		DBG_WARN("WARNING : START TASK (pthread_attr_destroy): %s with errno (%d:%s)", apTask->strName, nRet, strerror(nRet));
 	}
 
+	// a SCHED_DEADLINE task only exists once the kernel has admitted its reservation (it answers -EBUSY otherwise)
+	if (apTask->nSchedPolicy == SCHED_DEADLINE)
+	{
+		while (__atomic_load_n(&apTask->uDlApplied, __ATOMIC_ACQUIRE) == 0)
+			futex_wait(&apTask->uDlApplied, 0, TM_INFINITE);
+		if (apTask->nDlResult != RET_SUCC)
+		{
+			DBG_ERROR("FAILED : START TASK (sched_setattr): %s with errno (%d:%s)", apTask->strName, -apTask->nDlResult, strerror(-apTask->nDlResult));
+			return apTask->nDlResult;
+		}
+	}
+
 	return RET_SUCC;
 }
 /*****************************************************************************/
@@ -422,12 +1182,15 @@ delete_task(POSIX_TASK* apTask)
 	// return immediately if task is either dead or suspended
 	if (pTask->dwStatus >= eDead)
 	{
+		_unregister_task(pTask);
 		nRet = RET_SUCC;
 	}
 	// 
-	else if (pTask->dwStatus <= eReady)
+	else if (_is_task_started(pTask) == FALSE)
 	{
-		// reset all task settings if the task has not been started yet
+		// reset all task settings if the task has not been started yet, its arena stack can be reused at once
+		_release_stack_slot(pTask, 0);
+		_unregister_task(pTask);
 		_init_posix_task(apTask);
 		nRet = RET_SUCC;
 	}
@@ -441,9 +1204,27 @@ delete_task(POSIX_TASK* apTask)
 }
 /*****************************************************************************/
 INT
+wait_task_end(POSIX_TASK* apTask, RTTIME arttAbsTimeout)
+{
+	if (apTask == NULL)
+		return -EINVAL;
+	// a task that never got a thread has nothing to wait for
+	if (_is_task_started(apTask) == FALSE)
+		return RET_SUCC;
+
+	// eDead is the last access of the thread to the POSIX_TASK, the caller may free or reuse it right after
+	while (__atomic_load_n(&apTask->dwStatus, __ATOMIC_ACQUIRE) != (DWORD)eDead)
+	{
+		if (arttAbsTimeout != TM_INFINITE && read_timer() >= arttAbsTimeout)
+			return -ETIMEDOUT;
+		usleep(1000);
+	}
+	return RET_SUCC;
+}
+/*****************************************************************************/
+INT
 suspend_task(POSIX_TASK* apTask)
 {
-	INT nRet = RET_FAIL;
 	POSIX_TASK* pTask;
 	
 	pTask = _get_posix_task_or_self(apTask);
@@ -454,28 +1235,17 @@ suspend_task(POSIX_TASK* apTask)
 	}
 	// return immediately if task is either dead or suspended
 	if (pTask->dwStatus >= eSuspended)
-	{
-		nRet = RET_SUCC;
-	}
-	// 
-	else if (pTask->dwStatus <= ePendingStart)
-	{
-		pTask->bStartSuspended = TRUE;
-		nRet = RET_SUCC;
-	}
-	else
-	{
-		pthread_mutex_lock(&pTask->mtxSuspend);
-		pTask->dwStatus = (DWORD)eSuspended;
-		nRet = pthread_cond_wait(&pTask->cvSuspend, &pTask->mtxSuspend);
-		if (nRet != RET_SUCC)
-		{
-			DBG_ERROR("FAILED : Suspend Task (pthread_cond_wait): %s with errno (%d:%s)", pTask->strName, nRet, strerror(nRet));
-			exit(-1);
-		}
-		pthread_mutex_unlock(&pTask->mtxSuspend);
-	}
-	return nRet;
+		return RET_SUCC;
+
+	UINT32 uState = eSuspendNone;
+	__atomic_compare_exchange_n(&pTask->uSuspend, &uState, eSuspendPending, FALSE, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE);
+	trace_task_event(eTraceSuspend, pTask, 0, 0);
+
+	// the caller parks right away, any other task at its next suspension point (or at its start)
+	if (pTask->nPid != 0 && pTask->nPid == gettid())
+		_park_task(pTask);
+
+	return RET_SUCC;
 }
 /*****************************************************************************/
 INT
@@ -488,13 +1258,18 @@ resume_task(POSIX_TASK* apTask)
 		DBG_ERROR("FAILED : Resume Posix TASK: with errno (%d:%s)", EPERM, strerror(EPERM));
 		return -EPERM;
 	}
-	if (pTask->dwStatus == eSuspended)
+
+	// the timestamp is published by the exchange below, the woken task measures its resume latency with it
+	__atomic_store_n(&pTask->rttResumeRequest, read_timer(), __ATOMIC_RELAXED);
+	UINT32 uState = __atomic_exchange_n(&pTask->uSuspend, eSuspendNone, __ATOMIC_ACQ_REL);
+	trace_task_event(eTraceResume, pTask, 0, (uState == eSuspendParked) ? 1 : 0);
+	if (uState == eSuspendParked)
 	{
-		int nRet = pthread_cond_signal(&pTask->cvSuspend);
-		if (nRet != RET_SUCC)
+		INT nRet = futex_wake(&pTask->uSuspend, 1);
+		if (nRet < 0)
 		{
-			DBG_ERROR("FAILED : Resume Task (pthread_cond_wait): %s with errno (%d:%s)", pTask->strName, nRet, strerror(nRet));
-			exit(-1);
+			DBG_ERROR("FAILED : Resume Task (futex_wake): %s with errno (%d:%s)", pTask->strName, -nRet, strerror(-nRet));
+			return nRet;
 		}
 	}
 	return RET_SUCC;
@@ -514,6 +1289,7 @@ get_task_info(POSIX_TASK* apTask, POSIX_TASK_INFO* apTaskInfo)
 	apTaskInfo->nPriority = pTask->nPriority;
 	apTaskInfo->bRTMode = pTask->bRtMode;
 	apTaskInfo->bPeriodic = pTask->bPeriodic;
+	apTaskInfo->nSchedPolicy = pTask->nSchedPolicy;
 	memcpy(apTaskInfo->strName, pTask->strName, sizeof(pTask->strName));
 	apTaskInfo->nPid = pTask->nPid;
 	apTaskInfo->dwStatus = pTask->dwStatus;
@@ -521,169 +1297,1312 @@ get_task_info(POSIX_TASK* apTask, POSIX_TASK_INFO* apTaskInfo)
 	return RET_SUCC;
 }
 /*****************************************************************************/
-INT		
-set_cpu_affinity(POSIX_TASK* apTask, INT anCpuNum)
+static INT
+_get_hist_bucket(UINT64 aullValue)
 {
-	if (apTask == NULL)
-		return -EPERM;
-	
-	// disallow changing the affinity when the task is already scheduled
-	if (apTask->dwStatus > eReady)
-	{
-		DBG_ERROR("FAILED : Set CPU Affinity: This should be called before starting the RT Task!");
-		return -EPERM;
-	}
-	
-	int nCpuNum = 0;
-	// ensure that the anCpuNum is within the range of available CPUs
-	if (anCpuNum > (get_available_cpus()-1))
-	{
-		DBG_ERROR("FAILED : Set CPU Affinity: anCpuNum is greater than the available CPUS!");
-		return -EINVAL;
-	}
-	else if (anCpuNum < 0)  nCpuNum = 0;
-	else nCpuNum = anCpuNum;
-	
-	CPU_ZERO(&apTask->stCpuAffinity);
-	CPU_SET((size_t)nCpuNum, &apTask->stCpuAffinity);
+	// values below 2^SUB_BITS get a bucket each, above that every power of two is split linearly
+	if (aullValue < (1ULL << STAT_HIST_SUB_BITS))
+		return (INT)aullValue;
 
-	int nRet = pthread_attr_setaffinity_np(&apTask->stThreadAttr, sizeof(CPUSET), &apTask->stCpuAffinity);
-	if (nRet != RET_SUCC)
-	{
-		DBG_ERROR("FAILED : Set CPU Affinity: %s with errno (%d:%s)", apTask->strName, nRet, strerror(nRet));
-		return -nRet;
-	}
+	INT nMsb = 63 - __builtin_clzll(aullValue);
+	if (nMsb >= STAT_HIST_MAX_BITS)
+		return STAT_HIST_BUCKETS - 1;
 
-	DBG_TRACE("SUCCESS: Set CPU Affinity: taskname=%s, cpu#=%d",apTask->strName, nCpuNum);
-	return RET_SUCC;
+	INT nSub = (INT)((aullValue >> (nMsb - STAT_HIST_SUB_BITS)) & ((1ULL << STAT_HIST_SUB_BITS) - 1));
+	return ((nMsb - STAT_HIST_SUB_BITS + 1) << STAT_HIST_SUB_BITS) + nSub;
 }
 /*****************************************************************************/
-POSIX_TASK*
-get_self(VOID)
+static UINT64
+_get_hist_bucket_upper(INT anBucket)
 {
-	POSIX_TASK* pTask;
-	pTask = _get_current_task();
-	if (pTask == NULL)
-		DBG_WARN("WARNING : Get Self is not called inside a POSIX task... returning NULL");
+	if (anBucket < (1 << STAT_HIST_SUB_BITS))
+		return (UINT64)anBucket;
 
-	return pTask;
+	INT nMsb = (anBucket >> STAT_HIST_SUB_BITS) + STAT_HIST_SUB_BITS - 1;
+	UINT64 ullSub = (UINT64)(anBucket & ((1 << STAT_HIST_SUB_BITS) - 1));
+	UINT64 ullWidth = 1ULL << (nMsb - STAT_HIST_SUB_BITS);
+	return (1ULL << nMsb) + (ullSub + 1) * ullWidth - 1;
 }
 /*****************************************************************************/
-INT		
-set_task_period(POSIX_TASK* apTask, RTTIME aulStartTime, RTTIME aullPeriod)
+static void
+_update_hist(POSIX_TASK_HIST* apHist, UINT64 aullValue)
 {
-	INT nRet = RET_FAIL;
+	// single writer (the owning task), so plain load/store pairs are enough;
+	// the atomic stores only keep concurrent readers from seeing torn values
+	UINT64 ullCount = apHist->ullCount;
+	if (ullCount == 0 || aullValue < apHist->ullMin)
+		__atomic_store_n(&apHist->ullMin, aullValue, __ATOMIC_RELAXED);
+	if (aullValue > apHist->ullMax)
+		__atomic_store_n(&apHist->ullMax, aullValue, __ATOMIC_RELAXED);
+	__atomic_store_n(&apHist->ullSum, apHist->ullSum + aullValue, __ATOMIC_RELAXED);
 
-	TIMESPEC stStartTime;
-	POSIX_TASK* pTask;
+	INT nBucket = _get_hist_bucket(aullValue);
+	__atomic_store_n(&apHist->ullBuckets[nBucket], apHist->ullBuckets[nBucket] + 1, __ATOMIC_RELAXED);
+	__atomic_store_n(&apHist->ullCount, ullCount + 1, __ATOMIC_RELEASE);
+}
+/*****************************************************************************/
+static UINT64
+_get_hist_percentile(const POSIX_TASK_HIST* apHist, UINT64 aullCount, UINT64 aullPerMille)
+{
+	if (aullCount == 0)
+		return 0;
 
+	// rank of the requested percentile, rounded up
+	UINT64 ullRank = (aullCount * aullPerMille + 999) / 1000;
+	UINT64 ullSeen = 0;
+	for (INT nIdx = 0; nIdx < STAT_HIST_BUCKETS; nIdx++)
+	{
+		ullSeen += __atomic_load_n(&apHist->ullBuckets[nIdx], __ATOMIC_RELAXED);
+		if (ullSeen >= ullRank)
+		{
+			// report the bucket's upper bound, but never beyond the observed maximum
+			UINT64 ullUpper = _get_hist_bucket_upper(nIdx);
+			UINT64 ullMax = __atomic_load_n(&apHist->ullMax, __ATOMIC_RELAXED);
+			return (ullUpper < ullMax) ? ullUpper : ullMax;
+		}
+	}
+	return __atomic_load_n(&apHist->ullMax, __ATOMIC_RELAXED);
+}
+/*****************************************************************************/
+INT
+get_task_stats(POSIX_TASK* apTask, POSIX_TASK_STATS* apTaskStats)
+{
+	POSIX_TASK* pTask;
 	pTask = _get_posix_task_or_self(apTask);
-	if (pTask == NULL || pTask->dwStatus > ePendingStart)
-		goto failure;
+	if (pTask == NULL)
+		return -EPERM;
 
-	if (aulStartTime == (RTTIME)SET_TM_NOW)
-		nRet = clock_gettime(CLOCK_TO_USE, &stStartTime);
-	else
-		nRet = convert_nsecs_to_timespec(aulStartTime, &stStartTime);
+	if (apTaskStats == NULL)
+		return -EPERM;
 
-	if (nRet != RET_SUCC)
-		goto failure;
+	ZERO_MEMORY(apTaskStats, sizeof(POSIX_TASK_STATS));
 
-	/* add period to start_time */
-	stStartTime.tv_nsec += (INT64) aullPeriod;
-	stStartTime.tv_sec += stStartTime.tv_nsec / NANOSEC_PER_SEC;
-	stStartTime.tv_nsec %= NANOSEC_PER_SEC;
+	UINT64 ullCount = __atomic_load_n(&pTask->stLatency.ullCount, __ATOMIC_ACQUIRE);
+	apTaskStats->ullCycles = ullCount;
+	apTaskStats->ullOverruns = __atomic_load_n(&pTask->ullOverruns, __ATOMIC_RELAXED);
+	if (ullCount > 0)
+	{
+		apTaskStats->ullLatMin = __atomic_load_n(&pTask->stLatency.ullMin, __ATOMIC_RELAXED);
+		apTaskStats->ullLatMax = __atomic_load_n(&pTask->stLatency.ullMax, __ATOMIC_RELAXED);
+		apTaskStats->ullLatMean = __atomic_load_n(&pTask->stLatency.ullSum, __ATOMIC_RELAXED) / ullCount;
+		apTaskStats->ullLatP99 = _get_hist_percentile(&pTask->stLatency, ullCount, 990);
+		apTaskStats->ullLatP999 = _get_hist_percentile(&pTask->stLatency, ullCount, 999);
+	}
 
-	pTask->stDeadline = stStartTime;
-	pTask->ullPeriod = aullPeriod;
-	pTask->bPeriodic = TRUE;
+	ullCount = __atomic_load_n(&pTask->stExecTime.ullCount, __ATOMIC_ACQUIRE);
+	if (ullCount > 0)
+	{
+		apTaskStats->ullExecMin = __atomic_load_n(&pTask->stExecTime.ullMin, __ATOMIC_RELAXED);
+		apTaskStats->ullExecMax = __atomic_load_n(&pTask->stExecTime.ullMax, __ATOMIC_RELAXED);
+		apTaskStats->ullExecMean = __atomic_load_n(&pTask->stExecTime.ullSum, __ATOMIC_RELAXED) / ullCount;
+		apTaskStats->ullExecP99 = _get_hist_percentile(&pTask->stExecTime, ullCount, 990);
+		apTaskStats->ullExecP999 = _get_hist_percentile(&pTask->stExecTime, ullCount, 999);
+	}
+	if (pTask->nWakeupMode == eWakeupHybrid)
+		apTaskStats->ullSpinMargin = __atomic_load_n(&pTask->ullSpinMargin, __ATOMIC_RELAXED);
+	apTaskStats->ullResumeLatency = __atomic_load_n(&pTask->ullResumeLatency, __ATOMIC_RELAXED);
 
 	return RET_SUCC;
-
-failure:
-	DBG_ERROR("FAILED : Set Task Period: Invalid task parameters");
-	return -EWOULDBLOCK;
 }
 /*****************************************************************************/
-RTTIME	
-read_timer(VOID)
+INT
+get_task_histogram(POSIX_TASK* apTask, POSIX_TASK_HIST* apLatHist, POSIX_TASK_HIST* apExecHist)
 {
-	TIMESPEC	stNow;
-	if (clock_gettime(CLOCK_TO_USE, &stNow))
-	{
-		DBG_ERROR("FAILED : Read Timer!");
-		return (RTTIME)RET_FAIL;
-	}
-	else
+	POSIX_TASK* pTask;
+	pTask = _get_posix_task_or_self(apTask);
+	if (pTask == NULL)
+		return -EPERM;
+
+	const POSIX_TASK_HIST* pSrc[2] = { &pTask->stLatency, &pTask->stExecTime };
+	POSIX_TASK_HIST* pDst[2] = { apLatHist, apExecHist };
+	for (INT nHist = 0; nHist < 2; nHist++)
 	{
-		RTTIME		rttNow;
-		convert_timespec_to_nsecs(stNow, &rttNow);
-		return rttNow;
+		if (pDst[nHist] == NULL)
+			continue;
+		pDst[nHist]->ullCount = __atomic_load_n(&pSrc[nHist]->ullCount, __ATOMIC_ACQUIRE);
+		pDst[nHist]->ullMin = __atomic_load_n(&pSrc[nHist]->ullMin, __ATOMIC_RELAXED);
+		pDst[nHist]->ullMax = __atomic_load_n(&pSrc[nHist]->ullMax, __ATOMIC_RELAXED);
+		pDst[nHist]->ullSum = __atomic_load_n(&pSrc[nHist]->ullSum, __ATOMIC_RELAXED);
+		for (INT nIdx = 0; nIdx < STAT_HIST_BUCKETS; nIdx++)
+			pDst[nHist]->ullBuckets[nIdx] = __atomic_load_n(&pSrc[nHist]->ullBuckets[nIdx], __ATOMIC_RELAXED);
 	}
+	return RET_SUCC;
 }
 /*****************************************************************************/
-VOID	
-spin_timer(RTTIME aullSpinTimeNS)
+INT
+get_hist_bucket_range(INT anBucket, RTTIME* apullLower, RTTIME* apullUpper)
 {
-	RTTIME rttEndTime;
-	rttEndTime = read_timer() + aullSpinTimeNS;
-	while (read_timer() < rttEndTime)
-		cpu_relax();
+	if (anBucket < 0 || anBucket >= STAT_HIST_BUCKETS)
+		return -EINVAL;
+
+	RTTIME ullUpper = _get_hist_bucket_upper(anBucket);
+	RTTIME ullLower = (anBucket > 0) ? _get_hist_bucket_upper(anBucket - 1) + 1 : 0;
+	if (apullLower != NULL)
+		*apullLower = ullLower;
+	if (apullUpper != NULL)
+		*apullUpper = ullUpper;
+	return RET_SUCC;
 }
 /*****************************************************************************/
-INT		
-wait_next_period(UINT64* apullOverrunsCnt)
+INT
+set_task_priority(POSIX_TASK* apTask, INT anPriority)
 {
+	INT nRet = RET_FAIL;
 	POSIX_TASK* pTask;
 
-	pTask = _get_current_task();
-	if (pTask == NULL || pTask->bPeriodic == FALSE)
-		return -EWOULDBLOCK;
+	pTask = _get_posix_task_or_self(apTask);
+	if (pTask == NULL)
+		return -EPERM;
 
-	TIMESPEC stNow;
-	pTask->dwStatus = (DWORD)eWaiting;
-	INT nRet = clock_nanosleep(CLOCK_TO_USE, TIMER_ABSTIME, &pTask->stDeadline, NULL);
-	if (nRet != RET_SUCC)
+	if (pTask->nSchedPolicy != SCHED_FIFO)
 	{
-		DBG_WARN("WARNING : WAIT NEXT PERIOD : %s with errno (%d:%s)", pTask->strName, nRet, strerror(nRet));
-		DBG_WARN("WARNING : WAIT NEXT PERIOD : Continue calculating next period... ");
+		DBG_ERROR("FAILED : Set Task Priority: %s is not a SCHED_FIFO task", pTask->strName);
+		return -EINVAL;
+	}
+	if (anPriority <= (INT)LIM_PRIORITY_LO || anPriority > (INT)LIM_PRIORITY_HI)
+	{
+		DBG_ERROR("FAILED : Set Task Priority (anPriority should be within the range of %d ~ %d)", (INT)LIM_PRIORITY_LO, (INT)LIM_PRIORITY_HI);
+		return -EINVAL;
+	}
+
+	struct sched_param stParam = { .sched_priority = anPriority };
+	if (_is_task_started(pTask) == FALSE)
+	{
+		nRet = pthread_attr_setschedparam(&pTask->stThreadAttr, &stParam);
 	}
 	else
-		pTask->dwStatus = (DWORD)eReady;
-	
-	// update next deadline
-	pTask->stDeadline.tv_nsec += (INT64)pTask->ullPeriod;
-	pTask->stDeadline.tv_sec += pTask->stDeadline.tv_nsec / NANOSEC_PER_SEC;
-	pTask->stDeadline.tv_nsec %= NANOSEC_PER_SEC;
-	
-	// check for missed deadlines
-	convert_nsecs_to_timespec(read_timer(), &stNow);
-	if ((stNow.tv_sec > pTask->stDeadline.tv_sec) || (stNow.tv_sec == pTask->stDeadline.tv_sec && pTask->stDeadline.tv_nsec < stNow.tv_nsec))
 	{
-		if (apullOverrunsCnt != NULL)
-		{
-			*apullOverrunsCnt += 1;
-			DBG_WARN("WARNING : WAIT NEXT PERIOD : %s overrun occurs cnt=%d ", pTask->strName, *apullOverrunsCnt);
-		}
-		else
+		// the thread is detached, its pthread_t may be stale; change it by TID while the registry holds it
+		nRet = RET_SUCC;
+		pthread_mutex_lock(&g_mtxRegistry);
+		REGISTRY_ENTRY* pEntry = _find_registry_entry(pTask);
+		if (pEntry == NULL)
+			nRet = ESRCH;
+		else if (pEntry->nPid == 0)
 		{
-			DBG_WARN("WARNING : WAIT NEXT PERIOD : %s overrun occurs", pTask->strName);
+			// still starting, the thread applies the priority as soon as it has published its TID
+			pTask->nPriority = anPriority;
+			pTask->bPriorityPending = TRUE;
 		}
-		nRet = -ETIMEDOUT;
+		else if (sched_setscheduler(pEntry->nPid, SCHED_FIFO, &stParam) != 0)
+			nRet = errno;
+		pthread_mutex_unlock(&g_mtxRegistry);
 	}
-	else
+
+	if (nRet != RET_SUCC)
 	{
-		if (apullOverrunsCnt != NULL)
-			*apullOverrunsCnt = 0;
-		
-		nRet = RET_SUCC;
+		DBG_ERROR("FAILED : Set Task Priority: %s with errno (%d:%s)", pTask->strName, nRet, strerror(nRet));
+		return -nRet;
 	}
-	return nRet;
+
+	pTask->nPriority = anPriority;
+	DBG_TRACE("SUCCESS: Set Task Priority: taskname=%s, priority=%d", pTask->strName, anPriority);
+	return RET_SUCC;
 }
 /*****************************************************************************/
-LONG
-system_call(LONG alMagicNo)
+INT		
+set_cpu_affinity(POSIX_TASK* apTask, INT anCpuNum)
 {
-	return syscall(alMagicNo);
+	if (apTask == NULL)
+		return -EPERM;
+	
+	int nCpuNum = 0;
+	// ensure that the anCpuNum is within the range of available CPUs
+	if (anCpuNum > (get_available_cpus()-1))
+	{
+		DBG_ERROR("FAILED : Set CPU Affinity: anCpuNum is greater than the available CPUS!");
+		return -EINVAL;
+	}
+	else if (anCpuNum < 0)  nCpuNum = 0;
+	else nCpuNum = anCpuNum;
+	
+	CPUSET stCpuSet;
+	CPU_ZERO(&stCpuSet);
+	CPU_SET((size_t)nCpuNum, &stCpuSet);
+	return set_cpu_affinity_mask(apTask, &stCpuSet);
+}
+/*****************************************************************************/
+INT
+set_cpu_affinity_mask(POSIX_TASK* apTask, const CPUSET* apCpuSet)
+{
+	INT nRet = RET_FAIL;
+	POSIX_TASK* pTask;
+
+	pTask = _get_posix_task_or_self(apTask);
+	if (pTask == NULL)
+		return -EPERM;
+
+	if (apCpuSet == NULL || CPU_COUNT(apCpuSet) == 0)
+	{
+		DBG_ERROR("FAILED : Set CPU Affinity: %s the CPU set is empty", pTask->strName);
+		return -EINVAL;
+	}
+	for (INT nCpu = get_available_cpus(); nCpu < CPU_SETSIZE; nCpu++)
+	{
+		if (CPU_ISSET((size_t)nCpu, apCpuSet))
+		{
+			DBG_ERROR("FAILED : Set CPU Affinity: %s CPU%d is not available", pTask->strName, nCpu);
+			return -EINVAL;
+		}
+	}
+
+	if (pTask->nSchedPolicy == SCHED_DEADLINE)
+	{
+		DBG_ERROR("FAILED : Set CPU Affinity: SCHED_DEADLINE tasks must be allowed on every CPU of their root domain");
+		return -EINVAL;
+	}
+
+	if (_is_task_started(pTask) == FALSE)
+	{
+		nRet = pthread_attr_setaffinity_np(&pTask->stThreadAttr, sizeof(CPUSET), apCpuSet);
+	}
+	else
+	{
+		// the thread is detached, its pthread_t may be stale; migrate it by TID while the registry holds it
+		nRet = RET_SUCC;
+		pthread_mutex_lock(&g_mtxRegistry);
+		REGISTRY_ENTRY* pEntry = _find_registry_entry(pTask);
+		if (pEntry == NULL)
+			nRet = ESRCH;
+		else if (pEntry->nPid == 0)
+		{
+			// still starting, the thread applies the mask as soon as it has published its TID
+			pTask->stCpuAffinity = *apCpuSet;
+			pTask->bAffinityPending = TRUE;
+		}
+		else if (sched_setaffinity(pEntry->nPid, sizeof(CPUSET), apCpuSet) != 0)
+			nRet = errno;
+		pthread_mutex_unlock(&g_mtxRegistry);
+	}
+
+	if (nRet != RET_SUCC)
+	{
+		DBG_ERROR("FAILED : Set CPU Affinity: %s with errno (%d:%s)", pTask->strName, nRet, strerror(nRet));
+		return -nRet;
+	}
+
+	pTask->stCpuAffinity = *apCpuSet;
+	DBG_TRACE("SUCCESS: Set CPU Affinity: taskname=%s, cpus=%d", pTask->strName, CPU_COUNT(apCpuSet));
+	return RET_SUCC;
+}
+/*****************************************************************************/
+INT
+get_cpu_affinity_mask(POSIX_TASK* apTask, CPUSET* apCpuSet)
+{
+	POSIX_TASK* pTask;
+
+	pTask = _get_posix_task_or_self(apTask);
+	if (pTask == NULL || apCpuSet == NULL)
+		return -EPERM;
+
+	*apCpuSet = pTask->stCpuAffinity;
+	return RET_SUCC;
+}
+/*****************************************************************************/
+static INT
+_read_cpu_list(const CHAR* astrPath, CPUSET* apCpuSet)
+{
+	// sysfs CPU lists look like "2-3,6", an empty line or "(null)" means no CPU
+	CHAR strList[256];
+	FILE* pFile = fopen(astrPath, "r");
+	if (pFile == NULL)
+		return -errno;
+
+	if (fgets(strList, sizeof(strList), pFile) == NULL)
+		strList[0] = '\0';
+	fclose(pFile);
+
+	const CHAR* pCur = strList;
+	while (*pCur != '\0' && *pCur != '\n')
+	{
+		CHAR* pEnd;
+		LONG lFirst = strtol(pCur, &pEnd, 10);
+		LONG lLast = lFirst;
+		if (pEnd == pCur || lFirst < 0)
+			return -EINVAL;
+		if (*pEnd == '-')
+		{
+			pCur = pEnd + 1;
+			lLast = strtol(pCur, &pEnd, 10);
+			if (pEnd == pCur || lLast < lFirst)
+				return -EINVAL;
+		}
+		for (LONG lCpu = lFirst; lCpu <= lLast && lCpu < CPU_SETSIZE; lCpu++)
+			CPU_SET((size_t)lCpu, apCpuSet);
+		if (*pEnd == ',')
+			pEnd++;
+		pCur = pEnd;
+	}
+	return RET_SUCC;
+}
+/*****************************************************************************/
+INT
+get_isolated_cpus(CPUSET* apCpuSet)
+{
+	if (apCpuSet == NULL)
+		return -EINVAL;
+
+	// both isolcpus= and nohz_full= take CPUs away from the housekeeping work of the kernel
+	CPU_ZERO(apCpuSet);
+	_read_cpu_list("/sys/devices/system/cpu/isolated", apCpuSet);
+	_read_cpu_list("/sys/devices/system/cpu/nohz_full", apCpuSet);
+
+	for (INT nCpu = get_available_cpus(); nCpu < CPU_SETSIZE; nCpu++)
+		CPU_CLR((size_t)nCpu, apCpuSet);
+
+	return CPU_COUNT(apCpuSet);
+}
+/*****************************************************************************/
+INT
+get_housekeeping_cpus(CPUSET* apCpuSet)
+{
+	CPUSET stIsolated;
+	if (apCpuSet == NULL)
+		return -EINVAL;
+
+	get_isolated_cpus(&stIsolated);
+	CPU_ZERO(apCpuSet);
+	for (INT nCpu = 0; nCpu < get_available_cpus(); nCpu++)
+		if (!CPU_ISSET((size_t)nCpu, &stIsolated))
+			CPU_SET((size_t)nCpu, apCpuSet);
+
+	// every CPU is isolated, nothing better to offer than all of them
+	if (CPU_COUNT(apCpuSet) == 0)
+		for (INT nCpu = 0; nCpu < get_available_cpus(); nCpu++)
+			CPU_SET((size_t)nCpu, apCpuSet);
+
+	return CPU_COUNT(apCpuSet);
+}
+/*****************************************************************************/
+INT
+set_task_placement(INT anPlacement)
+{
+	if (anPlacement != ePlaceCpu0 && anPlacement != ePlaceAny && anPlacement != ePlaceIsolated)
+	{
+		DBG_ERROR("FAILED : Set Task Placement: unknown placement %d", anPlacement);
+		return -EINVAL;
+	}
+
+	__atomic_store_n(&g_nPlacement, anPlacement, __ATOMIC_RELAXED);
+	DBG_TRACE("SUCCESS: Set Task Placement: placement=%d", anPlacement);
+	return RET_SUCC;
+}
+/*****************************************************************************/
+static INT
+_place_task(POSIX_TASK* apTask)
+{
+	CPUSET stCpuSet;
+	CPU_ZERO(&stCpuSet);
+
+	switch (__atomic_load_n(&g_nPlacement, __ATOMIC_RELAXED))
+	{
+	case ePlaceAny:
+		for (INT nCpu = 0; nCpu < get_available_cpus(); nCpu++)
+			CPU_SET((size_t)nCpu, &stCpuSet);
+		break;
+	case ePlaceIsolated:
+		if (apTask->bRtMode == TRUE)
+		{
+			// spread RT tasks one CPU each, round robin over the isolated CPUs (or all CPUs if none are)
+			CPUSET stCandidates;
+			if (get_isolated_cpus(&stCandidates) <= 0)
+				for (INT nCpu = 0; nCpu < get_available_cpus(); nCpu++)
+					CPU_SET((size_t)nCpu, &stCandidates);
+
+			UINT32 uPick = __atomic_fetch_add(&g_uPlaceNext, 1, __ATOMIC_RELAXED) % (UINT32)CPU_COUNT(&stCandidates);
+			for (INT nCpu = 0; nCpu < CPU_SETSIZE; nCpu++)
+			{
+				if (CPU_ISSET((size_t)nCpu, &stCandidates) && uPick-- == 0)
+				{
+					CPU_SET((size_t)nCpu, &stCpuSet);
+					break;
+				}
+			}
+		}
+		else
+			get_housekeeping_cpus(&stCpuSet);
+		break;
+	default:
+		CPU_SET(0, &stCpuSet);
+		break;
+	}
+
+	return set_cpu_affinity_mask(apTask, &stCpuSet);
+}
+/*****************************************************************************/
+POSIX_TASK*
+get_self(VOID)
+{
+	POSIX_TASK* pTask;
+	pTask = _get_current_task();
+	if (pTask == NULL)
+		DBG_WARN("WARNING : Get Self is not called inside a POSIX task... returning NULL");
+
+	return pTask;
+}
+/*****************************************************************************/
+INT		
+set_task_period(POSIX_TASK* apTask, RTTIME aulStartTime, RTTIME aullPeriod)
+{
+	INT nRet = RET_FAIL;
+
+	TIMESPEC stStartTime;
+	POSIX_TASK* pTask;
+
+	pTask = _get_posix_task_or_self(apTask);
+	if (pTask == NULL || pTask->dwStatus > ePendingStart)
+		goto failure;
+
+	// the period of a SCHED_DEADLINE task is part of its reservation
+	if (pTask->nSchedPolicy == SCHED_DEADLINE && aullPeriod < pTask->ullDlDeadline)
+		goto failure;
+
+	if (aulStartTime == (RTTIME)SET_TM_NOW)
+		nRet = clock_gettime(CLOCK_TO_USE, &stStartTime);
+	else
+		nRet = convert_nsecs_to_timespec(aulStartTime, &stStartTime);
+
+	if (nRet != RET_SUCC)
+		goto failure;
+
+	/* add period to start_time */
+	stStartTime.tv_nsec += (INT64) aullPeriod;
+	stStartTime.tv_sec += stStartTime.tv_nsec / NANOSEC_PER_SEC;
+	stStartTime.tv_nsec %= NANOSEC_PER_SEC;
+
+	pTask->stDeadline = stStartTime;
+	pTask->ullPeriod = aullPeriod;
+	pTask->bPeriodic = TRUE;
+
+	return RET_SUCC;
+
+failure:
+	DBG_ERROR("FAILED : Set Task Period: Invalid task parameters");
+	return -EWOULDBLOCK;
+}
+/*****************************************************************************/
+RTTIME	
+read_timer(VOID)
+{
+	TIMESPEC	stNow;
+	if (clock_gettime(CLOCK_TO_USE, &stNow))
+	{
+		DBG_ERROR("FAILED : Read Timer!");
+		return (RTTIME)RET_FAIL;
+	}
+	else
+	{
+		RTTIME		rttNow;
+		convert_timespec_to_nsecs(stNow, &rttNow);
+		return rttNow;
+	}
+}
+/*****************************************************************************/
+static inline UINT64
+_read_tsc(VOID)
+{
+#if defined(__x86_64__) || defined(__i386__)
+	return __builtin_ia32_rdtsc();
+#elif defined(__aarch64__)
+	UINT64 ullTicks;
+	__asm__ __volatile__("isb; mrs %0, cntvct_el0" : "=r"(ullTicks));
+	return ullTicks;
+#else
+	return 0;
+#endif
+}
+/*****************************************************************************/
+static BOOL
+_has_invariant_tsc(VOID)
+{
+#if defined(__x86_64__) || defined(__i386__)
+	// CPUID.80000007H:EDX[8], the TSC runs at a constant rate in every P-, C- and T-state
+	UINT32 uEax, uEbx, uEcx, uEdx;
+	if (__get_cpuid(0x80000000, &uEax, &uEbx, &uEcx, &uEdx) == 0 || uEax < 0x80000007)
+		return FALSE;
+	__get_cpuid(0x80000007, &uEax, &uEbx, &uEcx, &uEdx);
+	return (uEdx & (1U << 8)) ? TRUE : FALSE;
+#elif defined(__aarch64__)
+	// the generic timer has a fixed frequency by architecture
+	return TRUE;
+#else
+	return FALSE;
+#endif
+}
+/*****************************************************************************/
+static void
+_sample_timebase(UINT64* apullTsc, RTTIME* aprttNs)
+{
+	// keep the sample with the tightest TSC bracket around clock_gettime()
+	UINT64 ullBest = (UINT64)-1;
+	for (INT nTry = 0; nTry < TSC_CALIB_SAMPLES; nTry++)
+	{
+		UINT64 ullBefore = _read_tsc();
+		RTTIME rttNow = read_timer();
+		UINT64 ullAfter = _read_tsc();
+		if (ullAfter - ullBefore < ullBest)
+		{
+			ullBest = ullAfter - ullBefore;
+			*apullTsc = ullBefore + ullBest / 2;
+			*aprttNs = rttNow;
+		}
+	}
+}
+/*****************************************************************************/
+static void
+_calibrate_timebase(VOID)
+{
+	g_stTimebase.bValid = FALSE;
+
+	const char* strSource = getenv("RTPOSIX_TIMER");
+	if ((strSource != NULL && strcmp(strSource, "clock") == 0) || _has_invariant_tsc() == FALSE)
+	{
+		DBG_INFO("TIMEBASE: using clock_gettime()");
+		return;
+	}
+
+	UINT64 ullTscStart, ullTscEnd;
+	RTTIME rttStart, rttEnd;
+	TIMESPEC stCalib = { .tv_sec = 0, .tv_nsec = TSC_CALIB_PERIOD };
+
+	_sample_timebase(&ullTscStart, &rttStart);
+	nanosleep(&stCalib, NULL);
+	_sample_timebase(&ullTscEnd, &rttEnd);
+
+	if (ullTscEnd <= ullTscStart || rttEnd <= rttStart)
+	{
+		DBG_WARN("WARNING : TIMEBASE: TSC calibration failed, using clock_gettime()");
+		return;
+	}
+
+	// ns = base + (ticks * mult) >> TSC_SHIFT, no division on the fast path
+	TSC_PARAMS* pParams = &g_stTimebase.stParams[0];
+	pParams->ullMult = (UINT64)((((unsigned __int128)(rttEnd - rttStart)) << TSC_SHIFT) / (ullTscEnd - ullTscStart));
+	pParams->ullTscBase = ullTscEnd;
+	pParams->rttNsBase = rttEnd;
+	g_stTimebase.ullFreqHz = (UINT64)(((unsigned __int128)(ullTscEnd - ullTscStart) * NANOSEC_PER_SEC) / (rttEnd - rttStart));
+	g_stTimebase.ullAnchorTicks = (UINT64)(((unsigned __int128)g_stTimebase.ullFreqHz * TSC_ANCHOR_PERIOD) / NANOSEC_PER_SEC);
+	g_stTimebase.ullCalTsc = ullTscEnd;
+	g_stTimebase.rttCalNs = rttEnd;
+	g_stTimebase.uActive = 0;
+	g_stTimebase.bValid = TRUE;
+
+	DBG_INFO("TIMEBASE: using invariant TSC at %llu Hz", (unsigned long long)g_stTimebase.ullFreqHz);
+}
+/*****************************************************************************/
+BOOL
+has_fast_timer(VOID)
+{
+	return g_stTimebase.bValid;
+}
+/*****************************************************************************/
+static inline RTTIME
+_tsc_to_nsecs(UINT64 aullTsc, UINT64 aullTscBase, RTTIME arttNsBase, UINT64 aullMult)
+{
+	// a TSC read on another CPU may lie slightly behind the base
+	UINT64 ullTicks = (aullTsc > aullTscBase) ? aullTsc - aullTscBase : 0;
+	return arttNsBase + (RTTIME)(((unsigned __int128)ullTicks * aullMult) >> TSC_SHIFT);
+}
+/*****************************************************************************/
+static void
+_reanchor_timebase(VOID)
+{
+	UINT32 uFree = 0;
+	if (!__atomic_compare_exchange_n(&g_stTimebase.uAnchoring, &uFree, 1, FALSE, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED))
+		return;
+
+	UINT64 ullTsc;
+	RTTIME rttNow;
+	_sample_timebase(&ullTsc, &rttNow);
+
+	UINT32 uActive = __atomic_load_n(&g_stTimebase.uActive, __ATOMIC_RELAXED);
+	TSC_PARAMS* pOld = &g_stTimebase.stParams[uActive];
+	TSC_PARAMS* pNew = &g_stTimebase.stParams[uActive ^ 1];
+	if (ullTsc > g_stTimebase.ullCalTsc && rttNow > g_stTimebase.rttCalNs)
+	{
+		// the rate over the whole second since the last sample, NTP slewing of CLOCK_MONOTONIC included
+		UINT64 ullMult = (UINT64)((((unsigned __int128)(rttNow - g_stTimebase.rttCalNs)) << TSC_SHIFT) / (ullTsc - g_stTimebase.ullCalTsc));
+		RTTIME rttBase = rttNow;
+
+		// never step back: start where the readers are and slew onto CLOCK_MONOTONIC until the next re-anchor
+		RTTIME rttFast = _tsc_to_nsecs(ullTsc, pOld->ullTscBase, pOld->rttNsBase, pOld->ullMult);
+		if (rttFast > rttNow)
+		{
+			RTTIME rttInterval = (RTTIME)(((unsigned __int128)g_stTimebase.ullAnchorTicks * ullMult) >> TSC_SHIFT);
+			RTTIME rttAhead = rttFast - rttNow;
+			rttBase = rttFast;
+			ullMult = (rttAhead < rttInterval / 2) ? (UINT64)((((unsigned __int128)(rttInterval - rttAhead)) << TSC_SHIFT) / g_stTimebase.ullAnchorTicks) : ullMult / 2;
+		}
+
+		__atomic_store_n(&pNew->uSeq, pNew->uSeq + 1, __ATOMIC_RELAXED);
+		__atomic_thread_fence(__ATOMIC_RELEASE);
+		__atomic_store_n(&pNew->ullTscBase, ullTsc, __ATOMIC_RELAXED);
+		__atomic_store_n(&pNew->rttNsBase, rttBase, __ATOMIC_RELAXED);
+		__atomic_store_n(&pNew->ullMult, ullMult, __ATOMIC_RELAXED);
+		__atomic_store_n(&pNew->uSeq, pNew->uSeq + 1, __ATOMIC_RELEASE);
+		__atomic_store_n(&g_stTimebase.uActive, uActive ^ 1, __ATOMIC_RELEASE);
+
+		g_stTimebase.ullCalTsc = ullTsc;
+		g_stTimebase.rttCalNs = rttNow;
+	}
+	__atomic_store_n(&g_stTimebase.uAnchoring, 0, __ATOMIC_RELEASE);
+}
+/*****************************************************************************/
+RTTIME
+read_timer_fast(VOID)
+{
+	if (g_stTimebase.bValid == FALSE)
+		return read_timer();
+
+	for (;;)
+	{
+		TSC_PARAMS* pParams = &g_stTimebase.stParams[__atomic_load_n(&g_stTimebase.uActive, __ATOMIC_ACQUIRE)];
+		UINT32 uSeq = __atomic_load_n(&pParams->uSeq, __ATOMIC_ACQUIRE);
+		UINT64 ullTscBase = __atomic_load_n(&pParams->ullTscBase, __ATOMIC_RELAXED);
+		RTTIME rttNsBase = __atomic_load_n(&pParams->rttNsBase, __ATOMIC_RELAXED);
+		UINT64 ullMult = __atomic_load_n(&pParams->ullMult, __ATOMIC_RELAXED);
+		UINT64 ullTsc = _read_tsc();
+
+		// the set is rewritten only if we were preempted for a whole re-anchor period since loading the index
+		__atomic_thread_fence(__ATOMIC_ACQUIRE);
+		if ((uSeq & 1) || __atomic_load_n(&pParams->uSeq, __ATOMIC_RELAXED) != uSeq)
+			continue;
+
+		if (ullTsc - ullTscBase >= g_stTimebase.ullAnchorTicks && ullTsc > ullTscBase)
+			_reanchor_timebase();
+		return _tsc_to_nsecs(ullTsc, ullTscBase, rttNsBase, ullMult);
+	}
+}
+/*****************************************************************************/
+VOID	
+spin_timer(RTTIME aullSpinTimeNS)
+{
+	RTTIME rttEndTime;
+	rttEndTime = read_timer() + aullSpinTimeNS;
+
+	if (g_stTimebase.bValid == TRUE)
+	{
+		// count ticks instead of nanoseconds so that every iteration is a single rdtsc
+		UINT64 ullMult = __atomic_load_n(&g_stTimebase.stParams[__atomic_load_n(&g_stTimebase.uActive, __ATOMIC_ACQUIRE)].ullMult, __ATOMIC_RELAXED);
+		UINT64 ullTicks = (UINT64)((((unsigned __int128)aullSpinTimeNS) << TSC_SHIFT) / ullMult);
+		UINT64 ullStart = _read_tsc();
+		while (_read_tsc() - ullStart < ullTicks)
+			cpu_relax();
+	}
+
+	// never return early with respect to CLOCK_MONOTONIC, this absorbs the calibration error of the TSC
+	while (read_timer() < rttEndTime)
+		cpu_relax();
+}
+/*****************************************************************************/
+static void
+_advance_deadline(POSIX_TASK* apTask, UINT64 aullPeriods)
+{
+	RTTIME rttDeadline;
+	convert_timespec_to_nsecs(apTask->stDeadline, &rttDeadline);
+	convert_nsecs_to_timespec(rttDeadline + aullPeriods * apTask->ullPeriod, &apTask->stDeadline);
+}
+/*****************************************************************************/
+INT
+set_overrun_policy(POSIX_TASK* apTask, INT anPolicy, POVERRUNFCN apHandler, PVOID apArg)
+{
+	POSIX_TASK* pTask;
+
+	pTask = _get_posix_task_or_self(apTask);
+	if (pTask == NULL)
+		return -EPERM;
+
+	if ((anPolicy != eOverrunCatchUp && anPolicy != eOverrunSkip && anPolicy != eOverrunHandler) ||
+		(anPolicy == eOverrunHandler && apHandler == NULL))
+	{
+		DBG_ERROR("FAILED : Set Overrun Policy: %s invalid policy %d", pTask->strName, anPolicy);
+		return -EINVAL;
+	}
+
+	// only the task itself reads these, inside wait_next_period()
+	pTask->pOverrunFcn = apHandler;
+	pTask->pOverrunArg = apArg;
+	__atomic_store_n(&pTask->nOverrunPolicy, anPolicy, __ATOMIC_RELEASE);
+
+	DBG_TRACE("SUCCESS: Set Overrun Policy: taskname=%s, policy=%d", pTask->strName, anPolicy);
+	return RET_SUCC;
+}
+/*****************************************************************************/
+static void
+_adapt_spin_margin(POSIX_TASK* apTask, RTTIME aullLateness)
+{
+	// keep some headroom over the observed wakeup lateness of clock_nanosleep()
+	RTTIME ullTarget = aullLateness + aullLateness / 4 + LIM_SPIN_MARGIN_MIN;
+	RTTIME ullMargin = apTask->ullSpinMargin;
+
+	// grow at once since a late wakeup costs the release, shrink slowly so that rare spikes stay covered
+	if (ullTarget > ullMargin)
+		ullMargin = ullTarget;
+	else
+		ullMargin -= (ullMargin - ullTarget) >> 6;
+
+	if (ullMargin > apTask->ullPeriod / 2)
+		ullMargin = apTask->ullPeriod / 2;
+	if (ullMargin < LIM_SPIN_MARGIN_MIN)
+		ullMargin = LIM_SPIN_MARGIN_MIN;
+
+	__atomic_store_n(&apTask->ullSpinMargin, ullMargin, __ATOMIC_RELAXED);
+}
+/*****************************************************************************/
+static INT
+_wait_hybrid(POSIX_TASK* apTask, RTTIME arttRelease)
+{
+	INT nRet = RET_SUCC;
+	RTTIME ullMargin = apTask->ullSpinMargin;
+
+	if (arttRelease > ullMargin && read_timer() < arttRelease - ullMargin)
+	{
+		TIMESPEC stWakeup;
+		RTTIME rttWakeup = arttRelease - ullMargin;
+		convert_nsecs_to_timespec(rttWakeup, &stWakeup);
+
+		nRet = clock_nanosleep(CLOCK_TO_USE, TIMER_ABSTIME, &stWakeup, NULL);
+		RTTIME rttNow = read_timer();
+		if (nRet == RET_SUCC)
+			_adapt_spin_margin(apTask, (rttNow > rttWakeup) ? rttNow - rttWakeup : 0);
+	}
+
+	// spin the rest of the way, the release itself does not depend on a scheduler wakeup
+	RTTIME rttNow = read_timer();
+	if (rttNow < arttRelease)
+		spin_timer(arttRelease - rttNow);
+
+	return nRet;
+}
+/*****************************************************************************/
+INT
+set_task_wakeup_mode(POSIX_TASK* apTask, INT anMode, RTTIME aullSpinMargin)
+{
+	POSIX_TASK* pTask;
+
+	pTask = _get_posix_task_or_self(apTask);
+	if (pTask == NULL)
+		return -EPERM;
+
+	if (anMode != eWakeupSleep && anMode != eWakeupHybrid)
+	{
+		DBG_ERROR("FAILED : Set Wakeup Mode: %s unknown mode %d", pTask->strName, anMode);
+		return -EINVAL;
+	}
+
+	// the CBS decides when a SCHED_DEADLINE task runs again, spinning would only burn its budget
+	if (anMode == eWakeupHybrid && pTask->nSchedPolicy == SCHED_DEADLINE)
+	{
+		DBG_ERROR("FAILED : Set Wakeup Mode: %s hybrid wakeup is not available for SCHED_DEADLINE tasks", pTask->strName);
+		return -EINVAL;
+	}
+
+	if (aullSpinMargin == 0)
+		aullSpinMargin = (RTTIME)DEFAULT_SPIN_MARGIN;
+	else if (aullSpinMargin < LIM_SPIN_MARGIN_MIN)
+		aullSpinMargin = (RTTIME)LIM_SPIN_MARGIN_MIN;
+
+	__atomic_store_n(&pTask->ullSpinMargin, (anMode == eWakeupHybrid) ? aullSpinMargin : 0, __ATOMIC_RELAXED);
+	__atomic_store_n(&pTask->nWakeupMode, anMode, __ATOMIC_RELEASE);
+
+	DBG_TRACE("SUCCESS: Set Wakeup Mode: taskname=%s, mode=%d, margin=%llu", pTask->strName, anMode, (unsigned long long)aullSpinMargin);
+	return RET_SUCC;
+}
+/*****************************************************************************/
+static void
+_account_exec_time(POSIX_TASK* apTask)
+{
+	// execution time of the cycle that ends here (measured from its wakeup)
+	RTTIME rttNow = read_timer();
+	if (apTask->rttLastWakeup != 0 && rttNow >= apTask->rttLastWakeup)
+	{
+		apTask->ullLastExecTime = rttNow - apTask->rttLastWakeup;
+		_update_hist(&apTask->stExecTime, apTask->ullLastExecTime);
+	}
+}
+/*****************************************************************************/
+static INT
+_release_period(POSIX_TASK* apTask, RTTIME arttRelease, UINT64* apullOverrunsCnt)
+{
+	RTTIME rttNow = read_timer();
+	if (apTask->nSchedPolicy == SCHED_DEADLINE && rttNow < arttRelease)
+	{
+		// the kernel released us before our estimate, follow its period grid from now on
+		arttRelease = rttNow;
+		convert_nsecs_to_timespec(rttNow, &apTask->stDeadline);
+	}
+
+	// record how late we woke up with respect to the programmed release time
+	apTask->rttLastWakeup = rttNow;
+	if (rttNow >= arttRelease)
+	{
+		apTask->ullLastLatency = rttNow - arttRelease;
+		_update_hist(&apTask->stLatency, apTask->ullLastLatency);
+	}
+	trace_task_event(eTraceRelease, apTask, arttRelease, 0);
+	trace_task_event(eTraceWakeup, apTask, rttNow, (rttNow >= arttRelease) ? rttNow - arttRelease : 0);
+	
+	// releases that already lie in the past, computed from the lateness so that the count is exact
+	UINT64 ullBehind = 0;
+	if (rttNow > arttRelease && apTask->ullPeriod > 0)
+		ullBehind = (rttNow - arttRelease) / apTask->ullPeriod;
+
+	// while catching up the same missed releases are behind us again, count each of them once
+	UINT64 ullMissed = 0;
+	RTTIME rttLastMissed = arttRelease + ullBehind * apTask->ullPeriod;
+	if (ullBehind > 0 && rttLastMissed > apTask->rttMissedUntil)
+	{
+		RTTIME rttCounted = (apTask->rttMissedUntil > arttRelease) ? apTask->rttMissedUntil : arttRelease;
+		ullMissed = (rttLastMissed - rttCounted) / apTask->ullPeriod;
+		apTask->rttMissedUntil = rttLastMissed;
+	}
+	if (apullOverrunsCnt != NULL)
+		*apullOverrunsCnt = ullMissed;
+
+	// update next deadline, by one period unless the overrun policy skips the missed releases;
+	// -ETIMEDOUT goes with a non-zero count only, a catch-up cycle of releases already reported is a success
+	UINT64 ullAdvance = 1;
+	INT nRet = RET_SUCC;
+	if (ullBehind > 0)
+	{
+		INT nPolicy = apTask->nOverrunPolicy;
+		if (ullMissed > 0)
+		{
+			__atomic_store_n(&apTask->ullOverruns, apTask->ullOverruns + ullMissed, __ATOMIC_RELAXED);
+			trace_task_event(eTraceOverrun, apTask, 0, ullMissed);
+			DBG_WARN("WARNING : WAIT NEXT PERIOD : %s overrun occurs, missed=%llu", apTask->strName, (unsigned long long)ullMissed);
+			if (nPolicy == eOverrunHandler)
+				apTask->nOverrunAction = (apTask->pOverrunFcn != NULL) ? apTask->pOverrunFcn(apTask, ullMissed, apTask->pOverrunArg) : eOverrunCatchUp;
+			nRet = -ETIMEDOUT;
+		}
+		if (nPolicy == eOverrunHandler)
+			nPolicy = apTask->nOverrunAction;
+		if (nPolicy == eOverrunSkip)
+			ullAdvance = ullBehind + 1;
+	}
+	_advance_deadline(apTask, ullAdvance);
+
+	publish_task_telemetry(apTask);
+	return nRet;
+}
+/*****************************************************************************/
+INT		
+wait_next_period(UINT64* apullOverrunsCnt)
+{
+	POSIX_TASK* pTask;
+
+	pTask = _get_current_task();
+	if (pTask == NULL || pTask->bPeriodic == FALSE)
+		return -EWOULDBLOCK;
+
+	_account_exec_time(pTask);
+	if (__atomic_load_n(&pTask->uSuspend, __ATOMIC_RELAXED) != eSuspendNone)
+		_park_periodic_task(pTask);
+
+	RTTIME rttRelease;
+	convert_timespec_to_nsecs(pTask->stDeadline, &rttRelease);
+	trace_task_event(eTraceWait, pTask, 0, rttRelease);
+
+	pTask->dwStatus = (DWORD)eWaiting;
+	INT nRet = RET_SUCC;
+	if (pTask->nSchedPolicy == SCHED_DEADLINE)
+	{
+		// give back the remaining runtime, the CBS wakes us up with a fresh budget on the next period
+		if (sched_yield() != 0)
+			nRet = errno;
+	}
+	else if (pTask->nWakeupMode == eWakeupHybrid)
+		nRet = _wait_hybrid(pTask, rttRelease);
+	else
+		nRet = clock_nanosleep(CLOCK_TO_USE, TIMER_ABSTIME, &pTask->stDeadline, NULL);
+
+	if (nRet != RET_SUCC)
+	{
+		DBG_WARN("WARNING : WAIT NEXT PERIOD : %s with errno (%d:%s)", pTask->strName, nRet, strerror(nRet));
+		DBG_WARN("WARNING : WAIT NEXT PERIOD : Continue calculating next period... ");
+	}
+	else
+		pTask->dwStatus = (DWORD)eReady;
+
+	return _release_period(pTask, rttRelease, apullOverrunsCnt);
+}
+/*****************************************************************************/
+RTTIME
+get_next_release(POSIX_TASK* apTask)
+{
+	POSIX_TASK* pTask;
+	RTTIME rttRelease = 0;
+
+	pTask = _get_posix_task_or_self(apTask);
+	if (pTask == NULL || pTask->bPeriodic == FALSE)
+		return 0;
+
+	convert_timespec_to_nsecs(pTask->stDeadline, &rttRelease);
+	return rttRelease;
+}
+/*****************************************************************************/
+INT
+create_wait_set(POSIX_WAIT_SET* apSet)
+{
+	if (apSet == NULL)
+		return -EINVAL;
+
+	ZERO_MEMORY(apSet, sizeof(POSIX_WAIT_SET));
+	for (INT nIdx = 0; nIdx < LIM_WAIT_FDS; nIdx++)
+		apSet->nFds[nIdx] = -1;
+
+	apSet->nTimerFd = -1;
+	apSet->nEpollFd = epoll_create1(EPOLL_CLOEXEC);
+	if (apSet->nEpollFd < 0)
+	{
+		DBG_ERROR("FAILED : Create Wait Set (epoll_create1): with errno (%d:%s)", errno, strerror(errno));
+		return -errno;
+	}
+
+	// the deadline is a timerfd in the same epoll set, so one epoll_wait() covers both
+	apSet->nTimerFd = timerfd_create(CLOCK_TO_USE, TFD_NONBLOCK | TFD_CLOEXEC);
+	if (apSet->nTimerFd < 0)
+	{
+		INT nErr = errno;
+		DBG_ERROR("FAILED : Create Wait Set (timerfd_create): with errno (%d:%s)", nErr, strerror(nErr));
+		close(apSet->nEpollFd);
+		apSet->nEpollFd = -1;
+		return -nErr;
+	}
+
+	struct epoll_event stEvent = { .events = EPOLLIN, .data.u32 = WAIT_SOURCE_TIMER_TAG };
+	if (epoll_ctl(apSet->nEpollFd, EPOLL_CTL_ADD, apSet->nTimerFd, &stEvent) != 0)
+	{
+		INT nErr = errno;
+		DBG_ERROR("FAILED : Create Wait Set (epoll_ctl): with errno (%d:%s)", nErr, strerror(nErr));
+		close(apSet->nTimerFd);
+		close(apSet->nEpollFd);
+		apSet->nTimerFd = apSet->nEpollFd = -1;
+		return -nErr;
+	}
+
+	apSet->rttArmed = TM_INFINITE;
+	return RET_SUCC;
+}
+/*****************************************************************************/
+INT
+delete_wait_set(POSIX_WAIT_SET* apSet)
+{
+	if (apSet == NULL || apSet->nEpollFd < 0)
+		return -EINVAL;
+
+	// the registered fds belong to the caller and stay open
+	close(apSet->nTimerFd);
+	close(apSet->nEpollFd);
+	apSet->nEpollFd = -1;
+	apSet->nTimerFd = -1;
+	apSet->uFdCnt = 0;
+	return RET_SUCC;
+}
+/*****************************************************************************/
+INT
+add_wait_fd(POSIX_WAIT_SET* apSet, INT anFd, UINT32 auEvents)
+{
+	if (apSet == NULL || apSet->nEpollFd < 0 || anFd < 0 || auEvents == 0)
+		return -EINVAL;
+
+	INT nSource = -1;
+	for (INT nIdx = 0; nIdx < LIM_WAIT_FDS; nIdx++)
+	{
+		if (apSet->nFds[nIdx] == anFd)
+			return -EEXIST;
+		if (nSource < 0 && apSet->nFds[nIdx] < 0)
+			nSource = nIdx;
+	}
+	if (nSource < 0)
+	{
+		DBG_ERROR("FAILED : Add Wait FD: the wait set is full (%d fds)", (INT)LIM_WAIT_FDS);
+		return -ENOSPC;
+	}
+
+	// the index of the source travels with the event, no lookup is needed on wakeup
+	struct epoll_event stEvent = { .events = auEvents, .data.u32 = (UINT32)nSource };
+	if (epoll_ctl(apSet->nEpollFd, EPOLL_CTL_ADD, anFd, &stEvent) != 0)
+	{
+		DBG_ERROR("FAILED : Add Wait FD (epoll_ctl): fd=%d with errno (%d:%s)", anFd, errno, strerror(errno));
+		return -errno;
+	}
+
+	apSet->nFds[nSource] = anFd;
+	apSet->uFdCnt++;
+	return nSource;
+}
+/*****************************************************************************/
+INT
+remove_wait_fd(POSIX_WAIT_SET* apSet, INT anFd)
+{
+	if (apSet == NULL || apSet->nEpollFd < 0 || anFd < 0)
+		return -EINVAL;
+
+	for (INT nIdx = 0; nIdx < LIM_WAIT_FDS; nIdx++)
+	{
+		if (apSet->nFds[nIdx] != anFd)
+			continue;
+
+		// a closed fd has already left the epoll set on its own
+		if (epoll_ctl(apSet->nEpollFd, EPOLL_CTL_DEL, anFd, NULL) != 0 && errno != EBADF && errno != ENOENT)
+			return -errno;
+		apSet->nFds[nIdx] = -1;
+		apSet->uFdCnt--;
+		return RET_SUCC;
+	}
+	return -ENOENT;
+}
+/*****************************************************************************/
+static INT
+_arm_wait_timer(POSIX_WAIT_SET* apSet, RTTIME arttDeadline)
+{
+	// repeated waits for the same deadline (e.g. between two fd events) keep the armed timer
+	if (apSet->rttArmed == arttDeadline)
+		return RET_SUCC;
+
+	struct itimerspec stTimer;
+	ZERO_MEMORY(&stTimer, sizeof(stTimer));
+	if (arttDeadline != TM_INFINITE)
+		convert_nsecs_to_timespec(arttDeadline, &stTimer.it_value);
+
+	// an absolute expiry in the past fires at once, a zero it_value disarms the timer
+	if (timerfd_settime(apSet->nTimerFd, TFD_TIMER_ABSTIME, &stTimer, NULL) != 0)
+		return -errno;
+
+	apSet->rttArmed = arttDeadline;
+	return RET_SUCC;
+}
+/*****************************************************************************/
+static INT
+_wait_set_poll(POSIX_WAIT_SET* apSet, RTTIME arttDeadline, POSIX_WAIT_EVENT* apEvent)
+{
+	struct epoll_event stEvents[LIM_WAIT_FDS + 1];
+	INT nRet = _arm_wait_timer(apSet, arttDeadline);
+	if (nRet != RET_SUCC)
+		return nRet;
+
+	INT nCnt;
+	do
+	{
+		nCnt = epoll_wait(apSet->nEpollFd, stEvents, LIM_WAIT_FDS + 1, -1);
+	} while (nCnt < 0 && errno == EINTR);
+	RTTIME rttNow = read_timer();
+	if (nCnt < 0)
+		return -errno;
+
+	// the deadline wins over ready fds, they are level-triggered and are reported by the next wait
+	INT nFirstFd = -1;
+	for (INT nIdx = 0; nIdx < nCnt; nIdx++)
+	{
+		if (stEvents[nIdx].data.u32 == WAIT_SOURCE_TIMER_TAG)
+		{
+			UINT64 ullExpirations;
+			if (read(apSet->nTimerFd, &ullExpirations, sizeof(ullExpirations)) < 0 && errno != EAGAIN)
+				return -errno;
+			apSet->rttArmed = TM_INFINITE;
+
+			apEvent->nSource = WAIT_SOURCE_DEADLINE;
+			apEvent->nFd = -1;
+			apEvent->uEvents = stEvents[nIdx].events;
+			apEvent->rttWakeup = rttNow;
+			apEvent->ullLatency = (rttNow > arttDeadline) ? rttNow - arttDeadline : 0;
+			return -ETIMEDOUT;
+		}
+		if (nFirstFd < 0)
+			nFirstFd = nIdx;
+	}
+
+	UINT32 uSource = stEvents[nFirstFd].data.u32;
+	apEvent->nSource = (INT)uSource;
+	apEvent->nFd = apSet->nFds[uSource];
+	apEvent->uEvents = stEvents[nFirstFd].events;
+	apEvent->rttWakeup = rttNow;
+	apEvent->ullLatency = 0;
+	return RET_SUCC;
+}
+/*****************************************************************************/
+INT
+wait_fd_event(POSIX_WAIT_SET* apSet, RTTIME aullAbsDeadline, POSIX_WAIT_EVENT* apEvent)
+{
+	if (apSet == NULL || apSet->nEpollFd < 0 || apEvent == NULL)
+		return -EINVAL;
+
+	POSIX_TASK* pTask = _get_current_task();
+	if (pTask != NULL)
+		pTask->dwStatus = (DWORD)eWaiting;
+
+	INT nRet = _wait_set_poll(apSet, aullAbsDeadline, apEvent);
+
+	if (pTask != NULL)
+		pTask->dwStatus = (DWORD)eReady;
+	return nRet;
+}
+/*****************************************************************************/
+INT
+wait_next_event(POSIX_WAIT_SET* apSet, POSIX_WAIT_EVENT* apEvent, UINT64* apullOverrunsCnt)
+{
+	POSIX_TASK* pTask;
+
+	if (apSet == NULL || apSet->nEpollFd < 0 || apEvent == NULL)
+		return -EINVAL;
+
+	pTask = _get_current_task();
+	if (pTask == NULL || pTask->bPeriodic == FALSE)
+		return -EWOULDBLOCK;
+
+	// only the first wait after a release ends the cycle, the waits after fd events are idle time
+	_account_exec_time(pTask);
+	pTask->rttLastWakeup = 0;
+	if (__atomic_load_n(&pTask->uSuspend, __ATOMIC_RELAXED) != eSuspendNone)
+		_park_periodic_task(pTask);
+	if (apullOverrunsCnt != NULL)
+		*apullOverrunsCnt = 0;
+
+	RTTIME rttRelease;
+	convert_timespec_to_nsecs(pTask->stDeadline, &rttRelease);
+	trace_task_event(eTraceWait, pTask, 0, rttRelease);
+
+	// in hybrid mode the timer fires a margin early and the rest of the way is spun
+	RTTIME rttWakeup = rttRelease;
+	BOOL bHybrid = (pTask->nWakeupMode == eWakeupHybrid && pTask->nSchedPolicy != SCHED_DEADLINE);
+	if (bHybrid == TRUE && rttRelease > pTask->ullSpinMargin)
+		rttWakeup = rttRelease - pTask->ullSpinMargin;
+
+	pTask->dwStatus = (DWORD)eWaiting;
+	INT nRet = _wait_set_poll(apSet, rttWakeup, apEvent);
+	if (nRet != -ETIMEDOUT)
+	{
+		// an fd fired before the release (or the wait failed), the period bookkeeping is untouched
+		if (nRet != RET_SUCC)
+			DBG_WARN("WARNING : WAIT NEXT EVENT : %s with errno (%d:%s)", pTask->strName, -nRet, strerror(-nRet));
+		pTask->dwStatus = (DWORD)eReady;
+		return nRet;
+	}
+
+	if (bHybrid == TRUE)
+	{
+		_adapt_spin_margin(pTask, apEvent->ullLatency);
+		RTTIME rttNow = read_timer();
+		if (rttNow < rttRelease)
+			spin_timer(rttRelease - rttNow);
+	}
+	pTask->dwStatus = (DWORD)eReady;
+
+	nRet = _release_period(pTask, rttRelease, apullOverrunsCnt);
+	apEvent->rttWakeup = pTask->rttLastWakeup;
+	apEvent->ullLatency = pTask->ullLastLatency;
+	return nRet;
+}
+/*****************************************************************************/
+static VOID
+_logger_task_proc(PVOID apArg)
+{
+	while (TRUE == __atomic_load_n(&g_bLoggerRunning, __ATOMIC_ACQUIRE))
+	{
+		wait_next_period(NULL);
+		flush_lowlevel_logger();
+	}
+}
+/*****************************************************************************/
+INT
+start_logger_task(RTTIME aullFlushPeriod)
+{
+	if (TRUE == g_bLoggerRunning)
+	{
+		DBG_ERROR("FAILED : Start Logger TASK: already running");
+		return -EBUSY;
+	}
+
+	if (aullFlushPeriod == 0)
+		aullFlushPeriod = (RTTIME)DEFAULT_LOG_PERIOD;
+
+	INT nRet = create_nrt_task(&g_stLoggerTask, (const PCHAR)"RTPOSIX_LOGGER", 0);
+	if (nRet != RET_SUCC)
+		return nRet;
+
+	nRet = set_task_period(&g_stLoggerTask, SET_TM_NOW, aullFlushPeriod);
+	if (nRet != RET_SUCC)
+		return nRet;
+
+	__atomic_store_n(&g_bLoggerRunning, TRUE, __ATOMIC_RELEASE);
+	nRet = start_task(&g_stLoggerTask, &_logger_task_proc, NULL);
+	if (nRet != RET_SUCC)
+	{
+		__atomic_store_n(&g_bLoggerRunning, FALSE, __ATOMIC_RELEASE);
+		return nRet;
+	}
+
+	// from now on DBG_* calls only enqueue binary records
+	init_deferred_logger(TRUE);
+	return RET_SUCC;
+}
+/*****************************************************************************/
+INT
+stop_logger_task(VOID)
+{
+	if (FALSE == g_bLoggerRunning)
+		return RET_SUCC;
+
+	__atomic_store_n(&g_bLoggerRunning, FALSE, __ATOMIC_RELEASE);
+
+	// the drain notices the flag on its next period
+	if (wait_task_end(&g_stLoggerTask, read_timer() + g_stLoggerTask.ullPeriod + NANOSEC_PER_SEC) != RET_SUCC)
+		DBG_WARN("WARNING : Stop Logger TASK: drain did not stop in time");
+
+	init_deferred_logger(FALSE);
+	flush_lowlevel_logger();
+	return RET_SUCC;
+}
+/*****************************************************************************/
+LONG
+system_call(LONG alMagicNo)
+{
+	return syscall(alMagicNo);
+}
+/*****************************************************************************/
+static void
+_reset_cached_tid(void)
+{
+	// the child of a fork() runs with a new TID but a copy of our TLS
+	t_nCachedTid = 0;
+}
+/*****************************************************************************/
+PID
+get_cached_tid(VOID)
+{
+	// one syscall per thread for the hot paths that need the TID
+	if (t_nCachedTid == 0)
+		t_nCachedTid = gettid();
+	return t_nCachedTid;
+}
+/*****************************************************************************/
+INT
+futex_wait(UINT32* apuAddr, UINT32 auExpected, RTTIME aullAbsTimeout)
+{
+	TIMESPEC stTimeout;
+	TIMESPEC* pTimeout = NULL;
+
+	if (aullAbsTimeout != TM_INFINITE)
+	{
+		convert_nsecs_to_timespec(aullAbsTimeout, &stTimeout);
+		pTimeout = &stTimeout;
+	}
+
+	// FUTEX_WAIT_BITSET takes an absolute timeout on CLOCK_MONOTONIC, same as read_timer()
+	if (syscall(SYS_futex, apuAddr, FUTEX_WAIT_BITSET | FUTEX_PRIVATE_FLAG, auExpected, pTimeout, NULL, FUTEX_BITSET_MATCH_ANY) != 0)
+		return -errno;
+
+	return RET_SUCC;
+}
+/*****************************************************************************/
+INT
+futex_wake(UINT32* apuAddr, INT anCount)
+{
+	LONG lRet = syscall(SYS_futex, apuAddr, FUTEX_WAKE | FUTEX_PRIVATE_FLAG, anCount, NULL, NULL, 0);
+	if (lRet < 0)
+		return -errno;
+
+	return (INT)lRet;
 }
 /*****************************************************************************/
@@ -0,0 +1,315 @@
+/*
+ *  This file is owned by the Embedded Systems Laboratory of Seoul National University of Science and Technology
+ *  as a part of RT-AIDE or the RTOS-Agnostic and Interoperable Development Environment for Real-time Systems
+ *
+ *  File: rt_cyclic.c
+ *  Author: 2022 Raimarius Delgado
+ *  Description: cyclic executive. The callbacks of every rate share one periodic task, the period of the
+ *				 task is the minor frame and the table repeats every major frame, so the execution order
+ *				 is fixed and one wakeup serves all rates due in that frame.
+ *
+ *
+*/
+#include "rt_cyclic.h"
+
+/*****************************************************************************/
+static UINT32
+_get_gcd(UINT32 auLeft, UINT32 auRight)
+{
+	while (auRight != 0)
+	{
+		UINT32 uTemp = auLeft % auRight;
+		auLeft = auRight;
+		auRight = uTemp;
+	}
+	return auLeft;
+}
+/*****************************************************************************/
+INT
+create_cyclic_executive(POSIX_CYCLIC* apCyclic, const PCHAR astrName, INT anStkSize, INT anPriority, RTTIME aullMinorPeriod)
+{
+	if (apCyclic == NULL || astrName == NULL || aullMinorPeriod == 0)
+		return -EINVAL;
+	if (strlen(astrName) >= MAX_NAME_LENGTH)
+	{
+		DBG_ERROR("FAILED : Create Cyclic Executive (Length of astrName should be less than %d)", (INT)MAX_NAME_LENGTH);
+		return -EINVAL;
+	}
+
+	ZERO_MEMORY(apCyclic, sizeof(POSIX_CYCLIC));
+	strcpy(apCyclic->strName, astrName);
+	apCyclic->ullMinorPeriod = aullMinorPeriod;
+
+	INT nRet = create_rt_task(&apCyclic->stTask, astrName, anStkSize, anPriority);
+	if (nRet != RET_SUCC)
+		return nRet;
+
+	// frames lost to an overrun are dropped, the table stays aligned to the time of the releases
+	set_overrun_policy(&apCyclic->stTask, eOverrunSkip, NULL, NULL);
+
+	DBG_TRACE("SUCCESS: Create Cyclic Executive : name=%s, minor=%llu", astrName, (unsigned long long)aullMinorPeriod);
+	return RET_SUCC;
+}
+/*****************************************************************************/
+INT
+delete_cyclic_executive(POSIX_CYCLIC* apCyclic)
+{
+	if (apCyclic == NULL)
+		return -EINVAL;
+
+	if (apCyclic->bStarted)
+		stop_cyclic_executive(apCyclic);
+
+	INT nRet = delete_task(&apCyclic->stTask);
+	apCyclic->uEntryCnt = 0;
+	return nRet;
+}
+/*****************************************************************************/
+INT
+set_cyclic_budget_handler(POSIX_CYCLIC* apCyclic, PCYCLICBUDGETFCN apFcn, PVOID apArg)
+{
+	if (apCyclic == NULL)
+		return -EINVAL;
+	if (apCyclic->bStarted)
+		return -EBUSY;
+
+	apCyclic->pBudgetFcn = apFcn;
+	apCyclic->pBudgetArg = apArg;
+	return RET_SUCC;
+}
+/*****************************************************************************/
+INT
+add_cyclic_entry(POSIX_CYCLIC* apCyclic, const PCHAR astrName, RTTIME aullPeriod, UINT32 auPhase,
+				 RTTIME aullBudget, PTASKFCN apFcn, PVOID apArg)
+{
+	if (apCyclic == NULL || astrName == NULL || apFcn == NULL || aullPeriod == 0)
+		return -EINVAL;
+
+	if (apCyclic->bStarted || apCyclic->uEntryCnt >= LIM_CYCLIC_ENTRIES)
+	{
+		DBG_ERROR("FAILED : Add Cyclic Entry: %s is already started or full", apCyclic->strName);
+		return -EBUSY;
+	}
+
+	// only rates harmonic to the minor frame have a fixed place in the table
+	UINT64 ullDivider = aullPeriod / apCyclic->ullMinorPeriod;
+	if (aullPeriod % apCyclic->ullMinorPeriod != 0 || ullDivider > LIM_CYCLIC_FRAMES || auPhase >= ullDivider)
+	{
+		DBG_ERROR("FAILED : Add Cyclic Entry: %s period %llu is not a multiple (up to %d) of %llu or phase %u is out of range",
+				  astrName, (unsigned long long)aullPeriod, LIM_CYCLIC_FRAMES, (unsigned long long)apCyclic->ullMinorPeriod, auPhase);
+		return -EINVAL;
+	}
+
+	INT nEntry = (INT)apCyclic->uEntryCnt;
+	POSIX_CYCLIC_ENTRY* pEntry = &apCyclic->stEntries[nEntry];
+	ZERO_MEMORY(pEntry, sizeof(POSIX_CYCLIC_ENTRY));
+	strncpy(pEntry->strName, astrName, MAX_NAME_LENGTH - 1);
+	pEntry->pFcn = apFcn;
+	pEntry->pArg = apArg;
+	pEntry->uDivider = (UINT32)ullDivider;
+	pEntry->uPhase = auPhase;
+	pEntry->ullBudget = aullBudget;
+	apCyclic->uEntryCnt++;
+	return nEntry;
+}
+/*****************************************************************************/
+static INT
+_build_cyclic_table(POSIX_CYCLIC* apCyclic)
+{
+	// the major frame is the least common multiple of all dividers
+	UINT32 uFrameCnt = 1;
+	for (UINT32 uIdx = 0; uIdx < apCyclic->uEntryCnt; uIdx++)
+	{
+		UINT32 uDivider = apCyclic->stEntries[uIdx].uDivider;
+		UINT64 ullLcm = (UINT64)uFrameCnt / _get_gcd(uFrameCnt, uDivider) * uDivider;
+		if (ullLcm > LIM_CYCLIC_FRAMES)
+		{
+			DBG_ERROR("FAILED : Build Cyclic Table: %s major frame exceeds %d minor frames", apCyclic->strName, LIM_CYCLIC_FRAMES);
+			return -EINVAL;
+		}
+		uFrameCnt = (UINT32)ullLcm;
+	}
+
+	// faster rates first, registration order among equal rates
+	UINT8 uOrder[LIM_CYCLIC_ENTRIES];
+	for (UINT32 uIdx = 0; uIdx < apCyclic->uEntryCnt; uIdx++)
+	{
+		UINT32 uPos = uIdx;
+		while (uPos > 0 && apCyclic->stEntries[uOrder[uPos - 1]].uDivider > apCyclic->stEntries[uIdx].uDivider)
+		{
+			uOrder[uPos] = uOrder[uPos - 1];
+			uPos--;
+		}
+		uOrder[uPos] = (UINT8)uIdx;
+	}
+
+	apCyclic->uFrameCnt = uFrameCnt;
+	for (UINT32 uFrame = 0; uFrame < uFrameCnt; uFrame++)
+	{
+		UINT8 uCnt = 0;
+		for (UINT32 uIdx = 0; uIdx < apCyclic->uEntryCnt; uIdx++)
+		{
+			POSIX_CYCLIC_ENTRY* pEntry = &apCyclic->stEntries[uOrder[uIdx]];
+			if (uFrame % pEntry->uDivider == pEntry->uPhase)
+				apCyclic->uFrameEntries[uFrame][uCnt++] = uOrder[uIdx];
+		}
+		apCyclic->uFrameEntryCnt[uFrame] = uCnt;
+	}
+	return RET_SUCC;
+}
+/*****************************************************************************/
+static BOOL
+_run_cyclic_frame(POSIX_CYCLIC* apCyclic, UINT32 auFrame)
+{
+	BOOL bContinue = TRUE;
+	RTTIME rttFrame = read_timer();
+	RTTIME rttStart = rttFrame;
+
+	for (UINT8 uIdx = 0; uIdx < apCyclic->uFrameEntryCnt[auFrame]; uIdx++)
+	{
+		INT nEntry = apCyclic->uFrameEntries[auFrame][uIdx];
+		POSIX_CYCLIC_ENTRY* pEntry = &apCyclic->stEntries[nEntry];
+
+		pEntry->pFcn(pEntry->pArg);
+
+		// the end of one callback is the start of the next, one timer read per callback
+		RTTIME rttEnd = read_timer();
+		RTTIME ullExec = rttEnd - rttStart;
+		rttStart = rttEnd;
+
+		__atomic_store_n(&pEntry->ullExecLast, ullExec, __ATOMIC_RELAXED);
+		__atomic_store_n(&pEntry->ullExecSum, pEntry->ullExecSum + ullExec, __ATOMIC_RELAXED);
+		if (ullExec > pEntry->ullExecMax)
+			__atomic_store_n(&pEntry->ullExecMax, ullExec, __ATOMIC_RELAXED);
+		__atomic_store_n(&pEntry->ullCalls, pEntry->ullCalls + 1, __ATOMIC_RELEASE);
+
+		if (pEntry->ullBudget != 0 && ullExec > pEntry->ullBudget)
+		{
+			__atomic_store_n(&pEntry->ullBudgetOverruns, pEntry->ullBudgetOverruns + 1, __ATOMIC_RELAXED);
+			if (apCyclic->pBudgetFcn != NULL && apCyclic->pBudgetFcn(apCyclic, nEntry, ullExec, apCyclic->pBudgetArg) < 0)
+				bContinue = FALSE;
+		}
+	}
+
+	RTTIME ullFrameExec = rttStart - rttFrame;
+	__atomic_store_n(&apCyclic->ullFrameExecLast, ullFrameExec, __ATOMIC_RELAXED);
+	if (ullFrameExec > apCyclic->ullFrameExecMax)
+		__atomic_store_n(&apCyclic->ullFrameExecMax, ullFrameExec, __ATOMIC_RELAXED);
+	if (ullFrameExec > apCyclic->ullMinorPeriod)
+		__atomic_store_n(&apCyclic->ullFrameOverruns, apCyclic->ullFrameOverruns + 1, __ATOMIC_RELAXED);
+	__atomic_store_n(&apCyclic->ullFrames, apCyclic->ullFrames + 1, __ATOMIC_RELEASE);
+	return bContinue;
+}
+/*****************************************************************************/
+static VOID
+_cyclic_proc(PVOID apArg)
+{
+	POSIX_CYCLIC* pCyclic = (POSIX_CYCLIC*)apArg;
+	UINT32 uFrame = 0;
+	UINT64 ullMissed = 0;
+
+	while (__atomic_load_n(&pCyclic->bStop, __ATOMIC_ACQUIRE) == FALSE)
+	{
+		wait_next_period(&ullMissed);
+		if (ullMissed > 0)
+		{
+			// the releases of the dropped frames are gone, the next frame is the one of this release
+			__atomic_store_n(&pCyclic->ullFramesSkipped, pCyclic->ullFramesSkipped + ullMissed, __ATOMIC_RELAXED);
+			uFrame = (UINT32)((uFrame + ullMissed) % pCyclic->uFrameCnt);
+		}
+		if (__atomic_load_n(&pCyclic->bStop, __ATOMIC_ACQUIRE))
+			break;
+
+		if (_run_cyclic_frame(pCyclic, uFrame) == FALSE)
+		{
+			DBG_WARN("WARNING : Cyclic Executive: %s stopped by its budget handler", pCyclic->strName);
+			break;
+		}
+		uFrame = (uFrame + 1 == pCyclic->uFrameCnt) ? 0 : uFrame + 1;
+	}
+}
+/*****************************************************************************/
+INT
+start_cyclic_executive(POSIX_CYCLIC* apCyclic, RTTIME arttStart)
+{
+	if (apCyclic == NULL || apCyclic->uEntryCnt == 0)
+		return -EINVAL;
+	if (apCyclic->bStarted)
+		return -EBUSY;
+
+	INT nRet = _build_cyclic_table(apCyclic);
+	if (nRet != RET_SUCC)
+		return nRet;
+
+	nRet = set_task_period(&apCyclic->stTask, arttStart, apCyclic->ullMinorPeriod);
+	if (nRet != RET_SUCC)
+	{
+		DBG_ERROR("FAILED : Start Cyclic Executive: %s cannot set the minor period", apCyclic->strName);
+		return (nRet < 0) ? nRet : -EINVAL;
+	}
+
+	apCyclic->bStop = FALSE;
+	nRet = start_task(&apCyclic->stTask, &_cyclic_proc, apCyclic);
+	if (nRet != RET_SUCC)
+		return nRet;
+
+	apCyclic->bStarted = TRUE;
+	DBG_TRACE("SUCCESS: Start Cyclic Executive : name=%s, entries=%u, frames=%u", apCyclic->strName, apCyclic->uEntryCnt, apCyclic->uFrameCnt);
+	return RET_SUCC;
+}
+/*****************************************************************************/
+INT
+stop_cyclic_executive(POSIX_CYCLIC* apCyclic)
+{
+	if (apCyclic == NULL || apCyclic->bStarted == FALSE)
+		return -EINVAL;
+
+	// the executive checks the flag once per minor frame
+	__atomic_store_n(&apCyclic->bStop, TRUE, __ATOMIC_RELEASE);
+	if (wait_task_end(&apCyclic->stTask, read_timer() + DEFAULT_CYCLIC_STOP_TIMEOUT) != RET_SUCC)
+	{
+		DBG_ERROR("FAILED : Stop Cyclic Executive: %s did not finish its frame", apCyclic->strName);
+		return -ETIMEDOUT;
+	}
+	return RET_SUCC;
+}
+/*****************************************************************************/
+INT
+get_cyclic_stats(POSIX_CYCLIC* apCyclic, POSIX_CYCLIC_STATS* apStats)
+{
+	if (apCyclic == NULL || apStats == NULL)
+		return -EINVAL;
+
+	ZERO_MEMORY(apStats, sizeof(POSIX_CYCLIC_STATS));
+	apStats->uMajorFrames = apCyclic->uFrameCnt;
+	apStats->ullFrames = __atomic_load_n(&apCyclic->ullFrames, __ATOMIC_ACQUIRE);
+	apStats->ullFramesSkipped = __atomic_load_n(&apCyclic->ullFramesSkipped, __ATOMIC_RELAXED);
+	apStats->ullFrameOverruns = __atomic_load_n(&apCyclic->ullFrameOverruns, __ATOMIC_RELAXED);
+	apStats->ullFrameExecLast = __atomic_load_n(&apCyclic->ullFrameExecLast, __ATOMIC_RELAXED);
+	apStats->ullFrameExecMax = __atomic_load_n(&apCyclic->ullFrameExecMax, __ATOMIC_RELAXED);
+	for (UINT32 uIdx = 0; uIdx < apCyclic->uEntryCnt; uIdx++)
+		apStats->ullBudgetOverruns += __atomic_load_n(&apCyclic->stEntries[uIdx].ullBudgetOverruns, __ATOMIC_RELAXED);
+	return RET_SUCC;
+}
+/*****************************************************************************/
+INT
+get_cyclic_entry(POSIX_CYCLIC* apCyclic, INT anEntry, POSIX_CYCLIC_ENTRY* apEntry)
+{
+	if (apCyclic == NULL || apEntry == NULL || anEntry < 0 || anEntry >= (INT)apCyclic->uEntryCnt)
+		return -EINVAL;
+
+	POSIX_CYCLIC_ENTRY* pEntry = &apCyclic->stEntries[anEntry];
+	memcpy(apEntry->strName, pEntry->strName, MAX_NAME_LENGTH);
+	apEntry->pFcn = pEntry->pFcn;
+	apEntry->pArg = pEntry->pArg;
+	apEntry->uDivider = pEntry->uDivider;
+	apEntry->uPhase = pEntry->uPhase;
+	apEntry->ullBudget = pEntry->ullBudget;
+	apEntry->ullCalls = __atomic_load_n(&pEntry->ullCalls, __ATOMIC_ACQUIRE);
+	apEntry->ullBudgetOverruns = __atomic_load_n(&pEntry->ullBudgetOverruns, __ATOMIC_RELAXED);
+	apEntry->ullExecLast = __atomic_load_n(&pEntry->ullExecLast, __ATOMIC_RELAXED);
+	apEntry->ullExecMax = __atomic_load_n(&pEntry->ullExecMax, __ATOMIC_RELAXED);
+	apEntry->ullExecSum = __atomic_load_n(&pEntry->ullExecSum, __ATOMIC_RELAXED);
+	return RET_SUCC;
+}
+/*****************************************************************************/
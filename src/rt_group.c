@@ -0,0 +1,197 @@
+/*
+ *  This file is owned by the Embedded Systems Laboratory of Seoul National University of Science and Technology
+ *  as a part of RT-AIDE or the RTOS-Agnostic and Interoperable Development Environment for Real-time Systems
+ *
+ *  File: rt_group.c
+ *  Author: 2022 Raimarius Delgado
+ *  Description: synchronized start of periodic task groups. All tasks are started first and wait on a
+ *				 futex barrier, the release time is fixed once every one of them is there, so thread
+ *				 creation never shifts the phase of one task against another.
+ *
+ *
+*/
+#include "rt_group.h"
+
+/*****************************************************************************/
+INT
+create_task_group(POSIX_TASK_GROUP* apGroup, const PCHAR astrName)
+{
+	if (apGroup == NULL || astrName == NULL)
+		return -EINVAL;
+	if (strlen(astrName) >= MAX_NAME_LENGTH)
+	{
+		DBG_ERROR("FAILED : Create Task Group (Length of astrName should be less than %d)", (INT)MAX_NAME_LENGTH);
+		return -EINVAL;
+	}
+
+	ZERO_MEMORY(apGroup, sizeof(POSIX_TASK_GROUP));
+	strcpy(apGroup->strName, astrName);
+	return RET_SUCC;
+}
+/*****************************************************************************/
+INT
+delete_task_group(POSIX_TASK_GROUP* apGroup)
+{
+	if (apGroup == NULL)
+		return -EINVAL;
+
+	for (UINT32 uIdx = 0; uIdx < apGroup->uTaskCnt; uIdx++)
+		delete_task(apGroup->stMembers[uIdx].pTask);
+
+	apGroup->uTaskCnt = 0;
+	return RET_SUCC;
+}
+/*****************************************************************************/
+INT
+add_group_task(POSIX_TASK_GROUP* apGroup, POSIX_TASK* apTask, RTTIME aullOffset, PTASKFCN apEntry, PVOID apArg)
+{
+	if (apGroup == NULL || apTask == NULL || apEntry == NULL)
+		return -EINVAL;
+
+	if (__atomic_load_n(&apGroup->uReleased, __ATOMIC_ACQUIRE) != 0 || apGroup->uTaskCnt >= LIM_GROUP_TASKS)
+	{
+		DBG_ERROR("FAILED : Add Group Task: %s is already released or full", apGroup->strName);
+		return -EBUSY;
+	}
+	// a periodic task is back in eReady between two cycles, only a task without a thread is not started
+	if (apTask->dwStatus != eReady || apTask->nPid != 0 || apTask->bPeriodic == FALSE)
+	{
+		DBG_ERROR("FAILED : Add Group Task: %s must be a periodic task that has not been started", apTask->strName);
+		return -EINVAL;
+	}
+
+	POSIX_GROUP_MEMBER* pMember = &apGroup->stMembers[apGroup->uTaskCnt++];
+	pMember->pGroup = apGroup;
+	pMember->pTask = apTask;
+	pMember->ullOffset = aullOffset;
+	pMember->pEntry = apEntry;
+	pMember->pArg = apArg;
+	return RET_SUCC;
+}
+/*****************************************************************************/
+INT
+create_group_task(POSIX_TASK_GROUP* apGroup, POSIX_TASK* apTask, const PCHAR astrName, INT anStkSize, INT anPriority,
+				  RTTIME aullPeriod, RTTIME aullOffset, PTASKFCN apEntry, PVOID apArg)
+{
+	if (apGroup == NULL || apTask == NULL || aullPeriod == 0)
+		return -EINVAL;
+
+	INT nRet = create_rt_task(apTask, astrName, anStkSize, anPriority);
+	if (nRet != RET_SUCC)
+		return nRet;
+
+	// the start time does not matter, the group release sets the phase
+	nRet = set_task_period(apTask, SET_TM_NOW, aullPeriod);
+	if (nRet == RET_SUCC)
+		nRet = add_group_task(apGroup, apTask, aullOffset, apEntry, apArg);
+
+	if (nRet != RET_SUCC)
+		delete_task(apTask);
+	return nRet;
+}
+/*****************************************************************************/
+static VOID
+_group_task_proc(PVOID apArg)
+{
+	POSIX_GROUP_MEMBER* pMember = (POSIX_GROUP_MEMBER*)apArg;
+	POSIX_TASK_GROUP* pGroup = pMember->pGroup;
+
+	// the last task to arrive wakes up start_task_group()
+	if (__atomic_add_fetch(&pGroup->uReady, 1, __ATOMIC_ACQ_REL) == pGroup->uTaskCnt)
+		futex_wake(&pGroup->uReady, 1);
+
+	UINT32 uBarrier;
+	while ((uBarrier = __atomic_load_n(&pGroup->uReleased, __ATOMIC_ACQUIRE)) == eGroupClosed)
+		futex_wait(&pGroup->uReleased, eGroupClosed, TM_INFINITE);
+	if (uBarrier == eGroupAborted)
+	{
+		DBG_TRACE("START PROC : %s leaves the aborted group %s", pMember->pTask->strName, pGroup->strName);
+		return;
+	}
+
+	// only the task itself touches its deadline once it runs, put the first release on the group grid
+	convert_nsecs_to_timespec(pGroup->rttRelease + pMember->ullOffset, &pMember->pTask->stDeadline);
+	wait_next_period(NULL);
+
+	pMember->pEntry(pMember->pArg);
+}
+/*****************************************************************************/
+static VOID
+_abort_task_group(POSIX_TASK_GROUP* apGroup, UINT32 auStartedCnt)
+{
+	__atomic_store_n(&apGroup->uReleased, eGroupAborted, __ATOMIC_RELEASE);
+	futex_wake(&apGroup->uReleased, INT_MAX);
+
+	// the started tasks return from the barrier without running their entry, wait until their threads are gone
+	RTTIME rttTimeout = read_timer() + DEFAULT_GROUP_READY_TIMEOUT;
+	for (UINT32 uIdx = 0; uIdx < auStartedCnt; uIdx++)
+	{
+		POSIX_TASK* pTask = apGroup->stMembers[uIdx].pTask;
+		if (wait_task_end(pTask, rttTimeout) != RET_SUCC)
+			DBG_WARN("WARNING : Start Task Group: %s did not leave the aborted group %s", pTask->strName, apGroup->strName);
+	}
+}
+/*****************************************************************************/
+INT
+start_task_group(POSIX_TASK_GROUP* apGroup, RTTIME aullReleaseTime)
+{
+	INT nRet = RET_SUCC;
+
+	if (apGroup == NULL || apGroup->uTaskCnt == 0)
+		return -EINVAL;
+	if (__atomic_load_n(&apGroup->uReleased, __ATOMIC_ACQUIRE) != eGroupClosed)
+		return -EBUSY;
+	if (aullReleaseTime != (RTTIME)SET_TM_NOW && aullReleaseTime <= read_timer())
+	{
+		DBG_ERROR("FAILED : Start Task Group: %s release time lies in the past", apGroup->strName);
+		return -EINVAL;
+	}
+
+	for (UINT32 uIdx = 0; uIdx < apGroup->uTaskCnt; uIdx++)
+	{
+		POSIX_GROUP_MEMBER* pMember = &apGroup->stMembers[uIdx];
+		nRet = start_task(pMember->pTask, &_group_task_proc, pMember);
+		if (nRet != RET_SUCC)
+		{
+			DBG_ERROR("FAILED : Start Task Group: %s could not start %s", apGroup->strName, pMember->pTask->strName);
+			_abort_task_group(apGroup, uIdx);
+			return nRet;
+		}
+	}
+
+	// wait for every task at the barrier, their stacks and scheduling are set up by then
+	RTTIME rttTimeout = read_timer() + DEFAULT_GROUP_READY_TIMEOUT;
+	UINT32 uReady;
+	while ((uReady = __atomic_load_n(&apGroup->uReady, __ATOMIC_ACQUIRE)) < apGroup->uTaskCnt)
+	{
+		if (futex_wait(&apGroup->uReady, uReady, rttTimeout) == -ETIMEDOUT)
+		{
+			DBG_ERROR("FAILED : Start Task Group: %s only %u of %u tasks reached the barrier", apGroup->strName, uReady, apGroup->uTaskCnt);
+			_abort_task_group(apGroup, apGroup->uTaskCnt);
+			return -ETIMEDOUT;
+		}
+	}
+
+	RTTIME rttNow = read_timer();
+	if (aullReleaseTime == (RTTIME)SET_TM_NOW)
+		aullReleaseTime = rttNow + DEFAULT_GROUP_RELEASE_DELAY;
+	else if (aullReleaseTime <= rttNow)
+		DBG_WARN("WARNING : Start Task Group: %s the release time passed while starting the tasks", apGroup->strName);
+
+	apGroup->rttRelease = aullReleaseTime;
+	__atomic_store_n(&apGroup->uReleased, eGroupReleased, __ATOMIC_RELEASE);
+	futex_wake(&apGroup->uReleased, INT_MAX);
+
+	DBG_TRACE("SUCCESS: Start Task Group : name=%s, tasks=%u, release=%llu", apGroup->strName, apGroup->uTaskCnt, (unsigned long long)aullReleaseTime);
+	return RET_SUCC;
+}
+/*****************************************************************************/
+RTTIME
+get_group_release(POSIX_TASK_GROUP* apGroup)
+{
+	if (apGroup == NULL || __atomic_load_n(&apGroup->uReleased, __ATOMIC_ACQUIRE) != eGroupReleased)
+		return 0;
+
+	return apGroup->rttRelease;
+}
+/*****************************************************************************/
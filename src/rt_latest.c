@@ -0,0 +1,242 @@
+/*
+ *  This file is owned by the Embedded Systems Laboratory of Seoul National University of Science and Technology
+ *  as a part of RT-AIDE or the RTOS-Agnostic and Interoperable Development Environment for Real-time Systems
+ *
+ *  File: rt_latest.c
+ *  Author: 2022 Raimarius Delgado
+ *  Description: latest-value channels. The values live in locked and pre-faulted regions, the seqlock copies
+ *				 them word by word with atomic accesses and the triple buffer hands whole slots over with
+ *				 one atomic exchange, so no side ever takes a lock that could invert priorities.
+ *
+ *
+*/
+#include "rt_latest.h"
+
+/*****************************************************************************/
+INT
+create_rt_seqlock(RT_SEQLOCK* apLock, UINT32 auSize)
+{
+	if (apLock == NULL || auSize == 0 || auSize > LIM_LATEST_SIZE)
+		return -EINVAL;
+
+	ZERO_MEMORY(apLock, sizeof(RT_SEQLOCK));
+	apLock->uSize = auSize;
+	apLock->uWordCnt = (UINT32)(ROUND_UP(auSize, sizeof(UINT64)) / sizeof(UINT64));
+	apLock->ulRegionSize = ROUND_UP((size_t)apLock->uWordCnt * sizeof(UINT64), (size_t)sysconf(_SC_PAGESIZE));
+	INT nRet = map_locked_region((PVOID*)&apLock->pRegion, apLock->ulRegionSize, "Create RT SEQLOCK");
+	if (nRet != RET_SUCC)
+		return nRet;
+
+	apLock->pullData = (UINT64*)apLock->pRegion;
+	return RET_SUCC;
+}
+/*****************************************************************************/
+INT
+delete_rt_seqlock(RT_SEQLOCK* apLock)
+{
+	if (apLock == NULL || apLock->pRegion == NULL)
+		return -EINVAL;
+
+	unmap_locked_region(apLock->pRegion, apLock->ulRegionSize);
+	apLock->pRegion = NULL;
+	apLock->pullData = NULL;
+	return RET_SUCC;
+}
+/*****************************************************************************/
+INT
+rt_seqlock_write(RT_SEQLOCK* apLock, const PVOID apData)
+{
+	if (apLock == NULL || apLock->pullData == NULL || apData == NULL)
+		return -EINVAL;
+
+	// single writer: the odd sequence tells the readers to retry, the stores of the data may not pass it
+	UINT32 uSeq = __atomic_load_n(&apLock->uSeq, __ATOMIC_RELAXED);
+	__atomic_store_n(&apLock->uSeq, uSeq + 1, __ATOMIC_RELAXED);
+	__atomic_thread_fence(__ATOMIC_RELEASE);
+
+	const BYTE* pSrc = (const BYTE*)apData;
+	UINT32 uFull = apLock->uSize / sizeof(UINT64);
+	for (UINT32 uIdx = 0; uIdx < uFull; uIdx++)
+	{
+		UINT64 ullWord;
+		memcpy(&ullWord, pSrc + uIdx * sizeof(UINT64), sizeof(UINT64));
+		__atomic_store_n(&apLock->pullData[uIdx], ullWord, __ATOMIC_RELAXED);
+	}
+	if (uFull < apLock->uWordCnt)
+	{
+		UINT64 ullWord = 0;
+		memcpy(&ullWord, pSrc + uFull * sizeof(UINT64), apLock->uSize - uFull * sizeof(UINT64));
+		__atomic_store_n(&apLock->pullData[uFull], ullWord, __ATOMIC_RELAXED);
+	}
+
+	__atomic_store_n(&apLock->uSeq, uSeq + 2, __ATOMIC_RELEASE);
+	if (apLock->bHasData == FALSE)
+		__atomic_store_n(&apLock->bHasData, TRUE, __ATOMIC_RELEASE);
+	return RET_SUCC;
+}
+/*****************************************************************************/
+INT
+rt_seqlock_try_read(RT_SEQLOCK* apLock, PVOID apData, UINT32* apuVersion)
+{
+	if (apLock == NULL || apLock->pullData == NULL || apData == NULL)
+		return -EINVAL;
+
+	if (__atomic_load_n(&apLock->bHasData, __ATOMIC_ACQUIRE) == FALSE)
+		return -ENODATA;
+	UINT32 uSeq = __atomic_load_n(&apLock->uSeq, __ATOMIC_ACQUIRE);
+	if (uSeq & 1)
+		return -EAGAIN;
+
+	PBYTE pDst = (PBYTE)apData;
+	UINT32 uFull = apLock->uSize / sizeof(UINT64);
+	for (UINT32 uIdx = 0; uIdx < uFull; uIdx++)
+	{
+		UINT64 ullWord = __atomic_load_n(&apLock->pullData[uIdx], __ATOMIC_RELAXED);
+		memcpy(pDst + uIdx * sizeof(UINT64), &ullWord, sizeof(UINT64));
+	}
+	if (uFull < apLock->uWordCnt)
+	{
+		UINT64 ullWord = __atomic_load_n(&apLock->pullData[uFull], __ATOMIC_RELAXED);
+		memcpy(pDst + uFull * sizeof(UINT64), &ullWord, apLock->uSize - uFull * sizeof(UINT64));
+	}
+
+	// the loads of the data may not pass the second read of the sequence
+	__atomic_thread_fence(__ATOMIC_ACQUIRE);
+	if (__atomic_load_n(&apLock->uSeq, __ATOMIC_RELAXED) != uSeq)
+		return -EAGAIN;
+
+	if (apuVersion != NULL)
+		*apuVersion = uSeq / 2;
+	return RET_SUCC;
+}
+/*****************************************************************************/
+INT
+rt_seqlock_read(RT_SEQLOCK* apLock, PVOID apData, UINT32* apuVersion)
+{
+	UINT32 uSpins = 0;
+	INT nRet;
+	while ((nRet = rt_seqlock_try_read(apLock, apData, apuVersion)) == -EAGAIN)
+	{
+		// a writer preempted in the middle of a write needs the CPU to finish it
+		if (++uSpins % DEFAULT_SEQLOCK_SPINS == 0)
+			sched_yield();
+		else
+			cpu_relax();
+	}
+	return nRet;
+}
+/*****************************************************************************/
+UINT32
+get_rt_seqlock_version(RT_SEQLOCK* apLock)
+{
+	if (apLock == NULL)
+		return 0;
+	return __atomic_load_n(&apLock->uSeq, __ATOMIC_ACQUIRE) / 2;
+}
+/*****************************************************************************/
+INT
+create_rt_triple_buf(RT_TRIPLE_BUF* apBuf, UINT32 auSize)
+{
+	if (apBuf == NULL || auSize == 0 || auSize > LIM_LATEST_SIZE)
+		return -EINVAL;
+
+	ZERO_MEMORY(apBuf, sizeof(RT_TRIPLE_BUF));
+	apBuf->uSize = auSize;
+	// every slot on its own cache lines, the writer and the reader never share one
+	apBuf->ulSlotSize = ROUND_UP(auSize, 64);
+	apBuf->ulRegionSize = ROUND_UP(apBuf->ulSlotSize * 3, (size_t)sysconf(_SC_PAGESIZE));
+	INT nRet = map_locked_region((PVOID*)&apBuf->pRegion, apBuf->ulRegionSize, "Create RT TRIPLE BUFFER");
+	if (nRet != RET_SUCC)
+		return nRet;
+
+	for (UINT32 uIdx = 0; uIdx < 3; uIdx++)
+		apBuf->pSlots[uIdx] = apBuf->pRegion + apBuf->ulSlotSize * uIdx;
+	apBuf->uWrite = 0;
+	apBuf->uMiddle = 1;
+	apBuf->uRead = 2;
+	return RET_SUCC;
+}
+/*****************************************************************************/
+INT
+delete_rt_triple_buf(RT_TRIPLE_BUF* apBuf)
+{
+	if (apBuf == NULL || apBuf->pRegion == NULL)
+		return -EINVAL;
+
+	unmap_locked_region(apBuf->pRegion, apBuf->ulRegionSize);
+	apBuf->pRegion = NULL;
+	return RET_SUCC;
+}
+/*****************************************************************************/
+PVOID
+rt_triple_write_slot(RT_TRIPLE_BUF* apBuf)
+{
+	if (apBuf == NULL || apBuf->pRegion == NULL)
+		return NULL;
+	return apBuf->pSlots[apBuf->uWrite];
+}
+/*****************************************************************************/
+INT
+rt_triple_publish(RT_TRIPLE_BUF* apBuf)
+{
+	if (apBuf == NULL || apBuf->pRegion == NULL)
+		return -EINVAL;
+
+	// the filled slot becomes the middle one, the old middle one is the next to be written
+	UINT32 uOld = __atomic_exchange_n(&apBuf->uMiddle, apBuf->uWrite | RT_TRIPLE_FRESH, __ATOMIC_ACQ_REL);
+	apBuf->uWrite = uOld & ~RT_TRIPLE_FRESH;
+	__atomic_store_n(&apBuf->ullPublished, apBuf->ullPublished + 1, __ATOMIC_RELAXED);
+	return RET_SUCC;
+}
+/*****************************************************************************/
+INT
+rt_triple_write(RT_TRIPLE_BUF* apBuf, const PVOID apData)
+{
+	if (apBuf == NULL || apBuf->pRegion == NULL || apData == NULL)
+		return -EINVAL;
+
+	memcpy(apBuf->pSlots[apBuf->uWrite], apData, apBuf->uSize);
+	return rt_triple_publish(apBuf);
+}
+/*****************************************************************************/
+PVOID
+rt_triple_read_slot(RT_TRIPLE_BUF* apBuf, BOOL* apbFresh)
+{
+	if (apBuf == NULL || apBuf->pRegion == NULL)
+		return NULL;
+
+	// only a fresh middle slot is taken, otherwise the reader keeps the value it already has
+	BOOL bFresh = (__atomic_load_n(&apBuf->uMiddle, __ATOMIC_RELAXED) & RT_TRIPLE_FRESH) != 0;
+	if (bFresh)
+	{
+		UINT32 uOld = __atomic_exchange_n(&apBuf->uMiddle, apBuf->uRead, __ATOMIC_ACQ_REL);
+		apBuf->uRead = uOld & ~RT_TRIPLE_FRESH;
+		apBuf->bHasData = TRUE;
+	}
+	if (apbFresh != NULL)
+		*apbFresh = bFresh;
+	return (apBuf->bHasData) ? apBuf->pSlots[apBuf->uRead] : NULL;
+}
+/*****************************************************************************/
+INT
+rt_triple_read(RT_TRIPLE_BUF* apBuf, PVOID apData, BOOL* apbFresh)
+{
+	if (apBuf == NULL || apBuf->pRegion == NULL || apData == NULL)
+		return -EINVAL;
+
+	PVOID pSlot = rt_triple_read_slot(apBuf, apbFresh);
+	if (pSlot == NULL)
+		return -ENODATA;
+
+	memcpy(apData, pSlot, apBuf->uSize);
+	return RET_SUCC;
+}
+/*****************************************************************************/
+UINT64
+get_rt_triple_published(RT_TRIPLE_BUF* apBuf)
+{
+	if (apBuf == NULL)
+		return 0;
+	return __atomic_load_n(&apBuf->ullPublished, __ATOMIC_RELAXED);
+}
+/*****************************************************************************/
@@ -0,0 +1,286 @@
+/*
+ *  This file is owned by the Embedded Systems Laboratory of Seoul National University of Science and Technology
+ *  as a part of RT-AIDE or the RTOS-Agnostic and Interoperable Development Environment for Real-time Systems
+ *
+ *  File: rt_offload.c
+ *  Author: 2022 Raimarius Delgado
+ *  Description: NRT offload pool. Every worker owns a bounded ring of sequenced slots, RT tasks spread
+ *				 their jobs over the rings with a bounded number of CAS attempts and give up instead of waiting.
+ *				 A worker whose ring is empty steals from the others before sleeping on a futex.
+ *
+ *
+*/
+#include "rt_offload.h"
+
+/*****************************************************************************/
+static BOOL
+_push_job(RT_OFFLOAD_POOL* apPool, RT_OFFLOAD_WORKER* apWorker, PTASKFCN apFcn, PVOID apArg)
+{
+	UINT32 uPos = __atomic_load_n(&apWorker->uTail, __ATOMIC_RELAXED);
+	RT_OFFLOAD_JOB* pJob = &apWorker->pJobs[uPos & apPool->uJobMask];
+
+	// the slot is free when its ticket equals the position, otherwise the ring is full or another producer won
+	if (__atomic_load_n(&pJob->uSeq, __ATOMIC_ACQUIRE) != uPos)
+		return FALSE;
+	if (!__atomic_compare_exchange_n(&apWorker->uTail, &uPos, uPos + 1, FALSE, __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+		return FALSE;
+
+	pJob->pFcn = apFcn;
+	pJob->pArg = apArg;
+	pJob->rttSubmit = read_timer();
+	__atomic_store_n(&pJob->uSeq, uPos + 1, __ATOMIC_RELEASE);
+	return TRUE;
+}
+/*****************************************************************************/
+static BOOL
+_pop_job(RT_OFFLOAD_POOL* apPool, RT_OFFLOAD_WORKER* apWorker, RT_OFFLOAD_JOB* apJob)
+{
+	UINT32 uPos = __atomic_load_n(&apWorker->uHead, __ATOMIC_RELAXED);
+	RT_OFFLOAD_JOB* pJob;
+
+	while (TRUE)
+	{
+		pJob = &apWorker->pJobs[uPos & apPool->uJobMask];
+		INT32 nDiff = (INT32)(__atomic_load_n(&pJob->uSeq, __ATOMIC_ACQUIRE) - (uPos + 1));
+		if (nDiff < 0)
+			return FALSE;
+		if (nDiff == 0)
+		{
+			if (__atomic_compare_exchange_n(&apWorker->uHead, &uPos, uPos + 1, TRUE, __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+				break;
+		}
+		else
+			uPos = __atomic_load_n(&apWorker->uHead, __ATOMIC_RELAXED);
+	}
+
+	*apJob = *pJob;
+	// hand the slot back to the producers for the next lap of the ring
+	__atomic_store_n(&pJob->uSeq, uPos + apPool->uJobMask + 1, __ATOMIC_RELEASE);
+	return TRUE;
+}
+/*****************************************************************************/
+static BOOL
+_take_job(RT_OFFLOAD_POOL* apPool, RT_OFFLOAD_WORKER* apWorker, RT_OFFLOAD_JOB* apJob)
+{
+	if (_pop_job(apPool, apWorker, apJob))
+		return TRUE;
+
+	for (UINT32 uIdx = 1; uIdx < apPool->uWorkerCnt; uIdx++)
+	{
+		RT_OFFLOAD_WORKER* pVictim = &apPool->stWorkers[(apWorker->uIndex + uIdx) % apPool->uWorkerCnt];
+		if (_pop_job(apPool, pVictim, apJob))
+		{
+			__atomic_add_fetch(&apWorker->ullStolen, 1, __ATOMIC_RELAXED);
+			return TRUE;
+		}
+	}
+	return FALSE;
+}
+/*****************************************************************************/
+static VOID
+_run_job(RT_OFFLOAD_POOL* apPool, RT_OFFLOAD_WORKER* apWorker, RT_OFFLOAD_JOB* apJob)
+{
+	// the depth only drops here, so the largest depth seen before a take is the peak
+	UINT32 uDepth = __atomic_fetch_sub(&apPool->uDepth, 1, __ATOMIC_RELAXED);
+	UINT32 uDepthMax = __atomic_load_n(&apPool->uDepthMax, __ATOMIC_RELAXED);
+	while (uDepth > uDepthMax && !__atomic_compare_exchange_n(&apPool->uDepthMax, &uDepthMax, uDepth, TRUE, __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+		;
+
+	RTTIME ullLatency = read_timer() - apJob->rttSubmit;
+	RTTIME ullLatencyMax = __atomic_load_n(&apPool->ullLatencyMax, __ATOMIC_RELAXED);
+	while (ullLatency > ullLatencyMax && !__atomic_compare_exchange_n(&apPool->ullLatencyMax, &ullLatencyMax, ullLatency, TRUE, __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+		;
+	__atomic_store_n(&apPool->ullLatencyLast, ullLatency, __ATOMIC_RELAXED);
+	__atomic_add_fetch(&apPool->ullLatencySum, ullLatency, __ATOMIC_RELAXED);
+
+	apJob->pFcn(apJob->pArg);
+	__atomic_add_fetch(&apWorker->ullExecuted, 1, __ATOMIC_RELAXED);
+}
+/*****************************************************************************/
+static VOID
+_offload_worker_proc(PVOID apArg)
+{
+	RT_OFFLOAD_WORKER* pWorker = (RT_OFFLOAD_WORKER*)apArg;
+	RT_OFFLOAD_POOL* pPool = pWorker->pPool;
+	RT_OFFLOAD_JOB stJob;
+
+	while (TRUE)
+	{
+		if (_take_job(pPool, pWorker, &stJob))
+		{
+			_run_job(pPool, pWorker, &stJob);
+			continue;
+		}
+		// the queues are drained before leaving
+		if (__atomic_load_n(&pPool->bStop, __ATOMIC_ACQUIRE))
+			break;
+
+		// submitters only wake when they see a sleeper, so announce before the last look at the rings
+		UINT32 uSignal = __atomic_load_n(&pPool->uSignal, __ATOMIC_SEQ_CST);
+		__atomic_add_fetch(&pPool->uSleepers, 1, __ATOMIC_SEQ_CST);
+		if (_take_job(pPool, pWorker, &stJob))
+		{
+			__atomic_sub_fetch(&pPool->uSleepers, 1, __ATOMIC_SEQ_CST);
+			_run_job(pPool, pWorker, &stJob);
+			continue;
+		}
+		if (__atomic_load_n(&pPool->bStop, __ATOMIC_ACQUIRE) == FALSE)
+			futex_wait(&pPool->uSignal, uSignal, TM_INFINITE);
+		__atomic_sub_fetch(&pPool->uSleepers, 1, __ATOMIC_SEQ_CST);
+	}
+}
+/*****************************************************************************/
+static VOID
+_stop_offload_workers(RT_OFFLOAD_POOL* apPool, UINT32 auWorkerCnt)
+{
+	__atomic_store_n(&apPool->bStop, TRUE, __ATOMIC_SEQ_CST);
+	__atomic_add_fetch(&apPool->uSignal, 1, __ATOMIC_SEQ_CST);
+	futex_wake(&apPool->uSignal, INT_MAX);
+
+	RTTIME rttTimeout = read_timer() + DEFAULT_OFFLOAD_STOP_TIMEOUT;
+	for (UINT32 uIdx = 0; uIdx < auWorkerCnt; uIdx++)
+	{
+		POSIX_TASK* pTask = &apPool->stWorkers[uIdx].stTask;
+		wait_task_end(pTask, rttTimeout);
+		delete_task(pTask);
+	}
+}
+/*****************************************************************************/
+INT
+create_rt_offload_pool(RT_OFFLOAD_POOL* apPool, const PCHAR astrName, UINT32 auWorkerCnt, UINT32 auJobCnt)
+{
+	INT nRet = RET_SUCC;
+	CHAR strWorker[MAX_NAME_LENGTH];
+
+	if (apPool == NULL || astrName == NULL || auWorkerCnt == 0 || auWorkerCnt > LIM_OFFLOAD_WORKERS || auJobCnt == 0 || auJobCnt > (1U << 24))
+	{
+		DBG_ERROR("FAILED : Create RT OFFLOAD POOL: invalid parameters");
+		return -EINVAL;
+	}
+	if (strlen(astrName) >= MAX_NAME_LENGTH - 2)
+	{
+		DBG_ERROR("FAILED : Create RT OFFLOAD POOL (Length of astrName should be less than %d)", (INT)MAX_NAME_LENGTH - 2);
+		return -EINVAL;
+	}
+
+	ZERO_MEMORY(apPool, sizeof(RT_OFFLOAD_POOL));
+	strcpy(apPool->strName, astrName);
+
+	UINT32 uJobCnt = 1;
+	while (uJobCnt < auJobCnt)
+		uJobCnt <<= 1;
+	size_t ulRingSize = ROUND_UP((size_t)uJobCnt * sizeof(RT_OFFLOAD_JOB), 64);
+	size_t ulRegionSize = ROUND_UP(ulRingSize * auWorkerCnt, (size_t)sysconf(_SC_PAGESIZE));
+
+	// the rings live in one pre-faulted and locked region like the RT POOL blocks
+	PVOID pRegion = NULL;
+	nRet = map_locked_region(&pRegion, ulRegionSize, "Create RT OFFLOAD POOL");
+	if (nRet != RET_SUCC)
+		return nRet;
+
+	apPool->pRegion = (PBYTE)pRegion;
+	apPool->ulRegionSize = ulRegionSize;
+	apPool->uJobMask = uJobCnt - 1;
+	apPool->uWorkerCnt = auWorkerCnt;
+
+	for (UINT32 uIdx = 0; uIdx < auWorkerCnt; uIdx++)
+	{
+		RT_OFFLOAD_WORKER* pWorker = &apPool->stWorkers[uIdx];
+		pWorker->pPool = apPool;
+		pWorker->uIndex = uIdx;
+		pWorker->pJobs = (RT_OFFLOAD_JOB*)(apPool->pRegion + ulRingSize * uIdx);
+		for (UINT32 uSlot = 0; uSlot < uJobCnt; uSlot++)
+			pWorker->pJobs[uSlot].uSeq = uSlot;
+	}
+
+	for (UINT32 uIdx = 0; uIdx < auWorkerCnt; uIdx++)
+	{
+		RT_OFFLOAD_WORKER* pWorker = &apPool->stWorkers[uIdx];
+		snprintf(strWorker, sizeof(strWorker), "%s%u", astrName, uIdx);
+
+		nRet = create_nrt_task(&pWorker->stTask, (const PCHAR)strWorker, 0);
+		if (nRet == RET_SUCC)
+			nRet = start_task(&pWorker->stTask, &_offload_worker_proc, pWorker);
+		if (nRet != RET_SUCC)
+		{
+			DBG_ERROR("FAILED : Create RT OFFLOAD POOL: %s could not start worker %u", astrName, uIdx);
+			_stop_offload_workers(apPool, uIdx + 1);
+			unmap_locked_region(apPool->pRegion, apPool->ulRegionSize);
+			apPool->pRegion = NULL;
+			return nRet;
+		}
+	}
+
+	DBG_TRACE("SUCCESS: Create RT OFFLOAD POOL : name=%s, workers=%u, jobs=%u", astrName, auWorkerCnt, uJobCnt);
+	return RET_SUCC;
+}
+/*****************************************************************************/
+INT
+delete_rt_offload_pool(RT_OFFLOAD_POOL* apPool)
+{
+	if (apPool == NULL || apPool->pRegion == NULL)
+		return -EINVAL;
+
+	_stop_offload_workers(apPool, apPool->uWorkerCnt);
+	unmap_locked_region(apPool->pRegion, apPool->ulRegionSize);
+	apPool->pRegion = NULL;
+	apPool->uWorkerCnt = 0;
+	return RET_SUCC;
+}
+/*****************************************************************************/
+INT
+rt_offload_submit(RT_OFFLOAD_POOL* apPool, PTASKFCN apFcn, PVOID apArg)
+{
+	if (apPool == NULL || apPool->pRegion == NULL || apFcn == NULL)
+		return -EINVAL;
+	if (__atomic_load_n(&apPool->bStop, __ATOMIC_ACQUIRE))
+		return -EPIPE;
+
+	// counted before the push, a worker may take the job before this call returns
+	__atomic_add_fetch(&apPool->uDepth, 1, __ATOMIC_RELAXED);
+
+	// at most two attempts per ring, a lost race moves on to the next ring instead of retrying
+	UINT32 uStart = __atomic_fetch_add(&apPool->uNextWorker, 1, __ATOMIC_RELAXED);
+	for (UINT32 uTry = 0; uTry < 2 * apPool->uWorkerCnt; uTry++)
+	{
+		RT_OFFLOAD_WORKER* pWorker = &apPool->stWorkers[(uStart + uTry) % apPool->uWorkerCnt];
+		if (_push_job(apPool, pWorker, apFcn, apArg) == FALSE)
+			continue;
+
+		__atomic_add_fetch(&apPool->ullSubmitted, 1, __ATOMIC_RELAXED);
+		if (__atomic_load_n(&apPool->uSleepers, __ATOMIC_SEQ_CST) != 0)
+		{
+			__atomic_add_fetch(&apPool->uSignal, 1, __ATOMIC_SEQ_CST);
+			futex_wake(&apPool->uSignal, 1);
+		}
+		return RET_SUCC;
+	}
+
+	__atomic_sub_fetch(&apPool->uDepth, 1, __ATOMIC_RELAXED);
+	__atomic_add_fetch(&apPool->ullRejected, 1, __ATOMIC_RELAXED);
+	return -EAGAIN;
+}
+/*****************************************************************************/
+INT
+get_rt_offload_stats(RT_OFFLOAD_POOL* apPool, RT_OFFLOAD_STATS* apStats)
+{
+	if (apPool == NULL || apStats == NULL)
+		return -EINVAL;
+
+	ZERO_MEMORY(apStats, sizeof(RT_OFFLOAD_STATS));
+	for (UINT32 uIdx = 0; uIdx < apPool->uWorkerCnt; uIdx++)
+	{
+		apStats->ullExecuted += __atomic_load_n(&apPool->stWorkers[uIdx].ullExecuted, __ATOMIC_RELAXED);
+		apStats->ullStolen += __atomic_load_n(&apPool->stWorkers[uIdx].ullStolen, __ATOMIC_RELAXED);
+	}
+	apStats->ullSubmitted = __atomic_load_n(&apPool->ullSubmitted, __ATOMIC_RELAXED);
+	apStats->ullRejected = __atomic_load_n(&apPool->ullRejected, __ATOMIC_RELAXED);
+	apStats->uDepth = __atomic_load_n(&apPool->uDepth, __ATOMIC_RELAXED);
+	apStats->uDepthMax = __atomic_load_n(&apPool->uDepthMax, __ATOMIC_RELAXED);
+	apStats->ullLatencyLast = __atomic_load_n(&apPool->ullLatencyLast, __ATOMIC_RELAXED);
+	apStats->ullLatencyMax = __atomic_load_n(&apPool->ullLatencyMax, __ATOMIC_RELAXED);
+	if (apStats->ullExecuted > 0)
+		apStats->ullLatencyAvg = __atomic_load_n(&apPool->ullLatencySum, __ATOMIC_RELAXED) / apStats->ullExecuted;
+	return RET_SUCC;
+}
+/*****************************************************************************/
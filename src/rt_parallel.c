@@ -0,0 +1,254 @@
+/*
+ *  This file is owned by the Embedded Systems Laboratory of Seoul National University of Science and Technology
+ *  as a part of RT-AIDE or the RTOS-Agnostic and Interoperable Development Environment for Real-time Systems
+ *
+ *  File: rt_parallel.c
+ *  Author: 2022 Raimarius Delgado
+ *  Description: fork-join worker pool. The workers are spawned once, pinned and kept at SCHED_FIFO,
+ *				 a loop is handed over by bumping a generation word and the chunks are claimed with
+ *				 an atomic counter. Waiting spins for a bounded time and then sleeps on a futex.
+ *
+ *
+*/
+#include "rt_parallel.h"
+
+/*****************************************************************************/
+static inline VOID
+_atomic_max(RTTIME* apullValue, RTTIME aullNew)
+{
+	RTTIME ullCur = __atomic_load_n(apullValue, __ATOMIC_RELAXED);
+	while (aullNew > ullCur && !__atomic_compare_exchange_n(apullValue, &ullCur, aullNew, TRUE, __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+		;
+}
+/*****************************************************************************/
+static inline VOID
+_update_par_stat(RTTIME aullValue, RTTIME* apullLast, RTTIME* apullMax, RTTIME* apullSum)
+{
+	*apullLast = aullValue;
+	*apullSum += aullValue;
+	if (aullValue > *apullMax)
+		*apullMax = aullValue;
+}
+/*****************************************************************************/
+static VOID
+_run_chunks(RT_PAR_POOL* apPool)
+{
+	UINT32 uIdx;
+	while ((uIdx = __atomic_fetch_add(&apPool->uNextChunk, 1, __ATOMIC_RELAXED)) < apPool->uChunkCnt)
+	{
+		UINT32 uBegin = apPool->uBegin + uIdx * apPool->uChunk;
+		UINT32 uEnd = (apPool->uEnd - uBegin > apPool->uChunk) ? uBegin + apPool->uChunk : apPool->uEnd;
+		apPool->pFcn(uBegin, uEnd, apPool->pArg);
+	}
+}
+/*****************************************************************************/
+static UINT32
+_wait_generation(RT_PAR_POOL* apPool, UINT32 auSeen)
+{
+	UINT32 uGen;
+
+	if (apPool->ullSpinTime > 0)
+	{
+		RTTIME rttSpinEnd = read_timer() + apPool->ullSpinTime;
+		while ((uGen = __atomic_load_n(&apPool->uGeneration, __ATOMIC_ACQUIRE)) == auSeen)
+		{
+			if (read_timer() >= rttSpinEnd)
+				break;
+			cpu_relax();
+		}
+		if (uGen != auSeen)
+			return uGen;
+	}
+
+	// the caller wakes the futex only when it sees a sleeper, so announce before the last check
+	while (TRUE)
+	{
+		__atomic_add_fetch(&apPool->uSleepers, 1, __ATOMIC_SEQ_CST);
+		if (__atomic_load_n(&apPool->uGeneration, __ATOMIC_SEQ_CST) == auSeen)
+			futex_wait(&apPool->uGeneration, auSeen, TM_INFINITE);
+		__atomic_sub_fetch(&apPool->uSleepers, 1, __ATOMIC_SEQ_CST);
+
+		uGen = __atomic_load_n(&apPool->uGeneration, __ATOMIC_ACQUIRE);
+		if (uGen != auSeen)
+			return uGen;
+	}
+}
+/*****************************************************************************/
+static VOID
+_wait_join(RT_PAR_POOL* apPool)
+{
+	UINT32 uPending;
+
+	if (apPool->ullSpinTime > 0)
+	{
+		RTTIME rttSpinEnd = read_timer() + apPool->ullSpinTime;
+		while (__atomic_load_n(&apPool->uPending, __ATOMIC_ACQUIRE) != 0)
+		{
+			if (read_timer() >= rttSpinEnd)
+				break;
+			cpu_relax();
+		}
+	}
+
+	__atomic_store_n(&apPool->uJoinWaiting, 1, __ATOMIC_SEQ_CST);
+	while ((uPending = __atomic_load_n(&apPool->uPending, __ATOMIC_SEQ_CST)) != 0)
+		futex_wait(&apPool->uPending, uPending, TM_INFINITE);
+	__atomic_store_n(&apPool->uJoinWaiting, 0, __ATOMIC_RELAXED);
+}
+/*****************************************************************************/
+static VOID
+_par_worker_proc(PVOID apArg)
+{
+	RT_PAR_POOL* pPool = ((RT_PAR_WORKER*)apArg)->pPool;
+	UINT32 uSeen = 0;
+
+	while (TRUE)
+	{
+		uSeen = _wait_generation(pPool, uSeen);
+		if (__atomic_load_n(&pPool->bStop, __ATOMIC_ACQUIRE))
+			break;
+
+		_atomic_max(&pPool->rttLastWakeup, read_timer());
+		_run_chunks(pPool);
+		_atomic_max(&pPool->rttLastDone, read_timer());
+
+		if (__atomic_sub_fetch(&pPool->uPending, 1, __ATOMIC_SEQ_CST) == 0 &&
+			__atomic_load_n(&pPool->uJoinWaiting, __ATOMIC_SEQ_CST) != 0)
+			futex_wake(&pPool->uPending, 1);
+	}
+}
+/*****************************************************************************/
+static VOID
+_stop_par_workers(RT_PAR_POOL* apPool, UINT32 auWorkerCnt)
+{
+	__atomic_store_n(&apPool->bStop, TRUE, __ATOMIC_RELEASE);
+	__atomic_add_fetch(&apPool->uGeneration, 1, __ATOMIC_SEQ_CST);
+	futex_wake(&apPool->uGeneration, INT_MAX);
+
+	RTTIME rttTimeout = read_timer() + DEFAULT_PAR_STOP_TIMEOUT;
+	for (UINT32 uIdx = 0; uIdx < auWorkerCnt; uIdx++)
+	{
+		POSIX_TASK* pTask = &apPool->stWorkers[uIdx].stTask;
+		wait_task_end(pTask, rttTimeout);
+		delete_task(pTask);
+	}
+}
+/*****************************************************************************/
+INT
+create_rt_par_pool(RT_PAR_POOL* apPool, const PCHAR astrName, const INT* apnCpus, UINT32 auWorkerCnt, INT anPriority, RTTIME aullSpinTime)
+{
+	INT nRet = RET_SUCC;
+	CHAR strWorker[MAX_NAME_LENGTH];
+
+	if (apPool == NULL || astrName == NULL || apnCpus == NULL || auWorkerCnt == 0 || auWorkerCnt > LIM_PAR_WORKERS)
+	{
+		DBG_ERROR("FAILED : Create RT PAR POOL: invalid parameters");
+		return -EINVAL;
+	}
+	if (strlen(astrName) >= MAX_NAME_LENGTH - 2)
+	{
+		DBG_ERROR("FAILED : Create RT PAR POOL (Length of astrName should be less than %d)", (INT)MAX_NAME_LENGTH - 2);
+		return -EINVAL;
+	}
+
+	ZERO_MEMORY(apPool, sizeof(RT_PAR_POOL));
+	strcpy(apPool->strName, astrName);
+	apPool->uWorkerCnt = auWorkerCnt;
+	apPool->ullSpinTime = aullSpinTime;
+
+	for (UINT32 uIdx = 0; uIdx < auWorkerCnt; uIdx++)
+	{
+		RT_PAR_WORKER* pWorker = &apPool->stWorkers[uIdx];
+		pWorker->pPool = apPool;
+		snprintf(strWorker, sizeof(strWorker), "%s%u", astrName, uIdx);
+
+		nRet = create_rt_task(&pWorker->stTask, (const PCHAR)strWorker, 0, anPriority);
+		if (nRet == RET_SUCC && apnCpus[uIdx] >= 0)
+			nRet = set_cpu_affinity(&pWorker->stTask, apnCpus[uIdx]);
+		if (nRet == RET_SUCC)
+			nRet = start_task(&pWorker->stTask, &_par_worker_proc, pWorker);
+		if (nRet != RET_SUCC)
+		{
+			DBG_ERROR("FAILED : Create RT PAR POOL: %s could not start worker %u", astrName, uIdx);
+			_stop_par_workers(apPool, uIdx + 1);
+			return nRet;
+		}
+	}
+
+	DBG_TRACE("SUCCESS: Create RT PAR POOL : name=%s, workers=%u, prio=%d, spin=%llu", astrName, auWorkerCnt, anPriority, (unsigned long long)aullSpinTime);
+	return RET_SUCC;
+}
+/*****************************************************************************/
+INT
+delete_rt_par_pool(RT_PAR_POOL* apPool)
+{
+	if (apPool == NULL || apPool->uWorkerCnt == 0)
+		return -EINVAL;
+	if (__atomic_exchange_n(&apPool->bBusy, TRUE, __ATOMIC_ACQUIRE))
+		return -EBUSY;
+
+	_stop_par_workers(apPool, apPool->uWorkerCnt);
+	apPool->uWorkerCnt = 0;
+	return RET_SUCC;
+}
+/*****************************************************************************/
+INT
+get_rt_par_stats(RT_PAR_POOL* apPool, RT_PAR_STATS* apStats)
+{
+	if (apPool == NULL || apStats == NULL)
+		return -EINVAL;
+
+	// written only by the caller of rt_parallel_for(), read it from the same task for a consistent copy
+	memcpy(apStats, &apPool->stStats, sizeof(RT_PAR_STATS));
+	return RET_SUCC;
+}
+/*****************************************************************************/
+INT
+rt_parallel_for(RT_PAR_POOL* apPool, UINT32 auBegin, UINT32 auEnd, UINT32 auChunk, PPARFCN apFcn, PVOID apArg)
+{
+	if (apPool == NULL || apFcn == NULL || apPool->uWorkerCnt == 0)
+		return -EINVAL;
+	if (auEnd <= auBegin)
+		return RET_SUCC;
+	if (__atomic_exchange_n(&apPool->bBusy, TRUE, __ATOMIC_ACQUIRE))
+	{
+		DBG_ERROR("FAILED : RT Parallel For: %s is used by another task", apPool->strName);
+		return -EBUSY;
+	}
+
+	// by default one chunk for each worker and one for the caller
+	UINT32 uCount = auEnd - auBegin;
+	if (auChunk == 0)
+		auChunk = (uCount + apPool->uWorkerCnt) / (apPool->uWorkerCnt + 1);
+
+	apPool->pFcn = apFcn;
+	apPool->pArg = apArg;
+	apPool->uBegin = auBegin;
+	apPool->uEnd = auEnd;
+	apPool->uChunk = auChunk;
+	apPool->uChunkCnt = (UINT32)(((UINT64)uCount + auChunk - 1) / auChunk);
+	apPool->uNextChunk = 0;
+	apPool->uPending = apPool->uWorkerCnt;
+	apPool->rttLastWakeup = 0;
+	apPool->rttLastDone = 0;
+
+	RTTIME rttDispatch = read_timer();
+	__atomic_add_fetch(&apPool->uGeneration, 1, __ATOMIC_SEQ_CST);
+	if (__atomic_load_n(&apPool->uSleepers, __ATOMIC_SEQ_CST) != 0)
+		futex_wake(&apPool->uGeneration, INT_MAX);
+
+	_run_chunks(apPool);
+	_atomic_max(&apPool->rttLastDone, read_timer());
+	_wait_join(apPool);
+	RTTIME rttJoin = read_timer();
+
+	RT_PAR_STATS* pStats = &apPool->stStats;
+	pStats->ullCalls++;
+	_update_par_stat(apPool->rttLastWakeup - rttDispatch, &pStats->ullWakeupLast, &pStats->ullWakeupMax, &pStats->ullWakeupSum);
+	_update_par_stat(rttJoin - apPool->rttLastDone, &pStats->ullJoinLast, &pStats->ullJoinMax, &pStats->ullJoinSum);
+	_update_par_stat(rttJoin - rttDispatch, &pStats->ullSpanLast, &pStats->ullSpanMax, &pStats->ullSpanSum);
+
+	__atomic_store_n(&apPool->bBusy, FALSE, __ATOMIC_RELEASE);
+	return RET_SUCC;
+}
+/*****************************************************************************/
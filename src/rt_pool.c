@@ -0,0 +1,200 @@
+/*
+ *  This file is owned by the Embedded Systems Laboratory of Seoul National University of Science and Technology
+ *  as a part of RT-AIDE or the RTOS-Agnostic and Interoperable Development Environment for Real-time Systems
+ *
+ *  File: rt_pool.c
+ *  Author: 2022 Raimarius Delgado
+ *  Description: deterministic fixed-block memory pool. All block-size classes are carved out of one
+ *				 pre-faulted and locked region at startup, every class keeps a lock-free free list.
+ *
+ *
+ *
+*/
+#include "rt_pool.h"
+
+/*****************************************************************************/
+static inline UINT64
+_make_head(UINT64 aullTag, UINT32 auIndex)
+{
+	return (aullTag << 32) | (UINT64)auIndex;
+}
+/*****************************************************************************/
+static PVOID
+_pop_block(RT_POOL_CLASS* apClass)
+{
+	UINT64 ullHead = __atomic_load_n(&apClass->ullFreeHead, __ATOMIC_ACQUIRE);
+	UINT64 ullNew;
+	do
+	{
+		UINT32 uIndex = (UINT32)ullHead;
+		if (uIndex == RT_POOL_EMPTY)
+			return NULL;
+		// the tag changes on every update, so a stale link read here makes the CAS fail (no ABA)
+		UINT32 uNext = __atomic_load_n(&apClass->puNext[uIndex], __ATOMIC_RELAXED);
+		ullNew = _make_head((ullHead >> 32) + 1, uNext);
+	} while (!__atomic_compare_exchange_n(&apClass->ullFreeHead, &ullHead, ullNew, TRUE, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE));
+
+	UINT32 uIndex = (UINT32)ullHead;
+	UINT32 uInUse = __atomic_add_fetch(&apClass->uInUse, 1, __ATOMIC_RELAXED);
+	UINT32 uHighWater = __atomic_load_n(&apClass->uHighWater, __ATOMIC_RELAXED);
+	while (uInUse > uHighWater && !__atomic_compare_exchange_n(&apClass->uHighWater, &uHighWater, uInUse, TRUE, __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+		PASS;
+
+	return apClass->pBase + (size_t)uIndex * apClass->uBlockSize;
+}
+/*****************************************************************************/
+static void
+_push_block(RT_POOL_CLASS* apClass, UINT32 auIndex)
+{
+	UINT64 ullHead = __atomic_load_n(&apClass->ullFreeHead, __ATOMIC_RELAXED);
+	do
+	{
+		__atomic_store_n(&apClass->puNext[auIndex], (UINT32)ullHead, __ATOMIC_RELAXED);
+	} while (!__atomic_compare_exchange_n(&apClass->ullFreeHead, &ullHead, _make_head((ullHead >> 32) + 1, auIndex), TRUE, __ATOMIC_RELEASE, __ATOMIC_RELAXED));
+
+	__atomic_sub_fetch(&apClass->uInUse, 1, __ATOMIC_RELAXED);
+}
+/*****************************************************************************/
+INT
+create_rt_pool(RT_POOL* apPool, const PCHAR astrName, const UINT32* apuBlockSizes, const UINT32* apuBlockCnts, UINT32 auClassCnt)
+{
+	if (apPool == NULL || astrName == NULL || apuBlockSizes == NULL || apuBlockCnts == NULL || auClassCnt == 0 || auClassCnt > RT_POOL_MAX_CLASSES)
+	{
+		DBG_ERROR("FAILED : Create RT POOL: invalid parameters");
+		return -EINVAL;
+	}
+	if (strlen(astrName) >= MAX_NAME_LENGTH)
+	{
+		DBG_ERROR("FAILED : Create RT POOL (Length of astrName should be less than %d)", (INT)MAX_NAME_LENGTH);
+		return -EINVAL;
+	}
+
+	ZERO_MEMORY(apPool, sizeof(RT_POOL));
+	strcpy(apPool->strName, astrName);
+
+	// classes must be given from the smallest to the largest block, so the first fit is the best fit;
+	// the order is checked on the aligned sizes, two requests that round to the same block are one class
+	size_t ulRegionSize = 0;
+	for (UINT32 uClass = 0; uClass < auClassCnt; uClass++)
+	{
+		RT_POOL_CLASS* pClass = &apPool->stClasses[uClass];
+		pClass->uBlockSize = (UINT32)ROUND_UP(apuBlockSizes[uClass], RT_POOL_ALIGNMENT);
+		if (apuBlockSizes[uClass] == 0 || apuBlockCnts[uClass] == 0 || apuBlockCnts[uClass] >= RT_POOL_EMPTY ||
+			(uClass > 0 && pClass->uBlockSize <= apPool->stClasses[uClass - 1].uBlockSize))
+		{
+			DBG_ERROR("FAILED : Create RT POOL: %s class %u has an invalid size or count", astrName, uClass);
+			return -EINVAL;
+		}
+		pClass->uBlockCnt = apuBlockCnts[uClass];
+		ulRegionSize += ROUND_UP((size_t)pClass->uBlockSize * pClass->uBlockCnt, 64);
+		ulRegionSize += ROUND_UP((size_t)pClass->uBlockCnt * sizeof(UINT32), 64);
+	}
+	ulRegionSize = ROUND_UP(ulRegionSize, (size_t)sysconf(_SC_PAGESIZE));
+
+	// every page is pre-faulted so that no allocation ever touches a new page
+	PVOID pRegion = NULL;
+	INT nRet = map_locked_region(&pRegion, ulRegionSize, "Create RT POOL");
+	if (nRet != RET_SUCC)
+		return nRet;
+
+	apPool->pRegion = (PBYTE)pRegion;
+	apPool->ulRegionSize = ulRegionSize;
+	apPool->uClassCnt = auClassCnt;
+
+	PBYTE pCur = apPool->pRegion;
+	for (UINT32 uClass = 0; uClass < auClassCnt; uClass++)
+	{
+		RT_POOL_CLASS* pClass = &apPool->stClasses[uClass];
+		pClass->pBase = pCur;
+		pCur += ROUND_UP((size_t)pClass->uBlockSize * pClass->uBlockCnt, 64);
+		pClass->puNext = (UINT32*)pCur;
+		pCur += ROUND_UP((size_t)pClass->uBlockCnt * sizeof(UINT32), 64);
+
+		// chain all blocks: 0 -> 1 -> ... -> n-1 -> empty
+		for (UINT32 uIdx = 0; uIdx < pClass->uBlockCnt; uIdx++)
+			pClass->puNext[uIdx] = (uIdx + 1 < pClass->uBlockCnt) ? uIdx + 1 : RT_POOL_EMPTY;
+		pClass->ullFreeHead = _make_head(0, 0);
+	}
+
+	DBG_TRACE("SUCCESS: Create RT POOL : name=%s, classes=%u, bytes=%zu", apPool->strName, apPool->uClassCnt, apPool->ulRegionSize);
+	return RET_SUCC;
+}
+/*****************************************************************************/
+INT
+delete_rt_pool(RT_POOL* apPool)
+{
+	if (apPool == NULL || apPool->pRegion == NULL)
+		return -EINVAL;
+
+	unmap_locked_region(apPool->pRegion, apPool->ulRegionSize);
+	apPool->pRegion = NULL;
+	apPool->uClassCnt = 0;
+	return RET_SUCC;
+}
+/*****************************************************************************/
+PVOID
+rt_pool_alloc(RT_POOL* apPool, size_t aulSize)
+{
+	if (apPool == NULL || apPool->pRegion == NULL)
+		return NULL;
+
+	// first class that fits, larger classes serve as overflow when it is exhausted
+	RT_POOL_CLASS* pFirstFit = NULL;
+	for (UINT32 uClass = 0; uClass < apPool->uClassCnt; uClass++)
+	{
+		RT_POOL_CLASS* pClass = &apPool->stClasses[uClass];
+		if (pClass->uBlockSize < aulSize)
+			continue;
+		if (pFirstFit == NULL)
+			pFirstFit = pClass;
+
+		PVOID pBlock = _pop_block(pClass);
+		if (pBlock != NULL)
+			return pBlock;
+	}
+
+	if (pFirstFit != NULL)
+		__atomic_add_fetch(&pFirstFit->ullFailures, 1, __ATOMIC_RELAXED);
+	return NULL;
+}
+/*****************************************************************************/
+INT
+rt_pool_free(RT_POOL* apPool, PVOID apBlock)
+{
+	if (apPool == NULL || apPool->pRegion == NULL || apBlock == NULL)
+		return -EINVAL;
+
+	PBYTE pBlock = (PBYTE)apBlock;
+	for (UINT32 uClass = 0; uClass < apPool->uClassCnt; uClass++)
+	{
+		RT_POOL_CLASS* pClass = &apPool->stClasses[uClass];
+		if (pBlock < pClass->pBase || pBlock >= pClass->pBase + (size_t)pClass->uBlockSize * pClass->uBlockCnt)
+			continue;
+
+		size_t ulOffset = (size_t)(pBlock - pClass->pBase);
+		if (ulOffset % pClass->uBlockSize != 0)
+			return -EINVAL;
+
+		_push_block(pClass, (UINT32)(ulOffset / pClass->uBlockSize));
+		return RET_SUCC;
+	}
+
+	DBG_ERROR("FAILED : RT POOL Free: %p does not belong to %s", apBlock, apPool->strName);
+	return -EINVAL;
+}
+/*****************************************************************************/
+INT
+get_rt_pool_stats(RT_POOL* apPool, UINT32 auClass, RT_POOL_STATS* apStats)
+{
+	if (apPool == NULL || apStats == NULL || auClass >= apPool->uClassCnt)
+		return -EINVAL;
+
+	RT_POOL_CLASS* pClass = &apPool->stClasses[auClass];
+	apStats->uBlockSize = pClass->uBlockSize;
+	apStats->uBlockCnt = pClass->uBlockCnt;
+	apStats->uInUse = __atomic_load_n(&pClass->uInUse, __ATOMIC_RELAXED);
+	apStats->uHighWater = __atomic_load_n(&pClass->uHighWater, __ATOMIC_RELAXED);
+	apStats->ullFailures = __atomic_load_n(&pClass->ullFailures, __ATOMIC_RELAXED);
+	return RET_SUCC;
+}
+/*****************************************************************************/
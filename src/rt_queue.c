@@ -0,0 +1,186 @@
+/*
+ *  This file is owned by the Embedded Systems Laboratory of Seoul National University of Science and Technology
+ *  as a part of RT-AIDE or the RTOS-Agnostic and Interoperable Development Environment for Real-time Systems
+ *
+ *  File: rt_queue.c
+ *  Author: 2022 Raimarius Delgado
+ *  Description: lock-free single-producer/single-consumer message queue between POSIX tasks.
+ *				 Slots are preallocated and cache-line aligned, producers write into a reserved slot
+ *				 and consumers read from it directly, so no message is ever copied.
+ *
+ *
+*/
+#include "rt_queue.h"
+
+/*****************************************************************************/
+static inline PBYTE
+_get_slot(RT_QUEUE* apQueue, UINT32 auIndex)
+{
+	return apQueue->pBuffer + (size_t)(auIndex & (apQueue->uSlotCnt - 1)) * apQueue->uSlotSize;
+}
+/*****************************************************************************/
+INT
+create_rt_queue(RT_QUEUE* apQueue, const PCHAR astrName, UINT32 auMsgSize, UINT32 auMsgCnt)
+{
+	if (apQueue == NULL || astrName == NULL || auMsgSize == 0 || auMsgCnt == 0 || auMsgCnt > (1U << 31))
+	{
+		DBG_ERROR("FAILED : Create RT QUEUE: invalid parameters");
+		return -EINVAL;
+	}
+	if (strlen(astrName) >= MAX_NAME_LENGTH)
+	{
+		DBG_ERROR("FAILED : Create RT QUEUE (Length of astrName should be less than %d)", (INT)MAX_NAME_LENGTH);
+		return -EINVAL;
+	}
+
+	ZERO_MEMORY(apQueue, sizeof(RT_QUEUE));
+	strcpy(apQueue->strName, astrName);
+
+	// round the slot count up to a power of two so that indexes wrap with a mask
+	UINT32 uSlotCnt = 1;
+	while (uSlotCnt < auMsgCnt)
+		uSlotCnt <<= 1;
+
+	apQueue->uSlotCnt = uSlotCnt;
+	apQueue->uSlotSize = (RT_QUEUE_SLOT_HDR + auMsgSize + RT_CACHELINE_SIZE - 1) & ~(UINT32)(RT_CACHELINE_SIZE - 1);
+	apQueue->uMsgSize = apQueue->uSlotSize - RT_QUEUE_SLOT_HDR;
+
+	size_t ulBytes = (size_t)apQueue->uSlotCnt * apQueue->uSlotSize;
+	PVOID pBuffer = NULL;
+	INT nRet = posix_memalign(&pBuffer, RT_CACHELINE_SIZE, ulBytes);
+	if (nRet != RET_SUCC)
+	{
+		DBG_ERROR("FAILED : Create RT QUEUE (posix_memalign): %s with errno (%d:%s)", astrName, nRet, strerror(nRet));
+		return -nRet;
+	}
+
+	// touch and lock every slot now so that the RT path never page-faults
+	ZERO_MEMORY(pBuffer, ulBytes);
+	if (mlock(pBuffer, ulBytes) != 0)
+		DBG_WARN("WARNING : Create RT QUEUE (mlock): %s with errno (%d:%s)", astrName, errno, strerror(errno));
+
+	apQueue->pBuffer = (PBYTE)pBuffer;
+	DBG_TRACE("SUCCESS: Create RT QUEUE : name=%s, slots=%u, msgsize=%u", apQueue->strName, apQueue->uSlotCnt, apQueue->uMsgSize);
+	return RET_SUCC;
+}
+/*****************************************************************************/
+INT
+delete_rt_queue(RT_QUEUE* apQueue)
+{
+	if (apQueue == NULL || apQueue->pBuffer == NULL)
+		return -EINVAL;
+
+	munlock(apQueue->pBuffer, (size_t)apQueue->uSlotCnt * apQueue->uSlotSize);
+	free(apQueue->pBuffer);
+	apQueue->pBuffer = NULL;
+	return RET_SUCC;
+}
+/*****************************************************************************/
+UINT32
+get_rt_queue_count(RT_QUEUE* apQueue)
+{
+	if (apQueue == NULL || apQueue->pBuffer == NULL)
+		return 0;
+
+	UINT32 uHead = __atomic_load_n(&apQueue->uHead, __ATOMIC_ACQUIRE);
+	UINT32 uTail = __atomic_load_n(&apQueue->uTail, __ATOMIC_ACQUIRE);
+	return uHead - uTail;
+}
+/*****************************************************************************/
+INT
+rt_queue_reserve(RT_QUEUE* apQueue, PVOID* appMsg)
+{
+	if (apQueue == NULL || apQueue->pBuffer == NULL || appMsg == NULL)
+		return -EINVAL;
+
+	UINT32 uHead = apQueue->uHead;
+	UINT32 uTail = __atomic_load_n(&apQueue->uTail, __ATOMIC_ACQUIRE);
+	if (uHead - uTail >= apQueue->uSlotCnt)
+		return -EAGAIN;
+
+	apQueue->bReserved = TRUE;
+	*appMsg = _get_slot(apQueue, uHead) + RT_QUEUE_SLOT_HDR;
+	return RET_SUCC;
+}
+/*****************************************************************************/
+INT
+rt_queue_commit(RT_QUEUE* apQueue, UINT32 auSize)
+{
+	if (apQueue == NULL || apQueue->bReserved == FALSE || auSize > apQueue->uMsgSize)
+		return -EINVAL;
+
+	UINT32 uHead = apQueue->uHead;
+	*(UINT32*)_get_slot(apQueue, uHead) = auSize;
+	apQueue->bReserved = FALSE;
+
+	// publish the slot, then check for a sleeping consumer (pairs with the fence in rt_queue_timed_receive)
+	__atomic_store_n(&apQueue->uHead, uHead + 1, __ATOMIC_RELEASE);
+	__atomic_thread_fence(__ATOMIC_SEQ_CST);
+	if (__atomic_load_n(&apQueue->uWaiting, __ATOMIC_RELAXED) != 0)
+		futex_wake(&apQueue->uHead, 1);
+
+	return RET_SUCC;
+}
+/*****************************************************************************/
+INT
+rt_queue_receive(RT_QUEUE* apQueue, PVOID* appMsg, UINT32* apuSize)
+{
+	if (apQueue == NULL || apQueue->pBuffer == NULL || appMsg == NULL)
+		return -EINVAL;
+
+	UINT32 uTail = apQueue->uTail;
+	UINT32 uHead = __atomic_load_n(&apQueue->uHead, __ATOMIC_ACQUIRE);
+	if (uHead == uTail)
+		return -EAGAIN;
+
+	PBYTE pSlot = _get_slot(apQueue, uTail);
+	if (apuSize != NULL)
+		*apuSize = *(UINT32*)pSlot;
+	*appMsg = pSlot + RT_QUEUE_SLOT_HDR;
+	return RET_SUCC;
+}
+/*****************************************************************************/
+INT
+rt_queue_timed_receive(RT_QUEUE* apQueue, PVOID* appMsg, UINT32* apuSize, RTTIME aullAbsTimeout)
+{
+	INT nRet = rt_queue_receive(apQueue, appMsg, apuSize);
+	while (nRet == -EAGAIN)
+	{
+		UINT32 uEmpty = apQueue->uTail;
+
+		// announce that we are going to sleep, then re-check so that a commit in between is not lost
+		__atomic_store_n(&apQueue->uWaiting, 1, __ATOMIC_RELAXED);
+		__atomic_thread_fence(__ATOMIC_SEQ_CST);
+		if (__atomic_load_n(&apQueue->uHead, __ATOMIC_ACQUIRE) == uEmpty)
+		{
+			nRet = futex_wait(&apQueue->uHead, uEmpty, aullAbsTimeout);
+			if (nRet == -ETIMEDOUT)
+			{
+				__atomic_store_n(&apQueue->uWaiting, 0, __ATOMIC_RELAXED);
+				// a message may have arrived right at the deadline
+				nRet = rt_queue_receive(apQueue, appMsg, apuSize);
+				return (nRet == -EAGAIN) ? -ETIMEDOUT : nRet;
+			}
+		}
+		__atomic_store_n(&apQueue->uWaiting, 0, __ATOMIC_RELAXED);
+		nRet = rt_queue_receive(apQueue, appMsg, apuSize);
+		if (nRet == -EAGAIN && aullAbsTimeout != TM_INFINITE && read_timer() >= aullAbsTimeout)
+			return -ETIMEDOUT;
+	}
+	return nRet;
+}
+/*****************************************************************************/
+INT
+rt_queue_release(RT_QUEUE* apQueue)
+{
+	if (apQueue == NULL || apQueue->pBuffer == NULL)
+		return -EINVAL;
+
+	UINT32 uTail = apQueue->uTail;
+	if (__atomic_load_n(&apQueue->uHead, __ATOMIC_ACQUIRE) == uTail)
+		return -EAGAIN;
+
+	__atomic_store_n(&apQueue->uTail, uTail + 1, __ATOMIC_RELEASE);
+	return RET_SUCC;
+}
+/*****************************************************************************/
@@ -0,0 +1,357 @@
+/*
+ *  This file is owned by the Embedded Systems Laboratory of Seoul National University of Science and Technology
+ *  as a part of RT-AIDE or the RTOS-Agnostic and Interoperable Development Environment for Real-time Systems
+ *
+ *  File: rt_sched.c
+ *  Author: 2022 Raimarius Delgado
+ *  Description: rate/deadline-monotonic priority assignment and fixed-priority response-time analysis.
+ *				 Every CPU is analysed with the tasks allowed on it, which is exact for pinned tasks and
+ *				 pessimistic for tasks that may migrate. SCHED_DEADLINE tasks count as interference only.
+ *
+ *
+*/
+#include "rt_sched.h"
+
+/* what the analysis needs of a task, copied so that no lock is held while analysing */
+typedef struct _RTA_TASK
+{
+	POSIX_TASK*		pTask;
+	CHAR			strName[MAX_NAME_LENGTH];
+	INT				nSchedPolicy;
+	INT				nPriority;
+	RTTIME			ullWcet;
+	RTTIME			ullPeriod;
+	RTTIME			ullDeadline;
+	CPUSET			stCpus;
+} RTA_TASK;
+
+typedef struct _RTA_COLLECT
+{
+	RTA_TASK*		pSet;
+	INT				nCnt;
+	POSIX_TASK*		pSkip;
+} RTA_COLLECT;
+
+static INT g_nAdmission = eAdmitOff;
+
+/* the task sets are too large for the stack of a task, one analysis runs at a time */
+static pthread_mutex_t g_mtxAnalysis = PTHREAD_MUTEX_INITIALIZER;
+static RTA_TASK g_stRtaSet[LIM_TASK_REGISTRY + 1];
+static RT_RTA_RESULT g_stRtaResults[LIM_TASK_REGISTRY + 1];
+
+/*****************************************************************************/
+INT
+set_task_wcet(POSIX_TASK* apTask, RTTIME aullWcet, RTTIME aullDeadline)
+{
+	POSIX_TASK* pTask = (apTask != NULL) ? apTask : get_self();
+	if (pTask == NULL)
+		return -EPERM;
+
+	// the analysis assumes constrained deadlines, a job must finish before the next release
+	if (pTask->ullPeriod > 0 && aullDeadline > pTask->ullPeriod)
+	{
+		DBG_ERROR("FAILED : Set Task WCET: %s deadline %llu is beyond the period %llu", pTask->strName,
+			(unsigned long long)aullDeadline, (unsigned long long)pTask->ullPeriod);
+		return -EINVAL;
+	}
+
+	pTask->ullWcet = aullWcet;
+	pTask->ullRelDeadline = aullDeadline;
+	DBG_TRACE("SUCCESS: Set Task WCET: taskname=%s, wcet=%llu, deadline=%llu", pTask->strName,
+		(unsigned long long)aullWcet, (unsigned long long)aullDeadline);
+	return RET_SUCC;
+}
+/*****************************************************************************/
+RTTIME
+get_task_wcet(POSIX_TASK* apTask)
+{
+	POSIX_TASK* pTask = (apTask != NULL) ? apTask : get_self();
+	if (pTask == NULL)
+		return 0;
+
+	// a declared WCET wins, the measured one includes preemptions and only covers what has run so far
+	if (pTask->ullWcet > 0)
+		return pTask->ullWcet;
+	if (pTask->stExecTime.ullCount > 0)
+		return pTask->stExecTime.ullMax;
+	return 0;
+}
+/*****************************************************************************/
+static void
+_fill_rta_task(POSIX_TASK* apTask, RTA_TASK* apRta)
+{
+	apRta->pTask = apTask;
+	memcpy(apRta->strName, apTask->strName, sizeof(apRta->strName));
+	apRta->nSchedPolicy = apTask->nSchedPolicy;
+	apRta->nPriority = apTask->nPriority;
+	apRta->ullPeriod = apTask->ullPeriod;
+	apRta->stCpus = apTask->stCpuAffinity;
+
+	if (apTask->nSchedPolicy == SCHED_DEADLINE)
+	{
+		// the CBS never lets the task run longer than its reservation
+		apRta->ullWcet = apTask->ullDlRuntime;
+		apRta->ullDeadline = apTask->ullDlDeadline;
+	}
+	else
+	{
+		apRta->ullWcet = get_task_wcet(apTask);
+		apRta->ullDeadline = apTask->ullRelDeadline;
+	}
+
+	if (apRta->ullDeadline == 0 || apRta->ullDeadline > apRta->ullPeriod)
+		apRta->ullDeadline = apRta->ullPeriod;
+}
+/*****************************************************************************/
+static BOOL
+_is_analysable(RTA_TASK* apRta)
+{
+	if (apRta->ullPeriod == 0 || apRta->ullWcet == 0)
+		return FALSE;
+	return (apRta->nSchedPolicy == SCHED_FIFO || apRta->nSchedPolicy == SCHED_DEADLINE) ? TRUE : FALSE;
+}
+/*****************************************************************************/
+static BOOL
+_interferes(RTA_TASK* apSet, INT anTask, INT anOther, INT anCpu)
+{
+	if (anOther == anTask || _is_analysable(&apSet[anOther]) == FALSE || !CPU_ISSET((size_t)anCpu, &apSet[anOther].stCpus))
+		return FALSE;
+
+	// SCHED_DEADLINE runs before every FIFO task, equal FIFO priorities are counted as higher (their order is unknown)
+	if (apSet[anOther].nSchedPolicy == SCHED_DEADLINE)
+		return TRUE;
+	return (apSet[anOther].nPriority >= apSet[anTask].nPriority) ? TRUE : FALSE;
+}
+/*****************************************************************************/
+static RTTIME
+_response_time(RTA_TASK* apSet, INT anCnt, INT anTask, INT anCpu)
+{
+	RTA_TASK* pTask = &apSet[anTask];
+
+	// R = C + sum(ceil(R / Tj) * Cj) over the interfering tasks, from one job of each up to the fixed point
+	RTTIME ullResponse = pTask->ullWcet;
+	for (INT nIdx = 0; nIdx < anCnt; nIdx++)
+	{
+		if (_interferes(apSet, anTask, nIdx, anCpu) == TRUE)
+			ullResponse += apSet[nIdx].ullWcet;
+	}
+
+	while (ullResponse <= pTask->ullDeadline)
+	{
+		RTTIME ullNext = pTask->ullWcet;
+		for (INT nIdx = 0; nIdx < anCnt; nIdx++)
+		{
+			if (_interferes(apSet, anTask, nIdx, anCpu) == TRUE)
+				ullNext += ((ullResponse + apSet[nIdx].ullPeriod - 1) / apSet[nIdx].ullPeriod) * apSet[nIdx].ullWcet;
+		}
+		if (ullNext == ullResponse)
+			break;
+		ullResponse = ullNext;
+	}
+	return ullResponse;
+}
+/*****************************************************************************/
+static INT
+_analyze(RTA_TASK* apSet, INT anCnt, RT_RTA_RESULT* apResults)
+{
+	INT nFailed = 0;
+	INT nCpus = get_available_cpus();
+
+	for (INT nTask = 0; nTask < anCnt; nTask++)
+	{
+		RT_RTA_RESULT* pResult = &apResults[nTask];
+		pResult->pTask = apSet[nTask].pTask;
+		pResult->nCpu = -1;
+		pResult->ullWcet = apSet[nTask].ullWcet;
+		pResult->ullDeadline = apSet[nTask].ullDeadline;
+		pResult->ullResponse = 0;
+		pResult->bSchedulable = TRUE;
+
+		// the kernel already runs its own admission test for SCHED_DEADLINE
+		if (_is_analysable(&apSet[nTask]) == FALSE || apSet[nTask].nSchedPolicy != SCHED_FIFO)
+			continue;
+
+		for (INT nCpu = 0; nCpu < nCpus; nCpu++)
+		{
+			if (!CPU_ISSET((size_t)nCpu, &apSet[nTask].stCpus))
+				continue;
+
+			RTTIME ullResponse = _response_time(apSet, anCnt, nTask, nCpu);
+			if (pResult->nCpu < 0 || ullResponse > pResult->ullResponse)
+			{
+				pResult->nCpu = nCpu;
+				pResult->ullResponse = ullResponse;
+			}
+		}
+
+		if (pResult->ullResponse > pResult->ullDeadline)
+		{
+			pResult->bSchedulable = FALSE;
+			nFailed++;
+		}
+	}
+	return nFailed;
+}
+/*****************************************************************************/
+INT
+analyze_task_set(POSIX_TASK** appTasks, INT anTaskCnt, RT_RTA_RESULT* apResults)
+{
+	if (appTasks == NULL || anTaskCnt <= 0 || anTaskCnt > LIM_TASK_REGISTRY)
+		return -EINVAL;
+
+	pthread_mutex_lock(&g_mtxAnalysis);
+	for (INT nIdx = 0; nIdx < anTaskCnt; nIdx++)
+	{
+		if (appTasks[nIdx] == NULL)
+		{
+			pthread_mutex_unlock(&g_mtxAnalysis);
+			return -EINVAL;
+		}
+		_fill_rta_task(appTasks[nIdx], &g_stRtaSet[nIdx]);
+		if (g_stRtaSet[nIdx].nSchedPolicy == SCHED_FIFO && g_stRtaSet[nIdx].ullPeriod > 0 && g_stRtaSet[nIdx].ullWcet == 0)
+			DBG_WARN("WARNING : Analyze Task Set: %s has neither a declared nor a measured WCET, it is left out", appTasks[nIdx]->strName);
+	}
+
+	RT_RTA_RESULT* pResults = (apResults != NULL) ? apResults : g_stRtaResults;
+	INT nFailed = _analyze(g_stRtaSet, anTaskCnt, pResults);
+	for (INT nIdx = 0; nIdx < anTaskCnt; nIdx++)
+	{
+		if (pResults[nIdx].bSchedulable == FALSE)
+			DBG_WARN("WARNING : Analyze Task Set: %s misses its deadline on CPU%d (response=%llu, deadline=%llu)", appTasks[nIdx]->strName,
+				pResults[nIdx].nCpu, (unsigned long long)pResults[nIdx].ullResponse, (unsigned long long)pResults[nIdx].ullDeadline);
+	}
+	pthread_mutex_unlock(&g_mtxAnalysis);
+
+	return (nFailed == 0) ? RET_SUCC : -EBUSY;
+}
+/*****************************************************************************/
+INT
+assign_task_priorities(POSIX_TASK** appTasks, INT anTaskCnt, INT anOrder, INT anPrioHi)
+{
+	INT nRank[LIM_TASK_REGISTRY];
+	RTTIME ullKeys[LIM_TASK_REGISTRY];
+
+	if (appTasks == NULL || anTaskCnt <= 0 || anTaskCnt > LIM_TASK_REGISTRY ||
+		(anOrder != eOrderRateMonotonic && anOrder != eOrderDeadlineMonotonic) ||
+		anPrioHi <= (INT)LIM_PRIORITY_LO || anPrioHi > (INT)LIM_PRIORITY_HI)
+	{
+		DBG_ERROR("FAILED : Assign Task Priorities: invalid parameters");
+		return -EINVAL;
+	}
+
+	// check everything first, a half-assigned task set is worse than none
+	for (INT nIdx = 0; nIdx < anTaskCnt; nIdx++)
+	{
+		if (appTasks[nIdx] == NULL || appTasks[nIdx]->nSchedPolicy != SCHED_FIFO || appTasks[nIdx]->ullPeriod == 0)
+		{
+			DBG_ERROR("FAILED : Assign Task Priorities: task %d is not a periodic SCHED_FIFO task", nIdx);
+			return -EINVAL;
+		}
+	}
+
+	// stable insertion sort by period (or deadline), the shortest first
+	for (INT nIdx = 0; nIdx < anTaskCnt; nIdx++)
+	{
+		RTA_TASK stRta;
+		_fill_rta_task(appTasks[nIdx], &stRta);
+		ullKeys[nIdx] = (anOrder == eOrderDeadlineMonotonic) ? stRta.ullDeadline : stRta.ullPeriod;
+
+		INT nPos = nIdx;
+		while (nPos > 0 && ullKeys[nRank[nPos - 1]] > ullKeys[nIdx])
+		{
+			nRank[nPos] = nRank[nPos - 1];
+			nPos--;
+		}
+		nRank[nPos] = nIdx;
+	}
+
+	// tasks with the same period (or deadline) share a priority level
+	INT nPriority = anPrioHi;
+	for (INT nPos = 0; nPos < anTaskCnt; nPos++)
+	{
+		POSIX_TASK* pTask = appTasks[nRank[nPos]];
+		if (nPos > 0 && ullKeys[nRank[nPos]] != ullKeys[nRank[nPos - 1]])
+		{
+			if (nPriority > (INT)LIM_PRIORITY_LO + 1)
+				nPriority--;
+			else
+				DBG_WARN("WARNING : Assign Task Priorities: out of priority levels, %s shares priority %d", pTask->strName, nPriority);
+		}
+
+		INT nRet = set_task_priority(pTask, nPriority);
+		if (nRet != RET_SUCC)
+			return nRet;
+	}
+
+	DBG_TRACE("SUCCESS: Assign Task Priorities: tasks=%d, order=%d, priorities=%d~%d", anTaskCnt, anOrder, nPriority, anPrioHi);
+	return RET_SUCC;
+}
+/*****************************************************************************/
+INT
+set_admission_control(INT anMode)
+{
+	if (anMode != eAdmitOff && anMode != eAdmitWarn && anMode != eAdmitReject)
+	{
+		DBG_ERROR("FAILED : Set Admission Control: unknown mode %d", anMode);
+		return -EINVAL;
+	}
+
+	__atomic_store_n(&g_nAdmission, anMode, __ATOMIC_RELEASE);
+	return RET_SUCC;
+}
+/*****************************************************************************/
+static INT
+_collect_started_task(POSIX_TASK* apTask, PVOID apArg)
+{
+	RTA_COLLECT* pCollect = (RTA_COLLECT*)apArg;
+
+	// the registry lists started tasks only, a periodic task between two cycles is in eReady and still competes
+	if (apTask == pCollect->pSkip || apTask->dwStatus >= eDead)
+		return RET_SUCC;
+
+	RTA_TASK* pRta = &pCollect->pSet[pCollect->nCnt];
+	_fill_rta_task(apTask, pRta);
+	if (_is_analysable(pRta) == TRUE)
+		pCollect->nCnt++;
+	return RET_SUCC;
+}
+/*****************************************************************************/
+INT
+admit_task(POSIX_TASK* apTask)
+{
+	INT nMode = __atomic_load_n(&g_nAdmission, __ATOMIC_ACQUIRE);
+	if (nMode == eAdmitOff || apTask == NULL)
+		return RET_SUCC;
+
+	RTA_TASK stNew;
+	_fill_rta_task(apTask, &stNew);
+	if (_is_analysable(&stNew) == FALSE || stNew.nSchedPolicy != SCHED_FIFO)
+		return RET_SUCC;
+
+	pthread_mutex_lock(&g_mtxAnalysis);
+	RTA_COLLECT stCollect = { .pSet = g_stRtaSet, .nCnt = 1, .pSkip = apTask };
+	g_stRtaSet[0] = stNew;
+	for_each_task(&_collect_started_task, &stCollect);
+	_analyze(g_stRtaSet, stCollect.nCnt, g_stRtaResults);
+
+	// only the CPUs of the new task can have become unschedulable because of it
+	INT nFailed = 0;
+	for (INT nIdx = 0; nIdx < stCollect.nCnt; nIdx++)
+	{
+		RT_RTA_RESULT* pResult = &g_stRtaResults[nIdx];
+		if (pResult->bSchedulable == TRUE || !CPU_ISSET((size_t)pResult->nCpu, &stNew.stCpus))
+			continue;
+
+		nFailed++;
+		if (nMode == eAdmitReject)
+			DBG_ERROR("FAILED : Admit Task: starting %s makes %s miss its deadline on CPU%d (response=%llu, deadline=%llu)", apTask->strName,
+				g_stRtaSet[nIdx].strName, pResult->nCpu, (unsigned long long)pResult->ullResponse, (unsigned long long)pResult->ullDeadline);
+		else
+			DBG_WARN("WARNING : Admit Task: starting %s makes %s miss its deadline on CPU%d (response=%llu, deadline=%llu)", apTask->strName,
+				g_stRtaSet[nIdx].strName, pResult->nCpu, (unsigned long long)pResult->ullResponse, (unsigned long long)pResult->ullDeadline);
+	}
+	pthread_mutex_unlock(&g_mtxAnalysis);
+
+	return (nFailed > 0 && nMode == eAdmitReject) ? -EBUSY : RET_SUCC;
+}
+/*****************************************************************************/
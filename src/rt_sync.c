@@ -0,0 +1,321 @@
+/*
+ *  This file is owned by the Embedded Systems Laboratory of Seoul National University of Science and Technology
+ *  as a part of RT-AIDE or the RTOS-Agnostic and Interoperable Development Environment for Real-time Systems
+ *
+ *  File: rt_sync.c
+ *  Author: 2022 Raimarius Delgado
+ *  Description: RT synchronization primitives. Every object is a single futex word that is taken and
+ *				 released with atomics, the kernel is entered only to sleep or to wake a sleeper.
+ *				 The mutex is a PI futex so that the kernel boosts its owner while RT tasks wait for it.
+ *
+ *
+*/
+#include "rt_sync.h"
+#include <linux/futex.h>
+
+#ifndef FUTEX_LOCK_PI2
+#define FUTEX_LOCK_PI2	(13)
+#endif
+
+static BOOL g_bNoLockPi2 = FALSE;			// kernel older than 5.14, timed locks go through CLOCK_REALTIME
+
+/*****************************************************************************/
+static INT
+_futex_lock_pi(UINT32* apuWord, RTTIME aullAbsTimeout)
+{
+	TIMESPEC stTimeout;
+	TIMESPEC* pTimeout = NULL;
+
+	if (__atomic_load_n(&g_bNoLockPi2, __ATOMIC_RELAXED) == FALSE)
+	{
+		if (aullAbsTimeout != TM_INFINITE)
+		{
+			convert_nsecs_to_timespec(aullAbsTimeout, &stTimeout);
+			pTimeout = &stTimeout;
+		}
+		// FUTEX_LOCK_PI2 takes an absolute timeout on CLOCK_MONOTONIC, same as read_timer()
+		if (syscall(SYS_futex, apuWord, FUTEX_LOCK_PI2 | FUTEX_PRIVATE_FLAG, 0, pTimeout, NULL, 0) == 0)
+			return RET_SUCC;
+		if (errno != ENOSYS)
+			return -errno;
+		__atomic_store_n(&g_bNoLockPi2, TRUE, __ATOMIC_RELAXED);
+	}
+
+	// FUTEX_LOCK_PI only knows absolute CLOCK_REALTIME timeouts, move the deadline over
+	if (aullAbsTimeout != TM_INFINITE)
+	{
+		RTTIME rttNow = read_timer();
+		UINT64 ullRealtime;
+		clock_gettime(CLOCK_REALTIME, &stTimeout);
+		convert_timespec_to_nsecs(stTimeout, &ullRealtime);
+		convert_nsecs_to_timespec(ullRealtime + ((aullAbsTimeout > rttNow) ? aullAbsTimeout - rttNow : 0), &stTimeout);
+		pTimeout = &stTimeout;
+	}
+	if (syscall(SYS_futex, apuWord, FUTEX_LOCK_PI | FUTEX_PRIVATE_FLAG, 0, pTimeout, NULL, 0) == 0)
+		return RET_SUCC;
+
+	return -errno;
+}
+/*****************************************************************************/
+INT
+create_rt_mutex(RT_MUTEX* apMutex)
+{
+	if (apMutex == NULL)
+		return -EINVAL;
+
+	__atomic_store_n(&apMutex->uOwner, 0, __ATOMIC_RELEASE);
+	return RET_SUCC;
+}
+/*****************************************************************************/
+INT
+delete_rt_mutex(RT_MUTEX* apMutex)
+{
+	if (apMutex == NULL)
+		return -EINVAL;
+
+	if (__atomic_load_n(&apMutex->uOwner, __ATOMIC_ACQUIRE) != 0)
+	{
+		DBG_ERROR("FAILED : Delete RT MUTEX: still owned by TID %u", apMutex->uOwner & FUTEX_TID_MASK);
+		return -EBUSY;
+	}
+	return RET_SUCC;
+}
+/*****************************************************************************/
+INT
+rt_mutex_trylock(RT_MUTEX* apMutex)
+{
+	if (apMutex == NULL)
+		return -EINVAL;
+
+	UINT32 uTid = (UINT32)get_cached_tid();
+	UINT32 uFree = 0;
+	if (__atomic_compare_exchange_n(&apMutex->uOwner, &uFree, uTid, FALSE, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED))
+		return RET_SUCC;
+
+	return ((uFree & FUTEX_TID_MASK) == uTid) ? -EDEADLK : -EBUSY;
+}
+/*****************************************************************************/
+INT
+rt_mutex_timed_lock(RT_MUTEX* apMutex, RTTIME aullAbsTimeout)
+{
+	INT nRet = rt_mutex_trylock(apMutex);
+	if (nRet != -EBUSY)
+		return nRet;
+
+	// contended: the kernel queues us by priority and lends our priority to the owner
+	do
+	{
+		nRet = _futex_lock_pi(&apMutex->uOwner, aullAbsTimeout);
+	} while (nRet == -EINTR);
+
+	return nRet;
+}
+/*****************************************************************************/
+INT
+rt_mutex_lock(RT_MUTEX* apMutex)
+{
+	return rt_mutex_timed_lock(apMutex, TM_INFINITE);
+}
+/*****************************************************************************/
+INT
+rt_mutex_unlock(RT_MUTEX* apMutex)
+{
+	if (apMutex == NULL)
+		return -EINVAL;
+
+	UINT32 uTid = (UINT32)get_cached_tid();
+	UINT32 uOwner = uTid;
+	if (__atomic_compare_exchange_n(&apMutex->uOwner, &uOwner, 0, FALSE, __ATOMIC_RELEASE, __ATOMIC_RELAXED))
+		return RET_SUCC;
+
+	if ((uOwner & FUTEX_TID_MASK) != uTid)
+		return -EPERM;
+
+	// FUTEX_WAITERS is set, the kernel hands the lock to the highest priority waiter
+	if (syscall(SYS_futex, &apMutex->uOwner, FUTEX_UNLOCK_PI | FUTEX_PRIVATE_FLAG, 0, NULL, NULL, 0) != 0)
+		return -errno;
+
+	return RET_SUCC;
+}
+/*****************************************************************************/
+INT
+create_rt_sem(RT_SEM* apSem, UINT32 auInitial)
+{
+	if (apSem == NULL)
+		return -EINVAL;
+
+	apSem->uWaiters = 0;
+	__atomic_store_n(&apSem->uCount, auInitial, __ATOMIC_RELEASE);
+	return RET_SUCC;
+}
+/*****************************************************************************/
+INT
+delete_rt_sem(RT_SEM* apSem)
+{
+	if (apSem == NULL)
+		return -EINVAL;
+
+	return (__atomic_load_n(&apSem->uWaiters, __ATOMIC_ACQUIRE) != 0) ? -EBUSY : RET_SUCC;
+}
+/*****************************************************************************/
+UINT32
+get_rt_sem_count(RT_SEM* apSem)
+{
+	if (apSem == NULL)
+		return 0;
+
+	return __atomic_load_n(&apSem->uCount, __ATOMIC_ACQUIRE);
+}
+/*****************************************************************************/
+INT
+rt_sem_post(RT_SEM* apSem)
+{
+	if (apSem == NULL)
+		return -EINVAL;
+
+	UINT32 uCount = __atomic_load_n(&apSem->uCount, __ATOMIC_RELAXED);
+	do
+	{
+		if (uCount == UINT32_MAX)
+			return -EOVERFLOW;
+	} while (!__atomic_compare_exchange_n(&apSem->uCount, &uCount, uCount + 1, TRUE, __ATOMIC_SEQ_CST, __ATOMIC_RELAXED));
+
+	// pairs with the increment of uWaiters before the futex_wait() in rt_sem_timed_wait()
+	if (__atomic_load_n(&apSem->uWaiters, __ATOMIC_SEQ_CST) != 0)
+		futex_wake(&apSem->uCount, 1);
+
+	return RET_SUCC;
+}
+/*****************************************************************************/
+INT
+rt_sem_trywait(RT_SEM* apSem)
+{
+	if (apSem == NULL)
+		return -EINVAL;
+
+	UINT32 uCount = __atomic_load_n(&apSem->uCount, __ATOMIC_RELAXED);
+	while (uCount > 0)
+	{
+		if (__atomic_compare_exchange_n(&apSem->uCount, &uCount, uCount - 1, TRUE, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED))
+			return RET_SUCC;
+	}
+	return -EAGAIN;
+}
+/*****************************************************************************/
+INT
+rt_sem_timed_wait(RT_SEM* apSem, RTTIME aullAbsTimeout)
+{
+	INT nRet = rt_sem_trywait(apSem);
+	while (nRet == -EAGAIN)
+	{
+		if (aullAbsTimeout != TM_INFINITE && read_timer() >= aullAbsTimeout)
+			return -ETIMEDOUT;
+
+		// the kernel sleeps only while the count is still 0, a post in between is not lost
+		__atomic_add_fetch(&apSem->uWaiters, 1, __ATOMIC_SEQ_CST);
+		futex_wait(&apSem->uCount, 0, aullAbsTimeout);
+		__atomic_sub_fetch(&apSem->uWaiters, 1, __ATOMIC_RELAXED);
+
+		nRet = rt_sem_trywait(apSem);
+	}
+	return nRet;
+}
+/*****************************************************************************/
+INT
+rt_sem_wait(RT_SEM* apSem)
+{
+	return rt_sem_timed_wait(apSem, TM_INFINITE);
+}
+/*****************************************************************************/
+INT
+create_rt_event(RT_EVENT* apEvent, UINT32 auInitial)
+{
+	if (apEvent == NULL)
+		return -EINVAL;
+
+	apEvent->uWaiters = 0;
+	__atomic_store_n(&apEvent->uFlags, auInitial, __ATOMIC_RELEASE);
+	return RET_SUCC;
+}
+/*****************************************************************************/
+INT
+delete_rt_event(RT_EVENT* apEvent)
+{
+	if (apEvent == NULL)
+		return -EINVAL;
+
+	return (__atomic_load_n(&apEvent->uWaiters, __ATOMIC_ACQUIRE) != 0) ? -EBUSY : RET_SUCC;
+}
+/*****************************************************************************/
+UINT32
+get_rt_event_flags(RT_EVENT* apEvent)
+{
+	if (apEvent == NULL)
+		return 0;
+
+	return __atomic_load_n(&apEvent->uFlags, __ATOMIC_ACQUIRE);
+}
+/*****************************************************************************/
+INT
+rt_event_set(RT_EVENT* apEvent, UINT32 auMask)
+{
+	if (apEvent == NULL)
+		return -EINVAL;
+
+	__atomic_or_fetch(&apEvent->uFlags, auMask, __ATOMIC_SEQ_CST);
+
+	// every waiter has its own mask, wake them all and let each one re-check
+	if (__atomic_load_n(&apEvent->uWaiters, __ATOMIC_SEQ_CST) != 0)
+		futex_wake(&apEvent->uFlags, INT_MAX);
+
+	return RET_SUCC;
+}
+/*****************************************************************************/
+INT
+rt_event_clear(RT_EVENT* apEvent, UINT32 auMask)
+{
+	if (apEvent == NULL)
+		return -EINVAL;
+
+	__atomic_and_fetch(&apEvent->uFlags, ~auMask, __ATOMIC_RELEASE);
+	return RET_SUCC;
+}
+/*****************************************************************************/
+INT
+rt_event_timed_wait(RT_EVENT* apEvent, UINT32 auMask, INT anMode, UINT32* apuFlags, RTTIME aullAbsTimeout)
+{
+	if (apEvent == NULL || auMask == 0 || (anMode & ~(eEventAll | eEventConsume)) != 0)
+		return -EINVAL;
+
+	UINT32 uFlags = __atomic_load_n(&apEvent->uFlags, __ATOMIC_ACQUIRE);
+	while (TRUE)
+	{
+		BOOL bReady = (anMode & eEventAll) ? ((uFlags & auMask) == auMask) : ((uFlags & auMask) != 0);
+		if (bReady == TRUE)
+		{
+			// consuming waiters race for the bits, only one of them gets each set
+			if ((anMode & eEventConsume) &&
+				!__atomic_compare_exchange_n(&apEvent->uFlags, &uFlags, uFlags & ~auMask, FALSE, __ATOMIC_ACQUIRE, __ATOMIC_ACQUIRE))
+				continue;
+			if (apuFlags != NULL)
+				*apuFlags = uFlags;
+			return RET_SUCC;
+		}
+
+		if (aullAbsTimeout != TM_INFINITE && read_timer() >= aullAbsTimeout)
+			return -ETIMEDOUT;
+
+		__atomic_add_fetch(&apEvent->uWaiters, 1, __ATOMIC_SEQ_CST);
+		futex_wait(&apEvent->uFlags, uFlags, aullAbsTimeout);
+		__atomic_sub_fetch(&apEvent->uWaiters, 1, __ATOMIC_RELAXED);
+
+		uFlags = __atomic_load_n(&apEvent->uFlags, __ATOMIC_ACQUIRE);
+	}
+}
+/*****************************************************************************/
+INT
+rt_event_wait(RT_EVENT* apEvent, UINT32 auMask, INT anMode, UINT32* apuFlags)
+{
+	return rt_event_timed_wait(apEvent, auMask, anMode, apuFlags, TM_INFINITE);
+}
+/*****************************************************************************/
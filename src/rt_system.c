@@ -0,0 +1,406 @@
+/*
+ *  This file is owned by the Embedded Systems Laboratory of Seoul National University of Science and Technology
+ *  as a part of RT-AIDE or the RTOS-Agnostic and Interoperable Development Environment for Real-time Systems
+ *
+ *  File: rt_system.c
+ *  Author: 2022 Raimarius Delgado
+ *  Description: process setup for RT and checks of the kernel and CPU settings. Every step records its
+ *				 own outcome, some of them need privileges that a process does not always have.
+ *
+ *
+*/
+#include "rt_system.h"
+
+#include <fcntl.h>
+#include <sys/prctl.h>
+#include <sys/utsname.h>
+
+#define SYS_CPU_DMA_LATENCY		"/dev/cpu_dma_latency"
+#define SYS_CPU_ISOLATED		"/sys/devices/system/cpu/isolated"
+#define SYS_CPU_NOHZ_FULL		"/sys/devices/system/cpu/nohz_full"
+#define SYS_CPU_GOVERNOR		"/sys/devices/system/cpu/cpu%d/cpufreq/scaling_governor"
+#define SYS_RT_RUNTIME			"/proc/sys/kernel/sched_rt_runtime_us"
+#define SYS_RT_PERIOD			"/proc/sys/kernel/sched_rt_period_us"
+#define SYS_REALTIME			"/sys/kernel/realtime"
+#define SYS_THP_ENABLED			"/sys/kernel/mm/transparent_hugepage/enabled"
+#define SYS_TIMER_MIGRATION		"/proc/sys/kernel/timer_migration"
+#define SYS_CMDLINE				"/proc/cmdline"
+
+// the kernel keeps the request only while the file stays open
+static INT g_nDmaLatencyFd = -1;
+static pthread_mutex_t g_mtxSystem = PTHREAD_MUTEX_INITIALIZER;
+
+static const PCHAR g_strSystemItems[eSysItemCnt] =
+{
+	(const PCHAR)"dma_latency", (const PCHAR)"timer_slack", (const PCHAR)"memlock", (const PCHAR)"malloc",
+	(const PCHAR)"prefault", (const PCHAR)"isolcpus", (const PCHAR)"nohz_full", (const PCHAR)"governor",
+	(const PCHAR)"rt_throttling", (const PCHAR)"preempt_rt", (const PCHAR)"hugepages", (const PCHAR)"timer_migration",
+	(const PCHAR)"rt_priority",
+};
+
+static const PCHAR g_strSystemResults[] =
+{
+	(const PCHAR)"SKIPPED", (const PCHAR)"PASSED", (const PCHAR)"WARNING", (const PCHAR)"FAILED",
+};
+
+/*****************************************************************************/
+static VOID
+_set_system_item(RT_SYSTEM_REPORT* apReport, INT anItem, INT anResult, INT anErrno, const CHAR* astrFmt, ...)
+{
+	RT_SYSTEM_CHECK* pItem = &apReport->stItems[anItem];
+	pItem->nResult = anResult;
+	pItem->nErrno = anErrno;
+
+	va_list vaArgs;
+	va_start(vaArgs, astrFmt);
+	vsnprintf(pItem->strDetail, MAX_SYSTEM_DETAIL, astrFmt, vaArgs);
+	va_end(vaArgs);
+
+	switch (anResult)
+	{
+	case eSysPassed:
+		DBG_TRACE("SUCCESS: System %s : %s", g_strSystemItems[anItem], pItem->strDetail);
+		break;
+	case eSysWarning:
+		DBG_WARN("WARNING : System %s : %s", g_strSystemItems[anItem], pItem->strDetail);
+		break;
+	case eSysFailed:
+		DBG_ERROR("FAILED : System %s : %s with errno (%d:%s)", g_strSystemItems[anItem], pItem->strDetail, anErrno, strerror(anErrno));
+		break;
+	default:
+		break;
+	}
+}
+/*****************************************************************************/
+static INT
+_read_system_file(const CHAR* astrPath, PCHAR astrBuf, size_t aulSize)
+{
+	INT nFd = open(astrPath, O_RDONLY | O_CLOEXEC);
+	if (nFd < 0)
+		return -errno;
+
+	ssize_t lLen = read(nFd, astrBuf, aulSize - 1);
+	INT nErr = errno;
+	close(nFd);
+	if (lLen < 0)
+		return -nErr;
+
+	// sysfs values end with a newline
+	while (lLen > 0 && (astrBuf[lLen - 1] == '\n' || astrBuf[lLen - 1] == ' '))
+		lLen--;
+	astrBuf[lLen] = '\0';
+	return (INT)lLen;
+}
+/*****************************************************************************/
+static VOID
+_prepare_dma_latency(RT_SYSTEM_REPORT* apReport)
+{
+	pthread_mutex_lock(&g_mtxSystem);
+	if (g_nDmaLatencyFd >= 0)
+	{
+		pthread_mutex_unlock(&g_mtxSystem);
+		_set_system_item(apReport, eSysDmaLatency, eSysPassed, 0, "0us already held");
+		return;
+	}
+
+	INT nFd = open(SYS_CPU_DMA_LATENCY, O_RDWR | O_CLOEXEC);
+	if (nFd < 0)
+	{
+		INT nErr = errno;
+		pthread_mutex_unlock(&g_mtxSystem);
+		_set_system_item(apReport, eSysDmaLatency, eSysFailed, nErr, "cannot open %s", SYS_CPU_DMA_LATENCY);
+		return;
+	}
+
+	INT32 nLatency = 0;
+	if (write(nFd, &nLatency, sizeof(nLatency)) != (ssize_t)sizeof(nLatency))
+	{
+		INT nErr = errno;
+		close(nFd);
+		pthread_mutex_unlock(&g_mtxSystem);
+		_set_system_item(apReport, eSysDmaLatency, eSysFailed, nErr, "cannot write %s", SYS_CPU_DMA_LATENCY);
+		return;
+	}
+	g_nDmaLatencyFd = nFd;
+	pthread_mutex_unlock(&g_mtxSystem);
+	_set_system_item(apReport, eSysDmaLatency, eSysPassed, 0, "0us, deep C-states are off");
+}
+/*****************************************************************************/
+static VOID
+_prepare_timer_slack(RT_SYSTEM_REPORT* apReport)
+{
+	// the slack is per thread, threads created from this one start with its value
+	if (prctl(PR_SET_TIMERSLACK, 1UL, 0UL, 0UL, 0UL) != 0)
+	{
+		_set_system_item(apReport, eSysTimerSlack, eSysFailed, errno, "PR_SET_TIMERSLACK");
+		return;
+	}
+	INT nSlack = prctl(PR_GET_TIMERSLACK, 0UL, 0UL, 0UL, 0UL);
+	_set_system_item(apReport, eSysTimerSlack, eSysPassed, 0, "%dns for the tasks created from this thread", nSlack);
+}
+/*****************************************************************************/
+static VOID
+_prepare_memlock(RT_SYSTEM_REPORT* apReport)
+{
+	if (mlockall(MCL_CURRENT | MCL_FUTURE) != 0)
+	{
+		INT nErr = errno;
+		struct rlimit stLimit;
+		getrlimit(RLIMIT_MEMLOCK, &stLimit);
+		_set_system_item(apReport, eSysMemLock, eSysFailed, nErr, "mlockall (RLIMIT_MEMLOCK=%ld)", (LONG)stLimit.rlim_cur);
+		return;
+	}
+	_set_system_item(apReport, eSysMemLock, eSysPassed, 0, "current and future pages");
+}
+/*****************************************************************************/
+static VOID
+_prepare_malloc(RT_SYSTEM_REPORT* apReport)
+{
+	// freed memory stays in the heap and large blocks never come from a fresh mmap
+	if (mallopt(M_TRIM_THRESHOLD, -1) == 0 || mallopt(M_TOP_PAD, 0) == 0 || mallopt(M_MMAP_MAX, 0) == 0)
+	{
+		_set_system_item(apReport, eSysMalloc, eSysFailed, EINVAL, "mallopt");
+		return;
+	}
+	_set_system_item(apReport, eSysMalloc, eSysPassed, 0, "no trimming, no mmap");
+}
+/*****************************************************************************/
+static VOID
+_prepare_prefault(RT_SYSTEM_REPORT* apReport, UINT32 auFlags, size_t aulSize)
+{
+	if (aulSize == 0)
+	{
+		_set_system_item(apReport, eSysPrefault, eSysSkipped, 0, "no size");
+		return;
+	}
+
+	volatile BYTE* pHeap = (volatile BYTE*)malloc(aulSize);
+	if (pHeap == NULL)
+	{
+		_set_system_item(apReport, eSysPrefault, eSysFailed, ENOMEM, "malloc of %zu bytes", aulSize);
+		return;
+	}
+	size_t ulPageSize = (size_t)sysconf(_SC_PAGESIZE);
+	for (size_t ulOffset = 0; ulOffset < aulSize; ulOffset += ulPageSize)
+		pHeap[ulOffset] = 0;
+	free((PVOID)pHeap);
+
+	if ((auFlags & RT_SYS_MALLOC) == 0)
+		_set_system_item(apReport, eSysPrefault, eSysWarning, 0, "%zu bytes, malloc may give them back without RT_SYS_MALLOC", aulSize);
+	else
+		_set_system_item(apReport, eSysPrefault, eSysPassed, 0, "%zu bytes", aulSize);
+}
+/*****************************************************************************/
+static VOID
+_check_isolation(RT_SYSTEM_REPORT* apReport)
+{
+	CHAR strValue[256];
+	INT nLen = _read_system_file(SYS_CPU_ISOLATED, strValue, sizeof(strValue));
+	if (nLen > 0)
+		_set_system_item(apReport, eSysIsolCpus, eSysPassed, 0, "CPUs %s", strValue);
+	else if (nLen == 0)
+		_set_system_item(apReport, eSysIsolCpus, eSysWarning, 0, "no isolated CPUs, add isolcpus= to the kernel command line");
+	else
+	{
+		// older kernels have no sysfs entry, look for the parameter itself
+		CHAR strCmdline[1024];
+		if (_read_system_file(SYS_CMDLINE, strCmdline, sizeof(strCmdline)) > 0 && strstr(strCmdline, "isolcpus=") != NULL)
+			_set_system_item(apReport, eSysIsolCpus, eSysPassed, 0, "isolcpus= on the kernel command line");
+		else
+			_set_system_item(apReport, eSysIsolCpus, eSysWarning, 0, "no isolated CPUs, add isolcpus= to the kernel command line");
+	}
+
+	nLen = _read_system_file(SYS_CPU_NOHZ_FULL, strValue, sizeof(strValue));
+	if (nLen > 0 && strcmp(strValue, "(null)") != 0)
+		_set_system_item(apReport, eSysNohzFull, eSysPassed, 0, "CPUs %s", strValue);
+	else
+		_set_system_item(apReport, eSysNohzFull, eSysWarning, 0, "the tick runs on every CPU, add nohz_full= to the kernel command line");
+}
+/*****************************************************************************/
+static VOID
+_check_governor(RT_SYSTEM_REPORT* apReport)
+{
+	CHAR strPath[128];
+	CHAR strValue[64];
+	CHAR strFirst[64] = { 0 };
+	INT nFirstCpu = -1;
+	INT nReadable = 0;
+	INT nOther = 0;
+
+	LONG lCpuCnt = sysconf(_SC_NPROCESSORS_CONF);
+	for (INT nCpu = 0; nCpu < (INT)lCpuCnt; nCpu++)
+	{
+		snprintf(strPath, sizeof(strPath), SYS_CPU_GOVERNOR, nCpu);
+		if (_read_system_file(strPath, strValue, sizeof(strValue)) <= 0)
+			continue;
+		nReadable++;
+		if (strcmp(strValue, "performance") == 0)
+			continue;
+		if (nOther++ == 0)
+		{
+			nFirstCpu = nCpu;
+			strncpy(strFirst, strValue, sizeof(strFirst) - 1);
+		}
+	}
+
+	if (nReadable == 0)
+		_set_system_item(apReport, eSysGovernor, eSysSkipped, 0, "no cpufreq");
+	else if (nOther > 0)
+		_set_system_item(apReport, eSysGovernor, eSysWarning, 0, "%d of %d CPUs are not on performance (cpu%d: %s)", nOther, nReadable, nFirstCpu, strFirst);
+	else
+		_set_system_item(apReport, eSysGovernor, eSysPassed, 0, "performance on %d CPUs", nReadable);
+}
+/*****************************************************************************/
+static VOID
+_check_kernel(RT_SYSTEM_REPORT* apReport)
+{
+	CHAR strValue[128];
+	CHAR strPeriod[32];
+
+	if (_read_system_file(SYS_RT_RUNTIME, strValue, sizeof(strValue)) <= 0)
+		_set_system_item(apReport, eSysRtThrottling, eSysSkipped, 0, "no %s", SYS_RT_RUNTIME);
+	else if (atol(strValue) < 0)
+		_set_system_item(apReport, eSysRtThrottling, eSysPassed, 0, "off");
+	else
+	{
+		if (_read_system_file(SYS_RT_PERIOD, strPeriod, sizeof(strPeriod)) <= 0)
+			strcpy(strPeriod, "?");
+		_set_system_item(apReport, eSysRtThrottling, eSysWarning, 0, "RT tasks stop after %sus of every %sus, write -1 to %s", strValue, strPeriod, SYS_RT_RUNTIME);
+	}
+
+	struct utsname stName;
+	if (_read_system_file(SYS_REALTIME, strValue, sizeof(strValue)) > 0 && strValue[0] == '1')
+		_set_system_item(apReport, eSysPreemptRt, eSysPassed, 0, "PREEMPT_RT");
+	else if (uname(&stName) == 0 && strstr(stName.version, "PREEMPT_RT") != NULL)
+		_set_system_item(apReport, eSysPreemptRt, eSysPassed, 0, "PREEMPT_RT");
+	else
+		_set_system_item(apReport, eSysPreemptRt, eSysWarning, 0, "the kernel is not PREEMPT_RT");
+
+	// khugepaged and the page faults of a huge page stall the task that touches it
+	if (_read_system_file(SYS_THP_ENABLED, strValue, sizeof(strValue)) <= 0)
+		_set_system_item(apReport, eSysHugePages, eSysSkipped, 0, "no transparent hugepages");
+	else if (strstr(strValue, "[always]") != NULL)
+		_set_system_item(apReport, eSysHugePages, eSysWarning, 0, "transparent hugepages are always on, set madvise or never");
+	else
+		_set_system_item(apReport, eSysHugePages, eSysPassed, 0, "%s", strValue);
+
+	if (_read_system_file(SYS_TIMER_MIGRATION, strValue, sizeof(strValue)) <= 0)
+		_set_system_item(apReport, eSysTimerMigration, eSysSkipped, 0, "no %s", SYS_TIMER_MIGRATION);
+	else if (strValue[0] != '0')
+		_set_system_item(apReport, eSysTimerMigration, eSysWarning, 0, "timers move to other CPUs, write 0 to %s", SYS_TIMER_MIGRATION);
+	else
+		_set_system_item(apReport, eSysTimerMigration, eSysPassed, 0, "off");
+
+	struct rlimit stLimit;
+	if (geteuid() == 0)
+		_set_system_item(apReport, eSysRtPriority, eSysPassed, 0, "root");
+	else if (getrlimit(RLIMIT_RTPRIO, &stLimit) == 0 && stLimit.rlim_cur >= LIM_PRIORITY_HI)
+		_set_system_item(apReport, eSysRtPriority, eSysPassed, 0, "RLIMIT_RTPRIO=%ld", (LONG)stLimit.rlim_cur);
+	else
+		_set_system_item(apReport, eSysRtPriority, eSysWarning, 0, "not root and RLIMIT_RTPRIO=%ld, RT tasks may fail to start", (LONG)stLimit.rlim_cur);
+}
+/*****************************************************************************/
+static INT
+_finish_system_report(RT_SYSTEM_REPORT* apReport)
+{
+	INT nRet = RET_SUCC;
+	apReport->uFailed = 0;
+	apReport->uWarnings = 0;
+	for (INT nItem = 0; nItem < eSysItemCnt; nItem++)
+	{
+		RT_SYSTEM_CHECK* pItem = &apReport->stItems[nItem];
+		if (pItem->nResult == eSysWarning)
+			apReport->uWarnings++;
+		else if (pItem->nResult == eSysFailed)
+		{
+			// the first failed step decides the return value
+			if (apReport->uFailed++ == 0)
+				nRet = -pItem->nErrno;
+		}
+	}
+	return nRet;
+}
+/*****************************************************************************/
+INT
+rt_system_check(RT_SYSTEM_REPORT* apReport)
+{
+	if (apReport == NULL)
+		return -EINVAL;
+
+	ZERO_MEMORY(apReport, sizeof(RT_SYSTEM_REPORT));
+	_check_isolation(apReport);
+	_check_governor(apReport);
+	_check_kernel(apReport);
+	return _finish_system_report(apReport);
+}
+/*****************************************************************************/
+INT
+rt_system_prepare(UINT32 auFlags, size_t aulPrefault, RT_SYSTEM_REPORT* apReport)
+{
+	if ((auFlags & ~RT_SYS_ALL) != 0)
+		return -EINVAL;
+
+	RT_SYSTEM_REPORT stReport;
+	RT_SYSTEM_REPORT* pReport = (apReport != NULL) ? apReport : &stReport;
+	ZERO_MEMORY(pReport, sizeof(RT_SYSTEM_REPORT));
+
+	// malloc is tuned before the heap is pre-faulted, otherwise the touched pages are trimmed again
+	if (auFlags & RT_SYS_DMA_LATENCY)
+		_prepare_dma_latency(pReport);
+	if (auFlags & RT_SYS_TIMER_SLACK)
+		_prepare_timer_slack(pReport);
+	if (auFlags & RT_SYS_MALLOC)
+		_prepare_malloc(pReport);
+	if (auFlags & RT_SYS_MEMLOCK)
+		_prepare_memlock(pReport);
+	if (auFlags & RT_SYS_PREFAULT)
+		_prepare_prefault(pReport, auFlags, aulPrefault);
+
+	_check_isolation(pReport);
+	_check_governor(pReport);
+	_check_kernel(pReport);
+
+	INT nRet = _finish_system_report(pReport);
+	DBG_TRACE("SUCCESS: System Prepare : flags=0x%x, failed=%u, warnings=%u", auFlags, pReport->uFailed, pReport->uWarnings);
+	return nRet;
+}
+/*****************************************************************************/
+INT
+rt_system_release(VOID)
+{
+	pthread_mutex_lock(&g_mtxSystem);
+	if (g_nDmaLatencyFd < 0)
+	{
+		pthread_mutex_unlock(&g_mtxSystem);
+		return -EINVAL;
+	}
+	close(g_nDmaLatencyFd);
+	g_nDmaLatencyFd = -1;
+	pthread_mutex_unlock(&g_mtxSystem);
+	return RET_SUCC;
+}
+/*****************************************************************************/
+const PCHAR
+get_rt_system_item_name(INT anItem)
+{
+	if (anItem < 0 || anItem >= eSysItemCnt)
+		return NULL;
+	return g_strSystemItems[anItem];
+}
+/*****************************************************************************/
+VOID
+print_rt_system_report(RT_SYSTEM_REPORT* apReport)
+{
+	if (apReport == NULL)
+		return;
+
+	for (INT nItem = 0; nItem < eSysItemCnt; nItem++)
+	{
+		RT_SYSTEM_CHECK* pItem = &apReport->stItems[nItem];
+		if (pItem->nResult == eSysSkipped && pItem->strDetail[0] == '\0')
+			continue;
+		DBG_INFO("%-16s %-8s %s", g_strSystemItems[nItem], g_strSystemResults[pItem->nResult], pItem->strDetail);
+	}
+	DBG_INFO("failed=%u, warnings=%u", apReport->uFailed, apReport->uWarnings);
+}
+/*****************************************************************************/
@@ -0,0 +1,249 @@
+/*
+ *  This file is owned by the Embedded Systems Laboratory of Seoul National University of Science and Technology
+ *  as a part of RT-AIDE or the RTOS-Agnostic and Interoperable Development Environment for Real-time Systems
+ *
+ *  File: rt_telemetry.c
+ *  Author: 2022 Raimarius Delgado
+ *  Description: per-task telemetry in a shm_open()'d region. Every task owns one cache-line aligned record
+ *				 and updates it under a seqlock, so the writer never blocks and readers in other processes
+ *				 only ever retry their own copy.
+ *
+ *
+*/
+#include "rt_telemetry.h"
+#include <fcntl.h>
+#include <sys/stat.h>
+
+#define TELEMETRY_READ_RETRIES	(1000)
+
+static RT_TELEMETRY_REGION* g_pTelemetry = NULL;
+static RT_TELEMETRY_REGION* g_pTelemetryMap = NULL;	// stays mapped after stop_telemetry(), reused by the next start
+static CHAR g_strTelemetryName[MAX_NAME_LENGTH];
+
+/*****************************************************************************/
+static void
+_get_telemetry_name(PID anPid, PCHAR astrName, size_t aulSize)
+{
+	snprintf(astrName, aulSize, "%s%d", RT_TELEMETRY_PREFIX, (INT)anPid);
+}
+/*****************************************************************************/
+INT
+start_telemetry(VOID)
+{
+	if (__atomic_load_n(&g_pTelemetry, __ATOMIC_ACQUIRE) != NULL)
+	{
+		DBG_ERROR("FAILED : Start Telemetry: already running");
+		return -EBUSY;
+	}
+
+	_get_telemetry_name(getpid(), g_strTelemetryName, sizeof(g_strTelemetryName));
+	INT nFd = shm_open(g_strTelemetryName, O_CREAT | O_RDWR, 0644);
+	if (nFd < 0)
+	{
+		DBG_ERROR("FAILED : Start Telemetry (shm_open): %s with errno (%d:%s)", g_strTelemetryName, errno, strerror(errno));
+		return -errno;
+	}
+	if (ftruncate(nFd, sizeof(RT_TELEMETRY_REGION)) != 0)
+	{
+		INT nErr = errno;
+		DBG_ERROR("FAILED : Start Telemetry (ftruncate): %s with errno (%d:%s)", g_strTelemetryName, nErr, strerror(nErr));
+		close(nFd);
+		shm_unlink(g_strTelemetryName);
+		return -nErr;
+	}
+
+	// a restart puts the new object over the pages of the previous one, start/stop cycles never pile up mappings
+	INT nFlags = MAP_SHARED | ((g_pTelemetryMap != NULL) ? MAP_FIXED : 0);
+	RT_TELEMETRY_REGION* pRegion = (RT_TELEMETRY_REGION*)mmap(g_pTelemetryMap, sizeof(RT_TELEMETRY_REGION), PROT_READ | PROT_WRITE, nFlags, nFd, 0);
+	close(nFd);
+	if (pRegion == MAP_FAILED)
+	{
+		DBG_ERROR("FAILED : Start Telemetry (mmap): %s with errno (%d:%s)", g_strTelemetryName, errno, strerror(errno));
+		shm_unlink(g_strTelemetryName);
+		return -errno;
+	}
+	g_pTelemetryMap = pRegion;
+
+	// fault the region in now, a task must never page-fault while publishing
+	ZERO_MEMORY(pRegion, sizeof(RT_TELEMETRY_REGION));
+	if (mlock(pRegion, sizeof(RT_TELEMETRY_REGION)) != 0)
+		DBG_WARN("WARNING : Start Telemetry (mlock): %s with errno (%d:%s)", g_strTelemetryName, errno, strerror(errno));
+
+	pRegion->stHeader.uVersion = RT_TELEMETRY_VERSION;
+	pRegion->stHeader.uRecordSize = sizeof(RT_TELEMETRY_RECORD);
+	pRegion->stHeader.uRecordCnt = RT_TELEMETRY_MAX_TASKS;
+	pRegion->stHeader.nPid = getpid();
+	pRegion->stHeader.rttStarted = read_timer();
+	strncpy(pRegion->stHeader.strProcess, program_invocation_short_name, MAX_NAME_LENGTH - 1);
+	__atomic_store_n(&pRegion->stHeader.uMagic, RT_TELEMETRY_MAGIC, __ATOMIC_RELEASE);
+
+	__atomic_store_n(&g_pTelemetry, pRegion, __ATOMIC_RELEASE);
+	DBG_TRACE("SUCCESS: Start Telemetry : shm=%s, records=%d", g_strTelemetryName, (INT)RT_TELEMETRY_MAX_TASKS);
+	return RET_SUCC;
+}
+/*****************************************************************************/
+INT
+stop_telemetry(VOID)
+{
+	RT_TELEMETRY_REGION* pRegion = __atomic_exchange_n(&g_pTelemetry, NULL, __ATOMIC_ACQ_REL);
+	if (pRegion == NULL)
+		return -EINVAL;
+
+	// the mapping stays, a task may still be in the middle of publishing into it; start_telemetry() reuses it
+	__atomic_store_n(&pRegion->stHeader.uMagic, 0, __ATOMIC_RELEASE);
+	shm_unlink(g_strTelemetryName);
+	return RET_SUCC;
+}
+/*****************************************************************************/
+static RT_TELEMETRY_RECORD*
+_get_task_record(RT_TELEMETRY_REGION* apRegion, POSIX_TASK* apTask)
+{
+	// uInUse holds the TID of the owner, the slot is still ours if nobody else took it over (e.g. after a restart)
+	UINT32 uOwner = (UINT32)apTask->nPid;
+	if (apTask->nTelemetrySlot >= 0)
+	{
+		RT_TELEMETRY_RECORD* pRecord = &apRegion->stRecords[apTask->nTelemetrySlot];
+		if (__atomic_load_n(&pRecord->uInUse, __ATOMIC_ACQUIRE) == uOwner)
+			return pRecord;
+		apTask->nTelemetrySlot = -1;
+	}
+
+	for (INT nSlot = 0; nSlot < RT_TELEMETRY_MAX_TASKS; nSlot++)
+	{
+		UINT32 uFree = 0;
+		RT_TELEMETRY_RECORD* pRecord = &apRegion->stRecords[nSlot];
+		if (__atomic_compare_exchange_n(&pRecord->uInUse, &uFree, uOwner, FALSE, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED))
+		{
+			apTask->nTelemetrySlot = nSlot;
+			return pRecord;
+		}
+	}
+	return NULL;
+}
+/*****************************************************************************/
+INT
+publish_task_telemetry(POSIX_TASK* apTask)
+{
+	RT_TELEMETRY_REGION* pRegion = __atomic_load_n(&g_pTelemetry, __ATOMIC_ACQUIRE);
+	if (pRegion == NULL)
+		return -ENODEV;
+
+	POSIX_TASK* pTask = (apTask != NULL) ? apTask : get_self();
+	if (pTask == NULL)
+		return -EPERM;
+	// the TID owns the record, a task without a thread has none
+	if (pTask->nPid == 0)
+		return -ESRCH;
+
+	RT_TELEMETRY_RECORD* pRecord = _get_task_record(pRegion, pTask);
+	if (pRecord == NULL)
+		return -ENOSPC;
+
+	// seqlock write: odd sequence while the record is inconsistent
+	UINT32 uSeq = pRecord->uSeq;
+	__atomic_store_n(&pRecord->uSeq, uSeq + 1, __ATOMIC_RELAXED);
+	__atomic_thread_fence(__ATOMIC_RELEASE);
+
+	memcpy(pRecord->strName, pTask->strName, sizeof(pRecord->strName));
+	pRecord->nPid = pTask->nPid;
+	pRecord->dwStatus = pTask->dwStatus;
+	pRecord->nPriority = pTask->nPriority;
+	pRecord->nSchedPolicy = pTask->nSchedPolicy;
+	pRecord->ullPeriod = pTask->ullPeriod;
+	pRecord->ullCycles = pTask->stLatency.ullCount;
+	pRecord->ullOverruns = pTask->ullOverruns;
+	pRecord->ullLatLast = pTask->ullLastLatency;
+	pRecord->ullLatMin = pTask->stLatency.ullMin;
+	pRecord->ullLatMax = pTask->stLatency.ullMax;
+	pRecord->ullLatSum = pTask->stLatency.ullSum;
+	pRecord->ullExecLast = pTask->ullLastExecTime;
+	pRecord->ullExecMax = pTask->stExecTime.ullMax;
+	pRecord->rttUpdated = read_timer_fast();
+
+	__atomic_store_n(&pRecord->uSeq, uSeq + 2, __ATOMIC_RELEASE);
+	return RET_SUCC;
+}
+/*****************************************************************************/
+VOID
+release_task_telemetry(POSIX_TASK* apTask)
+{
+	RT_TELEMETRY_REGION* pRegion = __atomic_load_n(&g_pTelemetry, __ATOMIC_ACQUIRE);
+	if (pRegion == NULL || apTask == NULL || apTask->nTelemetrySlot < 0)
+		return;
+
+	UINT32 uOwner = (UINT32)apTask->nPid;
+	RT_TELEMETRY_RECORD* pRecord = &pRegion->stRecords[apTask->nTelemetrySlot];
+	__atomic_compare_exchange_n(&pRecord->uInUse, &uOwner, 0, FALSE, __ATOMIC_RELEASE, __ATOMIC_RELAXED);
+	apTask->nTelemetrySlot = -1;
+}
+/*****************************************************************************/
+INT
+open_telemetry(PID anPid, RT_TELEMETRY_REGION** appRegion)
+{
+	CHAR strName[MAX_NAME_LENGTH];
+	if (appRegion == NULL)
+		return -EINVAL;
+
+	_get_telemetry_name(anPid, strName, sizeof(strName));
+	INT nFd = shm_open(strName, O_RDONLY, 0);
+	if (nFd < 0)
+		return -errno;
+
+	struct stat stStat;
+	if (fstat(nFd, &stStat) != 0 || (size_t)stStat.st_size < sizeof(RT_TELEMETRY_REGION))
+	{
+		close(nFd);
+		return -EPROTO;
+	}
+
+	// readers map the region read-only, they cannot disturb the publishing tasks
+	RT_TELEMETRY_REGION* pRegion = (RT_TELEMETRY_REGION*)mmap(NULL, sizeof(RT_TELEMETRY_REGION), PROT_READ, MAP_SHARED, nFd, 0);
+	close(nFd);
+	if (pRegion == MAP_FAILED)
+		return -errno;
+
+	if (__atomic_load_n(&pRegion->stHeader.uMagic, __ATOMIC_ACQUIRE) != RT_TELEMETRY_MAGIC ||
+		pRegion->stHeader.uVersion != RT_TELEMETRY_VERSION || pRegion->stHeader.uRecordSize != sizeof(RT_TELEMETRY_RECORD))
+	{
+		munmap(pRegion, sizeof(RT_TELEMETRY_REGION));
+		return -EPROTO;
+	}
+
+	*appRegion = pRegion;
+	return RET_SUCC;
+}
+/*****************************************************************************/
+INT
+read_telemetry_record(RT_TELEMETRY_REGION* apRegion, UINT32 auIndex, RT_TELEMETRY_RECORD* apRecord)
+{
+	if (apRegion == NULL || apRecord == NULL || auIndex >= apRegion->stHeader.uRecordCnt)
+		return -EINVAL;
+
+	const RT_TELEMETRY_RECORD* pRecord = &apRegion->stRecords[auIndex];
+	for (INT nTry = 0; nTry < TELEMETRY_READ_RETRIES; nTry++)
+	{
+		UINT32 uSeq = __atomic_load_n(&pRecord->uSeq, __ATOMIC_ACQUIRE);
+		if (uSeq & 1)
+		{
+			cpu_relax();
+			continue;
+		}
+
+		memcpy(apRecord, (const PVOID)pRecord, sizeof(RT_TELEMETRY_RECORD));
+		__atomic_thread_fence(__ATOMIC_ACQUIRE);
+		if (__atomic_load_n(&pRecord->uSeq, __ATOMIC_RELAXED) == uSeq)
+			return (apRecord->uInUse != 0) ? RET_SUCC : -ENOENT;
+	}
+	return -EAGAIN;
+}
+/*****************************************************************************/
+INT
+close_telemetry(RT_TELEMETRY_REGION* apRegion)
+{
+	if (apRegion == NULL)
+		return -EINVAL;
+
+	munmap(apRegion, sizeof(RT_TELEMETRY_REGION));
+	return RET_SUCC;
+}
+/*****************************************************************************/
@@ -0,0 +1,430 @@
+/*
+ *  This file is owned by the Embedded Systems Laboratory of Seoul National University of Science and Technology
+ *  as a part of RT-AIDE or the RTOS-Agnostic and Interoperable Development Environment for Real-time Systems
+ *
+ *  File: rt_trace.c
+ *  Author: 2022 Raimarius Delgado
+ *  Description: binary event tracer. Every CPU has its own ring of fixed-size events in one locked and
+ *				 pre-faulted region, a task claims a slot with an atomic add on the ring of its CPU and
+ *				 never takes a lock. The JSON export runs outside of the RT tasks.
+ *
+ *
+*/
+#include "rt_trace.h"
+
+typedef struct _RT_TRACE_RING
+{
+	UINT64			ullHead __attribute__((aligned(64)));	// events ever written to this ring
+	RT_TRACE_EVENT*	pEvents;
+} RT_TRACE_RING;
+
+typedef struct _RT_TRACE_BUFFER
+{
+	size_t			ulSize;
+	UINT32			uCpuCnt;
+	UINT32			uEventMask;		// events per ring minus one, the ring size is a power of two
+	INT				nMode;
+	BOOL			bActive;
+	BOOL			bFrozen;
+	RTTIME			rttFrozen;
+	UINT16			uFrozenBy;
+	RT_TRACE_RING	stRings[LIM_TRACE_CPUS];
+} RT_TRACE_BUFFER;
+
+typedef struct _RT_TRACE_TASK
+{
+	CHAR			strName[MAX_NAME_LENGTH];
+	PID				nTid;
+} RT_TRACE_TASK;
+
+static RT_TRACE_BUFFER* g_pTrace = NULL;
+static pthread_mutex_t g_mtxTrace = PTHREAD_MUTEX_INITIALIZER;	// start, stop and export only
+
+// cleared by start_trace(), a task re-claims an index once per session
+static RT_TRACE_TASK g_stTraceTasks[LIM_TRACE_TASKS];
+static UINT32 g_uTraceTaskCnt = 0;
+static UINT32 g_uTraceSession = 0;								// 0 is never a session, it marks a task without an index
+
+static const PCHAR g_strTraceTypes[eTraceTypeCnt] =
+{
+	(const PCHAR)"create", (const PCHAR)"start", (const PCHAR)"release", (const PCHAR)"wakeup", (const PCHAR)"wait",
+	(const PCHAR)"overrun", (const PCHAR)"suspend", (const PCHAR)"resume", (const PCHAR)"end", (const PCHAR)"user",
+};
+
+/*****************************************************************************/
+static UINT16
+_get_trace_task(POSIX_TASK* apTask)
+{
+	if (apTask == NULL)
+		return RT_TRACE_NO_TASK;
+
+	// an index of an older session points into a table that has been cleared since
+	UINT32 uSession = __atomic_load_n(&g_uTraceSession, __ATOMIC_ACQUIRE);
+	UINT64 ullOld = __atomic_load_n(&apTask->ullTraceTask, __ATOMIC_ACQUIRE);
+	if ((UINT32)(ullOld >> 32) == uSession)
+		return (UINT16)ullOld;
+
+	UINT32 uNew = __atomic_fetch_add(&g_uTraceTaskCnt, 1, __ATOMIC_RELAXED);
+	if (uNew >= LIM_TRACE_TASKS)
+		return RT_TRACE_NO_TASK;
+
+	strncpy(g_stTraceTasks[uNew].strName, apTask->strName, MAX_NAME_LENGTH - 1);
+	g_stTraceTasks[uNew].nTid = apTask->nPid;
+
+	// two threads may race for the same task, the loser leaves an unused entry behind
+	UINT64 ullNew = ((UINT64)uSession << 32) | uNew;
+	if (!__atomic_compare_exchange_n(&apTask->ullTraceTask, &ullOld, ullNew, FALSE, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE))
+	{
+		if ((UINT32)(ullOld >> 32) == uSession)
+			return (UINT16)ullOld;
+		return RT_TRACE_NO_TASK;
+	}
+	return (UINT16)uNew;
+}
+/*****************************************************************************/
+VOID
+trace_task_event(INT anType, POSIX_TASK* apTask, RTTIME arttStamp, UINT64 aullArg)
+{
+	RT_TRACE_BUFFER* pTrace = __atomic_load_n(&g_pTrace, __ATOMIC_ACQUIRE);
+	if (pTrace == NULL || __atomic_load_n(&pTrace->bActive, __ATOMIC_RELAXED) == FALSE || __atomic_load_n(&pTrace->bFrozen, __ATOMIC_RELAXED))
+		return;
+
+	UINT16 uTask = _get_trace_task(apTask);
+	if (anType == eTraceStart && uTask != RT_TRACE_NO_TASK)
+		__atomic_store_n(&g_stTraceTasks[uTask].nTid, (PID)aullArg, __ATOMIC_RELAXED);
+
+	// a migration after sched_getcpu() only costs a shared cache line, the slot claim is atomic anyway
+	INT nCpu = sched_getcpu();
+	UINT32 uCpu = (nCpu < 0) ? 0 : (UINT32)nCpu % pTrace->uCpuCnt;
+	RT_TRACE_RING* pRing = &pTrace->stRings[uCpu];
+
+	UINT64 ullPos = __atomic_fetch_add(&pRing->ullHead, 1, __ATOMIC_RELAXED);
+	RT_TRACE_EVENT* pEvent = &pRing->pEvents[ullPos & pTrace->uEventMask];
+
+	__atomic_store_n(&pEvent->uSeq, 0, __ATOMIC_RELAXED);
+	__atomic_thread_fence(__ATOMIC_RELEASE);
+	pEvent->uType = (UINT16)anType;
+	pEvent->uTask = uTask;
+	pEvent->nTid = get_cached_tid();
+	pEvent->uCpu = uCpu;
+	pEvent->rttStamp = (arttStamp != 0) ? arttStamp : read_timer();
+	pEvent->ullArg = aullArg;
+	__atomic_store_n(&pEvent->uSeq, (UINT32)(ullPos + 1), __ATOMIC_RELEASE);
+
+	// the flight recorder keeps what led to the first miss
+	if (anType == eTraceOverrun && pTrace->nMode == eTraceFlightRecorder)
+	{
+		BOOL bFrozen = FALSE;
+		if (__atomic_compare_exchange_n(&pTrace->bFrozen, &bFrozen, TRUE, FALSE, __ATOMIC_ACQ_REL, __ATOMIC_RELAXED))
+		{
+			pTrace->rttFrozen = pEvent->rttStamp;
+			pTrace->uFrozenBy = uTask;
+		}
+	}
+}
+/*****************************************************************************/
+VOID
+trace_user_event(UINT64 aullArg)
+{
+	trace_task_event(eTraceUser, get_self(), 0, aullArg);
+}
+/*****************************************************************************/
+static VOID
+_reset_trace(RT_TRACE_BUFFER* apTrace, INT anMode)
+{
+	for (UINT32 uCpu = 0; uCpu < apTrace->uCpuCnt; uCpu++)
+	{
+		RT_TRACE_RING* pRing = &apTrace->stRings[uCpu];
+		memset(pRing->pEvents, 0, sizeof(RT_TRACE_EVENT) * (apTrace->uEventMask + 1));
+		pRing->ullHead = 0;
+	}
+	apTrace->nMode = anMode;
+	apTrace->rttFrozen = 0;
+	apTrace->uFrozenBy = RT_TRACE_NO_TASK;
+	__atomic_store_n(&apTrace->bFrozen, FALSE, __ATOMIC_RELEASE);
+}
+/*****************************************************************************/
+INT
+start_trace(UINT32 auEventsPerCpu, INT anMode)
+{
+	if (auEventsPerCpu == 0 || auEventsPerCpu > (1U << 24) || (anMode != eTraceContinuous && anMode != eTraceFlightRecorder))
+		return -EINVAL;
+
+	UINT32 uEventCnt = 1;
+	while (uEventCnt < auEventsPerCpu)
+		uEventCnt <<= 1;
+
+	LONG lCpuCnt = sysconf(_SC_NPROCESSORS_CONF);
+	UINT32 uCpuCnt = (lCpuCnt <= 0) ? 1 : (lCpuCnt > LIM_TRACE_CPUS) ? LIM_TRACE_CPUS : (UINT32)lCpuCnt;
+
+	pthread_mutex_lock(&g_mtxTrace);
+	RT_TRACE_BUFFER* pTrace = g_pTrace;
+	if (pTrace != NULL && pTrace->bActive)
+	{
+		pthread_mutex_unlock(&g_mtxTrace);
+		DBG_ERROR("FAILED : Start Trace: already running");
+		return -EBUSY;
+	}
+
+	// a buffer of another size is left mapped, a task preempted inside trace_task_event() may still point into it
+	if (pTrace == NULL || pTrace->uEventMask != uEventCnt - 1 || pTrace->uCpuCnt != uCpuCnt)
+	{
+		size_t ulRingSize = ROUND_UP((size_t)uEventCnt * sizeof(RT_TRACE_EVENT), 64);
+		size_t ulSize = ROUND_UP(ROUND_UP(sizeof(RT_TRACE_BUFFER), 64) + ulRingSize * uCpuCnt, (size_t)sysconf(_SC_PAGESIZE));
+		PVOID pRegion = NULL;
+		INT nRet = map_locked_region(&pRegion, ulSize, "Start Trace");
+		if (nRet != RET_SUCC)
+		{
+			pthread_mutex_unlock(&g_mtxTrace);
+			return nRet;
+		}
+
+		pTrace = (RT_TRACE_BUFFER*)pRegion;
+		pTrace->ulSize = ulSize;
+		pTrace->uCpuCnt = uCpuCnt;
+		pTrace->uEventMask = uEventCnt - 1;
+		PBYTE pEvents = (PBYTE)pRegion + ROUND_UP(sizeof(RT_TRACE_BUFFER), 64);
+		for (UINT32 uCpu = 0; uCpu < uCpuCnt; uCpu++)
+			pTrace->stRings[uCpu].pEvents = (RT_TRACE_EVENT*)(pEvents + ulRingSize * uCpu);
+	}
+
+	// every page is touched here, recording never faults
+	_reset_trace(pTrace, anMode);
+
+	// the tasks of the last session are named again by their next event
+	ZERO_MEMORY(g_stTraceTasks, sizeof(g_stTraceTasks));
+	__atomic_store_n(&g_uTraceTaskCnt, 0, __ATOMIC_RELAXED);
+	UINT32 uSession = g_uTraceSession + 1;
+	__atomic_store_n(&g_uTraceSession, (uSession == 0) ? 1 : uSession, __ATOMIC_RELEASE);
+	__atomic_store_n(&pTrace->bActive, TRUE, __ATOMIC_RELEASE);
+	__atomic_store_n(&g_pTrace, pTrace, __ATOMIC_RELEASE);
+	pthread_mutex_unlock(&g_mtxTrace);
+
+	DBG_TRACE("SUCCESS: Start Trace : cpus=%u, events=%u, mode=%d", uCpuCnt, uEventCnt, anMode);
+	return RET_SUCC;
+}
+/*****************************************************************************/
+INT
+stop_trace(VOID)
+{
+	RT_TRACE_BUFFER* pTrace = __atomic_load_n(&g_pTrace, __ATOMIC_ACQUIRE);
+	if (pTrace == NULL || __atomic_exchange_n(&pTrace->bActive, FALSE, __ATOMIC_ACQ_REL) == FALSE)
+		return -EINVAL;
+
+	// the events stay for read_trace_events() and export_trace_json() until the next start_trace()
+	return RET_SUCC;
+}
+/*****************************************************************************/
+INT
+rearm_trace(VOID)
+{
+	RT_TRACE_BUFFER* pTrace = __atomic_load_n(&g_pTrace, __ATOMIC_ACQUIRE);
+	if (pTrace == NULL || pTrace->bActive == FALSE)
+		return -EINVAL;
+
+	// tasks may be writing while the rings are cleared, a torn event is dropped by its sequence number
+	pthread_mutex_lock(&g_mtxTrace);
+	__atomic_store_n(&pTrace->bActive, FALSE, __ATOMIC_RELEASE);
+	_reset_trace(pTrace, pTrace->nMode);
+	__atomic_store_n(&pTrace->bActive, TRUE, __ATOMIC_RELEASE);
+	pthread_mutex_unlock(&g_mtxTrace);
+	return RET_SUCC;
+}
+/*****************************************************************************/
+BOOL
+is_trace_frozen(VOID)
+{
+	RT_TRACE_BUFFER* pTrace = __atomic_load_n(&g_pTrace, __ATOMIC_ACQUIRE);
+	return (pTrace != NULL && __atomic_load_n(&pTrace->bFrozen, __ATOMIC_ACQUIRE));
+}
+/*****************************************************************************/
+INT
+get_trace_info(RT_TRACE_INFO* apInfo)
+{
+	RT_TRACE_BUFFER* pTrace = __atomic_load_n(&g_pTrace, __ATOMIC_ACQUIRE);
+	if (pTrace == NULL || apInfo == NULL)
+		return -EINVAL;
+
+	ZERO_MEMORY(apInfo, sizeof(RT_TRACE_INFO));
+	apInfo->bActive = __atomic_load_n(&pTrace->bActive, __ATOMIC_ACQUIRE);
+	apInfo->bFrozen = __atomic_load_n(&pTrace->bFrozen, __ATOMIC_ACQUIRE);
+	apInfo->nMode = pTrace->nMode;
+	apInfo->uCpuCnt = pTrace->uCpuCnt;
+	apInfo->uEventsPerCpu = pTrace->uEventMask + 1;
+	for (UINT32 uCpu = 0; uCpu < pTrace->uCpuCnt; uCpu++)
+	{
+		UINT64 ullHead = __atomic_load_n(&pTrace->stRings[uCpu].ullHead, __ATOMIC_ACQUIRE);
+		apInfo->ullRecorded += ullHead;
+		if (ullHead > apInfo->uEventsPerCpu)
+			apInfo->ullLost += ullHead - apInfo->uEventsPerCpu;
+	}
+	if (apInfo->bFrozen)
+	{
+		apInfo->rttFrozen = pTrace->rttFrozen;
+		get_trace_task_name(pTrace->uFrozenBy, apInfo->strFrozenBy);
+	}
+	return RET_SUCC;
+}
+/*****************************************************************************/
+INT
+get_trace_task_name(UINT16 auTask, PCHAR astrName)
+{
+	if (astrName == NULL)
+		return -EINVAL;
+
+	astrName[0] = '\0';
+	if (auTask >= LIM_TRACE_TASKS || auTask >= __atomic_load_n(&g_uTraceTaskCnt, __ATOMIC_ACQUIRE))
+		return -ENOENT;
+
+	memcpy(astrName, g_stTraceTasks[auTask].strName, MAX_NAME_LENGTH);
+	astrName[MAX_NAME_LENGTH - 1] = '\0';
+	return RET_SUCC;
+}
+/*****************************************************************************/
+static INT
+_compare_trace_events(const void* apLeft, const void* apRight)
+{
+	RTTIME rttLeft = ((const RT_TRACE_EVENT*)apLeft)->rttStamp;
+	RTTIME rttRight = ((const RT_TRACE_EVENT*)apRight)->rttStamp;
+	return (rttLeft > rttRight) - (rttLeft < rttRight);
+}
+/*****************************************************************************/
+INT
+read_trace_events(RT_TRACE_EVENT* apEvents, UINT32 auMaxCnt)
+{
+	RT_TRACE_BUFFER* pTrace = __atomic_load_n(&g_pTrace, __ATOMIC_ACQUIRE);
+	if (pTrace == NULL || apEvents == NULL)
+		return -EINVAL;
+
+	UINT32 uCnt = 0;
+	UINT32 uRingSize = pTrace->uEventMask + 1;
+	for (UINT32 uCpu = 0; uCpu < pTrace->uCpuCnt; uCpu++)
+	{
+		RT_TRACE_RING* pRing = &pTrace->stRings[uCpu];
+		UINT64 ullHead = __atomic_load_n(&pRing->ullHead, __ATOMIC_ACQUIRE);
+		UINT64 ullFirst = (ullHead > uRingSize) ? ullHead - uRingSize : 0;
+
+		// newest events first, so that a short buffer keeps the end of the trace
+		for (UINT64 ullPos = ullHead; ullPos > ullFirst && uCnt < auMaxCnt; ullPos--)
+		{
+			RT_TRACE_EVENT* pEvent = &pRing->pEvents[(ullPos - 1) & pTrace->uEventMask];
+			UINT32 uSeq = __atomic_load_n(&pEvent->uSeq, __ATOMIC_ACQUIRE);
+			if (uSeq != (UINT32)ullPos)
+				continue;
+			apEvents[uCnt] = *pEvent;
+			__atomic_thread_fence(__ATOMIC_ACQUIRE);
+			// overwritten while copying
+			if (__atomic_load_n(&pEvent->uSeq, __ATOMIC_RELAXED) != uSeq)
+				continue;
+			uCnt++;
+		}
+	}
+
+	qsort(apEvents, uCnt, sizeof(RT_TRACE_EVENT), _compare_trace_events);
+	return (INT)uCnt;
+}
+/*****************************************************************************/
+static VOID
+_write_json_string(FILE* apFile, const PCHAR astrValue)
+{
+	fputc('"', apFile);
+	for (const CHAR* pChar = astrValue; *pChar != '\0'; pChar++)
+	{
+		if (*pChar == '"' || *pChar == '\\')
+			fputc('\\', apFile);
+		if ((UINT8)*pChar >= 0x20)
+			fputc(*pChar, apFile);
+	}
+	fputc('"', apFile);
+}
+/*****************************************************************************/
+INT
+export_trace_json(const PCHAR astrPath)
+{
+	RT_TRACE_BUFFER* pTrace = __atomic_load_n(&g_pTrace, __ATOMIC_ACQUIRE);
+	if (pTrace == NULL || astrPath == NULL)
+		return -EINVAL;
+
+	UINT32 uMaxCnt = pTrace->uCpuCnt * (pTrace->uEventMask + 1);
+	RT_TRACE_EVENT* pEvents = (RT_TRACE_EVENT*)malloc(sizeof(RT_TRACE_EVENT) * uMaxCnt);
+	if (pEvents == NULL)
+		return -ENOMEM;
+
+	FILE* pFile = fopen(astrPath, "w");
+	if (pFile == NULL)
+	{
+		INT nErr = errno;
+		free(pEvents);
+		DBG_ERROR("FAILED : Export Trace (fopen): %s with errno (%d:%s)", astrPath, nErr, strerror(nErr));
+		return -nErr;
+	}
+
+	pthread_mutex_lock(&g_mtxTrace);
+	INT nCnt = read_trace_events(pEvents, uMaxCnt);
+	pthread_mutex_unlock(&g_mtxTrace);
+
+	// timestamps are microseconds for the trace viewers, the tasks are the threads of this process
+	PID nPid = getpid();
+	fprintf(pFile, "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n");
+	fprintf(pFile, "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":%d,\"args\":{\"name\":", (INT)nPid);
+	_write_json_string(pFile, (const PCHAR)program_invocation_short_name);
+	fprintf(pFile, "}}");
+
+	UINT32 uTaskCnt = __atomic_load_n(&g_uTraceTaskCnt, __ATOMIC_ACQUIRE);
+	for (UINT32 uTask = 0; uTask < uTaskCnt && uTask < LIM_TRACE_TASKS; uTask++)
+	{
+		if (g_stTraceTasks[uTask].nTid == 0)
+			continue;
+		fprintf(pFile, ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":%d,\"tid\":%d,\"args\":{\"name\":", (INT)nPid, (INT)g_stTraceTasks[uTask].nTid);
+		_write_json_string(pFile, g_stTraceTasks[uTask].strName);
+		fprintf(pFile, "}}");
+	}
+
+	BOOL bJobOpen[LIM_TRACE_TASKS] = { FALSE };
+	for (INT nIdx = 0; nIdx < nCnt; nIdx++)
+	{
+		RT_TRACE_EVENT* pEvent = &pEvents[nIdx];
+		if (pEvent->uType >= eTraceTypeCnt)
+			continue;
+
+		// events recorded by another thread (create, resume) go to the track of the task they are about
+		PID nTid = pEvent->nTid;
+		BOOL bKnown = (pEvent->uTask < uTaskCnt && pEvent->uTask < LIM_TRACE_TASKS);
+		if (bKnown && g_stTraceTasks[pEvent->uTask].nTid != 0)
+			nTid = g_stTraceTasks[pEvent->uTask].nTid;
+
+		// a job is the slice from its wakeup until the task waits again, a wait without a wakeup stays an instant
+		const CHAR* strPhase = "i";
+		if (bKnown && pEvent->uType == eTraceWakeup && bJobOpen[pEvent->uTask] == FALSE)
+		{
+			strPhase = "B";
+			bJobOpen[pEvent->uTask] = TRUE;
+		}
+		else if (bKnown && pEvent->uType == eTraceWait && bJobOpen[pEvent->uTask] == TRUE)
+		{
+			strPhase = "E";
+			bJobOpen[pEvent->uTask] = FALSE;
+		}
+
+		fprintf(pFile, ",\n{\"name\":\"%s\",\"cat\":\"rtposix\",\"ph\":\"%s\",\"ts\":%llu.%03llu,\"pid\":%d,\"tid\":%d",
+				(strPhase[0] != 'i') ? "job" : g_strTraceTypes[pEvent->uType], strPhase,
+				(unsigned long long)(pEvent->rttStamp / 1000), (unsigned long long)(pEvent->rttStamp % 1000), (INT)nPid, (INT)nTid);
+		if (strPhase[0] == 'i')
+			fprintf(pFile, ",\"s\":\"%s\"", (pEvent->uType == eTraceOverrun) ? "p" : "t");
+		fprintf(pFile, ",\"args\":{\"event\":\"%s\",\"arg\":%llu,\"cpu\":%u", g_strTraceTypes[pEvent->uType], (unsigned long long)pEvent->ullArg, pEvent->uCpu);
+		if (bKnown)
+		{
+			fprintf(pFile, ",\"task\":");
+			_write_json_string(pFile, g_stTraceTasks[pEvent->uTask].strName);
+		}
+		fprintf(pFile, "}}");
+	}
+	fprintf(pFile, "\n]}\n");
+
+	INT nRet = (fclose(pFile) == 0) ? nCnt : -errno;
+	free(pEvents);
+	if (nRet >= 0)
+		DBG_TRACE("SUCCESS: Export Trace : path=%s, events=%d", astrPath, nCnt);
+	return nRet;
+}
+/*****************************************************************************/
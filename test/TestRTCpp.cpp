@@ -0,0 +1,112 @@
+/*
+ *  This file is owned by the Embedded Systems Laboratory of Seoul National University of Science and Technology
+ *  as a part of RT-AIDE or the RTOS-Agnostic and Interoperable Development Environment for Real-time Systems
+ *
+ *  File: TestRTCpp.cpp
+ *  Author: 2022 Raimarius Delgado
+ *  Description: Unit test for the RT-Posix C++ wrapper based on GTest
+ *
+ *
+ *
+ *
+*/
+#include "UnitTest.h"
+#include "rt_posix.hpp"
+
+static_assert(rt::Millis<2>::value == std::chrono::milliseconds(2), "rt::Millis");
+static_assert(rt::Micros<250>::value == std::chrono::microseconds(250), "rt::Micros");
+static_assert(rt::to_rttime(rt::Seconds<1>::value) == 1000000000, "rt::to_rttime");
+static_assert(rt::Priority<80>::value == 80, "rt::Priority");
+
+TEST(testRTCPP, one_shot)
+{
+    std::atomic<INT> nRuns{ 0 };
+    rt::Task stTask{ "CPP_ONCE", rt::priority<70>, [&] { nRuns++; } };
+    EXPECT_EQ(RET_SUCC, stTask.error());
+    EXPECT_EQ(RET_SUCC, stTask.start());
+    EXPECT_EQ(RET_SUCC, stTask.join());
+    EXPECT_EQ(1, nRuns.load());
+    EXPECT_FALSE(stTask.running());
+}
+
+TEST(testRTCPP, one_shot_nrt)
+{
+    rt::Task stTask{ "CPP_NRT", rt::nrt, [](rt::TaskBase& arSelf) {
+        while (!arSelf.stop_requested())
+            usleep(1000);
+    } };
+    EXPECT_EQ(RET_SUCC, stTask.start());
+    usleep(5000);
+    EXPECT_TRUE(stTask.running());
+    stTask.request_stop();
+    EXPECT_EQ(RET_SUCC, stTask.join());
+}
+
+TEST(testRTCPP, periodic_cycles)
+{
+    INT nCycles = 0;
+    rt::PeriodicTask stTask{ "CPP_CYCLE", rt::Millis<1>{}, rt::priority<80>, [&] { return ++nCycles < 10; } };
+    static_assert(decltype(stTask)::period == std::chrono::milliseconds(1), "period of the task");
+    EXPECT_EQ(RET_SUCC, stTask.error());
+
+    RTTIME rttStart = read_timer();
+    EXPECT_EQ(RET_SUCC, stTask.start());
+    EXPECT_EQ(RET_SUCC, stTask.join());
+    RTTIME rttElapsed = read_timer() - rttStart;
+
+    // every job waits for its release first, the tenth one runs no earlier than 10 periods after the start
+    EXPECT_EQ(10, nCycles);
+    EXPECT_GE(rttElapsed, (RTTIME)10000000);
+
+    POSIX_TASK_STATS stStats;
+    EXPECT_EQ(RET_SUCC, stTask.stats(stStats));
+    EXPECT_EQ(10U, stStats.ullCycles);
+    EXPECT_EQ(stStats.ullOverruns, stTask.overruns());
+}
+
+TEST(testRTCPP, periodic_stop)
+{
+    std::atomic<UINT64> ullCycles{ 0 };
+    std::atomic<UINT64> ullMissed{ 0 };
+    rt::PeriodicTask stTask{ "CPP_STOP", rt::Micros<500>{}, rt::priority<75>, [&](UINT64 aullMissed) {
+        ullCycles++;
+        ullMissed += aullMissed;
+    } };
+    EXPECT_EQ(RET_SUCC, stTask.start());
+    usleep(20000);
+    EXPECT_TRUE(stTask.running());
+    stTask.request_stop();
+    EXPECT_EQ(RET_SUCC, stTask.join());
+    EXPECT_GT(ullCycles.load(), 10U);
+    // every wait handed its missed releases to the body, except one that the stop request ended
+    EXPECT_EQ(ullMissed.load() + stTask.last_missed(), stTask.overruns());
+}
+
+TEST(testRTCPP, destructor_stops)
+{
+    std::atomic<UINT64> ullCycles{ 0 };
+    {
+        rt::PeriodicTask stTask{ "CPP_SCOPE", rt::Millis<1>{}, rt::priority<70>, [&] { ullCycles++; } };
+        EXPECT_EQ(RET_SUCC, stTask.start());
+        usleep(5000);
+    }
+    UINT64 ullAfter = ullCycles.load();
+    usleep(5000);
+    EXPECT_GT(ullAfter, 0U);
+    EXPECT_EQ(ullAfter, ullCycles.load());
+}
+
+TEST(testRTCPP, destructor_waits)
+{
+    std::atomic<bool> bReturned{ false };
+    {
+        // the callable ignores the stop request for longer than the join() timeout
+        rt::Task stTask{ "CPP_SLOW", rt::nrt, [&] {
+            usleep(1500000);
+            bReturned = true;
+        } };
+        EXPECT_EQ(RET_SUCC, stTask.start());
+        usleep(10000);
+    }
+    EXPECT_TRUE(bReturned.load());
+}
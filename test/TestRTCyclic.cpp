@@ -0,0 +1,129 @@
+/*
+ *  This file is owned by the Embedded Systems Laboratory of Seoul National University of Science and Technology
+ *  as a part of RT-AIDE or the RTOS-Agnostic and Interoperable Development Environment for Real-time Systems
+ *
+ *  File: TestRTCyclic.cpp
+ *  Author: 2022 Raimarius Delgado
+ *  Description: Unit test for the RT-Posix cyclic executive based on GTest
+ *
+ *
+ *
+ *
+*/
+#include "UnitTest.h"
+#include "rt_cyclic.h"
+
+#define TEST_CYCLIC_MINOR	(1000000)
+#define TEST_CYCLIC_LOG_CNT	(512)
+
+typedef struct _TEST_CYCLIC_LOG
+{
+    UINT32          uCnt;
+    UINT8           uEntries[TEST_CYCLIC_LOG_CNT];
+} TEST_CYCLIC_LOG;
+
+static TEST_CYCLIC_LOG g_stCyclicLog;
+static UINT8 g_uCyclicIds[3] = { 0, 1, 2 };
+
+void test_cyclic_proc(void* arg)
+{
+    if (g_stCyclicLog.uCnt < TEST_CYCLIC_LOG_CNT)
+        g_stCyclicLog.uEntries[g_stCyclicLog.uCnt++] = *(UINT8*)arg;
+}
+
+void test_cyclic_spin(void* arg)
+{
+    spin_timer(300000);
+}
+
+static INT test_cyclic_budget(POSIX_CYCLIC* apCyclic, INT anEntry, RTTIME aullExecTime, PVOID apArg)
+{
+    INT* pCnt = (INT*)apArg;
+    return (++(*pCnt) >= 3) ? RET_FAIL : RET_SUCC;
+}
+
+TEST(testRTCYCLIC, entry_checks)
+{
+    POSIX_CYCLIC stCyclic;
+    EXPECT_EQ(RET_SUCC, create_cyclic_executive(&stCyclic, (const PCHAR)"CYC_CHK", 0, 70, TEST_CYCLIC_MINOR));
+    EXPECT_EQ(-EINVAL, start_cyclic_executive(&stCyclic, SET_TM_NOW));
+
+    // not harmonic, phase out of the period, a major frame over the limit
+    EXPECT_EQ(-EINVAL, add_cyclic_entry(&stCyclic, (const PCHAR)"HALF", 1500000, 0, 0, &test_cyclic_proc, NULL));
+    EXPECT_EQ(-EINVAL, add_cyclic_entry(&stCyclic, (const PCHAR)"PHASE", 2 * TEST_CYCLIC_MINOR, 2, 0, &test_cyclic_proc, NULL));
+    EXPECT_EQ(0, add_cyclic_entry(&stCyclic, (const PCHAR)"SEVEN", 7 * TEST_CYCLIC_MINOR, 0, 0, &test_cyclic_proc, NULL));
+    EXPECT_EQ(1, add_cyclic_entry(&stCyclic, (const PCHAR)"ELEVEN", 11 * TEST_CYCLIC_MINOR, 0, 0, &test_cyclic_proc, NULL));
+    EXPECT_EQ(-EINVAL, start_cyclic_executive(&stCyclic, SET_TM_NOW));
+
+    POSIX_CYCLIC_ENTRY stEntry;
+    EXPECT_EQ(RET_SUCC, get_cyclic_entry(&stCyclic, 1, &stEntry));
+    EXPECT_EQ(11U, stEntry.uDivider);
+    EXPECT_EQ(-EINVAL, get_cyclic_entry(&stCyclic, 2, &stEntry));
+    EXPECT_EQ(RET_SUCC, delete_cyclic_executive(&stCyclic));
+}
+
+TEST(testRTCYCLIC, multi_rate)
+{
+    POSIX_CYCLIC stCyclic;
+    ZERO_MEMORY(&g_stCyclicLog, sizeof(g_stCyclicLog));
+    EXPECT_EQ(RET_SUCC, create_cyclic_executive(&stCyclic, (const PCHAR)"CYC_RATE", 0, 80, TEST_CYCLIC_MINOR));
+
+    // registered slowest first, the table still runs the faster rates first
+    EXPECT_EQ(0, add_cyclic_entry(&stCyclic, (const PCHAR)"100HZ", 10 * TEST_CYCLIC_MINOR, 3, 0, &test_cyclic_proc, &g_uCyclicIds[2]));
+    EXPECT_EQ(1, add_cyclic_entry(&stCyclic, (const PCHAR)"500HZ", 2 * TEST_CYCLIC_MINOR, 1, 0, &test_cyclic_proc, &g_uCyclicIds[1]));
+    EXPECT_EQ(2, add_cyclic_entry(&stCyclic, (const PCHAR)"1KHZ", TEST_CYCLIC_MINOR, 0, 0, &test_cyclic_proc, &g_uCyclicIds[0]));
+    EXPECT_EQ(RET_SUCC, start_cyclic_executive(&stCyclic, SET_TM_NOW));
+    EXPECT_EQ(-EBUSY, add_cyclic_entry(&stCyclic, (const PCHAR)"LATE", TEST_CYCLIC_MINOR, 0, 0, &test_cyclic_proc, NULL));
+
+    usleep(60000);
+    EXPECT_EQ(RET_SUCC, stop_cyclic_executive(&stCyclic));
+
+    POSIX_CYCLIC_STATS stStats;
+    EXPECT_EQ(RET_SUCC, get_cyclic_stats(&stCyclic, &stStats));
+    EXPECT_EQ(10U, stStats.uMajorFrames);
+    EXPECT_GT(stStats.ullFrames, 20U);
+    EXPECT_EQ(0U, stStats.ullBudgetOverruns);
+
+    POSIX_CYCLIC_ENTRY stFast, stMid, stSlow;
+    EXPECT_EQ(RET_SUCC, get_cyclic_entry(&stCyclic, 2, &stFast));
+    EXPECT_EQ(RET_SUCC, get_cyclic_entry(&stCyclic, 1, &stMid));
+    EXPECT_EQ(RET_SUCC, get_cyclic_entry(&stCyclic, 0, &stSlow));
+    EXPECT_EQ(stStats.ullFrames, stFast.ullCalls);
+    if (stStats.ullFramesSkipped == 0)
+    {
+        EXPECT_EQ(stStats.ullFrames / 2, stMid.ullCalls);
+        EXPECT_EQ((stStats.ullFrames + 6) / 10, stSlow.ullCalls);
+
+        // frame 0: 1KHZ, frame 1: 1KHZ 500HZ, frame 2: 1KHZ, frame 3: 1KHZ 500HZ 100HZ
+        const UINT8 uExpected[] = { 0, 0, 1, 0, 0, 1, 2 };
+        for (UINT32 uIdx = 0; uIdx < sizeof(uExpected); uIdx++)
+            EXPECT_EQ(uExpected[uIdx], g_stCyclicLog.uEntries[uIdx]) << uIdx;
+    }
+    EXPECT_EQ(RET_SUCC, delete_cyclic_executive(&stCyclic));
+}
+
+TEST(testRTCYCLIC, budget_overrun)
+{
+    POSIX_CYCLIC stCyclic;
+    INT nHandled = 0;
+    EXPECT_EQ(RET_SUCC, create_cyclic_executive(&stCyclic, (const PCHAR)"CYC_BDGT", 0, 80, TEST_CYCLIC_MINOR));
+    EXPECT_EQ(RET_SUCC, set_cyclic_budget_handler(&stCyclic, &test_cyclic_budget, &nHandled));
+    EXPECT_EQ(0, add_cyclic_entry(&stCyclic, (const PCHAR)"SPIN", 2 * TEST_CYCLIC_MINOR, 0, 100000, &test_cyclic_spin, NULL));
+    EXPECT_EQ(RET_SUCC, start_cyclic_executive(&stCyclic, SET_TM_NOW));
+
+    // the handler stops the executive on the third overrun
+    for (INT nIdx = 0; nIdx < 100 && __atomic_load_n(&stCyclic.stTask.dwStatus, __ATOMIC_ACQUIRE) != eDead; nIdx++)
+        usleep(2000);
+    EXPECT_EQ(3, nHandled);
+
+    POSIX_CYCLIC_ENTRY stEntry;
+    EXPECT_EQ(RET_SUCC, get_cyclic_entry(&stCyclic, 0, &stEntry));
+    EXPECT_EQ(3U, stEntry.ullBudgetOverruns);
+    EXPECT_EQ(3U, stEntry.ullCalls);
+    EXPECT_GE(stEntry.ullExecMax, (RTTIME)300000);
+
+    POSIX_CYCLIC_STATS stStats;
+    EXPECT_EQ(RET_SUCC, get_cyclic_stats(&stCyclic, &stStats));
+    EXPECT_EQ(3U, stStats.ullBudgetOverruns);
+    EXPECT_EQ(RET_SUCC, delete_cyclic_executive(&stCyclic));
+}
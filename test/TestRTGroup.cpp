@@ -0,0 +1,145 @@
+/*
+ *  This file is owned by the Embedded Systems Laboratory of Seoul National University of Science and Technology
+ *  as a part of RT-AIDE or the RTOS-Agnostic and Interoperable Development Environment for Real-time Systems
+ *
+ *  File: TestRTGroup.cpp
+ *  Author: 2022 Raimarius Delgado
+ *  Description: Unit test for the RT-Posix synchronized task group start based on GTest
+ *
+ *
+ *
+ *
+*/
+#include "UnitTest.h"
+#include "rt_group.h"
+#include "rt_sched.h"
+
+#define TEST_GROUP_TASKS	(3)
+#define TEST_GROUP_JOBS		(5)
+#define TEST_GROUP_PERIOD	(2000000)
+
+typedef struct _TEST_GROUP_TASK
+{
+    RTTIME          rttNextRelease[TEST_GROUP_JOBS];
+    RTTIME          rttStart[TEST_GROUP_JOBS];
+    BOOL            bDone;
+} TEST_GROUP_TASK;
+
+void test_group_proc(void* arg)
+{
+    TEST_GROUP_TASK* pTest = (TEST_GROUP_TASK*)arg;
+    for (INT nIdx = 0; nIdx < TEST_GROUP_JOBS; nIdx++)
+    {
+        pTest->rttStart[nIdx] = read_timer();
+        pTest->rttNextRelease[nIdx] = get_next_release(NULL);
+        wait_next_period(NULL);
+    }
+    __atomic_store_n(&pTest->bDone, TRUE, __ATOMIC_RELEASE);
+}
+
+TEST(testRTGROUP, start_task_group)
+{
+    POSIX_TASK_GROUP stGroup;
+    POSIX_TASK stTasks[TEST_GROUP_TASKS];
+    TEST_GROUP_TASK stTest[TEST_GROUP_TASKS];
+    const RTTIME ullOffsets[TEST_GROUP_TASKS] = { 0, 500000, 1000000 };
+    CHAR strName[MAX_NAME_LENGTH];
+    memset(stTest, 0, sizeof(stTest));
+
+    EXPECT_EQ(RET_SUCC, create_task_group(&stGroup, (const PCHAR)"GROUP"));
+    EXPECT_EQ(-EINVAL, start_task_group(&stGroup, SET_TM_NOW));
+
+    // only periodic tasks that were not started can join
+    POSIX_TASK stAperiodic;
+    EXPECT_EQ(RET_SUCC, create_rt_task(&stAperiodic, (const PCHAR)"APERIODIC", 0, 50));
+    EXPECT_EQ(-EINVAL, add_group_task(&stGroup, &stAperiodic, 0, &test_group_proc, &stTest[0]));
+
+    for (INT nIdx = 0; nIdx < TEST_GROUP_TASKS; nIdx++)
+    {
+        snprintf(strName, sizeof(strName), "GROUP%d", nIdx);
+        EXPECT_EQ(RET_SUCC, create_group_task(&stGroup, &stTasks[nIdx], (const PCHAR)strName, 0, 60,
+                                              TEST_GROUP_PERIOD, ullOffsets[nIdx], &test_group_proc, &stTest[nIdx]));
+    }
+    EXPECT_EQ((UINT32)TEST_GROUP_TASKS, stGroup.uTaskCnt);
+    EXPECT_EQ(0, get_group_release(&stGroup));
+    EXPECT_EQ(-EINVAL, start_task_group(&stGroup, read_timer() - 1));
+
+    RTTIME rttRelease = read_timer() + 20000000;
+    EXPECT_EQ(RET_SUCC, start_task_group(&stGroup, rttRelease));
+    EXPECT_EQ(rttRelease, get_group_release(&stGroup));
+    EXPECT_EQ(-EBUSY, start_task_group(&stGroup, SET_TM_NOW));
+
+    usleep(20000 + TEST_GROUP_JOBS * TEST_GROUP_PERIOD / 1000 + 50000);
+
+    // every job of every task lies on the common grid shifted by its own offset
+    for (INT nIdx = 0; nIdx < TEST_GROUP_TASKS; nIdx++)
+    {
+        EXPECT_TRUE(__atomic_load_n(&stTest[nIdx].bDone, __ATOMIC_ACQUIRE));
+        for (INT nJob = 0; nJob < TEST_GROUP_JOBS; nJob++)
+        {
+            RTTIME rttJobRelease = rttRelease + ullOffsets[nIdx] + nJob * TEST_GROUP_PERIOD;
+            EXPECT_EQ(rttJobRelease + TEST_GROUP_PERIOD, stTest[nIdx].rttNextRelease[nJob]);
+            EXPECT_GE(stTest[nIdx].rttStart[nJob], rttJobRelease);
+        }
+    }
+
+    EXPECT_EQ(RET_SUCC, delete_task_group(&stGroup));
+    EXPECT_EQ(0u, stGroup.uTaskCnt);
+}
+
+void test_group_idle_proc(void* arg)
+{
+    // back in eReady after the first release, the thread keeps running
+    wait_next_period(NULL);
+    while (__atomic_load_n((BOOL*)arg, __ATOMIC_ACQUIRE) == FALSE)
+        usleep(1000);
+}
+
+TEST(testRTGROUP, abort_task_group)
+{
+    POSIX_TASK_GROUP stGroup;
+    POSIX_TASK stTasks[TEST_GROUP_TASKS];
+    TEST_GROUP_TASK stTest[TEST_GROUP_TASKS];
+    CHAR strName[MAX_NAME_LENGTH];
+    BOOL bStop = FALSE;
+    memset(stTest, 0, sizeof(stTest));
+
+    EXPECT_EQ(RET_SUCC, create_task_group(&stGroup, (const PCHAR)"ABORT"));
+
+    // a started periodic task between two cycles cannot join
+    POSIX_TASK stRunning;
+    EXPECT_EQ(RET_SUCC, create_rt_task(&stRunning, (const PCHAR)"RUNNING", 0, 50));
+    EXPECT_EQ(RET_SUCC, set_task_period(&stRunning, SET_TM_NOW, TEST_GROUP_PERIOD));
+    EXPECT_EQ(RET_SUCC, start_task(&stRunning, &test_group_idle_proc, &bStop));
+    usleep(20000);
+    EXPECT_EQ((DWORD)eReady, stRunning.dwStatus);
+    EXPECT_EQ(-EINVAL, add_group_task(&stGroup, &stRunning, 0, &test_group_proc, &stTest[0]));
+    __atomic_store_n(&bStop, TRUE, __ATOMIC_RELEASE);
+
+    // the admission test rejects the last task, the first two are parked at the barrier by then
+    for (INT nIdx = 0; nIdx < TEST_GROUP_TASKS; nIdx++)
+    {
+        snprintf(strName, sizeof(strName), "ABORT%d", nIdx);
+        EXPECT_EQ(RET_SUCC, create_group_task(&stGroup, &stTasks[nIdx], (const PCHAR)strName, 0, 60,
+                                              TEST_GROUP_PERIOD, 0, &test_group_proc, &stTest[nIdx]));
+        EXPECT_EQ(RET_SUCC, set_cpu_affinity(&stTasks[nIdx], 0));
+        EXPECT_EQ(RET_SUCC, set_task_wcet(&stTasks[nIdx], 900000, 0));
+    }
+    EXPECT_EQ(RET_SUCC, set_admission_control(eAdmitReject));
+    EXPECT_EQ(-EBUSY, start_task_group(&stGroup, SET_TM_NOW));
+    EXPECT_EQ(RET_SUCC, set_admission_control(eAdmitOff));
+
+    // the started tasks are gone without running their entry, the rejected one was never started
+    EXPECT_EQ((DWORD)eDead, stTasks[0].dwStatus);
+    EXPECT_EQ((DWORD)eDead, stTasks[1].dwStatus);
+    EXPECT_EQ(0, stTasks[2].nPid);
+    for (INT nIdx = 0; nIdx < TEST_GROUP_TASKS; nIdx++)
+        EXPECT_EQ(0u, stTest[nIdx].rttStart[0]);
+    EXPECT_EQ(0, get_group_release(&stGroup));
+    EXPECT_EQ(-EBUSY, start_task_group(&stGroup, SET_TM_NOW));
+
+    EXPECT_EQ(RET_SUCC, delete_task_group(&stGroup));
+    usleep(10000);
+    EXPECT_EQ((DWORD)eDead, stRunning.dwStatus);
+    delete_task(&stRunning);
+}
@@ -0,0 +1,193 @@
+/*
+ *  This file is owned by the Embedded Systems Laboratory of Seoul National University of Science and Technology
+ *  as a part of RT-AIDE or the RTOS-Agnostic and Interoperable Development Environment for Real-time Systems
+ *
+ *  File: TestRTLatest.cpp
+ *  Author: 2022 Raimarius Delgado
+ *  Description: Unit test for the RT-Posix latest-value channels based on GTest
+ *
+ *
+ *
+ *
+*/
+#include "UnitTest.h"
+#include "rt_latest.h"
+
+#define TEST_LATEST_WRITES	(3000)
+
+// odd size on purpose, the last word of the seqlock is a partial one
+typedef struct _TEST_LATEST_STATE
+{
+    UINT64          ullCount;
+    UINT64          ullWords[30];
+    UINT8           uTail[5];
+} TEST_LATEST_STATE;
+
+typedef struct _TEST_LATEST
+{
+    RT_SEQLOCK      stLock;
+    RT_TRIPLE_BUF   stBuf;
+    BOOL            bDone;
+    UINT64          ullReads;
+    UINT64          ullTorn;
+    UINT64          ullBackwards;
+} TEST_LATEST;
+
+static void test_latest_fill(TEST_LATEST_STATE* apState, UINT64 aullCount)
+{
+    apState->ullCount = aullCount;
+    for (INT nIdx = 0; nIdx < 30; nIdx++)
+        apState->ullWords[nIdx] = aullCount;
+    memset(apState->uTail, (INT)(aullCount & 0xFF), sizeof(apState->uTail));
+}
+
+static BOOL test_latest_torn(TEST_LATEST_STATE* apState)
+{
+    for (INT nIdx = 0; nIdx < 30; nIdx++)
+        if (apState->ullWords[nIdx] != apState->ullCount)
+            return TRUE;
+    for (INT nIdx = 0; nIdx < 5; nIdx++)
+        if (apState->uTail[nIdx] != (UINT8)(apState->ullCount & 0xFF))
+            return TRUE;
+    return FALSE;
+}
+
+void test_latest_writer(void* arg)
+{
+    TEST_LATEST* pTest = (TEST_LATEST*)arg;
+    TEST_LATEST_STATE stState;
+    for (UINT64 ullCount = 1; ullCount <= TEST_LATEST_WRITES; ullCount++)
+    {
+        test_latest_fill(&stState, ullCount);
+        rt_seqlock_write(&pTest->stLock, &stState);
+
+        // in place: fill the slot of the writer and hand it over
+        test_latest_fill((TEST_LATEST_STATE*)rt_triple_write_slot(&pTest->stBuf), ullCount);
+        rt_triple_publish(&pTest->stBuf);
+        usleep(20);
+    }
+    __atomic_store_n(&pTest->bDone, TRUE, __ATOMIC_RELEASE);
+}
+
+void test_latest_reader(void* arg)
+{
+    TEST_LATEST* pTest = (TEST_LATEST*)arg;
+    TEST_LATEST_STATE stState;
+    UINT64 ullLastLock = 0, ullLastBuf = 0;
+    BOOL bDone = FALSE;
+    while (bDone == FALSE)
+    {
+        bDone = __atomic_load_n(&pTest->bDone, __ATOMIC_ACQUIRE);
+        UINT32 uVersion;
+        if (rt_seqlock_read(&pTest->stLock, &stState, &uVersion) == RET_SUCC)
+        {
+            pTest->ullReads++;
+            pTest->ullTorn += test_latest_torn(&stState);
+            pTest->ullBackwards += (stState.ullCount < ullLastLock || stState.ullCount != uVersion);
+            ullLastLock = stState.ullCount;
+        }
+        BOOL bFresh;
+        if (rt_triple_read(&pTest->stBuf, &stState, &bFresh) == RET_SUCC)
+        {
+            pTest->ullTorn += test_latest_torn(&stState);
+            pTest->ullBackwards += (stState.ullCount < ullLastBuf || (bFresh == FALSE && stState.ullCount != ullLastBuf));
+            ullLastBuf = stState.ullCount;
+        }
+    }
+
+    // the last values are the ones seen after the writer is done
+    pTest->ullBackwards += (ullLastLock != TEST_LATEST_WRITES) + (ullLastBuf != TEST_LATEST_WRITES);
+}
+
+TEST(testRTLATEST, seqlock)
+{
+    RT_SEQLOCK stLock;
+    TEST_LATEST_STATE stState, stRead;
+    UINT32 uVersion = 0;
+
+    EXPECT_EQ(-EINVAL, create_rt_seqlock(&stLock, 0));
+    EXPECT_EQ(RET_SUCC, create_rt_seqlock(&stLock, sizeof(TEST_LATEST_STATE)));
+    EXPECT_EQ(-ENODATA, rt_seqlock_try_read(&stLock, &stRead, &uVersion));
+    EXPECT_EQ(0U, get_rt_seqlock_version(&stLock));
+
+    test_latest_fill(&stState, 7);
+    EXPECT_EQ(RET_SUCC, rt_seqlock_write(&stLock, &stState));
+    test_latest_fill(&stState, 8);
+    EXPECT_EQ(RET_SUCC, rt_seqlock_write(&stLock, &stState));
+    EXPECT_EQ(RET_SUCC, rt_seqlock_read(&stLock, &stRead, &uVersion));
+    EXPECT_EQ(0, memcmp(&stState, &stRead, sizeof(TEST_LATEST_STATE)));
+    EXPECT_EQ(2U, uVersion);
+    EXPECT_EQ(2U, get_rt_seqlock_version(&stLock));
+
+    // a write in progress makes the reader retry
+    stLock.uSeq++;
+    EXPECT_EQ(-EAGAIN, rt_seqlock_try_read(&stLock, &stRead, NULL));
+    stLock.uSeq--;
+
+    // the sequence wraps to 0 after 2^31 writes, the value stays readable
+    stLock.uSeq = 0xFFFFFFFE;
+    test_latest_fill(&stState, 9);
+    EXPECT_EQ(RET_SUCC, rt_seqlock_write(&stLock, &stState));
+    EXPECT_EQ(0U, stLock.uSeq);
+    EXPECT_EQ(RET_SUCC, rt_seqlock_try_read(&stLock, &stRead, &uVersion));
+    EXPECT_EQ(0, memcmp(&stState, &stRead, sizeof(TEST_LATEST_STATE)));
+    EXPECT_EQ(0U, uVersion);
+    EXPECT_EQ(RET_SUCC, delete_rt_seqlock(&stLock));
+    EXPECT_EQ(-EINVAL, delete_rt_seqlock(&stLock));
+}
+
+TEST(testRTLATEST, triple_buffer)
+{
+    RT_TRIPLE_BUF stBuf;
+    TEST_LATEST_STATE stState, stRead;
+    BOOL bFresh = TRUE;
+
+    EXPECT_EQ(RET_SUCC, create_rt_triple_buf(&stBuf, sizeof(TEST_LATEST_STATE)));
+    EXPECT_EQ(-ENODATA, rt_triple_read(&stBuf, &stRead, &bFresh));
+    EXPECT_FALSE(bFresh);
+
+    // only the latest of several writes is read, once as fresh
+    for (UINT64 ullCount = 1; ullCount <= 3; ullCount++)
+    {
+        test_latest_fill(&stState, ullCount);
+        EXPECT_EQ(RET_SUCC, rt_triple_write(&stBuf, &stState));
+    }
+    EXPECT_EQ(RET_SUCC, rt_triple_read(&stBuf, &stRead, &bFresh));
+    EXPECT_TRUE(bFresh);
+    EXPECT_EQ(3U, stRead.ullCount);
+    EXPECT_EQ(RET_SUCC, rt_triple_read(&stBuf, &stRead, &bFresh));
+    EXPECT_FALSE(bFresh);
+    EXPECT_EQ(3U, stRead.ullCount);
+    EXPECT_EQ(3U, get_rt_triple_published(&stBuf));
+
+    // the slots of the writer and of the reader are never the same
+    EXPECT_NE(rt_triple_write_slot(&stBuf), rt_triple_read_slot(&stBuf, NULL));
+    EXPECT_EQ(RET_SUCC, delete_rt_triple_buf(&stBuf));
+}
+
+TEST(testRTLATEST, rt_to_nrt)
+{
+    static TEST_LATEST stTest;
+    POSIX_TASK stWriter, stReader;
+    ZERO_MEMORY(&stTest, sizeof(stTest));
+    EXPECT_EQ(RET_SUCC, create_rt_seqlock(&stTest.stLock, sizeof(TEST_LATEST_STATE)));
+    EXPECT_EQ(RET_SUCC, create_rt_triple_buf(&stTest.stBuf, sizeof(TEST_LATEST_STATE)));
+
+    EXPECT_EQ(RET_SUCC, create_nrt_task(&stReader, (const PCHAR)"LATEST_RD", 0));
+    EXPECT_EQ(RET_SUCC, create_rt_task(&stWriter, (const PCHAR)"LATEST_WR", 0, 70));
+    EXPECT_EQ(RET_SUCC, start_task(&stReader, &test_latest_reader, &stTest));
+    EXPECT_EQ(RET_SUCC, start_task(&stWriter, &test_latest_writer, &stTest));
+
+    for (INT nIdx = 0; nIdx < 500 && (stReader.dwStatus != eDead || stWriter.dwStatus != eDead); nIdx++)
+        usleep(10000);
+    EXPECT_EQ((DWORD)eDead, stReader.dwStatus);
+    EXPECT_GT(stTest.ullReads, 0U);
+    EXPECT_EQ(0U, stTest.ullTorn);
+    EXPECT_EQ(0U, stTest.ullBackwards);
+    EXPECT_EQ((UINT64)TEST_LATEST_WRITES, get_rt_triple_published(&stTest.stBuf));
+
+    delete_task(&stWriter);
+    delete_task(&stReader);
+    delete_rt_seqlock(&stTest.stLock);
+    delete_rt_triple_buf(&stTest.stBuf);
+}
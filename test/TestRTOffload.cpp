@@ -0,0 +1,135 @@
+/*
+ *  This file is owned by the Embedded Systems Laboratory of Seoul National University of Science and Technology
+ *  as a part of RT-AIDE or the RTOS-Agnostic and Interoperable Development Environment for Real-time Systems
+ *
+ *  File: TestRTOffload.cpp
+ *  Author: 2022 Raimarius Delgado
+ *  Description: Unit test for the RT-Posix NRT offload pool based on GTest
+ *
+ *
+ *
+ *
+*/
+#include "UnitTest.h"
+#include "rt_offload.h"
+
+#define TEST_OFFLOAD_JOBS	(1000)
+
+typedef struct _TEST_OFFLOAD
+{
+    RT_OFFLOAD_POOL stPool;
+    UINT32          uCounter;
+    UINT32          uRejected;
+    BOOL            bStarted;
+    BOOL            bRelease;
+    BOOL            bDone;
+} TEST_OFFLOAD;
+
+void test_offload_job(void* arg)
+{
+    TEST_OFFLOAD* pTest = (TEST_OFFLOAD*)arg;
+    __atomic_add_fetch(&pTest->uCounter, 1, __ATOMIC_RELAXED);
+}
+
+void test_offload_blocking_job(void* arg)
+{
+    TEST_OFFLOAD* pTest = (TEST_OFFLOAD*)arg;
+    __atomic_store_n(&pTest->bStarted, TRUE, __ATOMIC_RELEASE);
+    while (__atomic_load_n(&pTest->bRelease, __ATOMIC_ACQUIRE) == FALSE)
+        usleep(1000);
+}
+
+void test_offload_producer_proc(void* arg)
+{
+    TEST_OFFLOAD* pTest = (TEST_OFFLOAD*)arg;
+    for (INT nIdx = 0; nIdx < TEST_OFFLOAD_JOBS; nIdx++)
+    {
+        if (rt_offload_submit(&pTest->stPool, &test_offload_job, pTest) != RET_SUCC)
+            pTest->uRejected++;
+        if (nIdx % 100 == 99)
+            wait_next_period(NULL);
+    }
+    __atomic_store_n(&pTest->bDone, TRUE, __ATOMIC_RELEASE);
+}
+
+static void test_offload_wait(UINT32* apuValue, UINT32 auExpected)
+{
+    for (INT nIdx = 0; nIdx < 200 && __atomic_load_n(apuValue, __ATOMIC_ACQUIRE) != auExpected; nIdx++)
+        usleep(5000);
+}
+
+TEST(testRTOFFLOAD, rt_offload_submit)
+{
+    static TEST_OFFLOAD stTest;
+    POSIX_TASK stProducer;
+    RT_OFFLOAD_STATS stStats;
+    memset(&stTest, 0, sizeof(stTest));
+
+    EXPECT_EQ(-EINVAL, create_rt_offload_pool(&stTest.stPool, (const PCHAR)"OFL", 0, 64));
+    EXPECT_EQ(-EINVAL, create_rt_offload_pool(&stTest.stPool, (const PCHAR)"OFL", 2, 0));
+    EXPECT_EQ(RET_SUCC, create_rt_offload_pool(&stTest.stPool, (const PCHAR)"OFL", 2, 100));
+    EXPECT_EQ(127u, stTest.stPool.uJobMask);
+    EXPECT_EQ(-EINVAL, rt_offload_submit(&stTest.stPool, NULL, &stTest));
+
+    // a FIFO task bursts jobs, the NRT workers pick them up whenever it sleeps
+    EXPECT_EQ(RET_SUCC, create_rt_task(&stProducer, (const PCHAR)"OFLPROD", 0, 80));
+    EXPECT_EQ(RET_SUCC, set_task_period(&stProducer, SET_TM_NOW, 5000000));
+    EXPECT_EQ(RET_SUCC, start_task(&stProducer, &test_offload_producer_proc, &stTest));
+    for (INT nIdx = 0; nIdx < 200 && __atomic_load_n(&stTest.bDone, __ATOMIC_ACQUIRE) == FALSE; nIdx++)
+        usleep(5000);
+    EXPECT_TRUE(__atomic_load_n(&stTest.bDone, __ATOMIC_ACQUIRE));
+    test_offload_wait(&stTest.uCounter, TEST_OFFLOAD_JOBS - stTest.uRejected);
+
+    EXPECT_EQ(RET_SUCC, get_rt_offload_stats(&stTest.stPool, &stStats));
+    EXPECT_EQ((UINT64)TEST_OFFLOAD_JOBS, stStats.ullSubmitted + stStats.ullRejected);
+    EXPECT_EQ((UINT64)stTest.uRejected, stStats.ullRejected);
+    EXPECT_EQ(stStats.ullSubmitted, stStats.ullExecuted);
+    EXPECT_EQ((UINT32)stStats.ullExecuted, stTest.uCounter);
+    EXPECT_EQ(0u, stStats.uDepth);
+    EXPECT_GT(stStats.uDepthMax, 1u);
+    EXPECT_LE(stStats.uDepthMax, 2u * 128u);
+    EXPECT_GT(stStats.ullLatencyMax, 0u);
+    EXPECT_GE(stStats.ullLatencyMax, stStats.ullLatencyAvg);
+    EXPECT_EQ(RET_SUCC, delete_rt_offload_pool(&stTest.stPool));
+    EXPECT_EQ(-EINVAL, rt_offload_submit(&stTest.stPool, &test_offload_job, &stTest));
+}
+
+TEST(testRTOFFLOAD, full_and_steal)
+{
+    static TEST_OFFLOAD stTest;
+    RT_OFFLOAD_STATS stStats;
+    memset(&stTest, 0, sizeof(stTest));
+
+    // one worker is kept busy, the rings fill up and the submit fails instead of waiting
+    EXPECT_EQ(RET_SUCC, create_rt_offload_pool(&stTest.stPool, (const PCHAR)"OFLF", 1, 4));
+    EXPECT_EQ(RET_SUCC, rt_offload_submit(&stTest.stPool, &test_offload_blocking_job, &stTest));
+    for (INT nIdx = 0; nIdx < 200 && __atomic_load_n(&stTest.bStarted, __ATOMIC_ACQUIRE) == FALSE; nIdx++)
+        usleep(5000);
+    for (INT nIdx = 0; nIdx < 4; nIdx++)
+        EXPECT_EQ(RET_SUCC, rt_offload_submit(&stTest.stPool, &test_offload_job, &stTest));
+    EXPECT_EQ(-EAGAIN, rt_offload_submit(&stTest.stPool, &test_offload_job, &stTest));
+
+    __atomic_store_n(&stTest.bRelease, TRUE, __ATOMIC_RELEASE);
+    test_offload_wait(&stTest.uCounter, 4);
+    EXPECT_EQ(RET_SUCC, get_rt_offload_stats(&stTest.stPool, &stStats));
+    EXPECT_EQ(5u, stStats.ullExecuted);
+    EXPECT_EQ(1u, stStats.ullRejected);
+    EXPECT_EQ(4u, stStats.uDepthMax);
+    EXPECT_EQ(RET_SUCC, delete_rt_offload_pool(&stTest.stPool));
+
+    // while one worker is blocked, the other one empties both rings
+    memset(&stTest, 0, sizeof(stTest));
+    EXPECT_EQ(RET_SUCC, create_rt_offload_pool(&stTest.stPool, (const PCHAR)"OFLS", 2, 16));
+    EXPECT_EQ(RET_SUCC, rt_offload_submit(&stTest.stPool, &test_offload_blocking_job, &stTest));
+    for (INT nIdx = 0; nIdx < 200 && __atomic_load_n(&stTest.bStarted, __ATOMIC_ACQUIRE) == FALSE; nIdx++)
+        usleep(5000);
+    for (INT nIdx = 0; nIdx < 20; nIdx++)
+        EXPECT_EQ(RET_SUCC, rt_offload_submit(&stTest.stPool, &test_offload_job, &stTest));
+    test_offload_wait(&stTest.uCounter, 20);
+    EXPECT_EQ(20u, __atomic_load_n(&stTest.uCounter, __ATOMIC_ACQUIRE));
+    EXPECT_EQ(RET_SUCC, get_rt_offload_stats(&stTest.stPool, &stStats));
+    EXPECT_GT(stStats.ullStolen, 0u);
+
+    __atomic_store_n(&stTest.bRelease, TRUE, __ATOMIC_RELEASE);
+    EXPECT_EQ(RET_SUCC, delete_rt_offload_pool(&stTest.stPool));
+}
@@ -0,0 +1,126 @@
+/*
+ *  This file is owned by the Embedded Systems Laboratory of Seoul National University of Science and Technology
+ *  as a part of RT-AIDE or the RTOS-Agnostic and Interoperable Development Environment for Real-time Systems
+ *
+ *  File: TestRTParallel.cpp
+ *  Author: 2022 Raimarius Delgado
+ *  Description: Unit test for the RT-Posix fork-join worker pool based on GTest
+ *
+ *
+ *
+ *
+*/
+#include "UnitTest.h"
+#include "rt_parallel.h"
+
+#define TEST_PAR_WORKERS	(3)
+#define TEST_PAR_ITEMS		(10000)
+#define TEST_PAR_CYCLES		(20)
+
+typedef struct _TEST_PAR
+{
+    RT_PAR_POOL     stPool;
+    UINT32          uVisits[TEST_PAR_ITEMS];
+    UINT32          uChunks;
+    INT             nResult;
+    BOOL            bDone;
+} TEST_PAR;
+
+void test_par_body(UINT32 auBegin, UINT32 auEnd, PVOID apArg)
+{
+    TEST_PAR* pTest = (TEST_PAR*)apArg;
+    for (UINT32 uIdx = auBegin; uIdx < auEnd; uIdx++)
+        __atomic_add_fetch(&pTest->uVisits[uIdx], 1, __ATOMIC_RELAXED);
+    __atomic_add_fetch(&pTest->uChunks, 1, __ATOMIC_RELAXED);
+}
+
+static void test_par_cpus(INT* apnCpus)
+{
+    INT nCpuCnt = (INT)sysconf(_SC_NPROCESSORS_ONLN);
+    for (INT nIdx = 0; nIdx < TEST_PAR_WORKERS; nIdx++)
+        apnCpus[nIdx] = nIdx % nCpuCnt;
+}
+
+static void test_par_check_visits(TEST_PAR* apTest, UINT32 auExpected)
+{
+    UINT32 uWrong = 0;
+    for (UINT32 uIdx = 0; uIdx < TEST_PAR_ITEMS; uIdx++)
+        uWrong += (apTest->uVisits[uIdx] != auExpected);
+    EXPECT_EQ(0u, uWrong);
+}
+
+TEST(testRTPARALLEL, rt_parallel_for)
+{
+    static TEST_PAR stTest;
+    INT nCpus[TEST_PAR_WORKERS];
+    RT_PAR_STATS stStats;
+    memset(&stTest, 0, sizeof(stTest));
+    test_par_cpus(nCpus);
+
+    EXPECT_EQ(-EINVAL, create_rt_par_pool(&stTest.stPool, (const PCHAR)"PAR", nCpus, 0, 60, 0));
+    EXPECT_EQ(-EINVAL, create_rt_par_pool(&stTest.stPool, (const PCHAR)"PAR", nCpus, LIM_PAR_WORKERS + 1, 60, 0));
+
+    // pure futex handoff
+    EXPECT_EQ(RET_SUCC, create_rt_par_pool(&stTest.stPool, (const PCHAR)"PAR", nCpus, TEST_PAR_WORKERS, 60, 0));
+    EXPECT_EQ(-EINVAL, rt_parallel_for(&stTest.stPool, 0, TEST_PAR_ITEMS, 0, NULL, &stTest));
+    EXPECT_EQ(RET_SUCC, rt_parallel_for(&stTest.stPool, 5, 5, 0, &test_par_body, &stTest));
+    EXPECT_EQ(0u, stTest.uChunks);
+
+    // the default chunking gives every worker and the caller one chunk
+    EXPECT_EQ(RET_SUCC, rt_parallel_for(&stTest.stPool, 0, TEST_PAR_ITEMS, 0, &test_par_body, &stTest));
+    EXPECT_EQ((UINT32)TEST_PAR_WORKERS + 1, stTest.uChunks);
+    test_par_check_visits(&stTest, 1);
+
+    // uneven chunks cover the range exactly once
+    stTest.uChunks = 0;
+    EXPECT_EQ(RET_SUCC, rt_parallel_for(&stTest.stPool, 0, TEST_PAR_ITEMS, 333, &test_par_body, &stTest));
+    EXPECT_EQ((UINT32)((TEST_PAR_ITEMS + 332) / 333), stTest.uChunks);
+    test_par_check_visits(&stTest, 2);
+
+    EXPECT_EQ(RET_SUCC, get_rt_par_stats(&stTest.stPool, &stStats));
+    EXPECT_EQ(2u, stStats.ullCalls);
+    EXPECT_GT(stStats.ullSpanLast, 0u);
+    EXPECT_GE(stStats.ullSpanMax, stStats.ullSpanLast);
+    EXPECT_GE(stStats.ullSpanLast, stStats.ullJoinLast);
+    EXPECT_EQ(RET_SUCC, delete_rt_par_pool(&stTest.stPool));
+    EXPECT_EQ(-EINVAL, rt_parallel_for(&stTest.stPool, 0, TEST_PAR_ITEMS, 0, &test_par_body, &stTest));
+}
+
+void test_par_periodic_proc(void* arg)
+{
+    TEST_PAR* pTest = (TEST_PAR*)arg;
+    for (INT nIdx = 0; nIdx < TEST_PAR_CYCLES && pTest->nResult == RET_SUCC; nIdx++)
+    {
+        pTest->nResult = rt_parallel_for(&pTest->stPool, 0, TEST_PAR_ITEMS, 1000, &test_par_body, pTest);
+        wait_next_period(NULL);
+    }
+    __atomic_store_n(&pTest->bDone, TRUE, __ATOMIC_RELEASE);
+}
+
+TEST(testRTPARALLEL, periodic_caller)
+{
+    static TEST_PAR stTest;
+    POSIX_TASK stTask;
+    INT nCpus[TEST_PAR_WORKERS];
+    RT_PAR_STATS stStats;
+    memset(&stTest, 0, sizeof(stTest));
+    test_par_cpus(nCpus);
+
+    // spin briefly before sleeping, every loop joins before the next period
+    EXPECT_EQ(RET_SUCC, create_rt_par_pool(&stTest.stPool, (const PCHAR)"PARS", nCpus, TEST_PAR_WORKERS, 70, 20000));
+    EXPECT_EQ(RET_SUCC, create_rt_task(&stTask, (const PCHAR)"PARCALLER", 0, 70));
+    EXPECT_EQ(RET_SUCC, set_cpu_affinity(&stTask, 0));
+    EXPECT_EQ(RET_SUCC, set_task_period(&stTask, SET_TM_NOW, 2000000));
+    EXPECT_EQ(RET_SUCC, start_task(&stTask, &test_par_periodic_proc, &stTest));
+
+    for (INT nIdx = 0; nIdx < 200 && __atomic_load_n(&stTest.bDone, __ATOMIC_ACQUIRE) == FALSE; nIdx++)
+        usleep(10000);
+
+    EXPECT_TRUE(__atomic_load_n(&stTest.bDone, __ATOMIC_ACQUIRE));
+    EXPECT_EQ(RET_SUCC, stTest.nResult);
+    test_par_check_visits(&stTest, TEST_PAR_CYCLES);
+    EXPECT_EQ(RET_SUCC, get_rt_par_stats(&stTest.stPool, &stStats));
+    EXPECT_EQ((UINT64)TEST_PAR_CYCLES, stStats.ullCalls);
+    EXPECT_GE(stStats.ullSpanSum, stStats.ullSpanMax);
+    EXPECT_EQ(RET_SUCC, delete_rt_par_pool(&stTest.stPool));
+}
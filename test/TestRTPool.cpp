@@ -0,0 +1,130 @@
+/*
+ *  This file is owned by the Embedded Systems Laboratory of Seoul National University of Science and Technology
+ *  as a part of RT-AIDE or the RTOS-Agnostic and Interoperable Development Environment for Real-time Systems
+ *
+ *  File: TestRTPool.cpp
+ *  Author: 2022 Raimarius Delgado
+ *  Description: Unit test for the RT-Posix memory pool based on GTest
+ *
+ *
+ *
+ *
+*/
+#include "UnitTest.h"
+#include "rt_pool.h"
+
+TEST(testRTPOOL, create_rt_pool)
+{
+    RT_POOL stPool;
+    UINT32 uSizes[] = { 64, 32 };
+    UINT32 uCounts[] = { 4, 4 };
+
+    // classes are not sorted
+    INT nRet = create_rt_pool(&stPool, (const PCHAR)"POOL", uSizes, uCounts, 2);
+    EXPECT_EQ(-EINVAL, nRet);
+
+    // sorted as requested, but both sizes round up to the same block
+    uSizes[0] = 20;
+    uSizes[1] = 30;
+    nRet = create_rt_pool(&stPool, (const PCHAR)"POOL", uSizes, uCounts, 2);
+    EXPECT_EQ(-EINVAL, nRet);
+
+    // too many classes
+    nRet = create_rt_pool(&stPool, (const PCHAR)"POOL", uSizes, uCounts, RT_POOL_MAX_CLASSES + 1);
+    EXPECT_EQ(-EINVAL, nRet);
+
+    // Successful
+    uSizes[0] = 20;
+    uSizes[1] = 64;
+    nRet = create_rt_pool(&stPool, (const PCHAR)"POOL", uSizes, uCounts, 2);
+    EXPECT_EQ(RET_SUCC, nRet);
+    EXPECT_EQ(32u, stPool.stClasses[0].uBlockSize);
+
+    nRet = delete_rt_pool(&stPool);
+    EXPECT_EQ(RET_SUCC, nRet);
+}
+
+TEST(testRTPOOL, alloc_free)
+{
+    RT_POOL stPool;
+    RT_POOL_STATS stStats;
+    UINT32 uSizes[] = { 32, 256 };
+    UINT32 uCounts[] = { 2, 1 };
+    PVOID pBlocks[4];
+
+    INT nRet = create_rt_pool(&stPool, (const PCHAR)"POOL", uSizes, uCounts, 2);
+    EXPECT_EQ(RET_SUCC, nRet);
+
+    // too large for any class
+    EXPECT_TRUE(rt_pool_alloc(&stPool, 1024) == NULL);
+
+    // small class first, then overflow into the larger class, then fail
+    pBlocks[0] = rt_pool_alloc(&stPool, 16);
+    pBlocks[1] = rt_pool_alloc(&stPool, 16);
+    pBlocks[2] = rt_pool_alloc(&stPool, 16);
+    pBlocks[3] = rt_pool_alloc(&stPool, 16);
+    EXPECT_TRUE(pBlocks[0] != NULL && pBlocks[1] != NULL && pBlocks[2] != NULL);
+    EXPECT_TRUE(pBlocks[3] == NULL);
+    EXPECT_EQ(0u, (uintptr_t)pBlocks[0] % RT_POOL_ALIGNMENT);
+    memset(pBlocks[2], 0xAB, 256);
+
+    EXPECT_EQ(RET_SUCC, get_rt_pool_stats(&stPool, 0, &stStats));
+    EXPECT_EQ(2u, stStats.uInUse);
+    EXPECT_EQ(2u, stStats.uHighWater);
+    EXPECT_EQ(1u, stStats.ullFailures);
+
+    // foreign and misaligned pointers are rejected
+    INT nLocal;
+    EXPECT_EQ(-EINVAL, rt_pool_free(&stPool, &nLocal));
+    EXPECT_EQ(-EINVAL, rt_pool_free(&stPool, (PBYTE)pBlocks[0] + 1));
+
+    for (INT nIdx = 0; nIdx < 3; nIdx++)
+        EXPECT_EQ(RET_SUCC, rt_pool_free(&stPool, pBlocks[nIdx]));
+
+    EXPECT_EQ(RET_SUCC, get_rt_pool_stats(&stPool, 0, &stStats));
+    EXPECT_EQ(0u, stStats.uInUse);
+    EXPECT_EQ(2u, stStats.uHighWater);
+    EXPECT_EQ(-EINVAL, get_rt_pool_stats(&stPool, 2, &stStats));
+
+    delete_rt_pool(&stPool);
+}
+
+static RT_POOL g_stTestPool;
+
+void test_pool_proc(void* arg)
+{
+    INT* nErrors = (INT*)arg;
+    for (INT nIdx = 0; nIdx < 10000; nIdx++)
+    {
+        INT* pBlock = (INT*)rt_pool_alloc(&g_stTestPool, sizeof(INT));
+        if (pBlock == NULL)
+            continue;
+        *pBlock = nIdx;
+        if (*pBlock != nIdx || rt_pool_free(&g_stTestPool, pBlock) != RET_SUCC)
+            (*nErrors)++;
+    }
+}
+
+TEST(testRTPOOL, concurrent_alloc_free)
+{
+    POSIX_TASK stTasks[2];
+    RT_POOL_STATS stStats;
+    UINT32 uSizes[] = { 64 };
+    UINT32 uCounts[] = { 8 };
+    INT nErrors[3] = { 0, 0, 0 };
+
+    INT nRet = create_rt_pool(&g_stTestPool, (const PCHAR)"POOL", uSizes, uCounts, 1);
+    EXPECT_EQ(RET_SUCC, nRet);
+
+    EXPECT_EQ(RET_SUCC, spawn_nrt_task(&stTasks[0], (const PCHAR)"POOL0", 0, &test_pool_proc, &nErrors[0]));
+    EXPECT_EQ(RET_SUCC, spawn_nrt_task(&stTasks[1], (const PCHAR)"POOL1", 0, &test_pool_proc, &nErrors[1]));
+    test_pool_proc(&nErrors[2]);
+    while (stTasks[0].dwStatus != eDead || stTasks[1].dwStatus != eDead)
+        usleep(1000);
+
+    EXPECT_EQ(0, nErrors[0] + nErrors[1] + nErrors[2]);
+    EXPECT_EQ(RET_SUCC, get_rt_pool_stats(&g_stTestPool, 0, &stStats));
+    EXPECT_EQ(0u, stStats.uInUse);
+
+    delete_rt_pool(&g_stTestPool);
+}
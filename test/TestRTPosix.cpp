@@ -12,6 +12,8 @@
 */
 #include "UnitTest.h"
 #include "posix_rt.h"
+#include <sys/eventfd.h>
+#include <sys/wait.h>
 
 TEST(testRTPOSIX, create_rt_task)
 {
@@ -226,3 +228,771 @@ TEST(testRTPOSIX, spin_timer)
     RTTIME nTimerDone = read_timer();
     EXPECT_TRUE(nTimerDone >= nTimerStart + 1000000000);
 }
+
+void test_periodic_proc(void* arg)
+{
+    int *nCycles = (int*)arg;
+    for (int nIdx = 0; nIdx < *nCycles; nIdx++)
+        wait_next_period(NULL);
+    *nCycles = 0; // signal the end of the periodic loop
+}
+
+TEST(testRTPOSIX, get_task_stats)
+{
+    POSIX_TASK stRTTask;
+    POSIX_TASK_STATS stStats;
+    INT nCycles = 200;
+
+    INT nRet = create_rt_task(&stRTTask, (const PCHAR)"ABCD", 0, 99);
+    EXPECT_EQ(RET_SUCC, nRet);
+
+    // failed
+    nRet = get_task_stats(&stRTTask, NULL);
+    EXPECT_EQ(-EPERM, nRet);
+
+    // no cycles yet
+    nRet = get_task_stats(&stRTTask, &stStats);
+    EXPECT_EQ(RET_SUCC, nRet);
+    EXPECT_EQ(0u, stStats.ullCycles);
+
+    nRet = set_task_period(&stRTTask, SET_TM_NOW, 1000000);
+    EXPECT_EQ(RET_SUCC, nRet);
+    nRet = start_task(&stRTTask, &test_periodic_proc, (void*)&nCycles);
+    EXPECT_EQ(RET_SUCC, nRet);
+    sleep(1);
+    EXPECT_EQ(0, nCycles);
+
+    nRet = get_task_stats(&stRTTask, &stStats);
+    EXPECT_EQ(RET_SUCC, nRet);
+    EXPECT_EQ(200u, stStats.ullCycles);
+    EXPECT_LE(stStats.ullLatMin, stStats.ullLatMean);
+    EXPECT_LE(stStats.ullLatMean, stStats.ullLatMax);
+    EXPECT_LE(stStats.ullLatP99, stStats.ullLatP999);
+    EXPECT_LE(stStats.ullLatP999, stStats.ullLatMax);
+    EXPECT_LE(stStats.ullExecMin, stStats.ullExecMax);
+    EXPECT_LE(stStats.ullExecP999, stStats.ullExecMax);
+}
+
+void test_logging_proc(void* arg)
+{
+    int *nArg = (int*)arg;
+    DBG_TRACE("deferred from %s: %d %5.2f %llu", "task", *nArg, 1.5, (unsigned long long)-1);
+    *nArg = 55;
+}
+
+TEST(testRTPOSIX, deferred_logger)
+{
+    POSIX_TASK stRTTask;
+    INT nArg = 0;
+
+    init_lowlevel_logger(TRUE);
+
+    // records are only printed once flushed
+    init_deferred_logger(TRUE);
+    DBG_INFO("deferred: %s %d %c %x %-4s|", "abc", -5, 'z', 255, "ab");
+    DBG_INFO("deferred: %*d %.*s", 6, 42, 2, "abcdef");
+    EXPECT_EQ(2, flush_lowlevel_logger());
+    EXPECT_EQ(0, flush_lowlevel_logger());
+    init_deferred_logger(FALSE);
+
+    // the drain task prints records of RT tasks
+    INT nRet = start_logger_task(1000000);
+    EXPECT_EQ(RET_SUCC, nRet);
+    EXPECT_EQ(-EBUSY, start_logger_task(1000000));
+
+    nRet = spawn_rt_task(&stRTTask, (const PCHAR)"ABCD", 0, 99, &test_logging_proc, (void*)&nArg);
+    EXPECT_EQ(RET_SUCC, nRet);
+    usleep(100000);
+    EXPECT_EQ(55, nArg);
+
+    nRet = stop_logger_task();
+    EXPECT_EQ(RET_SUCC, nRet);
+    EXPECT_EQ(0u, get_lowlevel_logger_drops());
+    init_lowlevel_logger(FALSE);
+}
+
+TEST(testRTPOSIX, create_dl_task)
+{
+    POSIX_TASK stDLTask;
+    POSIX_TASK_INFO stTaskInfo;
+
+    // runtime is greater than the deadline
+    INT nRet = create_dl_task(&stDLTask, (const PCHAR)"ABCD", 0, 600000, 500000, 1000000);
+    EXPECT_EQ(-EINVAL, nRet);
+
+    // deadline is greater than the period
+    nRet = create_dl_task(&stDLTask, (const PCHAR)"ABCD", 0, 100000, 2000000, 1000000);
+    EXPECT_EQ(-EINVAL, nRet);
+
+    // runtime is below the kernel's minimum
+    nRet = create_dl_task(&stDLTask, (const PCHAR)"ABCD", 0, 100, 0, 1000000);
+    EXPECT_EQ(-EINVAL, nRet);
+
+    // Successful, deadline defaults to the period
+    nRet = create_dl_task(&stDLTask, (const PCHAR)"ABCD", 0, 100000, 0, 1000000);
+    EXPECT_EQ(RET_SUCC, nRet);
+    EXPECT_EQ(1000000u, stDLTask.ullDlDeadline);
+
+    nRet = get_task_info(&stDLTask, &stTaskInfo);
+    EXPECT_EQ(RET_SUCC, nRet);
+    EXPECT_EQ(SCHED_DEADLINE, stTaskInfo.nSchedPolicy);
+    EXPECT_TRUE(stTaskInfo.bPeriodic);
+
+    // DL tasks cannot be pinned to a single CPU
+    nRet = set_cpu_affinity(&stDLTask, 0);
+    EXPECT_EQ(-EINVAL, nRet);
+}
+
+TEST(testRTPOSIX, spawn_dl_task)
+{
+    POSIX_TASK stDLTask;
+    POSIX_TASK_STATS stStats;
+    INT nCycles = 50;
+
+    INT nRet = spawn_dl_task(&stDLTask, (const PCHAR)"ABCD", 0, 200000, 0, 2000000, &test_periodic_proc, (void*)&nCycles);
+    EXPECT_EQ(RET_SUCC, nRet);
+    sleep(1);
+    EXPECT_EQ(0, nCycles);
+
+    nRet = get_task_stats(&stDLTask, &stStats);
+    EXPECT_EQ(RET_SUCC, nRet);
+    EXPECT_EQ(50u, stStats.ullCycles);
+
+    // the kernel refuses periods beyond sched_deadline_period_max_us (4s by default), start_task() reports it
+    nCycles = 50;
+    nRet = spawn_dl_task(&stDLTask, (const PCHAR)"ABCD", 0, 200000, 0, 5000000000ULL, &test_periodic_proc, (void*)&nCycles);
+    EXPECT_EQ(-EINVAL, nRet);
+    EXPECT_EQ((DWORD)eDead, stDLTask.dwStatus);
+    EXPECT_EQ(50, nCycles);
+}
+
+void test_stack_proc(void* arg)
+{
+    // touch most of the stack to make sure the arena slot is usable
+    volatile char byBuffer[32768];
+    memset((void*)byBuffer, 0xA5, sizeof(byBuffer));
+    *(int*)arg = byBuffer[sizeof(byBuffer) - 1];
+}
+
+void test_busy_period_proc(void* arg)
+{
+    // back in eReady after the release, busy until told to stop
+    volatile int *nRun = (volatile int*)arg;
+    wait_next_period(NULL);
+    while (*nRun != 0)
+        spin_timer(100000);
+}
+
+TEST(testRTPOSIX, stack_arena)
+{
+    POSIX_TASK stTasks[3];
+    UINT32 uSlotCnt = 0, uInUse = 0;
+    int nArg = 0;
+
+    INT nRet = init_stack_arena(2, 0);
+    EXPECT_EQ(-EINVAL, nRet);
+
+    nRet = init_stack_arena(2, 65536);
+    EXPECT_EQ(RET_SUCC, nRet);
+
+    // two tasks fit in the arena, the third one falls back to a glibc stack
+    nRet = create_rt_task(&stTasks[0], (const PCHAR)"ABCD", 0, 99);
+    EXPECT_EQ(RET_SUCC, nRet);
+    EXPECT_EQ(0, stTasks[0].nStackSlot);
+    nRet = create_nrt_task(&stTasks[1], (const PCHAR)"ABCD", 0);
+    EXPECT_EQ(RET_SUCC, nRet);
+    EXPECT_EQ(1, stTasks[1].nStackSlot);
+    nRet = create_nrt_task(&stTasks[2], (const PCHAR)"ABCD", 0);
+    EXPECT_EQ(RET_SUCC, nRet);
+    EXPECT_EQ(-1, stTasks[2].nStackSlot);
+
+    get_stack_arena_usage(&uSlotCnt, &uInUse);
+    EXPECT_EQ(2u, uSlotCnt);
+    EXPECT_EQ(2u, uInUse);
+    EXPECT_EQ(-EBUSY, release_stack_arena());
+
+    // deleting a task that has not started gives its stack back at once
+    nRet = delete_task(&stTasks[1]);
+    EXPECT_EQ(RET_SUCC, nRet);
+    nRet = create_nrt_task(&stTasks[2], (const PCHAR)"ABCD", 0);
+    EXPECT_EQ(1, stTasks[2].nStackSlot);
+    delete_task(&stTasks[2]);
+
+    // a periodic task in its body is in eReady, but it is running on its stack
+    volatile int nRun = 1;
+    nRet = create_nrt_task(&stTasks[1], (const PCHAR)"ABCD", 0);
+    EXPECT_EQ(1, stTasks[1].nStackSlot);
+    nRet = set_task_period(&stTasks[1], SET_TM_NOW, 1000000);
+    EXPECT_EQ(RET_SUCC, nRet);
+    nRet = start_task(&stTasks[1], &test_busy_period_proc, (void*)&nRun);
+    EXPECT_EQ(RET_SUCC, nRet);
+    usleep(50000);
+    EXPECT_EQ((DWORD)eReady, stTasks[1].dwStatus);
+    EXPECT_NE(RET_SUCC, delete_task(&stTasks[1]));
+    EXPECT_NE(RET_SUCC, start_task(&stTasks[1], &test_busy_period_proc, (void*)&nRun));
+    EXPECT_EQ(1, stTasks[1].nStackSlot);
+    get_stack_arena_usage(NULL, &uInUse);
+    EXPECT_EQ(2u, uInUse);
+    nRun = 0;
+    usleep(50000);
+    EXPECT_EQ((DWORD)eDead, stTasks[1].dwStatus);
+    EXPECT_EQ(-1, stTasks[1].nStackSlot);
+
+    // a finished task recycles its stack once the thread is gone
+    nRet = start_task(&stTasks[0], &test_stack_proc, (void*)&nArg);
+    EXPECT_EQ(RET_SUCC, nRet);
+    usleep(100000);
+    EXPECT_EQ((int)(signed char)0xA5, nArg);
+    EXPECT_EQ(-1, stTasks[0].nStackSlot);
+
+    get_stack_arena_usage(NULL, &uInUse);
+    EXPECT_EQ(0u, uInUse);
+    EXPECT_EQ(RET_SUCC, release_stack_arena());
+}
+
+TEST(testRTPOSIX, set_task_wakeup_mode)
+{
+    POSIX_TASK stRTTask;
+    POSIX_TASK stDLTask;
+    POSIX_TASK_STATS stStats;
+    INT nCycles = 200;
+
+    INT nRet = create_rt_task(&stRTTask, (const PCHAR)"ABCD", 0, 99);
+    EXPECT_EQ(RET_SUCC, nRet);
+
+    // unknown mode
+    nRet = set_task_wakeup_mode(&stRTTask, 5, 0);
+    EXPECT_EQ(-EINVAL, nRet);
+
+    // SCHED_DEADLINE tasks cannot spin
+    nRet = create_dl_task(&stDLTask, (const PCHAR)"ABCD", 0, 100000, 0, 1000000);
+    EXPECT_EQ(RET_SUCC, nRet);
+    nRet = set_task_wakeup_mode(&stDLTask, eWakeupHybrid, 0);
+    EXPECT_EQ(-EINVAL, nRet);
+
+    nRet = set_task_wakeup_mode(&stRTTask, eWakeupHybrid, 0);
+    EXPECT_EQ(RET_SUCC, nRet);
+    EXPECT_EQ((RTTIME)DEFAULT_SPIN_MARGIN, stRTTask.ullSpinMargin);
+
+    nRet = set_task_period(&stRTTask, SET_TM_NOW, 1000000);
+    EXPECT_EQ(RET_SUCC, nRet);
+    nRet = start_task(&stRTTask, &test_periodic_proc, (void*)&nCycles);
+    EXPECT_EQ(RET_SUCC, nRet);
+    sleep(1);
+    EXPECT_EQ(0, nCycles);
+
+    // the margin adapts but stays within the period, and no release happens early
+    nRet = get_task_stats(&stRTTask, &stStats);
+    EXPECT_EQ(RET_SUCC, nRet);
+    EXPECT_EQ(200u, stStats.ullCycles);
+    EXPECT_GE(stStats.ullSpinMargin, (RTTIME)LIM_SPIN_MARGIN_MIN);
+    EXPECT_LE(stStats.ullSpinMargin, (RTTIME)500000);
+    EXPECT_LT(stStats.ullLatMin, stStats.ullSpinMargin);
+}
+
+TEST(testRTPOSIX, read_timer_fast)
+{
+    // the fast timebase must follow CLOCK_MONOTONIC closely and never go backwards
+    RTTIME rttPrev = read_timer_fast();
+    for (INT nIdx = 0; nIdx < 100000; nIdx++)
+    {
+        RTTIME rttNow = read_timer_fast();
+        EXPECT_GE(rttNow, rttPrev);
+        rttPrev = rttNow;
+    }
+
+    RTTIME rttClock = read_timer();
+    RTTIME rttFast = read_timer_fast();
+    EXPECT_LT((rttFast > rttClock) ? rttFast - rttClock : rttClock - rttFast, (RTTIME)50000);
+
+    // the re-anchor keeps it on CLOCK_MONOTONIC over time and does not step back either
+    rttPrev = read_timer_fast();
+    RTTIME rttEnd = read_timer() + 1500000000ULL;
+    while (read_timer() < rttEnd)
+    {
+        usleep(10000);
+        // bracketed by two clock reads, a preemption in between only widens the window
+        RTTIME rttBefore = read_timer();
+        RTTIME rttNow = read_timer_fast();
+        RTTIME rttAfter = read_timer();
+        EXPECT_GE(rttNow, rttPrev);
+        EXPECT_GE(rttNow + 50000, rttBefore);
+        EXPECT_LE(rttNow, rttAfter + 50000);
+        rttPrev = rttNow;
+    }
+
+    // short spins end on time as well
+    RTTIME rttStart = read_timer();
+    spin_timer(20000);
+    EXPECT_GE(read_timer(), rttStart + 20000);
+}
+
+void test_busy_proc(void* arg)
+{
+    volatile int *nRun = (volatile int*)arg;
+    while (*nRun != 0)
+        usleep(1000);
+}
+
+TEST(testRTPOSIX, wait_task_end)
+{
+    POSIX_TASK stNRTTask;
+    volatile int nRun = 1;
+
+    EXPECT_EQ(-EINVAL, wait_task_end(NULL, TM_INFINITE));
+    EXPECT_EQ(RET_SUCC, create_nrt_task(&stNRTTask, (const PCHAR)"ABCD", 0));
+    // never started, nothing to wait for
+    EXPECT_EQ(RET_SUCC, wait_task_end(&stNRTTask, TM_INFINITE));
+
+    EXPECT_EQ(RET_SUCC, start_task(&stNRTTask, &test_busy_proc, (void*)&nRun));
+    RTTIME rttDeadline = read_timer() + 5000000;
+    EXPECT_EQ(-ETIMEDOUT, wait_task_end(&stNRTTask, rttDeadline));
+    EXPECT_GE(read_timer(), rttDeadline);
+
+    nRun = 0;
+    EXPECT_EQ(RET_SUCC, wait_task_end(&stNRTTask, TM_INFINITE));
+    EXPECT_EQ((DWORD)eDead, stNRTTask.dwStatus);
+    delete_task(&stNRTTask);
+}
+
+TEST(testRTPOSIX, get_cached_tid)
+{
+    EXPECT_EQ(gettid(), get_cached_tid());
+    EXPECT_EQ(gettid(), get_cached_tid());
+
+    // the child of a fork() reads its own TID, not the one cached by its parent
+    pid_t nChild = fork();
+    ASSERT_GE(nChild, 0);
+    if (nChild == 0)
+        _exit((get_cached_tid() == gettid()) ? 0 : 1);
+    INT nStatus = -1;
+    ASSERT_EQ(nChild, waitpid(nChild, &nStatus, 0));
+    EXPECT_TRUE(WIFEXITED(nStatus));
+    EXPECT_EQ(0, WEXITSTATUS(nStatus));
+}
+
+TEST(testRTPOSIX, set_cpu_affinity_mask)
+{
+    POSIX_TASK stNRTTask;
+    CPUSET stCpuSet;
+    volatile int nRun = 1;
+
+    INT nRet = create_nrt_task(&stNRTTask, (const PCHAR)"ABCD", 0);
+    EXPECT_EQ(RET_SUCC, nRet);
+
+    // empty set and CPUs beyond the available ones
+    CPU_ZERO(&stCpuSet);
+    nRet = set_cpu_affinity_mask(&stNRTTask, &stCpuSet);
+    EXPECT_EQ(-EINVAL, nRet);
+    CPU_SET(CPU_SETSIZE - 1, &stCpuSet);
+    nRet = set_cpu_affinity_mask(&stNRTTask, &stCpuSet);
+    EXPECT_EQ(-EINVAL, nRet);
+
+    // a running task is migrated at once
+    nRet = start_task(&stNRTTask, &test_busy_proc, (void*)&nRun);
+    EXPECT_EQ(RET_SUCC, nRet);
+    usleep(10000);
+
+    CPU_ZERO(&stCpuSet);
+    for (INT nCpu = 0; nCpu < get_available_cpus(); nCpu++)
+        CPU_SET(nCpu, &stCpuSet);
+    nRet = set_cpu_affinity_mask(&stNRTTask, &stCpuSet);
+    EXPECT_EQ(RET_SUCC, nRet);
+
+    CPUSET stKernelSet;
+    EXPECT_EQ(0, sched_getaffinity(stNRTTask.nPid, sizeof(stKernelSet), &stKernelSet));
+    EXPECT_TRUE(CPU_EQUAL(&stCpuSet, &stKernelSet));
+    EXPECT_EQ(RET_SUCC, get_cpu_affinity_mask(&stNRTTask, &stKernelSet));
+    EXPECT_TRUE(CPU_EQUAL(&stCpuSet, &stKernelSet));
+
+    // so is a periodic task in its body (eReady), it starts on CPU0 and moves to the last CPU
+    POSIX_TASK stPeriodic;
+    nRet = create_nrt_task(&stPeriodic, (const PCHAR)"ABCD", 0);
+    EXPECT_EQ(RET_SUCC, nRet);
+    EXPECT_EQ(RET_SUCC, set_task_period(&stPeriodic, SET_TM_NOW, 1000000));
+    EXPECT_EQ(RET_SUCC, start_task(&stPeriodic, &test_busy_period_proc, (void*)&nRun));
+    usleep(50000);
+    EXPECT_EQ((DWORD)eReady, stPeriodic.dwStatus);
+
+    CPU_ZERO(&stCpuSet);
+    CPU_SET(get_available_cpus() - 1, &stCpuSet);
+    nRet = set_cpu_affinity_mask(&stPeriodic, &stCpuSet);
+    EXPECT_EQ(RET_SUCC, nRet);
+    EXPECT_EQ(0, sched_getaffinity(stPeriodic.nPid, sizeof(stKernelSet), &stKernelSet));
+    EXPECT_TRUE(CPU_EQUAL(&stCpuSet, &stKernelSet));
+
+    // once the threads are gone their TIDs are never touched again
+    nRun = 0;
+    usleep(10000);
+    EXPECT_EQ(-ESRCH, set_cpu_affinity_mask(&stNRTTask, &stCpuSet));
+    EXPECT_EQ(-ESRCH, set_cpu_affinity_mask(&stPeriodic, &stCpuSet));
+}
+
+TEST(testRTPOSIX, set_task_placement)
+{
+    POSIX_TASK stRTTask;
+    POSIX_TASK stNRTTask;
+    CPUSET stIsolated, stHousekeeping;
+
+    INT nRet = set_task_placement(10);
+    EXPECT_EQ(-EINVAL, nRet);
+
+    INT nIsolated = get_isolated_cpus(&stIsolated);
+    INT nHousekeeping = get_housekeeping_cpus(&stHousekeeping);
+    EXPECT_GE(nIsolated, 0);
+    EXPECT_GE(nHousekeeping, 1);
+
+    nRet = set_task_placement(ePlaceIsolated);
+    EXPECT_EQ(RET_SUCC, nRet);
+
+    // RT tasks get a single CPU, isolated whenever the system has one
+    nRet = create_rt_task(&stRTTask, (const PCHAR)"ABCD", 0, 99);
+    EXPECT_EQ(RET_SUCC, nRet);
+    EXPECT_EQ(1, CPU_COUNT(&stRTTask.stCpuAffinity));
+    if (nIsolated > 0)
+    {
+        CPU_AND(&stIsolated, &stIsolated, &stRTTask.stCpuAffinity);
+        EXPECT_EQ(1, CPU_COUNT(&stIsolated));
+    }
+
+    // NRT tasks stay off the isolated CPUs
+    nRet = create_nrt_task(&stNRTTask, (const PCHAR)"ABCD", 0);
+    EXPECT_EQ(RET_SUCC, nRet);
+    EXPECT_TRUE(CPU_EQUAL(&stHousekeeping, &stNRTTask.stCpuAffinity));
+
+    nRet = set_task_placement(ePlaceCpu0);
+    EXPECT_EQ(RET_SUCC, nRet);
+}
+
+static INT test_count_visitor(POSIX_TASK* apTask, PVOID apArg)
+{
+    if (strcmp(apTask->strName, "REGISTRY") == 0)
+        (*(int*)apArg)++;
+    return RET_SUCC;
+}
+
+void test_burn_proc(void* arg)
+{
+    volatile int *nRun = (volatile int*)arg;
+    while (*nRun != 0)
+        spin_timer(100000);
+}
+
+TEST(testRTPOSIX, task_registry)
+{
+    POSIX_TASK stNRTTask;
+    POSIX_TASK_USAGE stUsage[LIM_TASK_REGISTRY];
+    volatile int nRun = 1;
+    int nVisited = 0;
+
+    EXPECT_EQ(NULL, find_task_by_name((const PCHAR)"REGISTRY"));
+
+    // a task is listed once its thread exists
+    INT nRet = create_nrt_task(&stNRTTask, (const PCHAR)"REGISTRY", 0);
+    EXPECT_EQ(RET_SUCC, nRet);
+    EXPECT_EQ(NULL, find_task_by_name((const PCHAR)"REGISTRY"));
+
+    nRet = start_task(&stNRTTask, &test_burn_proc, (void*)&nRun);
+    EXPECT_EQ(RET_SUCC, nRet);
+    EXPECT_EQ(&stNRTTask, find_task_by_name((const PCHAR)"REGISTRY"));
+
+    nRet = for_each_task(&test_count_visitor, &nVisited);
+    EXPECT_GE(nRet, 1);
+    EXPECT_EQ(1, nVisited);
+
+    // a busy task shows up in the snapshot with its CPU time and utilization
+    usleep(200000);
+
+    INT nCnt = get_task_snapshot(stUsage, LIM_TASK_REGISTRY);
+    EXPECT_GE(nCnt, 1);
+    INT nFound = -1;
+    for (INT nIdx = 0; nIdx < nCnt; nIdx++)
+        if (strcmp(stUsage[nIdx].strName, "REGISTRY") == 0)
+            nFound = nIdx;
+    ASSERT_GE(nFound, 0);
+    EXPECT_EQ(stNRTTask.nPid, stUsage[nFound].nPid);
+    EXPECT_GT(stUsage[nFound].ullCpuTime, (RTTIME)10000000);
+    EXPECT_GT(stUsage[nFound].uUtilization, 1000u);
+    EXPECT_LE(stUsage[nFound].uUtilization, 10100u);
+
+    // the final CPU time survives the end of the task, which leaves the registry
+    nRun = 0;
+    usleep(10000);
+    POSIX_TASK_USAGE stFinal;
+    nRet = get_task_usage(&stNRTTask, &stFinal);
+    EXPECT_EQ(RET_SUCC, nRet);
+    EXPECT_EQ((DWORD)eDead, stFinal.dwStatus);
+    EXPECT_GE(stFinal.ullCpuTime, stUsage[nFound].ullCpuTime);
+    EXPECT_EQ(NULL, find_task_by_name((const PCHAR)"REGISTRY"));
+
+    nRet = delete_task(&stNRTTask);
+    EXPECT_EQ(RET_SUCC, nRet);
+    EXPECT_EQ(NULL, find_task_by_name((const PCHAR)"REGISTRY"));
+}
+
+typedef struct _TEST_OVERRUN
+{
+    UINT64 ullMissed[9];
+    INT nRet[9];
+    UINT64 ullHandlerMissed;
+    INT nHandlerCalls;
+    BOOL bDone;
+} TEST_OVERRUN;
+
+void test_overrun_proc(void* arg)
+{
+    TEST_OVERRUN* pTest = (TEST_OVERRUN*)arg;
+
+    // start on a period boundary and then overrun by five and a half periods (four releases are missed)
+    pTest->nRet[0] = wait_next_period(&pTest->ullMissed[0]);
+    spin_timer(5500000);
+    for (INT nIdx = 1; nIdx < 9; nIdx++)
+        pTest->nRet[nIdx] = wait_next_period(&pTest->ullMissed[nIdx]);
+    pTest->bDone = TRUE;
+}
+
+static INT test_overrun_handler(POSIX_TASK* apTask, UINT64 aullMissed, PVOID apArg)
+{
+    TEST_OVERRUN* pTest = (TEST_OVERRUN*)apArg;
+    pTest->ullHandlerMissed += aullMissed;
+    pTest->nHandlerCalls++;
+    return eOverrunSkip;
+}
+
+static void test_run_overrun(INT anPolicy, TEST_OVERRUN* apTest, POSIX_TASK_STATS* apStats)
+{
+    POSIX_TASK stRTTask;
+    memset(apTest, 0, sizeof(TEST_OVERRUN));
+
+    INT nRet = create_rt_task(&stRTTask, (const PCHAR)"OVERRUN", 0, 99);
+    EXPECT_EQ(RET_SUCC, nRet);
+    nRet = set_overrun_policy(&stRTTask, anPolicy, &test_overrun_handler, apTest);
+    EXPECT_EQ(RET_SUCC, nRet);
+    nRet = set_task_period(&stRTTask, SET_TM_NOW, 1000000);
+    EXPECT_EQ(RET_SUCC, nRet);
+    nRet = start_task(&stRTTask, &test_overrun_proc, apTest);
+    EXPECT_EQ(RET_SUCC, nRet);
+    usleep(100000);
+    EXPECT_TRUE(apTest->bDone);
+    get_task_stats(&stRTTask, apStats);
+    delete_task(&stRTTask);
+}
+
+static UINT64 test_sum_missed(TEST_OVERRUN* apTest, INT* apnLate)
+{
+    // a loaded machine may add late cycles of its own, count them all
+    UINT64 ullTotal = 0;
+    *apnLate = 0;
+    for (INT nIdx = 0; nIdx < 9; nIdx++)
+    {
+        ullTotal += apTest->ullMissed[nIdx];
+        if (apTest->ullMissed[nIdx] > 0)
+            (*apnLate)++;
+        // the return code and the count agree on every call
+        EXPECT_EQ((apTest->ullMissed[nIdx] > 0) ? -ETIMEDOUT : RET_SUCC, apTest->nRet[nIdx]);
+    }
+    return ullTotal;
+}
+
+TEST(testRTPOSIX, set_overrun_policy)
+{
+    POSIX_TASK stRTTask;
+    TEST_OVERRUN stTest;
+    POSIX_TASK_STATS stStats;
+    INT nLate;
+
+    INT nRet = create_rt_task(&stRTTask, (const PCHAR)"ABCD", 0, 99);
+    EXPECT_EQ(RET_SUCC, nRet);
+    EXPECT_EQ(-EINVAL, set_overrun_policy(&stRTTask, 7, NULL, NULL));
+    EXPECT_EQ(-EINVAL, set_overrun_policy(&stRTTask, eOverrunHandler, NULL, NULL));
+    delete_task(&stRTTask);
+
+    // skip: one late cycle reports every missed release, the next one is back on the grid
+    test_run_overrun(eOverrunSkip, &stTest, &stStats);
+    EXPECT_EQ(-ETIMEDOUT, stTest.nRet[1]);
+    EXPECT_GE(stTest.ullMissed[1], 4u);
+    EXPECT_EQ(test_sum_missed(&stTest, &nLate), stStats.ullOverruns);
+
+    // catch-up: the missed releases run back-to-back but are counted only once
+    test_run_overrun(eOverrunCatchUp, &stTest, &stStats);
+    EXPECT_EQ(-ETIMEDOUT, stTest.nRet[1]);
+    EXPECT_GE(stTest.ullMissed[1], 4u);
+    EXPECT_EQ(RET_SUCC, stTest.nRet[2]);
+    EXPECT_EQ(0u, stTest.ullMissed[2]);
+    EXPECT_EQ(test_sum_missed(&stTest, &nLate), stStats.ullOverruns);
+
+    // handler: called once per late cycle with the exact count, its answer (skip) is applied
+    test_run_overrun(eOverrunHandler, &stTest, &stStats);
+    EXPECT_GE(stTest.ullMissed[1], 4u);
+    EXPECT_EQ(test_sum_missed(&stTest, &nLate), stTest.ullHandlerMissed);
+    EXPECT_EQ(nLate, stTest.nHandlerCalls);
+    EXPECT_EQ(stTest.ullHandlerMissed, stStats.ullOverruns);
+}
+
+TEST(testRTPOSIX, wait_fd_event)
+{
+    POSIX_WAIT_SET stSet;
+    POSIX_WAIT_EVENT stEvent;
+    UINT64 ullValue = 1;
+
+    INT nRet = create_wait_set(&stSet);
+    EXPECT_EQ(RET_SUCC, nRet);
+    INT nFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    EXPECT_EQ(0, add_wait_fd(&stSet, nFd, EPOLLIN));
+    EXPECT_EQ(-EEXIST, add_wait_fd(&stSet, nFd, EPOLLIN));
+
+    // nothing ready: the deadline fires
+    RTTIME rttDeadline = read_timer() + 2000000;
+    nRet = wait_fd_event(&stSet, rttDeadline, &stEvent);
+    EXPECT_EQ(-ETIMEDOUT, nRet);
+    EXPECT_EQ(WAIT_SOURCE_DEADLINE, stEvent.nSource);
+    EXPECT_GE(stEvent.rttWakeup, rttDeadline);
+    EXPECT_EQ(stEvent.rttWakeup - rttDeadline, stEvent.ullLatency);
+
+    // a ready fd returns before the deadline
+    EXPECT_EQ((ssize_t)sizeof(ullValue), write(nFd, &ullValue, sizeof(ullValue)));
+    nRet = wait_fd_event(&stSet, read_timer() + 1000000000, &stEvent);
+    EXPECT_EQ(RET_SUCC, nRet);
+    EXPECT_EQ(0, stEvent.nSource);
+    EXPECT_EQ(nFd, stEvent.nFd);
+    EXPECT_TRUE((stEvent.uEvents & EPOLLIN) != 0);
+
+    EXPECT_EQ(RET_SUCC, remove_wait_fd(&stSet, nFd));
+    EXPECT_EQ(-ENOENT, remove_wait_fd(&stSet, nFd));
+    EXPECT_EQ(-ETIMEDOUT, wait_fd_event(&stSet, read_timer() + 1000000, &stEvent));
+    EXPECT_EQ(RET_SUCC, delete_wait_set(&stSet));
+    close(nFd);
+}
+
+typedef struct _TEST_EVENT
+{
+    POSIX_WAIT_SET* pSet;
+    INT nFd;
+    INT nReleases;
+    INT nFdEvents;
+    BOOL bDone;
+} TEST_EVENT;
+
+void test_event_proc(void* arg)
+{
+    TEST_EVENT* pTest = (TEST_EVENT*)arg;
+    POSIX_WAIT_EVENT stEvent;
+    UINT64 ullValue;
+
+    while (pTest->nReleases < 50)
+    {
+        wait_next_event(pTest->pSet, &stEvent, NULL);
+        if (stEvent.nSource == WAIT_SOURCE_DEADLINE)
+            pTest->nReleases++;
+        else if (read(stEvent.nFd, &ullValue, sizeof(ullValue)) == sizeof(ullValue))
+            pTest->nFdEvents++;
+    }
+    pTest->bDone = TRUE;
+}
+
+TEST(testRTPOSIX, wait_next_event)
+{
+    POSIX_TASK stRTTask;
+    POSIX_TASK_STATS stStats;
+    POSIX_WAIT_SET stSet;
+    POSIX_WAIT_EVENT stEvent;
+    TEST_EVENT stTest;
+    UINT64 ullValue = 1;
+
+    EXPECT_EQ(-EINVAL, wait_next_event(NULL, &stEvent, NULL));
+    EXPECT_EQ(RET_SUCC, create_wait_set(&stSet));
+
+    memset(&stTest, 0, sizeof(stTest));
+    stTest.pSet = &stSet;
+    stTest.nFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    EXPECT_EQ(0, add_wait_fd(&stSet, stTest.nFd, EPOLLIN));
+
+    INT nRet = create_rt_task(&stRTTask, (const PCHAR)"EVENT", 0, 99);
+    EXPECT_EQ(RET_SUCC, nRet);
+    nRet = set_task_period(&stRTTask, SET_TM_NOW, 2000000);
+    EXPECT_EQ(RET_SUCC, nRet);
+    nRet = start_task(&stRTTask, &test_event_proc, &stTest);
+    EXPECT_EQ(RET_SUCC, nRet);
+
+    // wake the task in the middle of its periods, the releases keep their grid
+    for (INT nIdx = 0; nIdx < 3; nIdx++)
+    {
+        usleep(20000);
+        EXPECT_EQ((ssize_t)sizeof(ullValue), write(stTest.nFd, &ullValue, sizeof(ullValue)));
+    }
+    usleep(200000);
+    EXPECT_TRUE(stTest.bDone);
+    EXPECT_EQ(3, stTest.nFdEvents);
+
+    get_task_stats(&stRTTask, &stStats);
+    EXPECT_EQ(50u, stStats.ullCycles);
+    delete_task(&stRTTask);
+    delete_wait_set(&stSet);
+    close(stTest.nFd);
+}
+
+typedef struct _TEST_SUSPEND
+{
+    INT nCycles;
+    BOOL bStarted;
+    BOOL bStop;
+} TEST_SUSPEND;
+
+void test_suspend_proc(void* arg)
+{
+    TEST_SUSPEND* pTest = (TEST_SUSPEND*)arg;
+    __atomic_store_n(&pTest->bStarted, TRUE, __ATOMIC_RELEASE);
+    while (__atomic_load_n(&pTest->bStop, __ATOMIC_ACQUIRE) == FALSE)
+    {
+        wait_next_period(NULL);
+        __atomic_add_fetch(&pTest->nCycles, 1, __ATOMIC_RELEASE);
+    }
+}
+
+TEST(testRTPOSIX, suspend_resume_task)
+{
+    POSIX_TASK stRTTask;
+    POSIX_TASK_STATS stStats;
+    TEST_SUSPEND stTest;
+    memset(&stTest, 0, sizeof(stTest));
+
+    // suspended before the start: the task parks before its entry
+    EXPECT_EQ(RET_SUCC, create_rt_task(&stRTTask, (const PCHAR)"SUSPEND", 0, 90));
+    EXPECT_EQ(RET_SUCC, set_task_period(&stRTTask, SET_TM_NOW, 2000000));
+    EXPECT_EQ(RET_SUCC, suspend_task(&stRTTask));
+    EXPECT_EQ(RET_SUCC, start_task(&stRTTask, &test_suspend_proc, &stTest));
+    usleep(20000);
+    EXPECT_FALSE(stTest.bStarted);
+    EXPECT_EQ((DWORD)eSuspended, stRTTask.dwStatus);
+    EXPECT_EQ(RET_SUCC, resume_task(&stRTTask));
+    usleep(20000);
+    EXPECT_TRUE(stTest.bStarted);
+    EXPECT_GT(stTest.nCycles, 0);
+
+    // a running task parks at its next period boundary
+    EXPECT_EQ(RET_SUCC, suspend_task(&stRTTask));
+    usleep(20000);
+    EXPECT_EQ((DWORD)eSuspended, stRTTask.dwStatus);
+    INT nCycles = __atomic_load_n(&stTest.nCycles, __ATOMIC_ACQUIRE);
+    usleep(20000);
+    EXPECT_EQ(nCycles, __atomic_load_n(&stTest.nCycles, __ATOMIC_ACQUIRE));
+
+    // resume is a futex wake, the parked task measures how long it took to run again
+    EXPECT_EQ(RET_SUCC, resume_task(&stRTTask));
+    usleep(20000);
+    EXPECT_GT(__atomic_load_n(&stTest.nCycles, __ATOMIC_ACQUIRE), nCycles);
+    EXPECT_EQ(RET_SUCC, get_task_stats(&stRTTask, &stStats));
+    EXPECT_GT(stStats.ullResumeLatency, 0u);
+    EXPECT_LT(stStats.ullResumeLatency, 20000000u);
+
+    // a resume that comes before the boundary cancels the suspension
+    EXPECT_EQ(RET_SUCC, suspend_task(&stRTTask));
+    EXPECT_EQ(RET_SUCC, resume_task(&stRTTask));
+    nCycles = __atomic_load_n(&stTest.nCycles, __ATOMIC_ACQUIRE);
+    usleep(20000);
+    EXPECT_GT(__atomic_load_n(&stTest.nCycles, __ATOMIC_ACQUIRE), nCycles);
+
+    __atomic_store_n(&stTest.bStop, TRUE, __ATOMIC_RELEASE);
+    usleep(10000);
+    delete_task(&stRTTask);
+}
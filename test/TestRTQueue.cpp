@@ -0,0 +1,121 @@
+/*
+ *  This file is owned by the Embedded Systems Laboratory of Seoul National University of Science and Technology
+ *  as a part of RT-AIDE or the RTOS-Agnostic and Interoperable Development Environment for Real-time Systems
+ *
+ *  File: TestRTQueue.cpp
+ *  Author: 2022 Raimarius Delgado
+ *  Description: Unit test for the RT-Posix message queue based on GTest
+ *
+ *
+ *
+ *
+*/
+#include "UnitTest.h"
+#include "rt_queue.h"
+
+TEST(testRTQUEUE, create_rt_queue)
+{
+    RT_QUEUE stQueue;
+
+    // invalid message size and count
+    INT nRet = create_rt_queue(&stQueue, (const PCHAR)"QUEUE", 0, 8);
+    EXPECT_EQ(-EINVAL, nRet);
+    nRet = create_rt_queue(&stQueue, (const PCHAR)"QUEUE", 32, 0);
+    EXPECT_EQ(-EINVAL, nRet);
+
+    // Successful, slots are rounded up to a power of two and to cache lines
+    nRet = create_rt_queue(&stQueue, (const PCHAR)"QUEUE", 100, 5);
+    EXPECT_EQ(RET_SUCC, nRet);
+    EXPECT_EQ(8u, stQueue.uSlotCnt);
+    EXPECT_EQ(0u, stQueue.uSlotSize % RT_CACHELINE_SIZE);
+    EXPECT_GE(stQueue.uMsgSize, 100u);
+    EXPECT_EQ(0u, (uintptr_t)stQueue.pBuffer % RT_CACHELINE_SIZE);
+
+    nRet = delete_rt_queue(&stQueue);
+    EXPECT_EQ(RET_SUCC, nRet);
+}
+
+TEST(testRTQUEUE, reserve_commit_receive)
+{
+    RT_QUEUE stQueue;
+    PVOID pMsg = NULL;
+    UINT32 uSize = 0;
+
+    INT nRet = create_rt_queue(&stQueue, (const PCHAR)"QUEUE", sizeof(INT), 4);
+    EXPECT_EQ(RET_SUCC, nRet);
+
+    // empty queue
+    EXPECT_EQ(-EAGAIN, rt_queue_receive(&stQueue, &pMsg, &uSize));
+    EXPECT_EQ(-EAGAIN, rt_queue_release(&stQueue));
+    EXPECT_EQ(-EINVAL, rt_queue_commit(&stQueue, sizeof(INT)));
+
+    // fill the queue in place
+    for (INT nIdx = 0; nIdx < 4; nIdx++)
+    {
+        EXPECT_EQ(RET_SUCC, rt_queue_reserve(&stQueue, &pMsg));
+        *(INT*)pMsg = nIdx;
+        EXPECT_EQ(RET_SUCC, rt_queue_commit(&stQueue, sizeof(INT)));
+    }
+    EXPECT_EQ(-EAGAIN, rt_queue_reserve(&stQueue, &pMsg));
+    EXPECT_EQ(4u, get_rt_queue_count(&stQueue));
+
+    // messages come out in order and are read where they were written
+    for (INT nIdx = 0; nIdx < 4; nIdx++)
+    {
+        EXPECT_EQ(RET_SUCC, rt_queue_receive(&stQueue, &pMsg, &uSize));
+        EXPECT_EQ(sizeof(INT), uSize);
+        EXPECT_EQ(nIdx, *(INT*)pMsg);
+        EXPECT_EQ(RET_SUCC, rt_queue_release(&stQueue));
+    }
+    EXPECT_EQ(0u, get_rt_queue_count(&stQueue));
+
+    // deadline-bounded receive on an empty queue
+    RTTIME rttStart = read_timer();
+    nRet = rt_queue_timed_receive(&stQueue, &pMsg, &uSize, rttStart + 10000000);
+    EXPECT_EQ(-ETIMEDOUT, nRet);
+    EXPECT_GE(read_timer(), rttStart + 10000000);
+
+    delete_rt_queue(&stQueue);
+}
+
+static RT_QUEUE g_stTestQueue;
+
+void test_queue_producer_proc(void* arg)
+{
+    INT nCount = *(INT*)arg;
+    PVOID pMsg;
+    for (INT nIdx = 0; nIdx < nCount; nIdx++)
+    {
+        while (rt_queue_reserve(&g_stTestQueue, &pMsg) != RET_SUCC)
+            usleep(100);
+        *(INT*)pMsg = nIdx;
+        rt_queue_commit(&g_stTestQueue, sizeof(INT));
+        if (nIdx % 100 == 0)
+            usleep(1000); // let the consumer fall asleep once in a while
+    }
+}
+
+TEST(testRTQUEUE, producer_consumer)
+{
+    POSIX_TASK stProducer;
+    INT nCount = 1000;
+    PVOID pMsg;
+    UINT32 uSize;
+
+    INT nRet = create_rt_queue(&g_stTestQueue, (const PCHAR)"QUEUE", sizeof(INT), 16);
+    EXPECT_EQ(RET_SUCC, nRet);
+
+    nRet = spawn_rt_task(&stProducer, (const PCHAR)"PRODUCER", 0, 90, &test_queue_producer_proc, (void*)&nCount);
+    EXPECT_EQ(RET_SUCC, nRet);
+
+    for (INT nIdx = 0; nIdx < nCount; nIdx++)
+    {
+        nRet = rt_queue_timed_receive(&g_stTestQueue, &pMsg, &uSize, read_timer() + NANOSEC_PER_SEC);
+        ASSERT_EQ(RET_SUCC, nRet);
+        EXPECT_EQ(nIdx, *(INT*)pMsg);
+        rt_queue_release(&g_stTestQueue);
+    }
+
+    usleep(10000);
+    delete_rt_queue(&g_stTestQueue);
+}
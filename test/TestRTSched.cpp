@@ -0,0 +1,155 @@
+/*
+ *  This file is owned by the Embedded Systems Laboratory of Seoul National University of Science and Technology
+ *  as a part of RT-AIDE or the RTOS-Agnostic and Interoperable Development Environment for Real-time Systems
+ *
+ *  File: TestRTSched.cpp
+ *  Author: 2022 Raimarius Delgado
+ *  Description: Unit test for the RT-Posix priority assignment and schedulability analysis based on GTest
+ *
+ *
+ *
+ *
+*/
+#include "UnitTest.h"
+#include "rt_sched.h"
+
+static void test_create_sched_set(POSIX_TASK* apTasks, POSIX_TASK** appSet, const RTTIME* apullPeriods, const RTTIME* apullWcets, INT anCnt)
+{
+    CHAR strName[MAX_NAME_LENGTH];
+    for (INT nIdx = 0; nIdx < anCnt; nIdx++)
+    {
+        snprintf(strName, sizeof(strName), "RTA%d", nIdx);
+        EXPECT_EQ(RET_SUCC, create_rt_task(&apTasks[nIdx], (const PCHAR)strName, 0, 50));
+        EXPECT_EQ(RET_SUCC, set_cpu_affinity(&apTasks[nIdx], 0));
+        EXPECT_EQ(RET_SUCC, set_task_period(&apTasks[nIdx], SET_TM_NOW, apullPeriods[nIdx]));
+        EXPECT_EQ(RET_SUCC, set_task_wcet(&apTasks[nIdx], apullWcets[nIdx], 0));
+        appSet[nIdx] = &apTasks[nIdx];
+    }
+}
+
+TEST(testRTSCHED, assign_task_priorities)
+{
+    POSIX_TASK stTasks[3];
+    POSIX_TASK* pSet[3];
+    const RTTIME ullPeriods[3] = { 5000000, 1000000, 2000000 };
+    const RTTIME ullWcets[3] = { 100000, 100000, 100000 };
+
+    test_create_sched_set(stTasks, pSet, ullPeriods, ullWcets, 3);
+    EXPECT_EQ(-EINVAL, assign_task_priorities(pSet, 3, eOrderRateMonotonic, 100));
+    EXPECT_EQ(-EINVAL, assign_task_priorities(pSet, 3, 7, 90));
+
+    // rate-monotonic: the shortest period gets the highest priority
+    EXPECT_EQ(RET_SUCC, assign_task_priorities(pSet, 3, eOrderRateMonotonic, 90));
+    EXPECT_EQ(88, stTasks[0].nPriority);
+    EXPECT_EQ(90, stTasks[1].nPriority);
+    EXPECT_EQ(89, stTasks[2].nPriority);
+
+    // deadline-monotonic: a short deadline beats a short period
+    EXPECT_EQ(RET_SUCC, set_task_wcet(&stTasks[0], 100000, 500000));
+    EXPECT_EQ(-EINVAL, set_task_wcet(&stTasks[1], 100000, 2000000));
+    EXPECT_EQ(RET_SUCC, assign_task_priorities(pSet, 3, eOrderDeadlineMonotonic, 90));
+    EXPECT_EQ(90, stTasks[0].nPriority);
+    EXPECT_EQ(89, stTasks[1].nPriority);
+    EXPECT_EQ(88, stTasks[2].nPriority);
+
+    // NRT tasks have no priority to assign
+    POSIX_TASK stNrtTask;
+    POSIX_TASK* pNrt = &stNrtTask;
+    EXPECT_EQ(RET_SUCC, create_nrt_task(&stNrtTask, (const PCHAR)"NRT", 0));
+    EXPECT_EQ(-EINVAL, assign_task_priorities(&pNrt, 1, eOrderRateMonotonic, 90));
+
+    delete_task(&stNrtTask);
+    for (INT nIdx = 0; nIdx < 3; nIdx++)
+        delete_task(&stTasks[nIdx]);
+}
+
+TEST(testRTSCHED, analyze_task_set)
+{
+    POSIX_TASK stTasks[3];
+    POSIX_TASK* pSet[3];
+    RT_RTA_RESULT stResults[3];
+    const RTTIME ullPeriods[3] = { 4000000, 5000000, 20000000 };
+    const RTTIME ullWcets[3] = { 1000000, 2000000, 5000000 };
+
+    test_create_sched_set(stTasks, pSet, ullPeriods, ullWcets, 3);
+    EXPECT_EQ(RET_SUCC, assign_task_priorities(pSet, 3, eOrderRateMonotonic, 90));
+
+    // R1 = 1, R2 = 2 + 1 = 3, R3 = 5 + ceil(15/4) * 1 + ceil(15/5) * 2 = 15 (ms)
+    EXPECT_EQ(RET_SUCC, analyze_task_set(pSet, 3, stResults));
+    EXPECT_EQ(1000000u, stResults[0].ullResponse);
+    EXPECT_EQ(3000000u, stResults[1].ullResponse);
+    EXPECT_EQ(15000000u, stResults[2].ullResponse);
+    EXPECT_EQ(0, stResults[2].nCpu);
+    EXPECT_TRUE(stResults[2].bSchedulable);
+
+    // a longer WCET of the lowest priority task pushes it past its deadline
+    EXPECT_EQ(RET_SUCC, set_task_wcet(&stTasks[2], 9000000, 0));
+    EXPECT_EQ(-EBUSY, analyze_task_set(pSet, 3, stResults));
+    EXPECT_TRUE(stResults[0].bSchedulable);
+    EXPECT_TRUE(stResults[1].bSchedulable);
+    EXPECT_FALSE(stResults[2].bSchedulable);
+    EXPECT_GT(stResults[2].ullResponse, stResults[2].ullDeadline);
+
+    // tasks on another CPU do not interfere
+    if (get_available_cpus() > 1)
+    {
+        EXPECT_EQ(RET_SUCC, set_cpu_affinity(&stTasks[1], 1));
+        EXPECT_EQ(RET_SUCC, analyze_task_set(pSet, 3, stResults));
+    }
+
+    for (INT nIdx = 0; nIdx < 3; nIdx++)
+        delete_task(&stTasks[nIdx]);
+}
+
+void test_admitted_proc(void* arg)
+{
+    // after its first release the task stays in eReady, it still holds its share of the CPU
+    wait_next_period(NULL);
+    while (__atomic_load_n((BOOL*)arg, __ATOMIC_ACQUIRE) == FALSE)
+        usleep(1000);
+}
+
+TEST(testRTSCHED, admission_control)
+{
+    POSIX_TASK stTasks[3];
+    POSIX_TASK* pSet[3];
+    const RTTIME ullPeriods[3] = { 4000000, 5000000, 20000000 };
+    const RTTIME ullWcets[3] = { 1000000, 2000000, 9000000 };
+    BOOL bStop = FALSE;
+
+    EXPECT_EQ(-EINVAL, set_admission_control(7));
+    test_create_sched_set(stTasks, pSet, ullPeriods, ullWcets, 3);
+    EXPECT_EQ(RET_SUCC, assign_task_priorities(pSet, 3, eOrderRateMonotonic, 90));
+
+    // the first two fit on CPU0, the third would miss its deadline
+    EXPECT_EQ(RET_SUCC, set_admission_control(eAdmitReject));
+    EXPECT_EQ(RET_SUCC, start_task(&stTasks[0], &test_admitted_proc, &bStop));
+    EXPECT_EQ(RET_SUCC, start_task(&stTasks[1], &test_admitted_proc, &bStop));
+    usleep(20000);
+    EXPECT_EQ((DWORD)eReady, stTasks[0].dwStatus);
+    EXPECT_EQ(-EBUSY, start_task(&stTasks[2], &test_admitted_proc, &bStop));
+    EXPECT_EQ((DWORD)eReady, stTasks[2].dwStatus);
+
+    // warnings only
+    EXPECT_EQ(RET_SUCC, set_admission_control(eAdmitWarn));
+    EXPECT_EQ(RET_SUCC, start_task(&stTasks[2], &test_admitted_proc, &bStop));
+
+    // the new priorities reach the running threads, also between two cycles
+    usleep(20000);
+    EXPECT_EQ(RET_SUCC, assign_task_priorities(pSet, 3, eOrderRateMonotonic, 80));
+    for (INT nIdx = 0; nIdx < 3; nIdx++)
+    {
+        struct sched_param stParam;
+        EXPECT_EQ(0, sched_getparam(stTasks[nIdx].nPid, &stParam));
+        EXPECT_EQ(SCHED_FIFO, sched_getscheduler(stTasks[nIdx].nPid));
+        EXPECT_EQ(80 - nIdx, stParam.sched_priority);
+    }
+
+    EXPECT_EQ(RET_SUCC, set_admission_control(eAdmitOff));
+    __atomic_store_n(&bStop, TRUE, __ATOMIC_RELEASE);
+    usleep(50000);
+    // the threads are gone, their TIDs are never touched again
+    EXPECT_EQ(-ESRCH, set_task_priority(&stTasks[0], 60));
+    for (INT nIdx = 0; nIdx < 3; nIdx++)
+        delete_task(&stTasks[nIdx]);
+}
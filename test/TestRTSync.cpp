@@ -0,0 +1,185 @@
+/*
+ *  This file is owned by the Embedded Systems Laboratory of Seoul National University of Science and Technology
+ *  as a part of RT-AIDE or the RTOS-Agnostic and Interoperable Development Environment for Real-time Systems
+ *
+ *  File: TestRTSync.cpp
+ *  Author: 2022 Raimarius Delgado
+ *  Description: Unit test for the RT-Posix mutex, semaphore and event flags based on GTest
+ *
+ *
+ *
+ *
+*/
+#include "UnitTest.h"
+#include "rt_sync.h"
+
+typedef struct _TEST_SYNC
+{
+    RT_MUTEX stMutex;
+    RT_SEM stSem;
+    RT_EVENT stEvent;
+    INT nCounter;
+    INT nResult;
+    UINT32 uFlags;
+    BOOL bStop;
+    BOOL bDone;
+} TEST_SYNC;
+
+static INT test_get_effective_prio(PID anTid)
+{
+    // field 18 of /proc/<tid>/stat is the priority the kernel schedules with, -1 - rtprio for RT tasks
+    CHAR strPath[64];
+    CHAR strStat[512];
+    snprintf(strPath, sizeof(strPath), "/proc/self/task/%d/stat", (INT)anTid);
+    FILE* pFile = fopen(strPath, "r");
+    if (pFile == NULL)
+        return 0;
+    size_t ulLen = fread(strStat, 1, sizeof(strStat) - 1, pFile);
+    fclose(pFile);
+    strStat[ulLen] = '\0';
+
+    CHAR* pField = strrchr(strStat, ')');
+    INT nPrio = 0;
+    for (INT nIdx = 0; pField != NULL && nIdx < 16; nIdx++)
+        pField = strchr(pField + 1, ' ');
+    if (pField != NULL)
+        nPrio = atoi(pField + 1);
+    return nPrio;
+}
+
+void test_mutex_holder_proc(void* arg)
+{
+    TEST_SYNC* pTest = (TEST_SYNC*)arg;
+    rt_mutex_lock(&pTest->stMutex);
+    while (__atomic_load_n(&pTest->bStop, __ATOMIC_ACQUIRE) == FALSE)
+        usleep(1000);
+    rt_mutex_unlock(&pTest->stMutex);
+}
+
+void test_mutex_waiter_proc(void* arg)
+{
+    TEST_SYNC* pTest = (TEST_SYNC*)arg;
+    pTest->nResult = rt_mutex_lock(&pTest->stMutex);
+    pTest->nCounter++;
+    rt_mutex_unlock(&pTest->stMutex);
+    pTest->bDone = TRUE;
+}
+
+TEST(testRTSYNC, rt_mutex)
+{
+    TEST_SYNC stTest;
+    POSIX_TASK stHolder, stWaiter;
+    memset(&stTest, 0, sizeof(stTest));
+
+    EXPECT_EQ(RET_SUCC, create_rt_mutex(&stTest.stMutex));
+
+    // uncontended, never enters the kernel
+    EXPECT_EQ(RET_SUCC, rt_mutex_lock(&stTest.stMutex));
+    EXPECT_EQ((UINT32)gettid(), stTest.stMutex.uOwner);
+    EXPECT_EQ(-EDEADLK, rt_mutex_trylock(&stTest.stMutex));
+    EXPECT_EQ(-EBUSY, delete_rt_mutex(&stTest.stMutex));
+    EXPECT_EQ(RET_SUCC, rt_mutex_unlock(&stTest.stMutex));
+    EXPECT_EQ(-EPERM, rt_mutex_unlock(&stTest.stMutex));
+
+    // a low priority task holds the lock
+    EXPECT_EQ(RET_SUCC, spawn_rt_task(&stHolder, (const PCHAR)"HOLDER", 0, 10, &test_mutex_holder_proc, &stTest));
+    usleep(20000);
+    EXPECT_EQ(-EBUSY, rt_mutex_trylock(&stTest.stMutex));
+    RTTIME rttStart = read_timer();
+    EXPECT_EQ(-ETIMEDOUT, rt_mutex_timed_lock(&stTest.stMutex, rttStart + 5000000));
+    EXPECT_GE(read_timer(), rttStart + 5000000);
+
+    // a high priority waiter lends its priority to the holder
+    EXPECT_EQ(RET_SUCC, spawn_rt_task(&stWaiter, (const PCHAR)"WAITER", 0, 80, &test_mutex_waiter_proc, &stTest));
+    usleep(20000);
+    EXPECT_FALSE(stTest.bDone);
+    EXPECT_EQ(-1 - 80, test_get_effective_prio(stHolder.nPid));
+
+    __atomic_store_n(&stTest.bStop, TRUE, __ATOMIC_RELEASE);
+    usleep(20000);
+    EXPECT_TRUE(stTest.bDone);
+    EXPECT_EQ(RET_SUCC, stTest.nResult);
+    EXPECT_EQ(1, stTest.nCounter);
+    EXPECT_EQ(RET_SUCC, delete_rt_mutex(&stTest.stMutex));
+}
+
+void test_sem_consumer_proc(void* arg)
+{
+    TEST_SYNC* pTest = (TEST_SYNC*)arg;
+    for (INT nIdx = 0; nIdx < 10; nIdx++)
+    {
+        if (rt_sem_timed_wait(&pTest->stSem, read_timer() + 1000000000) == RET_SUCC)
+            pTest->nCounter++;
+    }
+    pTest->bDone = TRUE;
+}
+
+TEST(testRTSYNC, rt_sem)
+{
+    TEST_SYNC stTest;
+    POSIX_TASK stConsumer;
+    memset(&stTest, 0, sizeof(stTest));
+
+    EXPECT_EQ(RET_SUCC, create_rt_sem(&stTest.stSem, 2));
+    EXPECT_EQ(RET_SUCC, rt_sem_trywait(&stTest.stSem));
+    EXPECT_EQ(RET_SUCC, rt_sem_wait(&stTest.stSem));
+    EXPECT_EQ(-EAGAIN, rt_sem_trywait(&stTest.stSem));
+
+    RTTIME rttStart = read_timer();
+    EXPECT_EQ(-ETIMEDOUT, rt_sem_timed_wait(&stTest.stSem, rttStart + 5000000));
+    EXPECT_GE(read_timer(), rttStart + 5000000);
+
+    // the consumer sleeps on the count and is woken by every post
+    EXPECT_EQ(RET_SUCC, spawn_rt_task(&stConsumer, (const PCHAR)"CONSUMER", 0, 80, &test_sem_consumer_proc, &stTest));
+    for (INT nIdx = 0; nIdx < 10; nIdx++)
+    {
+        usleep(1000);
+        EXPECT_EQ(RET_SUCC, rt_sem_post(&stTest.stSem));
+    }
+    usleep(20000);
+    EXPECT_TRUE(stTest.bDone);
+    EXPECT_EQ(10, stTest.nCounter);
+    EXPECT_EQ(0u, get_rt_sem_count(&stTest.stSem));
+    EXPECT_EQ(RET_SUCC, delete_rt_sem(&stTest.stSem));
+}
+
+void test_event_waiter_proc(void* arg)
+{
+    TEST_SYNC* pTest = (TEST_SYNC*)arg;
+    pTest->nResult = rt_event_timed_wait(&pTest->stEvent, 0x3, eEventAll | eEventConsume, &pTest->uFlags, read_timer() + 1000000000);
+    pTest->bDone = TRUE;
+}
+
+TEST(testRTSYNC, rt_event)
+{
+    TEST_SYNC stTest;
+    POSIX_TASK stWaiter;
+    UINT32 uFlags = 0;
+    memset(&stTest, 0, sizeof(stTest));
+
+    EXPECT_EQ(RET_SUCC, create_rt_event(&stTest.stEvent, 0x4));
+    EXPECT_EQ(-EINVAL, rt_event_wait(&stTest.stEvent, 0, eEventAny, &uFlags));
+
+    // any: one of the bits is enough, the flags stay set
+    EXPECT_EQ(RET_SUCC, rt_event_wait(&stTest.stEvent, 0x5, eEventAny, &uFlags));
+    EXPECT_EQ(0x4u, uFlags);
+    EXPECT_EQ(0x4u, get_rt_event_flags(&stTest.stEvent));
+    EXPECT_EQ(-ETIMEDOUT, rt_event_timed_wait(&stTest.stEvent, 0x5, eEventAll, &uFlags, read_timer() + 2000000));
+
+    // all + consume: the waiter sleeps until both bits are set and clears only those
+    EXPECT_EQ(RET_SUCC, spawn_rt_task(&stWaiter, (const PCHAR)"EVWAITER", 0, 80, &test_event_waiter_proc, &stTest));
+    usleep(10000);
+    EXPECT_EQ(RET_SUCC, rt_event_set(&stTest.stEvent, 0x1));
+    usleep(10000);
+    EXPECT_FALSE(stTest.bDone);
+    EXPECT_EQ(RET_SUCC, rt_event_set(&stTest.stEvent, 0x2));
+    usleep(10000);
+    EXPECT_TRUE(stTest.bDone);
+    EXPECT_EQ(RET_SUCC, stTest.nResult);
+    EXPECT_EQ(0x7u, stTest.uFlags);
+    EXPECT_EQ(0x4u, get_rt_event_flags(&stTest.stEvent));
+
+    EXPECT_EQ(RET_SUCC, rt_event_clear(&stTest.stEvent, 0x4));
+    EXPECT_EQ(0x0u, get_rt_event_flags(&stTest.stEvent));
+    EXPECT_EQ(RET_SUCC, delete_rt_event(&stTest.stEvent));
+}
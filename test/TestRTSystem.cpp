@@ -0,0 +1,103 @@
+/*
+ *  This file is owned by the Embedded Systems Laboratory of Seoul National University of Science and Technology
+ *  as a part of RT-AIDE or the RTOS-Agnostic and Interoperable Development Environment for Real-time Systems
+ *
+ *  File: TestRTSystem.cpp
+ *  Author: 2022 Raimarius Delgado
+ *  Description: Unit test for the RT-Posix system setup and checks based on GTest
+ *
+ *
+ *
+ *
+*/
+#include "UnitTest.h"
+#include "rt_system.h"
+#include <sys/prctl.h>
+
+static void test_system_counts(RT_SYSTEM_REPORT* apReport)
+{
+    UINT32 uFailed = 0, uWarnings = 0;
+    for (INT nItem = 0; nItem < eSysItemCnt; nItem++)
+    {
+        EXPECT_LE(apReport->stItems[nItem].nResult, (INT)eSysFailed);
+        uFailed += (apReport->stItems[nItem].nResult == eSysFailed);
+        uWarnings += (apReport->stItems[nItem].nResult == eSysWarning);
+    }
+    EXPECT_EQ(uFailed, apReport->uFailed);
+    EXPECT_EQ(uWarnings, apReport->uWarnings);
+}
+
+TEST(testRTSYSTEM, check_only)
+{
+    RT_SYSTEM_REPORT stReport;
+    INT nSlack = prctl(PR_GET_TIMERSLACK, 0UL, 0UL, 0UL, 0UL);
+
+    EXPECT_EQ(-EINVAL, rt_system_check(NULL));
+    EXPECT_EQ(RET_SUCC, rt_system_check(&stReport));
+    test_system_counts(&stReport);
+
+    // the checks change nothing and leave the setup steps alone
+    EXPECT_EQ(nSlack, prctl(PR_GET_TIMERSLACK, 0UL, 0UL, 0UL, 0UL));
+    for (INT nItem = eSysDmaLatency; nItem <= eSysPrefault; nItem++)
+        EXPECT_EQ((INT)eSysSkipped, stReport.stItems[nItem].nResult);
+    for (INT nItem = eSysIsolCpus; nItem < eSysItemCnt; nItem++)
+        EXPECT_NE('\0', stReport.stItems[nItem].strDetail[0]) << get_rt_system_item_name(nItem);
+}
+
+TEST(testRTSYSTEM, prepare)
+{
+    RT_SYSTEM_REPORT stReport;
+    EXPECT_EQ(-EINVAL, rt_system_prepare(0x100, 0, &stReport));
+
+    INT nRet = rt_system_prepare(RT_SYS_TIMER_SLACK | RT_SYS_MALLOC | RT_SYS_PREFAULT, 4 * 1024 * 1024, &stReport);
+    EXPECT_EQ(RET_SUCC, nRet);
+    test_system_counts(&stReport);
+    EXPECT_EQ((INT)eSysPassed, stReport.stItems[eSysTimerSlack].nResult);
+    EXPECT_EQ((INT)eSysPassed, stReport.stItems[eSysMalloc].nResult);
+    EXPECT_EQ((INT)eSysPassed, stReport.stItems[eSysPrefault].nResult);
+    EXPECT_EQ((INT)eSysSkipped, stReport.stItems[eSysDmaLatency].nResult);
+    EXPECT_EQ(1, prctl(PR_GET_TIMERSLACK, 0UL, 0UL, 0UL, 0UL));
+
+    // the slack is inherited by the tasks created afterwards
+    POSIX_TASK stTask;
+    static INT nTaskSlack;
+    nTaskSlack = -1;
+    EXPECT_EQ(RET_SUCC, create_nrt_task(&stTask, (const PCHAR)"SLACK", 0));
+    EXPECT_EQ(RET_SUCC, start_task(&stTask, [](void*) { nTaskSlack = prctl(PR_GET_TIMERSLACK, 0UL, 0UL, 0UL, 0UL); }, NULL));
+    usleep(20000);
+    EXPECT_EQ(1, nTaskSlack);
+    delete_task(&stTask);
+}
+
+TEST(testRTSYSTEM, prepare_all)
+{
+    RT_SYSTEM_REPORT stReport;
+    INT nRet = rt_system_prepare(RT_SYS_ALL, DEFAULT_SYSTEM_PREFAULT, &stReport);
+    test_system_counts(&stReport);
+    print_rt_system_report(&stReport);
+
+    // some steps need privileges, a failure is reported with its errno
+    for (INT nItem = eSysDmaLatency; nItem <= eSysPrefault; nItem++)
+    {
+        EXPECT_NE((INT)eSysSkipped, stReport.stItems[nItem].nResult) << get_rt_system_item_name(nItem);
+        if (stReport.stItems[nItem].nResult == eSysFailed)
+        {
+            EXPECT_GT(stReport.stItems[nItem].nErrno, 0);
+        }
+    }
+    if (stReport.uFailed == 0)
+    {
+        EXPECT_EQ(RET_SUCC, nRet);
+    }
+    else
+    {
+        EXPECT_LT(nRet, 0);
+    }
+
+    if (stReport.stItems[eSysDmaLatency].nResult == eSysPassed)
+    {
+        EXPECT_EQ(RET_SUCC, rt_system_release());
+    }
+    EXPECT_EQ(-EINVAL, rt_system_release());
+    EXPECT_EQ(NULL, get_rt_system_item_name(eSysItemCnt));
+}
@@ -0,0 +1,126 @@
+/*
+ *  This file is owned by the Embedded Systems Laboratory of Seoul National University of Science and Technology
+ *  as a part of RT-AIDE or the RTOS-Agnostic and Interoperable Development Environment for Real-time Systems
+ *
+ *  File: TestRTTelemetry.cpp
+ *  Author: 2022 Raimarius Delgado
+ *  Description: Unit test for the RT-Posix shared-memory telemetry based on GTest
+ *
+ *
+ *
+ *
+*/
+#include "UnitTest.h"
+#include "rt_telemetry.h"
+
+static INT test_find_record(RT_TELEMETRY_REGION* apRegion, const char* astrName, RT_TELEMETRY_RECORD* apRecord)
+{
+    for (UINT32 uIdx = 0; uIdx < apRegion->stHeader.uRecordCnt; uIdx++)
+    {
+        if (read_telemetry_record(apRegion, uIdx, apRecord) == RET_SUCC && strcmp(apRecord->strName, astrName) == 0)
+            return (INT)uIdx;
+    }
+    return -1;
+}
+
+TEST(testRTTELEMETRY, start_stop_telemetry)
+{
+    RT_TELEMETRY_REGION* pRegion = NULL;
+
+    // nothing is published yet
+    INT nRet = open_telemetry(getpid(), &pRegion);
+    EXPECT_EQ(-ENOENT, nRet);
+    EXPECT_EQ(-EINVAL, stop_telemetry());
+
+    nRet = start_telemetry();
+    EXPECT_EQ(RET_SUCC, nRet);
+    EXPECT_EQ(-EBUSY, start_telemetry());
+
+    nRet = open_telemetry(getpid(), &pRegion);
+    ASSERT_EQ(RET_SUCC, nRet);
+    EXPECT_EQ((UINT32)RT_TELEMETRY_MAGIC, pRegion->stHeader.uMagic);
+    EXPECT_EQ(getpid(), pRegion->stHeader.nPid);
+    EXPECT_EQ(0u, sizeof(RT_TELEMETRY_RECORD) % 64);
+    EXPECT_EQ(RET_SUCC, close_telemetry(pRegion));
+
+    nRet = stop_telemetry();
+    EXPECT_EQ(RET_SUCC, nRet);
+    EXPECT_EQ(-ENOENT, open_telemetry(getpid(), &pRegion));
+}
+
+static INT test_count_mappings(void)
+{
+    CHAR strName[MAX_NAME_LENGTH];
+    CHAR strLine[512];
+    INT nCnt = 0;
+
+    snprintf(strName, sizeof(strName), "%s%d", RT_TELEMETRY_PREFIX, getpid());
+    FILE* pMaps = fopen("/proc/self/maps", "r");
+    if (pMaps == NULL)
+        return -1;
+    while (fgets(strLine, sizeof(strLine), pMaps) != NULL)
+    {
+        if (strstr(strLine, strName) != NULL)
+            nCnt++;
+    }
+    fclose(pMaps);
+    return nCnt;
+}
+
+TEST(testRTTELEMETRY, restart_telemetry)
+{
+    RT_TELEMETRY_REGION* pRegion = NULL;
+
+    // every restart reuses the pages of the stopped region
+    for (INT nIdx = 0; nIdx < 4; nIdx++)
+    {
+        ASSERT_EQ(RET_SUCC, start_telemetry());
+        EXPECT_EQ(1, test_count_mappings());
+
+        ASSERT_EQ(RET_SUCC, open_telemetry(getpid(), &pRegion));
+        EXPECT_EQ((UINT32)RT_TELEMETRY_MAGIC, pRegion->stHeader.uMagic);
+        EXPECT_EQ(RET_SUCC, close_telemetry(pRegion));
+
+        EXPECT_EQ(RET_SUCC, stop_telemetry());
+        EXPECT_EQ(-ENOENT, open_telemetry(getpid(), &pRegion));
+    }
+    EXPECT_EQ(1, test_count_mappings());
+}
+
+TEST(testRTTELEMETRY, periodic_task_records)
+{
+    POSIX_TASK stRTTask;
+    RT_TELEMETRY_REGION* pRegion = NULL;
+    RT_TELEMETRY_RECORD stRecord;
+    INT nCycles = 100;
+
+    INT nRet = start_telemetry();
+    EXPECT_EQ(RET_SUCC, nRet);
+    nRet = open_telemetry(getpid(), &pRegion);
+    ASSERT_EQ(RET_SUCC, nRet);
+
+    nRet = create_rt_task(&stRTTask, (const PCHAR)"TELEMETRY", 0, 99);
+    EXPECT_EQ(RET_SUCC, nRet);
+    nRet = set_task_period(&stRTTask, SET_TM_NOW, 5000000);
+    EXPECT_EQ(RET_SUCC, nRet);
+    nRet = start_task(&stRTTask, &test_periodic_proc, (void*)&nCycles);
+    EXPECT_EQ(RET_SUCC, nRet);
+
+    // the record follows the task while it runs
+    usleep(100000);
+    ASSERT_GE(test_find_record(pRegion, "TELEMETRY", &stRecord), 0);
+    EXPECT_EQ(stRTTask.nPid, stRecord.nPid);
+    EXPECT_EQ(SCHED_FIFO, stRecord.nSchedPolicy);
+    EXPECT_EQ(5000000u, stRecord.ullPeriod);
+    EXPECT_GT(stRecord.ullCycles, 5u);
+    EXPECT_LE(stRecord.ullLatMin, stRecord.ullLatMax);
+
+    // and is given back when the task ends
+    sleep(1);
+    EXPECT_EQ(0, nCycles);
+    EXPECT_EQ(-1, test_find_record(pRegion, "TELEMETRY", &stRecord));
+
+    close_telemetry(pRegion);
+    delete_task(&stRTTask);
+    EXPECT_EQ(RET_SUCC, stop_telemetry());
+}
@@ -0,0 +1,185 @@
+/*
+ *  This file is owned by the Embedded Systems Laboratory of Seoul National University of Science and Technology
+ *  as a part of RT-AIDE or the RTOS-Agnostic and Interoperable Development Environment for Real-time Systems
+ *
+ *  File: TestRTTrace.cpp
+ *  Author: 2022 Raimarius Delgado
+ *  Description: Unit test for the RT-Posix event tracer based on GTest
+ *
+ *
+ *
+ *
+*/
+#include "UnitTest.h"
+#include "rt_trace.h"
+
+#define TEST_TRACE_CYCLES	(20)
+#define TEST_TRACE_PATH		"/tmp/rtposix_trace_test.json"
+
+typedef struct _TEST_TRACE
+{
+    INT             nLateCycle;     // cycle that runs past its period, -1 for none
+    BOOL            bDone;
+} TEST_TRACE;
+
+void test_trace_proc(void* arg)
+{
+    TEST_TRACE* pTest = (TEST_TRACE*)arg;
+    for (INT nIdx = 0; nIdx < TEST_TRACE_CYCLES; nIdx++)
+    {
+        trace_user_event((UINT64)nIdx);
+        if (nIdx == pTest->nLateCycle)
+            spin_timer(3500000);
+        wait_next_period(NULL);
+    }
+    __atomic_store_n(&pTest->bDone, TRUE, __ATOMIC_RELEASE);
+}
+
+static void test_trace_run(POSIX_TASK* apTask, TEST_TRACE* apTest, const PCHAR astrName)
+{
+    EXPECT_EQ(RET_SUCC, create_rt_task(apTask, astrName, 0, 60));
+    EXPECT_EQ(RET_SUCC, set_task_period(apTask, SET_TM_NOW, 1000000));
+    EXPECT_EQ(RET_SUCC, start_task(apTask, &test_trace_proc, apTest));
+    for (INT nIdx = 0; nIdx < 200 && __atomic_load_n(&apTest->bDone, __ATOMIC_ACQUIRE) == FALSE; nIdx++)
+        usleep(5000);
+    EXPECT_TRUE(__atomic_load_n(&apTest->bDone, __ATOMIC_ACQUIRE));
+}
+
+TEST(testRTTRACE, flight_recorder)
+{
+    POSIX_TASK stTask;
+    TEST_TRACE stTest = { 10, FALSE };
+    RT_TRACE_INFO stInfo;
+    static RT_TRACE_EVENT stEvents[LIM_TRACE_CPUS * 256];
+    CHAR strName[MAX_NAME_LENGTH];
+
+    EXPECT_EQ(-EINVAL, start_trace(256, 5));
+    EXPECT_EQ(RET_SUCC, start_trace(200, eTraceFlightRecorder));
+    EXPECT_EQ(-EBUSY, start_trace(256, eTraceContinuous));
+    EXPECT_FALSE(is_trace_frozen());
+
+    test_trace_run(&stTask, &stTest, (const PCHAR)"TRACEFR");
+
+    // the buffer stopped at the first overrun
+    EXPECT_TRUE(is_trace_frozen());
+    EXPECT_EQ(RET_SUCC, get_trace_info(&stInfo));
+    EXPECT_TRUE(stInfo.bActive);
+    EXPECT_EQ(256u, stInfo.uEventsPerCpu);
+    EXPECT_STREQ("TRACEFR", stInfo.strFrozenBy);
+
+    INT nCnt = read_trace_events(stEvents, sizeof(stEvents) / sizeof(stEvents[0]));
+    ASSERT_GT(nCnt, 0);
+    EXPECT_EQ((UINT64)nCnt, stInfo.ullRecorded);
+    EXPECT_EQ(eTraceOverrun, stEvents[nCnt - 1].uType);
+    EXPECT_EQ(RET_SUCC, get_trace_task_name(stEvents[nCnt - 1].uTask, strName));
+    EXPECT_STREQ("TRACEFR", strName);
+
+    INT nTypes[eTraceTypeCnt] = { 0 };
+    for (INT nIdx = 0; nIdx < nCnt; nIdx++)
+    {
+        nTypes[stEvents[nIdx].uType]++;
+        // the task records its own cycle events, the creation is recorded by the caller
+        if (stEvents[nIdx].uType == eTraceWakeup || stEvents[nIdx].uType == eTraceUser)
+        {
+            EXPECT_EQ(stTask.nPid, stEvents[nIdx].nTid);
+        }
+        else if (stEvents[nIdx].uType == eTraceCreate)
+        {
+            EXPECT_EQ(gettid(), stEvents[nIdx].nTid);
+        }
+        if (nIdx > 0)
+        {
+            EXPECT_LE(stEvents[nIdx - 1].rttStamp, stEvents[nIdx].rttStamp);
+        }
+    }
+    EXPECT_EQ(1, nTypes[eTraceCreate]);
+    EXPECT_EQ(1, nTypes[eTraceStart]);
+    EXPECT_EQ(1, nTypes[eTraceOverrun]);
+    EXPECT_EQ(0, nTypes[eTraceEnd]);
+    EXPECT_EQ(nTypes[eTraceRelease], nTypes[eTraceWakeup]);
+    EXPECT_GE(nTypes[eTraceWait], nTypes[eTraceWakeup]);
+    EXPECT_GE(nTypes[eTraceUser], 1);
+
+    // the export holds the same events, the task is named and the overrun is there
+    EXPECT_EQ(nCnt, export_trace_json((const PCHAR)TEST_TRACE_PATH));
+    FILE* pFile = fopen(TEST_TRACE_PATH, "r");
+    ASSERT_TRUE(pFile != NULL);
+    static CHAR strJson[1 << 20];
+    size_t ulLen = fread(strJson, 1, sizeof(strJson) - 1, pFile);
+    fclose(pFile);
+    strJson[ulLen] = '\0';
+    EXPECT_TRUE(strstr(strJson, "\"traceEvents\"") != NULL);
+    EXPECT_TRUE(strstr(strJson, "\"thread_name\"") != NULL);
+    EXPECT_TRUE(strstr(strJson, "\"TRACEFR\"") != NULL);
+    EXPECT_TRUE(strstr(strJson, "\"name\":\"overrun\"") != NULL);
+    EXPECT_TRUE(strstr(strJson, "\"ph\":\"B\"") != NULL);
+    // a job ends only if the overrun was not the first wakeup
+    if (nTypes[eTraceWakeup] > 1)
+    {
+        EXPECT_TRUE(strstr(strJson, "\"ph\":\"E\"") != NULL);
+    }
+    unlink(TEST_TRACE_PATH);
+
+    EXPECT_EQ(RET_SUCC, rearm_trace());
+    EXPECT_FALSE(is_trace_frozen());
+    EXPECT_EQ(RET_SUCC, stop_trace());
+    EXPECT_EQ(-EINVAL, stop_trace());
+    EXPECT_EQ(-EINVAL, rearm_trace());
+}
+
+TEST(testRTTRACE, continuous)
+{
+    POSIX_TASK stTask;
+    TEST_TRACE stTest = { -1, FALSE };
+    RT_TRACE_INFO stInfo;
+    static RT_TRACE_EVENT stEvents[LIM_TRACE_CPUS * 64];
+
+    // the rings keep only the newest events and never freeze
+    EXPECT_EQ(RET_SUCC, start_trace(64, eTraceContinuous));
+    test_trace_run(&stTask, &stTest, (const PCHAR)"TRACECO");
+    usleep(10000);
+    EXPECT_EQ(RET_SUCC, stop_trace());
+    EXPECT_FALSE(is_trace_frozen());
+
+    EXPECT_EQ(RET_SUCC, get_trace_info(&stInfo));
+    EXPECT_FALSE(stInfo.bActive);
+    EXPECT_GE(stInfo.ullRecorded, (UINT64)TEST_TRACE_CYCLES * 4);
+    INT nCnt = read_trace_events(stEvents, sizeof(stEvents) / sizeof(stEvents[0]));
+    EXPECT_EQ(stInfo.ullRecorded - stInfo.ullLost, (UINT64)nCnt);
+    EXPECT_EQ(eTraceEnd, stEvents[nCnt - 1].uType);
+
+    // nothing is recorded once stopped
+    EXPECT_EQ(RET_SUCC, suspend_task(&stTask));
+    EXPECT_EQ(RET_SUCC, get_trace_info(&stInfo));
+    EXPECT_EQ((UINT64)nCnt, stInfo.ullRecorded - stInfo.ullLost);
+}
+
+TEST(testRTTRACE, task_table_per_session)
+{
+    POSIX_TASK stTask;
+    RT_TRACE_EVENT stEvents[LIM_TRACE_CPUS * 16];
+    CHAR strName[MAX_NAME_LENGTH];
+
+    // more sessions than table entries, every session starts with an empty table
+    for (INT nSession = 0; nSession < LIM_TRACE_TASKS + 4; nSession++)
+    {
+        ASSERT_EQ(RET_SUCC, start_trace(16, eTraceContinuous));
+        for (INT nIdx = 0; nIdx < 2; nIdx++)
+        {
+            // a re-created task claims a new entry of the same session
+            ASSERT_EQ(RET_SUCC, create_rt_task(&stTask, (const PCHAR)"TRACETBL", 0, 60));
+            EXPECT_EQ(RET_SUCC, delete_task(&stTask));
+        }
+        EXPECT_EQ(RET_SUCC, stop_trace());
+
+        INT nCnt = read_trace_events(stEvents, sizeof(stEvents) / sizeof(stEvents[0]));
+        ASSERT_EQ(2, nCnt);
+        for (INT nIdx = 0; nIdx < nCnt; nIdx++)
+        {
+            EXPECT_EQ(eTraceCreate, stEvents[nIdx].uType);
+            ASSERT_EQ((UINT16)nIdx, stEvents[nIdx].uTask);
+            EXPECT_EQ(RET_SUCC, get_trace_task_name(stEvents[nIdx].uTask, strName));
+            EXPECT_STREQ("TRACETBL", strName);
+        }
+    }
+}
@@ -12,6 +12,19 @@
  */
  #include "UnitTest.h"
  #include "TestRTPosix.cpp"
+ #include "TestRTQueue.cpp"
+ #include "TestRTPool.cpp"
+ #include "TestRTTelemetry.cpp"
+ #include "TestRTSched.cpp"
+ #include "TestRTSync.cpp"
+ #include "TestRTGroup.cpp"
+ #include "TestRTParallel.cpp"
+ #include "TestRTOffload.cpp"
+ #include "TestRTTrace.cpp"
+ #include "TestRTCpp.cpp"
+ #include "TestRTSystem.cpp"
+ #include "TestRTCyclic.cpp"
+ #include "TestRTLatest.cpp"
 
  int main(int argc, char **argv) 
  {
@@ -0,0 +1,186 @@
+/*
+ *  This file is owned by the Embedded Systems Laboratory of Seoul National University of Science and Technology
+ *  as a part of RT-AIDE or the RTOS-Agnostic and Interoperable Development Environment for Real-time Systems
+ *
+ *  File: rtposix-top.c
+ *  Author: 2022 Raimarius Delgado
+ *  Description: top-like live view of the tasks of an rt_posix process, read from its shared-memory telemetry
+ *
+ *
+ *
+ *
+*/
+#include "rt_telemetry.h"
+#include <dirent.h>
+#include <getopt.h>
+
+#define DEFAULT_DELAY_MS	(1000)
+
+static volatile BOOL g_bStop = FALSE;
+
+/*****************************************************************************/
+static void
+top_signal_handler(int nSignal)
+{
+	g_bStop = TRUE;
+}
+/*****************************************************************************/
+static void
+print_usage(const char* astrProgram)
+{
+	printf("usage: %s [options]\n", astrProgram);
+	printf("  -p <pid>     process to watch (default: the only rt_posix process publishing telemetry)\n");
+	printf("  -d <ms>      refresh interval in milliseconds (default %d)\n", DEFAULT_DELAY_MS);
+	printf("  -n <count>   number of refreshes before exiting (default: until interrupted)\n");
+	printf("  -b           batch mode, no screen clearing\n");
+}
+/*****************************************************************************/
+static PID
+find_process(VOID)
+{
+	// every publishing process has a /dev/shm/rtposix.<pid> entry
+	PID nFound = 0;
+	INT nCnt = 0;
+	DIR* pDir = opendir("/dev/shm");
+	if (pDir == NULL)
+		return 0;
+
+	struct dirent* pEntry;
+	while ((pEntry = readdir(pDir)) != NULL)
+	{
+		INT nPid;
+		if (sscanf(pEntry->d_name, "rtposix.%d", &nPid) == 1 && kill(nPid, 0) == 0)
+		{
+			nFound = nPid;
+			nCnt++;
+		}
+	}
+	closedir(pDir);
+
+	if (nCnt > 1)
+	{
+		fprintf(stderr, "more than one rt_posix process is publishing telemetry, select one with -p\n");
+		return 0;
+	}
+	return nFound;
+}
+/*****************************************************************************/
+static const char*
+get_status_name(DWORD adwStatus)
+{
+	switch (adwStatus)
+	{
+	case eReady:		return "READY";
+	case ePendingStart:	return "START";
+	case eWaiting:		return "WAIT";
+	case eRunning:		return "RUN";
+	case eSuspended:	return "SUSP";
+	case eDead:			return "DEAD";
+	default:			return "?";
+	}
+}
+/*****************************************************************************/
+static const char*
+get_policy_name(INT anPolicy)
+{
+	switch (anPolicy)
+	{
+	case SCHED_FIFO:		return "FIFO";
+	case SCHED_DEADLINE:	return "DL";
+	default:				return "OTHER";
+	}
+}
+/*****************************************************************************/
+static void
+print_region(RT_TELEMETRY_REGION* apRegion)
+{
+	printf("rtposix-top - %s (pid %d)\n\n", apRegion->stHeader.strProcess, (INT)apRegion->stHeader.nPid);
+	printf("%-16s %7s %-5s %-5s %4s %10s %10s %8s %9s %9s %9s %9s %9s\n",
+		"NAME", "TID", "STATE", "POL", "PRIO", "PERIOD(us)", "CYCLES", "OVERRUN",
+		"LAT(us)", "LATAVG", "LATMAX", "EXEC(us)", "EXECMAX");
+
+	for (UINT32 uIdx = 0; uIdx < apRegion->stHeader.uRecordCnt; uIdx++)
+	{
+		RT_TELEMETRY_RECORD stRecord;
+		if (read_telemetry_record(apRegion, uIdx, &stRecord) != RET_SUCC)
+			continue;
+
+		double dLatAvg = (stRecord.ullCycles > 0) ? (double)stRecord.ullLatSum / (double)stRecord.ullCycles / 1000.0 : 0.0;
+		printf("%-16.16s %7d %-5s %-5s %4d %10.1f %10llu %8llu %9.1f %9.1f %9.1f %9.1f %9.1f\n",
+			stRecord.strName, (INT)stRecord.nPid, get_status_name(stRecord.dwStatus), get_policy_name(stRecord.nSchedPolicy),
+			stRecord.nPriority, (double)stRecord.ullPeriod / 1000.0,
+			(unsigned long long)stRecord.ullCycles, (unsigned long long)stRecord.ullOverruns,
+			(double)stRecord.ullLatLast / 1000.0, dLatAvg, (double)stRecord.ullLatMax / 1000.0,
+			(double)stRecord.ullExecLast / 1000.0, (double)stRecord.ullExecMax / 1000.0);
+	}
+	fflush(stdout);
+}
+/*****************************************************************************/
+int
+main(int argc, char** argv)
+{
+	PID nPid = 0;
+	INT nDelayMs = DEFAULT_DELAY_MS;
+	INT nCount = 0;
+	BOOL bBatch = FALSE;
+	int nOpt;
+
+	init_lowlevel_logger(FALSE);
+	while ((nOpt = getopt(argc, argv, "p:d:n:bh")) != -1)
+	{
+		switch (nOpt)
+		{
+		case 'p':
+			nPid = (PID)atoi(optarg);
+			break;
+		case 'd':
+			nDelayMs = atoi(optarg);
+			break;
+		case 'n':
+			nCount = atoi(optarg);
+			break;
+		case 'b':
+			bBatch = TRUE;
+			break;
+		default:
+			print_usage(argv[0]);
+			return (nOpt == 'h') ? 0 : 1;
+		}
+	}
+
+	if (nPid == 0 && (nPid = find_process()) == 0)
+	{
+		fprintf(stderr, "no rt_posix process with telemetry found (call start_telemetry() in the application)\n");
+		return 1;
+	}
+
+	RT_TELEMETRY_REGION* pRegion;
+	INT nRet = open_telemetry(nPid, &pRegion);
+	if (nRet != RET_SUCC)
+	{
+		fprintf(stderr, "failed to open the telemetry of pid %d (%d:%s)\n", (INT)nPid, nRet, strerror(-nRet));
+		return 1;
+	}
+
+	// the library installs its own handlers, we want Ctrl-C to end the tool
+	signal(SIGINT, top_signal_handler);
+	signal(SIGTERM, top_signal_handler);
+
+	for (INT nIter = 0; g_bStop == FALSE && (nCount == 0 || nIter < nCount); nIter++)
+	{
+		if (nIter > 0)
+			usleep((useconds_t)nDelayMs * 1000);
+		if (bBatch == FALSE)
+			printf("\033[H\033[2J");
+		print_region(pRegion);
+		if (bBatch == TRUE)
+			printf("\n");
+
+		// the process has gone or stopped its telemetry
+		if (__atomic_load_n(&pRegion->stHeader.uMagic, __ATOMIC_ACQUIRE) != RT_TELEMETRY_MAGIC || kill(nPid, 0) != 0)
+			break;
+	}
+
+	close_telemetry(pRegion);
+	return 0;
+}
@@ -0,0 +1,15 @@
+#!/bin/bash 
+## This is a project made within Seoul National University of Science and Technology 
+## Embedded Systems Laboratory 2018 - Raimarius Tolentino Delgado 
+
+## Start-up for dynamically linked executable file 
+
+export LD_LIBRARY_PATH=:../lib 
+cur_dir=.
+
+if [[ -x $1 ]]
+then
+	 ${cur_dir}/$1 "${@:2}"
+else
+	 echo run with executable file
+fi